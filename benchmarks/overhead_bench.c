@@ -0,0 +1,169 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+// Microbenchmark for measuring the profiler's per-call overhead. It runs one
+// collective in a tight loop - after a warmup phase that also absorbs the
+// profiler's lazy initialization - and prints the mean and minimum time per
+// call as a single machine-readable line:
+//
+//   BENCH <collective> np=<n> msgsize=<ints/peer> calls=<n> mean_us=<f> min_us=<f>
+//
+// The run_overhead_matrix.sh driver launches it under every preload variant
+// and subtracts the no-preload baseline to get per-feature costs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mpi.h"
+
+#define MPICHECK(c)                                  \
+    do                                               \
+    {                                                \
+        if (c != MPI_SUCCESS)                        \
+        {                                            \
+            fprintf(stderr, "MPI command failed\n"); \
+            return 1;                                \
+        }                                            \
+    } while (0);
+
+#define DEFAULT_MSG_SIZE (16)
+#define DEFAULT_NUM_CALLS (1000)
+#define DEFAULT_NUM_WARMUP (100)
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s <alltoallv|alltoall|allgatherv> [msgsize] [calls] [warmup]\n", argv0);
+    fprintf(stderr, "  msgsize: ints sent to each peer (default %d)\n", DEFAULT_MSG_SIZE);
+    fprintf(stderr, "  calls:   timed iterations (default %d)\n", DEFAULT_NUM_CALLS);
+    fprintf(stderr, "  warmup:  untimed iterations (default %d)\n", DEFAULT_NUM_WARMUP);
+}
+
+int main(int argc, char **argv)
+{
+    int i, n;
+    int world_size;
+    int world_rank;
+    int msg_size = DEFAULT_MSG_SIZE;
+    int num_calls = DEFAULT_NUM_CALLS;
+    int num_warmup = DEFAULT_NUM_WARMUP;
+
+    if (argc < 2)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    const char *collective = argv[1];
+    if (strcmp(collective, "alltoallv") != 0 && strcmp(collective, "alltoall") != 0 &&
+        strcmp(collective, "allgatherv") != 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (argc > 2)
+    {
+        msg_size = atoi(argv[2]);
+    }
+    if (argc > 3)
+    {
+        num_calls = atoi(argv[3]);
+    }
+    if (argc > 4)
+    {
+        num_warmup = atoi(argv[4]);
+    }
+
+    MPICHECK(MPI_Init(&argc, &argv));
+    MPICHECK(MPI_Comm_size(MPI_COMM_WORLD, &world_size));
+    MPICHECK(MPI_Comm_rank(MPI_COMM_WORLD, &world_rank));
+
+    int *send_buffer = (int *)calloc((size_t)world_size * msg_size, sizeof(int));
+    int *recv_buffer = (int *)calloc((size_t)world_size * msg_size, sizeof(int));
+    int *send_count = calloc(world_size, sizeof(int));
+    int *recv_count = calloc(world_size, sizeof(int));
+    int *send_displ = calloc(world_size, sizeof(int));
+    int *recv_displ = calloc(world_size, sizeof(int));
+    if (!send_buffer || !recv_buffer || !send_count || !recv_count || !send_displ || !recv_displ)
+    {
+        fprintf(stderr, "Out of resources\n");
+        return 1;
+    }
+
+    for (i = 0; i < world_size; i++)
+    {
+        send_count[i] = msg_size;
+        recv_count[i] = msg_size;
+        send_displ[i] = i * msg_size;
+        recv_displ[i] = i * msg_size;
+    }
+    for (i = 0; i < world_size * msg_size; i++)
+    {
+        send_buffer[i] = world_rank;
+    }
+
+    double t_min = 0.0;
+    double t_total = 0.0;
+
+    for (n = 0; n < num_warmup + num_calls; n++)
+    {
+        // Keep the ranks in lockstep so a single slow call does not skew the
+        // per-call times of everyone's next iteration.
+        MPICHECK(MPI_Barrier(MPI_COMM_WORLD));
+        double t_start = MPI_Wtime();
+
+        if (strcmp(collective, "alltoallv") == 0)
+        {
+            MPICHECK(MPI_Alltoallv(send_buffer, send_count, send_displ, MPI_INT,
+                                   recv_buffer, recv_count, recv_displ, MPI_INT,
+                                   MPI_COMM_WORLD));
+        }
+        else if (strcmp(collective, "alltoall") == 0)
+        {
+            MPICHECK(MPI_Alltoall(send_buffer, msg_size, MPI_INT,
+                                  recv_buffer, msg_size, MPI_INT,
+                                  MPI_COMM_WORLD));
+        }
+        else
+        {
+            MPICHECK(MPI_Allgatherv(send_buffer, msg_size, MPI_INT,
+                                    recv_buffer, recv_count, recv_displ, MPI_INT,
+                                    MPI_COMM_WORLD));
+        }
+
+        double elapsed = MPI_Wtime() - t_start;
+        if (n < num_warmup)
+        {
+            continue;
+        }
+        t_total += elapsed;
+        if (t_min == 0.0 || elapsed < t_min)
+        {
+            t_min = elapsed;
+        }
+    }
+
+    // Overhead is a property of the slowest rank: a call is only done once
+    // every rank is done with its profiling work.
+    double t_total_max, t_min_max;
+    MPICHECK(MPI_Reduce(&t_total, &t_total_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD));
+    MPICHECK(MPI_Reduce(&t_min, &t_min_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD));
+
+    if (world_rank == 0)
+    {
+        printf("BENCH %s np=%d msgsize=%d calls=%d mean_us=%.3f min_us=%.3f\n",
+               collective, world_size, msg_size, num_calls,
+               t_total_max / num_calls * 1e6, t_min_max * 1e6);
+    }
+
+    free(send_buffer);
+    free(recv_buffer);
+    free(send_count);
+    free(recv_count);
+    free(send_displ);
+    free(recv_displ);
+
+    MPICHECK(MPI_Finalize());
+    return 0;
+}
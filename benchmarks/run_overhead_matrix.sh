@@ -0,0 +1,110 @@
+#!/bin/bash
+#
+# Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+# See LICENSE.txt for license information
+#
+# Runs overhead_bench across a matrix of {collective, comm size, message size,
+# call count} x {no preload, profiler variants} and emits one TSV row per
+# cell with the measured per-call time and the overhead versus the no-preload
+# baseline of the same cell. Intended use: run it before and after a change to
+# the hot path and diff the tables.
+#
+# Environment knobs (all optional):
+#   BENCH_NP_LIST       comm sizes, default "2 4"
+#   BENCH_MSGSIZE_LIST  ints per peer, default "1 16 256"
+#   BENCH_CALLS         timed calls per cell, default 1000
+#   BENCH_WARMUP        warmup calls per cell, default 100
+#   BENCH_COLLECTIVES   default "alltoallv alltoall allgatherv"
+#   BENCH_OUTPUT_DIR    where profile files land, default a fresh temp dir
+#   MPIRUN_FLAGS        extra flags for mpirun (e.g. --oversubscribe)
+
+set -u
+
+BENCH_DIR="$(cd "$(dirname "$0")" && pwd)"
+REPO_DIR="$(dirname "$BENCH_DIR")"
+
+NP_LIST="${BENCH_NP_LIST:-2 4}"
+MSGSIZE_LIST="${BENCH_MSGSIZE_LIST:-1 16 256}"
+CALLS="${BENCH_CALLS:-1000}"
+WARMUP="${BENCH_WARMUP:-100}"
+COLLECTIVES="${BENCH_COLLECTIVES:-alltoallv alltoall allgatherv}"
+MPIRUN_FLAGS="${MPIRUN_FLAGS:-}"
+
+if [ ! -x "$BENCH_DIR/overhead_bench" ]; then
+    echo "overhead_bench is not built; run make in benchmarks/" >&2
+    exit 1
+fi
+
+# Profile output is redirected to a scratch directory so benchmark runs do not
+# litter the working directory; discarded unless BENCH_OUTPUT_DIR is set.
+if [ -n "${BENCH_OUTPUT_DIR:-}" ]; then
+    OUTPUT_DIR="$BENCH_OUTPUT_DIR"
+    mkdir -p "$OUTPUT_DIR"
+    CLEANUP_OUTPUT=0
+else
+    OUTPUT_DIR="$(mktemp -d)"
+    CLEANUP_OUTPUT=1
+fi
+export A2A_PROFILING_OUTPUT_DIR="$OUTPUT_DIR"
+
+# Preload variants per collective. "none" is the baseline every other variant
+# is compared against.
+variants_for()
+{
+    local collective="$1"
+    local libdir="$REPO_DIR/src/$collective"
+    echo "none:"
+    echo "base:$libdir/lib$collective.so"
+    echo "counts:$libdir/lib${collective}_counts.so"
+    echo "exec_timings:$libdir/lib${collective}_exec_timings.so"
+    echo "backtrace:$libdir/lib${collective}_backtrace.so"
+    echo "location:$libdir/lib${collective}_location.so"
+}
+
+run_cell()
+{
+    local preload="$1" np="$2" collective="$3" msgsize="$4"
+    local out
+    out=$(LD_PRELOAD="$preload" mpirun -np "$np" $MPIRUN_FLAGS \
+          -x A2A_PROFILING_OUTPUT_DIR ${preload:+-x LD_PRELOAD} \
+          "$BENCH_DIR/overhead_bench" "$collective" "$msgsize" "$CALLS" "$WARMUP" </dev/null 2>/dev/null \
+          | grep '^BENCH ')
+    echo "$out" | sed -n 's/.*mean_us=\([0-9.]*\).*/\1/p'
+}
+
+printf "collective\tnp\tmsgsize\tcalls\tvariant\tmean_us\toverhead_us\n"
+
+for collective in $COLLECTIVES; do
+    for np in $NP_LIST; do
+        for msgsize in $MSGSIZE_LIST; do
+            baseline=""
+            while IFS=: read -r variant lib; do
+                if [ -n "$lib" ] && [ ! -f "$lib" ]; then
+                    printf "%s\t%s\t%s\t%s\t%s\tmissing\tmissing\n" \
+                        "$collective" "$np" "$msgsize" "$CALLS" "$variant" >&2
+                    continue
+                fi
+                mean_us=$(run_cell "$lib" "$np" "$collective" "$msgsize")
+                if [ -z "$mean_us" ]; then
+                    printf "%s\t%s\t%s\t%s\t%s\tfailed\tfailed\n" \
+                        "$collective" "$np" "$msgsize" "$CALLS" "$variant" >&2
+                    continue
+                fi
+                if [ "$variant" = "none" ]; then
+                    baseline="$mean_us"
+                    overhead="0.000"
+                else
+                    overhead=$(echo "$mean_us $baseline" | awk '{printf "%.3f", $1 - $2}')
+                fi
+                printf "%s\t%s\t%s\t%s\t%s\t%s\t%s\n" \
+                    "$collective" "$np" "$msgsize" "$CALLS" "$variant" "$mean_us" "$overhead"
+            done <<EOF
+$(variants_for "$collective")
+EOF
+        done
+    done
+done
+
+if [ "$CLEANUP_OUTPUT" = "1" ]; then
+    rm -rf "$OUTPUT_DIR"
+fi
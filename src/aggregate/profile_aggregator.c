@@ -0,0 +1,651 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+// profile_aggregator: native post-processing tool for the per-rank profiles
+// written by the collective profiler. A run on N ranks leaves behind N
+// send/recv counters files (send-counters.job<j>.rank<r>.txt) and up to one
+// timing file per rank and communicator
+// (<collective>_execution_times.rank<r>_comm<c>_job<j>.md); crunching them
+// with scripts does not scale. This tool mmaps every file, parses it with a
+// byte-level scanner (memchr for line splitting, hand-rolled integer
+// conversion - no sscanf in the hot loop), aggregates one file per worker
+// thread and merges the per-worker partial results at the end.
+//
+// Reported summaries:
+//   - per-phase byte totals (send / recv)
+//   - per-rank byte totals and the resulting imbalance metric (max/mean)
+//   - the heaviest talker pairs (src rank -> dest rank by bytes sent)
+//   - per-comm-rank execution time mean/max across all calls and files
+//
+// Usage: profile_aggregator [-t threads] [-p pairs] <profile directory>
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FILE_TYPE_SEND_COUNTS (0)
+#define FILE_TYPE_RECV_COUNTS (1)
+#define FILE_TYPE_TIMINGS (2)
+
+#define DEFAULT_TOP_PAIRS (20)
+
+typedef struct file_task
+{
+    char *path;
+    int type;
+} file_task_t;
+
+// Square matrix of byte totals indexed [src][dest]; grown when a counts file
+// reports a larger communicator than anything seen before.
+typedef struct pair_matrix
+{
+    uint64_t *bytes;
+    int dim;
+} pair_matrix_t;
+
+// Per-comm-rank timing accumulators. Indexed by the rank's position in its
+// communicator, which is how the timing files are laid out.
+typedef struct timing_stats
+{
+    double *sum;
+    double *max;
+    uint64_t *samples;
+    int dim;
+} timing_stats_t;
+
+// One aggregate per worker thread; merged under no lock once all workers
+// joined.
+typedef struct aggregate
+{
+    pair_matrix_t send_pairs;
+    pair_matrix_t recv_pairs;
+    uint64_t send_bytes;
+    uint64_t recv_bytes;
+    timing_stats_t timings;
+    uint64_t files_parsed;
+    uint64_t parse_errors;
+} aggregate_t;
+
+typedef struct worker_args
+{
+    file_task_t *tasks;
+    int num_tasks;
+    int *next_task; // Shared cursor, advanced with an atomic fetch-add
+    aggregate_t agg;
+} worker_args_t;
+
+static void pair_matrix_reserve(pair_matrix_t *m, int dim)
+{
+    if (dim <= m->dim)
+    {
+        return;
+    }
+    uint64_t *grown = (uint64_t *)calloc((size_t)dim * dim, sizeof(uint64_t));
+    assert(grown);
+    int i;
+    for (i = 0; i < m->dim; i++)
+    {
+        memcpy(&grown[(size_t)i * dim], &m->bytes[(size_t)i * m->dim], m->dim * sizeof(uint64_t));
+    }
+    free(m->bytes);
+    m->bytes = grown;
+    m->dim = dim;
+}
+
+static void timing_stats_reserve(timing_stats_t *t, int dim)
+{
+    if (dim <= t->dim)
+    {
+        return;
+    }
+    t->sum = (double *)realloc(t->sum, dim * sizeof(double));
+    t->max = (double *)realloc(t->max, dim * sizeof(double));
+    t->samples = (uint64_t *)realloc(t->samples, dim * sizeof(uint64_t));
+    assert(t->sum);
+    assert(t->max);
+    assert(t->samples);
+    int i;
+    for (i = t->dim; i < dim; i++)
+    {
+        t->sum[i] = 0.0;
+        t->max[i] = 0.0;
+        t->samples[i] = 0;
+    }
+    t->dim = dim;
+}
+
+// Byte-level scanning helpers. The cursor is advanced in place; none of them
+// read past <end>.
+
+static const char *skip_spaces(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+    return p;
+}
+
+static uint64_t parse_u64(const char **cursor, const char *end)
+{
+    const char *p = *cursor;
+    uint64_t value = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        value = value * 10 + (uint64_t)(*p - '0');
+        p++;
+    }
+    *cursor = p;
+    return value;
+}
+
+// Find the next line and return its start; *cursor moves past the newline.
+static const char *next_line(const char **cursor, const char *end, size_t *len)
+{
+    const char *p = *cursor;
+    if (p >= end)
+    {
+        return NULL;
+    }
+    const char *nl = (const char *)memchr(p, '\n', end - p);
+    if (nl == NULL)
+    {
+        nl = end;
+    }
+    *len = nl - p;
+    *cursor = (nl < end) ? nl + 1 : end;
+    return p;
+}
+
+static int line_starts_with(const char *line, size_t len, const char *prefix)
+{
+    size_t plen = strlen(prefix);
+    return len >= plen && memcmp(line, prefix, plen) == 0;
+}
+
+// Parse one "Rank(s) <list>: c0 c1 ..." row. The rank list uses the profiler's
+// compressed notation ("0-3, 5"); the counters vector applies to every rank in
+// the list. Byte totals are weighted by the number of calls the data set
+// covers.
+static void parse_counts_row(const char *line, const char *end, int comm_size,
+                             int type_size, uint64_t num_calls,
+                             pair_matrix_t *pairs, uint64_t *phase_bytes)
+{
+    const char *p = line + strlen("Rank(s) ");
+    const char *colon = (const char *)memchr(p, ':', end - p);
+    if (colon == NULL)
+    {
+        return;
+    }
+
+    const char *counts_start = colon + 1;
+    int n;
+
+    // The counters vector is identical for all ranks of the row: accumulate it
+    // once into a per-dest scratch pass, then credit each source rank.
+    const char *list_cursor = p;
+    while (list_cursor < colon)
+    {
+        list_cursor = skip_spaces(list_cursor, colon);
+        uint64_t first = parse_u64(&list_cursor, colon);
+        uint64_t last = first;
+        if (list_cursor < colon && *list_cursor == '-')
+        {
+            list_cursor++;
+            last = parse_u64(&list_cursor, colon);
+        }
+        if (list_cursor < colon && *list_cursor == ',')
+        {
+            list_cursor++;
+        }
+
+        uint64_t src;
+        for (src = first; src <= last && src < (uint64_t)comm_size; src++)
+        {
+            uint64_t *row = &pairs->bytes[src * (size_t)pairs->dim];
+            const char *c = counts_start;
+            for (n = 0; n < comm_size && c < end; n++)
+            {
+                c = skip_spaces(c, end);
+                uint64_t bytes = parse_u64(&c, end) * (uint64_t)type_size * num_calls;
+                row[n] += bytes;
+                *phase_bytes += bytes;
+            }
+        }
+    }
+}
+
+// Parse a send-counters/recv-counters file. Each file holds one "# Raw
+// counters" section per data set, with a small header (communicator size,
+// datatype size, covered calls) followed by the compressed rows between
+// BEGINNING DATA and END DATA.
+static int parse_counts_file(const char *data, size_t size, pair_matrix_t *pairs,
+                             uint64_t *phase_bytes)
+{
+    const char *cursor = data;
+    const char *end = data + size;
+    const char *line;
+    size_t len;
+    int comm_size = 0;
+    int type_size = 0;
+    uint64_t num_calls = 0;
+    int in_data = 0;
+
+    while ((line = next_line(&cursor, end, &len)) != NULL)
+    {
+        if (in_data)
+        {
+            if (line_starts_with(line, len, "END DATA"))
+            {
+                in_data = 0;
+            }
+            else if (line_starts_with(line, len, "Rank(s) "))
+            {
+                parse_counts_row(line, line + len, comm_size, type_size, num_calls, pairs, phase_bytes);
+            }
+            continue;
+        }
+
+        if (line_starts_with(line, len, "Number of ranks: "))
+        {
+            const char *p = line + strlen("Number of ranks: ");
+            comm_size = (int)parse_u64(&p, line + len);
+        }
+        else if (line_starts_with(line, len, "Datatype size: "))
+        {
+            const char *p = line + strlen("Datatype size: ");
+            type_size = (int)parse_u64(&p, line + len);
+        }
+        else if (line_starts_with(line, len, "Count: "))
+        {
+            const char *p = line + strlen("Count: ");
+            num_calls = parse_u64(&p, line + len);
+        }
+        else if (line_starts_with(line, len, "BEGINNING DATA"))
+        {
+            if (comm_size <= 0 || type_size <= 0)
+            {
+                return 1;
+            }
+            pair_matrix_reserve(pairs, comm_size);
+            in_data = 1;
+        }
+    }
+    return 0;
+}
+
+// Parse a timing file: "# Call <id>" followed by one time per comm rank.
+static int parse_timings_file(const char *data, size_t size, timing_stats_t *stats)
+{
+    const char *cursor = data;
+    const char *end = data + size;
+    const char *line;
+    size_t len;
+    int rank = 0;
+
+    while ((line = next_line(&cursor, end, &len)) != NULL)
+    {
+        if (len == 0 || line[0] == '#')
+        {
+            rank = 0;
+            continue;
+        }
+
+        char buf[64];
+        if (len >= sizeof(buf))
+        {
+            return 1;
+        }
+        memcpy(buf, line, len);
+        buf[len] = '\0';
+        double t = strtod(buf, NULL);
+
+        timing_stats_reserve(stats, rank + 1);
+        stats->sum[rank] += t;
+        if (t > stats->max[rank])
+        {
+            stats->max[rank] = t;
+        }
+        stats->samples[rank]++;
+        rank++;
+    }
+    return 0;
+}
+
+static int process_file(file_task_t *task, aggregate_t *agg)
+{
+    int fd = open(task->path, O_RDONLY);
+    if (fd == -1)
+    {
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size == 0)
+    {
+        close(fd);
+        return st.st_size == 0 ? 0 : 1;
+    }
+
+    char *data = (char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return 1;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    int rc = 0;
+    switch (task->type)
+    {
+    case FILE_TYPE_SEND_COUNTS:
+        rc = parse_counts_file(data, st.st_size, &(agg->send_pairs), &(agg->send_bytes));
+        break;
+    case FILE_TYPE_RECV_COUNTS:
+        rc = parse_counts_file(data, st.st_size, &(agg->recv_pairs), &(agg->recv_bytes));
+        break;
+    case FILE_TYPE_TIMINGS:
+        rc = parse_timings_file(data, st.st_size, &(agg->timings));
+        break;
+    }
+
+    munmap(data, st.st_size);
+    return rc;
+}
+
+static void *worker_main(void *arg)
+{
+    worker_args_t *args = (worker_args_t *)arg;
+
+    while (1)
+    {
+        int idx = __atomic_fetch_add(args->next_task, 1, __ATOMIC_RELAXED);
+        if (idx >= args->num_tasks)
+        {
+            break;
+        }
+        if (process_file(&(args->tasks[idx]), &(args->agg)))
+        {
+            fprintf(stderr, "[WARNING] unable to parse %s\n", args->tasks[idx].path);
+            args->agg.parse_errors++;
+        }
+        else
+        {
+            args->agg.files_parsed++;
+        }
+    }
+    return NULL;
+}
+
+static void merge_pair_matrix(pair_matrix_t *into, pair_matrix_t *from)
+{
+    if (from->dim == 0)
+    {
+        return;
+    }
+    pair_matrix_reserve(into, from->dim);
+    int i, j;
+    for (i = 0; i < from->dim; i++)
+    {
+        for (j = 0; j < from->dim; j++)
+        {
+            into->bytes[(size_t)i * into->dim + j] += from->bytes[(size_t)i * from->dim + j];
+        }
+    }
+}
+
+static void merge_aggregate(aggregate_t *into, aggregate_t *from)
+{
+    merge_pair_matrix(&(into->send_pairs), &(from->send_pairs));
+    merge_pair_matrix(&(into->recv_pairs), &(from->recv_pairs));
+    into->send_bytes += from->send_bytes;
+    into->recv_bytes += from->recv_bytes;
+    timing_stats_reserve(&(into->timings), from->timings.dim);
+    int i;
+    for (i = 0; i < from->timings.dim; i++)
+    {
+        into->timings.sum[i] += from->timings.sum[i];
+        if (from->timings.max[i] > into->timings.max[i])
+        {
+            into->timings.max[i] = from->timings.max[i];
+        }
+        into->timings.samples[i] += from->timings.samples[i];
+    }
+    into->files_parsed += from->files_parsed;
+    into->parse_errors += from->parse_errors;
+}
+
+static int classify_file(const char *name)
+{
+    if (strncmp(name, "send-counters.", strlen("send-counters.")) == 0)
+    {
+        return FILE_TYPE_SEND_COUNTS;
+    }
+    if (strncmp(name, "recv-counters.", strlen("recv-counters.")) == 0)
+    {
+        return FILE_TYPE_RECV_COUNTS;
+    }
+    if (strstr(name, "_execution_times.rank") != NULL)
+    {
+        return FILE_TYPE_TIMINGS;
+    }
+    return -1;
+}
+
+static void report_top_pairs(pair_matrix_t *pairs, int top_n)
+{
+    int reported;
+    for (reported = 0; reported < top_n; reported++)
+    {
+        uint64_t best = 0;
+        int best_src = -1, best_dst = -1;
+        int i, j;
+        for (i = 0; i < pairs->dim; i++)
+        {
+            for (j = 0; j < pairs->dim; j++)
+            {
+                uint64_t b = pairs->bytes[(size_t)i * pairs->dim + j];
+                if (b > best)
+                {
+                    best = b;
+                    best_src = i;
+                    best_dst = j;
+                }
+            }
+        }
+        if (best_src == -1)
+        {
+            break;
+        }
+        printf("  %d -> %d: %" PRIu64 " bytes\n", best_src, best_dst, best);
+        // Knock the winner out so the next scan finds the runner-up
+        pairs->bytes[(size_t)best_src * pairs->dim + best_dst] = 0;
+    }
+}
+
+static void report_imbalance(pair_matrix_t *pairs)
+{
+    if (pairs->dim == 0)
+    {
+        printf("  no count data\n");
+        return;
+    }
+
+    uint64_t max_total = 0, grand_total = 0;
+    int max_rank = 0;
+    int i, j;
+    for (i = 0; i < pairs->dim; i++)
+    {
+        uint64_t row_total = 0;
+        for (j = 0; j < pairs->dim; j++)
+        {
+            row_total += pairs->bytes[(size_t)i * pairs->dim + j];
+        }
+        grand_total += row_total;
+        if (row_total > max_total)
+        {
+            max_total = row_total;
+            max_rank = i;
+        }
+    }
+
+    double mean = (double)grand_total / pairs->dim;
+    printf("  ranks: %d; mean: %.0f bytes/rank; max: %" PRIu64 " bytes (rank %d)\n",
+           pairs->dim, mean, max_total, max_rank);
+    if (mean > 0)
+    {
+        printf("  imbalance (max/mean): %.3f\n", (double)max_total / mean);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int top_pairs = DEFAULT_TOP_PAIRS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:p:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            num_threads = atoi(optarg);
+            break;
+        case 'p':
+            top_pairs = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-t threads] [-p pairs] <profile directory>\n", argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc)
+    {
+        fprintf(stderr, "Usage: %s [-t threads] [-p pairs] <profile directory>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *dir_path = argv[optind];
+    if (num_threads < 1)
+    {
+        num_threads = 1;
+    }
+
+    DIR *dir = opendir(dir_path);
+    if (dir == NULL)
+    {
+        fprintf(stderr, "[ERROR] unable to open %s\n", dir_path);
+        return EXIT_FAILURE;
+    }
+
+    file_task_t *tasks = NULL;
+    int num_tasks = 0, max_tasks = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        int type = classify_file(entry->d_name);
+        if (type == -1)
+        {
+            continue;
+        }
+        if (num_tasks == max_tasks)
+        {
+            max_tasks = max_tasks ? max_tasks * 2 : 256;
+            tasks = (file_task_t *)realloc(tasks, max_tasks * sizeof(file_task_t));
+            assert(tasks);
+        }
+        int rc = asprintf(&(tasks[num_tasks].path), "%s/%s", dir_path, entry->d_name);
+        assert(rc > 0);
+        tasks[num_tasks].type = type;
+        num_tasks++;
+    }
+    closedir(dir);
+
+    if (num_tasks == 0)
+    {
+        fprintf(stderr, "[ERROR] no profile files found in %s\n", dir_path);
+        return EXIT_FAILURE;
+    }
+    if (num_threads > num_tasks)
+    {
+        num_threads = num_tasks;
+    }
+
+    int next_task = 0;
+    worker_args_t *workers = (worker_args_t *)calloc(num_threads, sizeof(worker_args_t));
+    pthread_t *threads = (pthread_t *)malloc(num_threads * sizeof(pthread_t));
+    assert(workers);
+    assert(threads);
+
+    int i;
+    for (i = 0; i < num_threads; i++)
+    {
+        workers[i].tasks = tasks;
+        workers[i].num_tasks = num_tasks;
+        workers[i].next_task = &next_task;
+        pthread_create(&threads[i], NULL, worker_main, &workers[i]);
+    }
+
+    aggregate_t total;
+    memset(&total, 0, sizeof(total));
+    for (i = 0; i < num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+        merge_aggregate(&total, &(workers[i].agg));
+    }
+
+    printf("Aggregated %" PRIu64 " profile file(s) (%" PRIu64 " unparsable) with %d worker(s)\n\n",
+           total.files_parsed, total.parse_errors, num_threads);
+
+    printf("== Per-phase byte totals ==\n");
+    printf("  send: %" PRIu64 " bytes\n", total.send_bytes);
+    printf("  recv: %" PRIu64 " bytes\n\n", total.recv_bytes);
+
+    printf("== Send imbalance ==\n");
+    report_imbalance(&(total.send_pairs));
+    printf("\n== Heaviest talker pairs (by bytes sent) ==\n");
+    report_top_pairs(&(total.send_pairs), top_pairs);
+
+    printf("\n== Execution times per comm rank ==\n");
+    if (total.timings.dim == 0)
+    {
+        printf("  no timing data\n");
+    }
+    for (i = 0; i < total.timings.dim; i++)
+    {
+        if (total.timings.samples[i] == 0)
+        {
+            continue;
+        }
+        printf("  rank %d: mean %f s, max %f s (%" PRIu64 " sample(s))\n",
+               i, total.timings.sum[i] / total.timings.samples[i], total.timings.max[i],
+               total.timings.samples[i]);
+    }
+
+    for (i = 0; i < num_tasks; i++)
+    {
+        free(tasks[i].path);
+    }
+    free(tasks);
+    free(workers);
+    free(threads);
+    free(total.send_pairs.bytes);
+    free(total.recv_pairs.bytes);
+    free(total.timings.sum);
+    free(total.timings.max);
+    free(total.timings.samples);
+    return total.parse_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
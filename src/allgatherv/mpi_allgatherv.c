@@ -13,12 +13,21 @@
 #include "pattern.h"
 #include "execinfo.h"
 #include "timings.h"
+#include "comm.h"
 #include "backtrace.h"
 #include "location.h"
 #include "buff_content.h"
+#include "compress.h"
+#include "node_aggregate.h"
 #include "datatype.h"
+#include "bigcounts.h"
+
+// Count collection is handled by the shared engine; for allgatherv each rank
+// contributes a single send count and a communicator-size receive vector.
+#define COUNTS_ENGINE_SEND_VEC_LEN(size) (1)
+#define COUNTS_ENGINE_DEBUG DEBUG_ALLGATHERV_PROFILING
+#include "counts_engine.h"
 
-static SRCountNode_t *counts_head = NULL;
 static SRDisplNode_t *displs_head = NULL;
 static TimingsNode_t *op_timing_exec_head = NULL;
 static TimingsNode_t *op_timing_exec_tail = NULL;
@@ -33,7 +42,59 @@ static int world_rank = -1;
 static uint64_t allgathervCalls = 0;       // Total number of allgatherv calls that we went through (indexed on 0, not 1)
 static uint64_t allgathervCallsLogged = 0; // Total number of allgatherv calls for which we gathered data
 static uint64_t allgathervCallStart = -1;  // Number of allgatherv call during which we started to gather data
-static uint64_t dump_call_data = -1;
+// Call-data dumping window. DUMP_CALL_DATA accepts a comma-separated list of
+// call IDs and ranges (e.g. "4,7,10-12"); each selected call has its datatype
+// information and buffer content dumped while the application keeps running,
+// and the buffcontent loggers are released after every dump so a long window
+// does not accumulate open files.
+typedef struct dump_call_range
+{
+    uint64_t start;
+    uint64_t end; // inclusive
+} dump_call_range_t;
+
+static dump_call_range_t *dump_call_ranges = NULL;
+static int num_dump_call_ranges = 0;
+
+static void parse_dump_call_data(char *str)
+{
+    char *copy = strdup(str);
+    assert(copy);
+    char *token = strtok(copy, ",");
+    while (token != NULL)
+    {
+        dump_call_ranges = (dump_call_range_t *)realloc(dump_call_ranges, (num_dump_call_ranges + 1) * sizeof(dump_call_range_t));
+        assert(dump_call_ranges);
+        char *dash = strchr(token, '-');
+        if (dash != NULL)
+        {
+            *dash = '\0';
+            dump_call_ranges[num_dump_call_ranges].start = strtoull(token, NULL, 10);
+            dump_call_ranges[num_dump_call_ranges].end = strtoull(dash + 1, NULL, 10);
+        }
+        else
+        {
+            dump_call_ranges[num_dump_call_ranges].start = strtoull(token, NULL, 10);
+            dump_call_ranges[num_dump_call_ranges].end = dump_call_ranges[num_dump_call_ranges].start;
+        }
+        num_dump_call_ranges++;
+        token = strtok(NULL, ",");
+    }
+    free(copy);
+}
+
+static int dump_call_data_requested(uint64_t call_id)
+{
+    int i;
+    for (i = 0; i < num_dump_call_ranges; i++)
+    {
+        if (call_id >= dump_call_ranges[i].start && call_id <= dump_call_ranges[i].end)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
 
 static uint64_t _num_call_start_profiling = ALLGATHERV_NUM_CALL_START_PROFILING;
 static uint64_t _limit_av_calls = DEFAULT_LIMIT_ALLGATHERV_CALLS;
@@ -68,66 +129,26 @@ extern int mpi_fortran_bottom_;
 static int _finalize_profiling();
 static int _commit_data();
 
-static int *lookupRankRecvDispls(SRDisplNode_t *call_data, int rank)
-{
-    return lookup_rank_displs(call_data->recv_data_size, call_data->recv_data, rank);
-}
-
-static int *lookupRankSendCounters(SRCountNode_t *call_data, int rank)
-{
-    return lookup_rank_counters(call_data->send_data_size, call_data->send_data, rank);
-}
-
-static int *lookupRankRecvCounters(SRCountNode_t *call_data, int rank)
-{
-    return lookup_rank_counters(call_data->recv_data_size, call_data->recv_data, rank);
-}
-
-// Compare if two arrays are identical.
-static bool same_call_counters(SRCountNode_t *call_data, int *send_counts, int *recv_counts, int size)
+static displs_data_t *lookupRankRecvDisplsData(SRDisplNode_t *call_data, int rank)
 {
-    int num = 0;
-    int rank, count_num;
-
-    DEBUG_ALLGATHERV_PROFILING("Comparing data with existing data...\n");
-    DEBUG_ALLGATHERV_PROFILING("-> Comparing send counts...\n");
-    // First compare the send counts, each rank has a single count
-    for (rank = 0; rank < size; rank++)
-    {
-        int *_counts = lookupRankSendCounters(call_data, rank);
-        assert(_counts);
-        if (_counts[rank] != send_counts[num])
-        {
-            DEBUG_ALLGATHERV_PROFILING("Data differs\n");
-            return false;
-        }
-        num++;
-    }
-    DEBUG_ALLGATHERV_PROFILING("-> Send counts are the same\n");
-
-    // Then the receive counts
-    DEBUG_ALLGATHERV_PROFILING("-> Comparing recv counts...\n");
-    num = 0;
-    for (rank = 0; rank < size; rank++)
+    int i, j;
+    for (i = 0; i < call_data->recv_data_size; i++)
     {
-        int *_counts = lookupRankRecvCounters(call_data, rank);
-        for (count_num = 0; count_num < size; count_num++)
+        for (j = 0; j < call_data->recv_data[i]->num_ranks; j++)
         {
-            if (_counts[count_num] != recv_counts[num])
+            if (call_data->recv_data[i]->ranks[j] == rank)
             {
-                DEBUG_ALLGATHERV_PROFILING("Data differs\n");
-                return false;
+                return call_data->recv_data[i];
             }
-            num++;
         }
     }
-
-    DEBUG_ALLGATHERV_PROFILING("Data is the same\n");
-    return true;
+    return NULL;
 }
 
-// Compare if two arrays are identical.
-static bool same_call_displs(SRDisplNode_t *call_data, int *displs, int size)
+// Compare if two arrays are identical. derived flags one entry per rank whose
+// displacements are the prefix sum of its counts; those ranks match a stored
+// marker entry instead of a stored vector.
+static bool same_call_displs(SRDisplNode_t *call_data, int *derived, int *displs, int size)
 {
     int num = 0;
     int rank, displ_num;
@@ -139,11 +160,21 @@ static bool same_call_displs(SRDisplNode_t *call_data, int *displs, int size)
     num = 0;
     for (rank = 0; rank < size; rank++)
     {
-        int *_displs = lookupRankRecvDispls(call_data, rank);
-        assert(_displs);
+        displs_data_t *_data = lookupRankRecvDisplsData(call_data, rank);
+        assert(_data);
+        if (_data->derived_from_counts || derived[rank])
+        {
+            if (!_data->derived_from_counts || !derived[rank])
+            {
+                DEBUG_ALLGATHERV_PROFILING("Data differs\n");
+                return false;
+            }
+            num += size;
+            continue;
+        }
         for (displ_num = 0; displ_num < size; displ_num++)
         {
-            if (_displs[displ_num] != displs[num])
+            if (_data->displs[displ_num] != displs[num])
             {
                 DEBUG_ALLGATHERV_PROFILING("Data differs\n");
                 return false;
@@ -156,26 +187,22 @@ static bool same_call_displs(SRDisplNode_t *call_data, int *displs, int size)
     return true;
 }
 
-static counts_data_t *lookupCounters(int size, int num, counts_data_t **list, int *count)
+// Linear pass checking whether a displacement vector is the exclusive prefix
+// sum of the matching counts vector, in which case it carries no information
+// of its own and only a marker needs to be stored.
+static int displs_derived_from_counts(const int *counts, const int *displs, int size)
 {
-    int i, j;
-    for (i = 0; i < num; i++)
+    int i;
+    int offset = 0;
+    for (i = 0; i < size; i++)
     {
-        for (j = 0; j < size; j++)
-        {
-            if (count[j] != list[i]->counters[j])
-            {
-                break;
-            }
-        }
-
-        if (j == size)
+        if (displs[i] != offset)
         {
-            return list[i];
+            return 0;
         }
+        offset += counts[i];
     }
-
-    return NULL;
+    return 1;
 }
 
 static displs_data_t *lookupDispls(int size, int num, displs_data_t **list, int *displs)
@@ -183,6 +210,10 @@ static displs_data_t *lookupDispls(int size, int num, displs_data_t **list, int
     int i, j;
     for (i = 0; i < num; i++)
     {
+        if (list[i]->derived_from_counts)
+        {
+            continue;
+        }
         for (j = 0; j < size; j++)
         {
             if (displs[j] != list[i]->displs[j])
@@ -379,31 +410,6 @@ static displs_data_t *lookupRecvDispls(int *counts, SRDisplNode_t *call_data)
     return lookupDispls(num, call_data->recv_data_size, call_data->recv_data, counts);
 }
 
-static counts_data_t *lookupSendCounters(int *counts, SRCountNode_t *call_data)
-{
-    int num_counts = 1;
-    return lookupCounters(num_counts, call_data->send_data_size, call_data->send_data, counts);
-}
-
-static counts_data_t *lookupRecvCounters(int *counts, SRCountNode_t *call_data)
-{
-    return lookupCounters(call_data->size, call_data->recv_data_size, call_data->recv_data, counts);
-}
-
-static int add_rank_to_counters_data(int rank, counts_data_t *counters_data)
-{
-    if (counters_data->num_ranks >= counters_data->max_ranks)
-    {
-        counters_data->max_ranks = counters_data->num_ranks + MAX_TRACKED_RANKS;
-        counters_data->ranks = (int *)realloc(counters_data->ranks, counters_data->max_ranks * sizeof(int));
-        assert(counters_data->ranks);
-    }
-
-    counters_data->ranks[counters_data->num_ranks] = rank;
-    counters_data->num_ranks++;
-    return 0;
-}
-
 static void delete_counter_data(counts_data_t **data)
 {
     if (*data)
@@ -421,96 +427,6 @@ static void delete_counter_data(counts_data_t **data)
     }
 }
 
-static counts_data_t *new_counter_data(int size, int rank, int *counts)
-{
-    int i;
-    counts_data_t *new_data = (counts_data_t *)malloc(sizeof(counts_data_t));
-    assert(new_data);
-    new_data->counters = (int *)malloc(size * sizeof(int));
-    assert(new_data->counters);
-    new_data->num_ranks = 0;
-    new_data->max_ranks = MAX_TRACKED_RANKS;
-    new_data->ranks = (int *)malloc(new_data->max_ranks * sizeof(int));
-    assert(new_data->ranks);
-
-    for (i = 0; i < size; i++)
-    {
-        new_data->counters[i] = counts[i];
-    }
-    new_data->ranks[new_data->num_ranks] = rank;
-    new_data->num_ranks++;
-
-    return new_data;
-}
-
-static int add_new_send_counters_to_counters_data(SRCountNode_t *call_data, int rank, int *counts)
-{
-    counts_data_t *new_data = new_counter_data(1 /*call_data->size*/, rank, counts);
-    call_data->send_data[call_data->send_data_size] = new_data;
-    call_data->send_data_size++;
-
-    return 0;
-}
-
-static int add_new_recv_counters_to_counters_data(SRCountNode_t *call_data, int rank, int *counts)
-{
-    counts_data_t *new_data = new_counter_data(call_data->size, rank, counts);
-    call_data->recv_data[call_data->recv_data_size] = new_data;
-    call_data->recv_data_size++;
-
-    return 0;
-}
-
-static int compareAndSaveSendCounters(int rank, int *counts, SRCountNode_t *call_data)
-{
-    counts_data_t *ptr = lookupSendCounters(counts, call_data);
-    if (ptr)
-    {
-        DEBUG_ALLGATHERV_PROFILING("Add send rank %d to existing count data\n", rank);
-        if (add_rank_to_counters_data(rank, ptr))
-        {
-            fprintf(stderr, "[%s:%d][ERROR] unable to add rank counters (rank: %d)\n", __FILE__, __LINE__, rank);
-            return -1;
-        }
-    }
-    else
-    {
-        DEBUG_ALLGATHERV_PROFILING("Add send new count data for rank %d\n", rank);
-        if (add_new_send_counters_to_counters_data(call_data, rank, counts))
-        {
-            fprintf(stderr, "[%s:%d][ERROR] unable to add new send counters\n", __FILE__, __LINE__);
-            return -1;
-        }
-    }
-
-    return 0;
-}
-
-static int compareAndSaveRecvCounters(int rank, int *counts, SRCountNode_t *call_data)
-{
-    counts_data_t *ptr = lookupRecvCounters(counts, call_data);
-    if (ptr)
-    {
-        DEBUG_ALLGATHERV_PROFILING("Add recv rank %d to existing count data\n", rank);
-        if (add_rank_to_counters_data(rank, ptr))
-        {
-            fprintf(stderr, "[ERROR] unable to add rank counters\n");
-            return -1;
-        }
-    }
-    else
-    {
-        DEBUG_ALLGATHERV_PROFILING("Add recv new count data for rank %d\n", rank);
-        if (add_new_recv_counters_to_counters_data(call_data, rank, counts))
-        {
-            fprintf(stderr, "[ERROR] unable to add new recv counters\n");
-            return -1;
-        }
-    }
-
-    return 0;
-}
-
 static int add_rank_to_displs_data(int rank, displs_data_t *displs_data)
 {
     if (displs_data->num_ranks >= displs_data->max_ranks)
@@ -535,6 +451,7 @@ static displs_data_t *new_displ_data(int size, int rank, int *displs)
     assert(new_data);
     new_data->displs = (int *)malloc(size * sizeof(int));
     assert(new_data->displs);
+    new_data->derived_from_counts = 0;
     new_data->num_ranks = 0;
     new_data->max_ranks = MAX_TRACKED_RANKS;
     new_data->ranks = (int *)malloc(new_data->max_ranks * sizeof(int));
@@ -559,8 +476,66 @@ static int add_new_recv_displs_to_displs_data(SRDisplNode_t *call_data, int rank
     return 0;
 }
 
-static int compareAndSaveRecvDispls(int rank, int *displs, SRDisplNode_t *call_data)
+static displs_data_t *lookupDerivedDispls(SRDisplNode_t *call_data)
 {
+    int i;
+    for (i = 0; i < call_data->recv_data_size; i++)
+    {
+        if (call_data->recv_data[i]->derived_from_counts)
+        {
+            return call_data->recv_data[i];
+        }
+    }
+    return NULL;
+}
+
+// Record that a rank's displacements are the prefix sum of its counts: all
+// such ranks share a single marker entry without a displacement vector.
+static int add_derived_recv_displs_to_displs_data(SRDisplNode_t *call_data, int rank)
+{
+    displs_data_t *new_data = NULL;
+
+    new_data = (displs_data_t *)malloc(sizeof(displs_data_t));
+    assert(new_data);
+    new_data->displs = NULL;
+    new_data->derived_from_counts = 1;
+    new_data->num_ranks = 0;
+    new_data->max_ranks = MAX_TRACKED_RANKS;
+    new_data->ranks = (int *)malloc(new_data->max_ranks * sizeof(int));
+    assert(new_data->ranks);
+    new_data->ranks[new_data->num_ranks] = rank;
+    new_data->num_ranks++;
+
+    call_data->recv_data[call_data->recv_data_size] = new_data;
+    call_data->recv_data_size++;
+
+    return 0;
+}
+
+static int compareAndSaveRecvDispls(int rank, int *displs, int derived, SRDisplNode_t *call_data)
+{
+    if (derived)
+    {
+        displs_data_t *marker = lookupDerivedDispls(call_data);
+        if (marker)
+        {
+            DEBUG_ALLGATHERV_PROFILING("Add recv rank %d to derived displacements marker\n", rank);
+            if (add_rank_to_displs_data(rank, marker))
+            {
+                fprintf(stderr, "[ERROR] unable to add rank displacements\n");
+                return -1;
+            }
+            return 0;
+        }
+        DEBUG_ALLGATHERV_PROFILING("Add derived displacements marker for rank %d\n", rank);
+        if (add_derived_recv_displs_to_displs_data(call_data, rank))
+        {
+            fprintf(stderr, "[ERROR] unable to add derived displacements marker\n");
+            return -1;
+        }
+        return 0;
+    }
+
     displs_data_t *ptr = lookupRecvDispls(displs, call_data);
     if (ptr)
     {
@@ -586,7 +561,7 @@ static int compareAndSaveRecvDispls(int rank, int *displs, SRDisplNode_t *call_d
 
 // Compare new recv displacement data with existing data.
 // If there is a match, increase the counter. Add new data, otherwise.
-static int insert_displ_data(int *rbuf, int size, int sendtype_size, int recvtype_size)
+static int insert_displ_data(int *dflags, int *rbuf, int size, int sendtype_size, int recvtype_size)
 {
     int num = 0;
     struct SRDisplNode *newNode = NULL;
@@ -600,7 +575,7 @@ static int insert_displ_data(int *rbuf, int size, int sendtype_size, int recvtyp
     temp = displs_head;
     while (temp != NULL)
     {
-        if (temp->size != size || temp->recvtype_size != recvtype_size || temp->sendtype_size != sendtype_size || !same_call_displs(temp, rbuf, size))
+        if (temp->size != size || temp->recvtype_size != recvtype_size || temp->sendtype_size != sendtype_size || !same_call_displs(temp, dflags, rbuf, size))
         {
             // New data
 #if DEBUG
@@ -616,13 +591,16 @@ static int insert_displ_data(int *rbuf, int size, int sendtype_size, int recvtyp
             // Data exist, adding call info to it
             DEBUG_ALLGATHERV_PROFILING("Displacement data already exists, updating metadata...\n");
             assert(temp->list_calls);
-            if (temp->count >= temp->max_calls)
+            if (!call_interval_list_absorb(temp->list_calls, temp->num_intervals, allgathervCalls))
             {
-                temp->max_calls = temp->max_calls * 2;
-                temp->list_calls = (uint64_t *)realloc(temp->list_calls, temp->max_calls * sizeof(uint64_t));
-                assert(temp->list_calls);
+                if (temp->num_intervals >= temp->max_intervals)
+                {
+                    temp->max_intervals = temp->max_intervals * 2;
+                    temp->list_calls = (call_interval_t *)realloc(temp->list_calls, temp->max_intervals * sizeof(call_interval_t));
+                    assert(temp->list_calls);
+                }
+                call_interval_list_push(temp->list_calls, &temp->num_intervals, allgathervCalls);
             }
-            temp->list_calls[temp->count] = allgathervCalls; // Note: count starts at 1, not 0
             temp->count++;
 #if DEBUG
             fprintf(logger->f, "old data: %d --> %d --- %d\n", size, temp->size, temp->count);
@@ -642,9 +620,10 @@ static int insert_displ_data(int *rbuf, int size, int sendtype_size, int recvtyp
     newNode->rank_send_vec_len = 1; // 1 send count per rank
     newNode->rank_recv_vec_len = size; // communicator size counts per rank
     newNode->count = 1;
-    newNode->list_calls = (uint64_t *)malloc(DEFAULT_TRACKED_CALLS * sizeof(uint64_t));
+    newNode->list_calls = (call_interval_t *)malloc(DEFAULT_TRACKED_CALLS * sizeof(call_interval_t));
     assert(newNode->list_calls);
-    newNode->max_calls = DEFAULT_TRACKED_CALLS;
+    newNode->max_intervals = DEFAULT_TRACKED_CALLS;
+    newNode->num_intervals = 0;
     // We have at most <size> different counts (one per rank) and we just allocate pointers of pointers here, not much space used
     newNode->send_data = (displs_data_t **)malloc(size * sizeof(displs_data_t));
     assert(newNode->send_data);
@@ -658,7 +637,7 @@ static int insert_displ_data(int *rbuf, int size, int sendtype_size, int recvtyp
     int _rank;
     for (_rank = 0; _rank < size; _rank++)
     {
-        if (compareAndSaveRecvDispls(_rank, &(rbuf[num * size]), newNode))
+        if (compareAndSaveRecvDispls(_rank, &(rbuf[num * size]), dflags[_rank], newNode))
         {
             fprintf(stderr, "[%s:%d][ERROR] unable to add recv displacements\n", __FILE__, __LINE__);
             return -1;
@@ -668,7 +647,7 @@ static int insert_displ_data(int *rbuf, int size, int sendtype_size, int recvtyp
 
     newNode->sendtype_size = sendtype_size;
     newNode->recvtype_size = recvtype_size;
-    newNode->list_calls[0] = allgathervCalls;
+    call_interval_list_push(newNode->list_calls, &newNode->num_intervals, allgathervCalls);
     newNode->next = NULL;
 #if DEBUG
     fprintf(logger->f, "new entry: %d --> %d --- %d\n", size, newNode->size, newNode->count);
@@ -689,123 +668,19 @@ static int insert_displ_data(int *rbuf, int size, int sendtype_size, int recvtyp
 }
 
 
-// Compare new send count data with existing data.
-// If there is a match, increase the counter. Add new data, otherwise.
-static int insert_sendrecv_count_data(int *sbuf, int *rbuf, int size, int sendtype_size, int recvtype_size)
-{
-    int num = 0;
-    struct SRCountNode *newNode = NULL;
-    struct SRCountNode *temp;
-
-    DEBUG_ALLGATHERV_PROFILING("Insert data for a new allgatherv call...\n");
-
-    assert(sbuf);
-    assert(rbuf);
-    assert(logger);
-
-    temp = counts_head;
-    while (temp != NULL)
-    {
-        if (temp->size != size || temp->recvtype_size != recvtype_size || temp->sendtype_size != sendtype_size || !same_call_counters(temp, sbuf, rbuf, size))
-        {
-            // New data
-#if DEBUG
-            fprintf(logger->f, "new data: %d\n", size);
-#endif
-            if (temp->next != NULL)
-                temp = temp->next;
-            else
-                break;
-        }
-        else
-        {
-            // Data exist, adding call info to it
-            DEBUG_ALLGATHERV_PROFILING("Data already exists, updating metadata...\n");
-            assert(temp->list_calls);
-            if (temp->count >= temp->max_calls)
-            {
-                temp->max_calls = temp->max_calls * 2;
-                temp->list_calls = (uint64_t *)realloc(temp->list_calls, temp->max_calls * sizeof(uint64_t));
-                assert(temp->list_calls);
-            }
-            temp->list_calls[temp->count] = allgathervCalls; // Note: count starts at 1, not 0
-            temp->count++;
-#if DEBUG
-            fprintf(logger->f, "old data: %d --> %d --- %d\n", size, temp->size, temp->count);
-#endif
-            DEBUG_ALLGATHERV_PROFILING("Metadata successfully updated\n");
-            return 0;
-        }
-    }
+// Process identity is immutable for the life of the process: the hostname -
+// whose lookup can go through NSS - and the PID are resolved once at init and
+// reused by every per-call and per-logger path.
+static char _hostname[256] = {0};
+static int _pid = 0;
 
-#if DEBUG
-    fprintf(logger->f, "no data: %d \n", size);
-#endif
-    newNode = (struct SRCountNode *)malloc(sizeof(SRCountNode_t));
-    assert(newNode);
-
-    newNode->size = size;
-    newNode->rank_send_vec_len = 1; // 1 send count per rank
-    newNode->rank_recv_vec_len = size; // communicator size counts per rank
-    newNode->count = 1;
-    newNode->list_calls = (uint64_t *)malloc(DEFAULT_TRACKED_CALLS * sizeof(uint64_t));
-    assert(newNode->list_calls);
-    newNode->max_calls = DEFAULT_TRACKED_CALLS;
-    // We have at most <size> different counts (one per rank) and we just allocate pointers of pointers here, not much space used
-    newNode->send_data = (counts_data_t **)malloc(size * sizeof(counts_data_t));
-    assert(newNode->send_data);
-    newNode->send_data_size = 0;
-    newNode->recv_data = (counts_data_t **)malloc(size * sizeof(counts_data_t));
-    assert(newNode->recv_data);
-    newNode->recv_data_size = 0;
-
-    // We add rank's data one by one so we can compress the data when possible
-    num = 0;
-    int _rank = 0;
-
-    DEBUG_ALLGATHERV_PROFILING("handling send counts...\n");
-    for (_rank = 0; _rank < size; _rank++)
-    {
-        if (compareAndSaveSendCounters(_rank, &(sbuf[_rank]), newNode))
-        {
-            fprintf(stderr, "[%s:%d][ERROR] unable to add send counters\n", __FILE__, __LINE__);
-            return -1;
-        }
-        num++;
-    }
-
-    DEBUG_ALLGATHERV_PROFILING("handling recv counts...\n");
-    num = 0;
-    for (_rank = 0; _rank < size; _rank++)
-    {
-        if (compareAndSaveRecvCounters(_rank, &(rbuf[num * size]), newNode))
-        {
-            fprintf(stderr, "[%s:%d][ERROR] unable to add recv counters\n", __FILE__, __LINE__);
-            return -1;
-        }
-        num++;
-    }
-
-    newNode->sendtype_size = sendtype_size;
-    newNode->recvtype_size = recvtype_size;
-    newNode->list_calls[0] = allgathervCalls;
-    newNode->next = NULL;
-#if DEBUG
-    fprintf(logger->f, "new entry: %d --> %d --- %d\n", size, newNode->size, newNode->count);
-#endif
-
-    DEBUG_ALLGATHERV_PROFILING("Data for the new allgatherv call has %d unique series for send counts and %d for recv counts\n", newNode->recv_data_size, newNode->send_data_size);
-
-    if (counts_head == NULL)
-    {
-        counts_head = newNode;
-    }
-    else
+static void init_process_identity(void)
+{
+    if (_pid == 0)
     {
-        temp->next = newNode;
+        gethostname(_hostname, sizeof(_hostname));
+        _pid = getpid();
     }
-
-    return 0;
 }
 
 int _mpi_init(int *argc, char ***argv)
@@ -824,6 +699,7 @@ int _mpi_init(int *argc, char ***argv)
     }
 
     ret = PMPI_Init(argc, argv);
+    init_process_identity();
 
     PMPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
     PMPI_Comm_size(MPI_COMM_WORLD, &world_size);
@@ -878,8 +754,8 @@ int _mpi_init(int *argc, char ***argv)
     }
 
     char *dump_call_data_envvar = getenv("DUMP_CALL_DATA");
-    if (dump_call_data_envvar != NULL)
-        dump_call_data = atoi(dump_call_data_envvar);
+    if (dump_call_data_envvar != NULL && num_dump_call_ranges == 0)
+        parse_dump_call_data(dump_call_data_envvar);
 
     // Make sure we do not create an articial imbalance between ranks.
     PMPI_Barrier(MPI_COMM_WORLD);
@@ -903,6 +779,7 @@ int _mpi_init_thread(int *argc, char ***argv, int required, int *provided)
     }
 
     ret = PMPI_Init_thread(argc, argv, required, provided);
+    init_process_identity();
 
     PMPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
     PMPI_Comm_size(MPI_COMM_WORLD, &world_size);
@@ -957,8 +834,8 @@ int _mpi_init_thread(int *argc, char ***argv, int required, int *provided)
     }
 
     char *dump_call_data_envvar = getenv("DUMP_CALL_DATA");
-    if (dump_call_data_envvar != NULL)
-        dump_call_data = atoi(dump_call_data_envvar);
+    if (dump_call_data_envvar != NULL && num_dump_call_ranges == 0)
+        parse_dump_call_data(dump_call_data_envvar);
 
     // Make sure we do not create an articial imbalance between ranks.
     PMPI_Barrier(MPI_COMM_WORLD);
@@ -970,6 +847,7 @@ int MPI_Finalize()
 {
     _commit_data();
     _finalize_profiling();
+    node_aggregate_finalize("allgatherv");
     return PMPI_Finalize();
 }
 
@@ -1046,47 +924,18 @@ static int _release_displs_resources()
 static int _release_counts_resources()
 {
     // All data has been handled, now we can clean up
-    int i;
-    while (counts_head != NULL)
-    {
-        SRCountNode_t *c_ptr = counts_head->next;
-
-        for (i = 0; i < counts_head->send_data_size; i++)
-        {
-            delete_counter_data(&(counts_head->send_data[i]));
-        }
-
-        for (i = 0; i < counts_head->recv_data_size; i++)
-        {
-            delete_counter_data(&(counts_head->recv_data[i]));
-        }
-
-        free(counts_head->recv_data);
-        free(counts_head->send_data);
-        free(counts_head->list_calls);
-
-        free(counts_head);
-        counts_head = c_ptr;
-    }
+    counts_engine_release();
     return 0;
 }
 #endif // ENABLE_RAW_DATA || ENABLE_VALIDATION
 
 static int _release_pattern_resources()
 {
-    while (rpatterns != NULL)
-    {
-        avPattern_t *rp = rpatterns->next;
-        free(rpatterns);
-        rpatterns = rp;
-    }
-
-    while (spatterns != NULL)
-    {
-        avPattern_t *sp = spatterns->next;
-        free(spatterns);
-        spatterns = sp;
-    }
+    free_patterns(rpatterns);
+    rpatterns = NULL;
+    free_patterns(spatterns);
+    spatterns = NULL;
+    patterns_cleanup();
 
     return 0;
 }
@@ -1187,7 +1036,7 @@ static void save_counts(int *sendcount, int *recvcounts, int s_datatype_size, in
     }
     assert(rc > 0);
 
-    FILE *f = fopen(filename, "w");
+    FILE *f = profile_fopen(filename, "w", "counts");
     assert(f);
 
     fprintf(f, "Send datatype size: %d\n", s_datatype_size);
@@ -1280,12 +1129,12 @@ int _mpi_allgatherv(const void *sendbuf, const int sendcount, MPI_Datatype sendt
     {
         void *array[16];
         size_t _s;
-        char **strings;
-        char *caller_trace = NULL;
 
+        // Symbol resolution is cached on the raw return addresses: see
+        // insert_caller_data_addrs(), backtrace_symbols() only runs once per
+        // unique trace.
         _s = backtrace(array, 16);
-        strings = backtrace_symbols(array, _s);
-        insert_caller_data(collective_name, strings, _s, comm, my_comm_rank, world_rank, allgathervCalls);
+        insert_caller_data_addrs(collective_name, array, _s, comm, my_comm_rank, world_rank, allgathervCalls);
     }
 #endif // ENABLE_BACKTRACE
 
@@ -1309,25 +1158,21 @@ int _mpi_allgatherv(const void *sendbuf, const int sendcount, MPI_Datatype sendt
             allgathervCallStart = allgathervCalls;
         }
 
-        if (dump_call_data == allgathervCalls)
+        if (dump_call_data_requested(allgathervCalls))
         {
             // Save datatypes information
             if (my_comm_rank == 0)
             {
-                datatype_info_t sendtype_info;
-                sendtype_info.analyzed = false;
-                analyze_datatype(sendtype, &sendtype_info);
-                int rc = save_datatype_info(collective_name, comm, my_comm_rank, world_rank, allgathervCalls, "send", &sendtype_info);
+                datatype_info_t *sendtype_info = lookup_datatype_info(sendtype);
+                int rc = save_datatype_info(collective_name, comm, my_comm_rank, world_rank, allgathervCalls, "send", sendtype_info);
                 if (rc)
                 {
                     fprintf(stderr, "save_datatype_info() failed (rc: %d)\n", rc);
                     MPI_Abort(MPI_COMM_WORLD, 12);
                 }
 
-                datatype_info_t recvtype_info;
-                recvtype_info.analyzed = false;
-                analyze_datatype(recvtype, &recvtype_info);
-                rc = save_datatype_info(collective_name, comm, my_comm_rank, world_rank, allgathervCalls, "recv", &recvtype_info);
+                datatype_info_t *recvtype_info = lookup_datatype_info(recvtype);
+                rc = save_datatype_info(collective_name, comm, my_comm_rank, world_rank, allgathervCalls, "recv", recvtype_info);
                 if (rc)
                 {
                     fprintf(stderr, "save_datatype_info() failed (rc: %d)\n", rc);
@@ -1360,7 +1205,7 @@ int _mpi_allgatherv(const void *sendbuf, const int sendcount, MPI_Datatype sendt
 
         ret = PMPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm);
 
-        if (dump_call_data == allgathervCalls)
+        if (dump_call_data_requested(allgathervCalls))
         {
             int rc = store_call_data(collective_name, RECV_CONTEXT_IDX, comm, my_comm_rank, world_rank, allgathervCalls, (void *)recvbuf, (int *)recvcounts, (int *)rdispls, recvtype);
             if (rc)
@@ -1369,11 +1214,9 @@ int _mpi_allgatherv(const void *sendbuf, const int sendcount, MPI_Datatype sendt
                 MPI_Abort(MPI_COMM_WORLD, 11);
             }
             save_buf_content(recvbuf, recvcounts, rdispls, recvtype, comm, world_rank, "recv");
-            release_buffcontent_loggers();
-            PMPI_Barrier(comm);
-            if (my_comm_rank == 0)
-                fprintf(stderr, "All data acquired, aborting...\n");
-            MPI_Abort(MPI_COMM_WORLD, 22);
+            // Push the dumped content out right away; the descriptors stay
+            // open so the next dumped call does not pay for a reopen.
+            sync_buffcontent_loggers();
         }
 
 #if ENABLE_EXEC_TIMING
@@ -1386,8 +1229,10 @@ int _mpi_allgatherv(const void *sendbuf, const int sendcount, MPI_Datatype sendt
 #endif // ENABLE_LATE_ARRIVAL_TIMING
 
 #if ENABLE_DISPLS
-        // Gather receive displacements
-        sbuf = NULL;
+        // Gather receive displacements, plus one flag per rank telling the
+        // root whether they are just the prefix sum of the rank's counts
+        int displs_derived = displs_derived_from_counts(recvcounts, rdispls, comm_size);
+        PMPI_Gather(&displs_derived, 1, MPI_INT, sbuf, 1, MPI_INT, 0, comm);
         PMPI_Gather(rdispls, comm_size, MPI_INT, rbuf, comm_size, MPI_INT, 0, comm);
 #else
         // Gather a bunch of counters
@@ -1406,14 +1251,10 @@ int _mpi_allgatherv(const void *sendbuf, const int sendcount, MPI_Datatype sendt
 #if ENABLE_SAVE_DATA_VALIDATION
         if (do_send_buffs > 0)
         {
-            int dtsize;
-            PMPI_Type_size(sendtype, &dtsize);
             store_call_data_single_count(collective_name, SEND_CONTEXT_IDX, comm, my_comm_rank, world_rank, allgathervCalls, (void *)sendbuf, sendcount, sendtype);
         }
         else
         {
-            int dtsize;
-            PMPI_Type_size(recvtype, &dtsize);
             store_call_data(collective_name, RECV_CONTEXT_IDX, comm, my_comm_rank, world_rank, allgathervCalls, (void *)recvbuf, (int *)recvcounts, (int *)rdispls, recvtype);
         }
 
@@ -1464,29 +1305,51 @@ int _mpi_allgatherv(const void *sendbuf, const int sendcount, MPI_Datatype sendt
 #endif // ENABLE_COMPARE_DATA_VALIDATION
 
 #if ENABLE_LOCATION_TRACKING
-        int my_pid = getpid();
-        // Note that the library will free all the allocated memory. We hand over the pointer
-        // and the profiler frees the memory when finalizing
-        int *pids = (int *)malloc(comm_size * sizeof(int));
-        assert(pids);
-        int *world_comm_ranks = (int *)malloc(comm_size * sizeof(int));
-        assert(world_comm_ranks);
-        char hostname[256];
-        gethostname(hostname, 256);
-        char *hostnames = (char *)malloc(256 * comm_size * sizeof(char));
-        assert(hostnames);
-
-        PMPI_Gather(&my_pid, 1, MPI_INT, pids, 1, MPI_INT, 0, comm);
-        PMPI_Gather(&world_rank, 1, MPI_INT, world_comm_ranks, 1, MPI_INT, 0, comm);
-        PMPI_Gather(&hostname, 256, MPI_CHAR, hostnames, 256, MPI_CHAR, 0, comm);
-        if (my_comm_rank == 0)
+        // Locations are immutable for the life of a communicator: gather them
+        // only the first time the communicator is profiled, afterwards just
+        // reference the cached record by communicator ID.
+        comm_data_t *location_comm_data = NULL;
+        if (lookup_comm_data(comm, &location_comm_data) != 0)
         {
-            int rc = commit_rank_locations(collective_name, comm, comm_size, world_rank, my_comm_rank, pids, world_comm_ranks, hostnames, allgathervCalls);
-            if (rc)
+            uint32_t location_comm_id;
+            add_comm(comm, world_rank, my_comm_rank, &location_comm_id);
+            lookup_comm_data(comm, &location_comm_data);
+        }
+        assert(location_comm_data);
+        if (location_comm_data->location_tracked == 0)
+        {
+            int *pids = NULL;
+            int *world_comm_ranks = NULL;
+            char *hostnames = NULL;
+            if (my_comm_rank == 0)
             {
-                fprintf(stderr, "save_rank_locations() failed: %d", rc);
-                PMPI_Abort(MPI_COMM_WORLD, 1);
+                // The profiler frees these buffers when finalizing; only the root
+                // needs them.
+                pids = (int *)malloc(comm_size * sizeof(int));
+                assert(pids);
+                world_comm_ranks = (int *)malloc(comm_size * sizeof(int));
+                assert(world_comm_ranks);
+                hostnames = (char *)malloc(256 * comm_size * sizeof(char));
+                assert(hostnames);
+            }
+
+            PMPI_Gather(&_pid, 1, MPI_INT, pids, 1, MPI_INT, 0, comm);
+            PMPI_Gather(&world_rank, 1, MPI_INT, world_comm_ranks, 1, MPI_INT, 0, comm);
+            PMPI_Gather(_hostname, 256, MPI_CHAR, hostnames, 256, MPI_CHAR, 0, comm);
+            if (my_comm_rank == 0)
+            {
+                int rc = commit_rank_locations(collective_name, comm, comm_size, world_rank, my_comm_rank, pids, world_comm_ranks, hostnames, allgathervCalls);
+                if (rc)
+                {
+                    fprintf(stderr, "save_rank_locations() failed: %d", rc);
+                    PMPI_Abort(MPI_COMM_WORLD, 1);
+                }
             }
+            location_comm_data->location_tracked = 1;
+        }
+        else if (my_comm_rank == 0)
+        {
+            commit_rank_locations_by_id(collective_name, comm, allgathervCalls);
         }
 #endif // ENABLE_LOCATION_TRACKING
 
@@ -1499,9 +1362,9 @@ int _mpi_allgatherv(const void *sendbuf, const int sendcount, MPI_Datatype sendt
 #if ENABLE_DISPLS
             DEBUG_ALLGATHERV_PROFILING("Saving displacement data of call #%" PRIu64 ".\n", allgathervCalls);
             int s_dt_size, r_dt_size;
-            PMPI_Type_size(sendtype, &s_dt_size);
-            PMPI_Type_size(recvtype, &r_dt_size);
-            if (insert_displ_data(rbuf, comm_size, s_dt_size, r_dt_size))
+            s_dt_size = cached_type_size(sendtype);
+            r_dt_size = cached_type_size(recvtype);
+            if (insert_displ_data(sbuf, rbuf, comm_size, s_dt_size, r_dt_size))
             {
                 fprintf(stderr, "[%s:%d][ERROR] unable to insert displacement data\n", __FILE__, __LINE__);
                 PMPI_Abort(MPI_COMM_WORLD, 1);
@@ -1511,9 +1374,9 @@ int _mpi_allgatherv(const void *sendbuf, const int sendcount, MPI_Datatype sendt
 #if ((ENABLE_RAW_DATA || ENABLE_PER_RANK_STATS || ENABLE_VALIDATION) && ENABLE_COMPACT_FORMAT)
             DEBUG_ALLGATHERV_PROFILING("Saving data of call #%" PRIu64 ".\n", allgathervCalls);
             int s_dt_size, r_dt_size;
-            PMPI_Type_size(sendtype, &s_dt_size);
-            PMPI_Type_size(recvtype, &r_dt_size);
-            if (insert_sendrecv_count_data(sbuf, rbuf, comm_size, s_dt_size, r_dt_size))
+            s_dt_size = cached_type_size(sendtype);
+            r_dt_size = cached_type_size(recvtype);
+            if (insert_sendrecv_count_data(sbuf, rbuf, comm_size, s_dt_size, r_dt_size, allgathervCalls))
             {
                 fprintf(stderr, "[%s:%d][ERROR] unable to insert send/recv counts\n", __FILE__, __LINE__);
                 PMPI_Abort(MPI_COMM_WORLD, 1);
@@ -1523,8 +1386,8 @@ int _mpi_allgatherv(const void *sendbuf, const int sendcount, MPI_Datatype sendt
 #if ((ENABLE_RAW_DATA || ENABLE_PER_RANK_STATS || ENABLE_VALIDATION) && !ENABLE_COMPACT_FORMAT)
             DEBUG_ALLGATHERV_PROFILING("Saving data of call #%" PRIu64 ".\n", allgathervCalls);
             int s_dt_size, r_dt_size;
-            PMPI_Type_size(sendtype, &s_dt_size);
-            PMPI_Type_size(recvtype, &r_dt_size);
+            s_dt_size = cached_type_size(sendtype);
+            r_dt_size = cached_type_size(recvtype);
             save_counts(sbuf, rbuf, s_dt_size, r_dt_size, comm_size, allgathervCalls);
 #endif // ((ENABLE_RAW_DATA || ENABLE_PER_RANK_STATS || ENABLE_VALIDATION) && !ENABLE_COMPACT_FORMAT)
 
@@ -1594,6 +1457,84 @@ int _mpi_allgatherv(const void *sendbuf, const int sendcount, MPI_Datatype sendt
     return ret;
 }
 
+// The datatype cache keys on the handle, which the MPI library may recycle
+// once the type is freed.
+int MPI_Type_free(MPI_Datatype *type)
+{
+    if (type != NULL)
+    {
+        datatype_cache_invalidate(*type);
+    }
+    return PMPI_Type_free(type);
+}
+
+int MPI_Comm_free(MPI_Comm *comm)
+{
+    // Release the per-communicator profiling state: close the timing loggers
+    // early (their content is complete once the communicator goes away) and
+    // drop the handle mapping so a recycled handle gets a fresh record.
+    comm_data_t *comm_data = NULL;
+    if (lookup_comm_data(*comm, &comm_data) == 0)
+    {
+        int series;
+        for (series = 0; series < NUM_TIMING_SERIES; series++)
+        {
+            if (comm_data->timing_logger[series] != NULL)
+            {
+                comm_timing_logger_t *timing_logger = (comm_timing_logger_t *)comm_data->timing_logger[series];
+                fini_time_tracking(&timing_logger);
+            }
+        }
+        release_comm_buffcontent_loggers(*comm);
+        drop_comm(*comm);
+    }
+    return PMPI_Comm_free(comm);
+}
+
+// Register a newly created communicator eagerly so the first profiled
+// collective on it does not pay for the registration.
+static void register_new_comm(MPI_Comm newcomm)
+{
+    uint32_t comm_id;
+    if (newcomm == MPI_COMM_NULL || lookup_comm(newcomm, &comm_id) == 0)
+    {
+        return;
+    }
+    int my_comm_rank;
+    PMPI_Comm_rank(newcomm, &my_comm_rank);
+    add_comm(newcomm, world_rank, my_comm_rank, &comm_id);
+}
+
+int MPI_Comm_dup(MPI_Comm comm, MPI_Comm *newcomm)
+{
+    int ret = PMPI_Comm_dup(comm, newcomm);
+    if (ret == MPI_SUCCESS)
+    {
+        register_new_comm(*newcomm);
+    }
+    return ret;
+}
+
+int MPI_Comm_split(MPI_Comm comm, int color, int key, MPI_Comm *newcomm)
+{
+    int ret = PMPI_Comm_split(comm, color, key, newcomm);
+    if (ret == MPI_SUCCESS)
+    {
+        register_new_comm(*newcomm);
+    }
+    return ret;
+}
+
+int MPI_Comm_split_type(MPI_Comm comm, int split_type, int key, MPI_Info info, MPI_Comm *newcomm)
+{
+    int ret = PMPI_Comm_split_type(comm, split_type, key, info, newcomm);
+    if (ret == MPI_SUCCESS)
+    {
+        register_new_comm(*newcomm);
+    }
+    return ret;
+}
+
 int MPI_Allgatherv(const void *sendbuf, const int sendcount, MPI_Datatype sendtype,
                    void *recvbuf, const int *recvcounts, const int *rdispls, MPI_Datatype recvtype,
                    MPI_Comm comm)
@@ -1601,6 +1542,41 @@ int MPI_Allgatherv(const void *sendbuf, const int sendcount, MPI_Datatype sendty
     return _mpi_allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm);
 }
 
+#if defined(MPI_VERSION) && MPI_VERSION >= 4
+// MPI-4 large-count variant. When every count and displacement fits in an int
+// - by far the common case - the call is narrowed and profiled through the
+// regular path; otherwise the exact 64-bit count rows are saved to a per-rank
+// sidecar file and the operation runs unprofiled.
+int MPI_Allgatherv_c(const void *sendbuf, MPI_Count sendcount, MPI_Datatype sendtype,
+                     void *recvbuf, const MPI_Count recvcounts[], const MPI_Aint rdispls[],
+                     MPI_Datatype recvtype, MPI_Comm comm)
+{
+    int comm_size;
+    int ret;
+
+    PMPI_Comm_size(comm, &comm_size);
+
+    if (large_counts_fit(&sendcount, 1) && large_counts_fit(recvcounts, comm_size) &&
+        large_displs_fit(rdispls, comm_size))
+    {
+        int *narrow_recvcounts = (int *)malloc(2 * comm_size * sizeof(int));
+        assert(narrow_recvcounts);
+        int *narrow_rdispls = narrow_recvcounts + comm_size;
+        narrow_large_counts(recvcounts, narrow_recvcounts, comm_size);
+        narrow_large_displs(rdispls, narrow_rdispls, comm_size);
+        ret = _mpi_allgatherv(sendbuf, (int)sendcount, sendtype, recvbuf, narrow_recvcounts, narrow_rdispls, recvtype, comm);
+        free(narrow_recvcounts);
+        return ret;
+    }
+
+    PMPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    save_large_counts("allgatherv", world_rank, allgathervCalls, &sendcount, 1, recvcounts, comm_size);
+    ret = PMPI_Allgatherv_c(sendbuf, sendcount, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm);
+    allgathervCalls++;
+    return ret;
+}
+#endif // MPI_VERSION >= 4
+
 void mpi_allgatherv_(void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sendtype,
                      void *recvbuf, MPI_Fint *recvcount, MPI_Fint *rdispls, MPI_Fint *recvtype,
                      MPI_Fint *comm, MPI_Fint *ierr)
@@ -1634,4 +1610,5 @@ __attribute__((destructor)) void calledLast()
 {
     _commit_data();
     _finalize_profiling();
+    node_aggregate_finalize("allgatherv");
 }
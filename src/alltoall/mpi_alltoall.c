@@ -19,10 +19,23 @@
 #include "pattern.h"
 #include "execinfo.h"
 #include "timings.h"
+#include "comm.h"
 #include "backtrace.h"
 #include "location.h"
+#include "datatype.h"
+#include "bigcounts.h"
+#include "validation_store.h"
+#include "compress.h"
+#include "node_aggregate.h"
+
+// Count collection is handled by the shared engine; for alltoall every rank
+// contributes a single send count and a single recv count, so the engine
+// stores one int per rank instead of full-size rows.
+#define COUNTS_ENGINE_SEND_VEC_LEN(size) (1)
+#define COUNTS_ENGINE_RECV_VEC_LEN(size) (1)
+#define COUNTS_ENGINE_DEBUG DEBUG_ALLTOALL_PROFILING
+#include "counts_engine.h"
 
-static SRCountNode_t *counts_head = NULL;
 static SRDisplNode_t *displs_head = NULL;
 static avTimingsNode_t *op_timing_exec_head = NULL;
 static avTimingsNode_t *op_timing_exec_tail = NULL;
@@ -77,107 +90,6 @@ void print_trace(FILE *f)
 	fprintf(f, "stack trace for %s pid=%s\n", name_buf, pid_buf);
 }
 
-static int *lookupRankSendCounters(SRCountNode_t *call_data, int rank)
-{
-	return lookup_rank_counters(call_data->send_data_size, call_data->send_data, rank);  //TODO alltoallv coversion: send_data_size will =1 if it, where is that set?
-}
-
-static int *lookupRankRecvCounters(SRCountNode_t *call_data, int rank)
-{
-	return lookup_rank_counters(call_data->recv_data_size, call_data->recv_data, rank); //TODO alltoallv coversion: send_data_size will =1?, where is that set?
-}
-
-// Compare if two arrays are identical.
-// Called with same_call_counters(temp, sbuf, rbuf, size) where temp is current CountNode in the linked list being worked through
-static bool same_call_counters(SRCountNode_t *call_data, int *send_counts, int *recv_counts, int size)  // size = size of communicator
-{
-	int num = 0;
-	int rank, count_num;
-	int *_counts;
-
-	DEBUG_ALLTOALL_PROFILING("Comparing data with existing data...\n");
-	DEBUG_ALLTOALL_PROFILING("-> Comparing send counts...\n");
-	// First compare the send counts
-// #if ASSUME_COUNTS_EQUAL_ALL_RANKS !=1
-	for (rank = 0; rank < size; rank++)
-	{
-		_counts = lookupRankSendCounters(call_data, rank);  // TODO conversion from alltoallv: return just the singe counter value for that rank
-		assert(_counts);
-		count_num = 0; //  conversion from alltoallv: no need to loop since only one value for the rank
-		if (_counts[count_num] != send_counts[num])
-		{
-			DEBUG_ALLTOALL_PROFILING("Data differs\n");
-			return false;
-		}
-	}
-// #else
-// 	rank = 0;
-// 	_counts = lookupRankSendCounters(call_data, rank);  // TODO conversion from alltoallv: return just the singe counter value for that rank
-// 	assert(_counts);
-// 	count_num = 0;  // conversion from alltoallv: no need to loop since only one value for the rank
-// 	if (_counts[count_num] != send_counts[num])
-// 	{
-// 		DEBUG_ALLTOALL_PROFILING("Data differs\n");
-// 		return false;
-// 	}
-// #endif
-	DEBUG_ALLTOALL_PROFILING("-> Send counts are the same\n");
-
-	// Then the receive counts
-	DEBUG_ALLTOALL_PROFILING("-> Comparing recv counts...\n");
-	num = 0;
-// #if ASSUME_COUNTS_EQUAL_ALL_RANKS !=1
-	for (rank = 0; rank < size; rank++)
-	{
-		_counts = lookupRankRecvCounters(call_data, rank);  // TODO conversion from alltoallv: return just the singe counter value for that rank
-		count_num = 0;  //  conversion from alltoallv: no need to loop since only one value for the rank
-		if (_counts[count_num] != recv_counts[num])
-		{
-			DEBUG_ALLTOALL_PROFILING("Data differs\n");
-			return false;
-		}
-	}
-// #else
-// 	rank = 0;
-// 	_counts = lookupRankRecvCounters(call_data, rank);  // TODO conversion from alltoallv: return just the singe counter value for that rank
-// 	count_num = 0;  // TODO conversion from alltoallv: no need to loop since only one value for the rank
-// 	if (_counts[count_num] != recv_counts[num])
-// 	{
-// 		DEBUG_ALLTOALL_PROFILING("Data differs\n");
-// 		return false;
-// 	}
-// #endif
-
-	DEBUG_ALLTOALL_PROFILING("Data is the same\n");
-	return true;
-}
-
-// called with lookupCounters(call_data->size, call_data->send_data_size --> num, call_data->send_data, counts);
-// call_data is a SRCountNode_t and size is the comm size, send_data_size is "Size of the array of unique series of send counters", send_data is counts_data_t ** the just said array 
-// and counts is &(rbuf[num * size])
-// returns list[i] where count[j] != list[i]->counters[j], list[i] is the counts_data argument, which is call_data->send_data, which is NewNode->senddata and if j == size, i.e. if they match 
-static counts_data_t *lookupCounters(int size, int num, counts_data_t **list, int *count)
-{
-	int i, j;
-	for (i = 0; i < num; i++)  // i counts to num, so this is a loop over counts_data ** send_data
-	{
-		for (j = 0; j < size; j++)  // and this is a loop over ranks? (Size= communicator size)
-		{
-			if (count[j] != list[i]->counters[j])
-			{
-				break;
-			}
-		}
-
-		if (j == size)  // i.e. if j loop completed without a difference being found by the if
-		{
-			return list[i];
-		}
-	}
-
-	return NULL;
-}
-
 static int extract_patterns_from_counts(int *send_counts, int *recv_counts, int size)
 {
 	int i, j, num;
@@ -338,268 +250,6 @@ static int commit_pattern_from_counts(int callID, int *send_counts, int *recv_co
 #endif
 }
 
-static counts_data_t *lookupSendCounters(int *counts, SRCountNode_t *call_data)
-{
-	return lookupCounters(call_data->size, call_data->send_data_size, call_data->send_data, counts);
-}
-
-static counts_data_t *lookupRecvCounters(int *counts, SRCountNode_t *call_data)
-{
-	return lookupCounters(call_data->size, call_data->recv_data_size, call_data->recv_data, counts);
-}
-
-static int add_rank_to_counters_data(int rank, counts_data_t *counters_data)  // TODO - DONE no alltoall mods here - adding rank records not counts.
-{
-	if (counters_data->num_ranks >= counters_data->max_ranks)
-	{
-		counters_data->max_ranks = counters_data->num_ranks + MAX_TRACKED_RANKS;
-		counters_data->ranks = (int *)realloc(counters_data->ranks, counters_data->max_ranks * sizeof(int));
-		assert(counters_data->ranks);
-	}
-
-	counters_data->ranks[counters_data->num_ranks] = rank;
-	counters_data->num_ranks++;
-	return 0;
-}
-
-static void delete_counter_data(counts_data_t **data)
-{
-	if (*data)
-	{
-		if ((*data)->ranks)
-		{
-			free((*data)->ranks);
-		}
-		if ((*data)->counters)
-		{
-			free((*data)->counters);
-		}
-		free(*data);
-		*data = NULL;
-	}
-}
-
-static counts_data_t *new_counter_data(int size, int rank, int *counts)
-{
-	int i;
-	counts_data_t *new_data = (counts_data_t *)malloc(sizeof(counts_data_t));
-	assert(new_data);
-	new_data->counters = (int *)malloc(sizeof(int)); // was malloc(size * sizeof(int)) for alltoallv but only one count per rank for alltoall
-	assert(new_data->counters);
-	new_data->num_ranks = 0;
-	new_data->max_ranks = MAX_TRACKED_RANKS;
-	new_data->ranks = (int *)malloc(new_data->max_ranks * sizeof(int));
-	assert(new_data->ranks);
-
-    // alltoall mod here is to write only one count (so loop removed cf alltoallv) 
-	new_data->counters[0] = counts[0];
-
-	new_data->ranks[new_data->num_ranks] = rank;
-	new_data->num_ranks++;
-
-	return new_data;
-}
-
-// called with add_new_send_counters_to_counters_data(call_data, rank, counts), which are the newnode?, the rank and the relevant section of sbuf?
-static int add_new_send_counters_to_counters_data(SRCountNode_t *call_data, int rank, int *counts)  //TODO alltoall mods fro alltoallv
-{
-	counts_data_t *new_data = new_counter_data(call_data->size, rank, counts);
-	call_data->send_data[call_data->send_data_size] = new_data;
-	call_data->send_data_size++;
-
-	return 0;
-}
-
-static int add_new_recv_counters_to_counters_data(SRCountNode_t *call_data, int rank, int *counts)
-{
-	counts_data_t *new_data = new_counter_data(call_data->size, rank, counts);
-	call_data->recv_data[call_data->recv_data_size] = new_data;
-	call_data->recv_data_size++;
-
-	return 0;
-}
-
-// called with compareAndSaveSendCounters(_rank, &(sbuf[num * size]), newNode) in alltoallv
-// for alltoall called with compareAndSaveSendCounters(_rank, &(sbuf[num]), newNode) or compareAndSaveSendCounters(_rank, &(sbuf[0]), newNode)
-static int compareAndSaveSendCounters(int rank, int *counts, SRCountNode_t *call_data)
-{
-	counts_data_t *ptr = lookupSendCounters(counts, call_data);
-	if (ptr)
-	{
-		DEBUG_ALLTOALL_PROFILING("Add send rank %d to existing count data\n", rank);
-		if (add_rank_to_counters_data(rank, ptr))
-		{
-			fprintf(stderr, "[%s:%d][ERROR] unable to add rank counters (rank: %d)\n", __FILE__, __LINE__, rank);
-			return -1;
-		}
-	}
-	else
-	{
-		DEBUG_ALLTOALL_PROFILING("Add send new count data for rank %d\n", rank);
-		if (add_new_send_counters_to_counters_data(call_data, rank, counts))
-		{
-			fprintf(stderr, "[%s:%d][ERROR] unable to add new send counters\n", __FILE__, __LINE__);
-			return -1;
-		}
-	}
-
-	return 0;
-}
-
-static int compareAndSaveRecvCounters(int rank, int *counts, SRCountNode_t *call_data)
-{
-	counts_data_t *ptr = lookupRecvCounters(counts, call_data);
-	if (ptr)
-	{
-		DEBUG_ALLTOALL_PROFILING("Add recv rank %d to existing count data\n", rank);
-		if (add_rank_to_counters_data(rank, ptr))
-		{
-			fprintf(stderr, "[ERROR] unable to add rank counters\n");
-			return -1;
-		}
-	}
-	else
-	{
-		DEBUG_ALLTOALL_PROFILING("Add recv new count data for rank %d\n", rank);
-		if (add_new_recv_counters_to_counters_data(call_data, rank, counts))
-		{
-			fprintf(stderr, "[ERROR] unable to add new recv counters\n");
-			return -1;
-		}
-	}
-
-	return 0;
-}
-
-// Compare new send count data with existing data.
-// If there is a match, increas the counter. Add new data, otherwise.
-// recv count was not compared.
-// called with insert_sendrecv_count_data(sbuf, rbuf, comm_size, sizeof(sendtype), sizeof(recvtype))
-static int insert_sendrecv_count_data(int *sbuf, int *rbuf, int size, int sendtype_size, int recvtype_size)  // size = size of communicator
-{
-	int i, j, num = 0;
-	struct SRCountNode *newNode = NULL;
-	struct SRCountNode *temp;
-
-	DEBUG_ALLTOALL_PROFILING("Insert data for a new alltoall call...\n");
-
-	assert(sbuf);
-	assert(rbuf);
-	assert(logger);
-
-	temp = counts_head;
-	while (temp != NULL)
-	{
-		if (temp->size != size || temp->recvtype_size != recvtype_size || temp->sendtype_size != sendtype_size || !same_call_counters(temp, sbuf, rbuf, size))
-		{
-			// New data
-#if DEBUG
-			fprintf(logger->f, "new data: %d\n", size);
-#endif
-			if (temp->next != NULL)
-				temp = temp->next;
-			else
-				break;
-		}
-		else
-		{
-			// Data exist, adding call info to it
-			DEBUG_ALLTOALL_PROFILING("Data already exists, updating metadata...\n");
-			assert(temp->list_calls);
-			if (temp->count >= temp->max_calls)
-			{
-				temp->max_calls = temp->max_calls * 2;
-				temp->list_calls = (uint64_t *)realloc(temp->list_calls, temp->max_calls * sizeof(uint64_t));
-				assert(temp->list_calls);
-			}
-			temp->list_calls[temp->count] = avCalls; // Note: count starts at 1, not 0
-			temp->count++;
-#if DEBUG
-			fprintf(logger->f, "old data: %d --> %d --- %d\n", size, temp->size, temp->count);
-#endif
-			DEBUG_ALLTOALL_PROFILING("Metadata successfully updated\n");
-			return 0;
-		}
-	}
-
-#if DEBUG
-	fprintf(logger->f, "no data: %d \n", size);
-#endif
-	newNode = (struct SRCountNode *)malloc(sizeof(SRCountNode_t));  // TODO Anaylse data structure written from here onwards 
-	assert(newNode);
-
-	newNode->size = size;
-	newNode->rank_send_vec_len = 1;
-	newNode->rank_recv_vec_len = 1;
-	newNode->count = 1;
-	newNode->list_calls = (uint64_t *)malloc(DEFAULT_TRACKED_CALLS * sizeof(uint64_t));
-	assert(newNode->list_calls);
-	newNode->max_calls = DEFAULT_TRACKED_CALLS;
-	// We have at most <size> different counts (one per rank) and we just allocate pointers of pointers here, not much space used  //TODO adapt to counts for alltoall (cf alltoallv)
-	newNode->send_data = (counts_data_t **)malloc(size * sizeof(counts_data_t));
-	assert(newNode->send_data);
-	newNode->send_data_size = 0;
-	newNode->recv_data = (counts_data_t **)malloc(size * sizeof(counts_data_t));
-	assert(newNode->recv_data);
-	newNode->recv_data_size = 0;
-
-	// We add rank's data one by one so we can compress the data when possible
-	num = 0;
-	int _rank;
-
-	DEBUG_ALLTOALL_PROFILING("handling send counts...\n");
-	for (_rank = 0; _rank < size; _rank++)
-	{
-//#if ASSUME_COUNTS_EQUAL_ALL_RANKS != 1 	
-		if (compareAndSaveSendCounters(_rank, &(sbuf[num]), newNode))  //portion of sbuf selected is just one count, for the rank, for alltoall
-// #else
-// 		if (compareAndSaveSendCounters(_rank, &(sbuf[0]), newNode))  //portion of sbuf selected is just one count, for all ranks, for alltoall , [0] because assuming it is the same for all ranks
-// #endif
-		{
-			fprintf(stderr, "[%s:%d][ERROR] unable to add send counters\n", __FILE__, __LINE__);
-			return -1;
-		}
-		num++;  // so num always = _rank   - but why?
-	}
-
-	DEBUG_ALLTOALL_PROFILING("handling recv counts...\n");
-	num = 0;
-	for (_rank = 0; _rank < size; _rank++)
-	{
-//#if ASSUME_COUNTS_EQUAL_ALL_RANKS != 1 	
-		if (compareAndSaveRecvCounters(_rank, &(rbuf[num]), newNode))
-// #else
-// 		if (compareAndSaveRecvCounters(_rank, &(rbuf[0]), newNode))
-// #endif
-		{
-			fprintf(stderr, "[%s:%d][ERROR] unable to add recv counters\n", __FILE__, __LINE__);
-			return -1;
-		}
-		num++;
-	}
-
-	newNode->sendtype_size = sendtype_size;
-	newNode->recvtype_size = recvtype_size;
-	newNode->list_calls[0] = avCalls;
-	newNode->next = NULL;
-#if DEBUG
-	fprintf(logger->f, "new entry: %d --> %d --- %d\n", size, newNode->size, newNode->count);
-#endif
-
-	DEBUG_ALLTOALL_PROFILING("Data for the new alltoall call has %d unique series for send counts and %d for recv counts\n", newNode->recv_data_size, newNode->send_data_size);
-
-	if (counts_head == NULL)
-	{
-		counts_head = newNode;
-	}
-	else
-	{
-		temp->next = newNode;
-	}
-
-	return 0;
-}
-
 static void display_per_host_data(int size)
 {
 	int i;
@@ -639,7 +289,7 @@ static void save_call_patterns(int uniqueID)
 	}
 	assert(size > 0);
 
-	FILE *fh = fopen(filename, "w");
+	FILE *fh = profile_fopen(filename, "w", "patterns");
 	assert(fh);
 
 	avCallPattern_t *ptr = call_patterns;
@@ -677,9 +327,9 @@ static void save_patterns(int world_rank)
 		assert(size > 0);
 	}
 
-	FILE *spatterns_fh = fopen(spatterns_filename, "w");
+	FILE *spatterns_fh = profile_fopen(spatterns_filename, "w", "patterns");
 	assert(spatterns_fh);
-	FILE *rpatterns_fh = fopen(rpatterns_filename, "w");
+	FILE *rpatterns_fh = profile_fopen(rpatterns_filename, "w", "patterns");
 	assert(rpatterns_fh);
 	avPattern_t *ptr;
 
@@ -692,38 +342,38 @@ static void save_patterns(int world_rank)
 	free(rpatterns_filename);
 }
 
+// Validation data goes to one append-only binary store per rank (with an
+// embedded call index) instead of one text file per rank per call, which at
+// scale created millions of tiny files and throttled the metadata servers.
+static validation_store_t *_validation_store = NULL;
+
 static void save_counters_for_validation(int myrank, int avCalls, int size, const int *sendcounts, const int *recvcounts)
 {
-	char *filename;
-	int rc;
-
-	if (getenv(OUTPUT_DIR_ENVVAR))
-	{
-		_asprintf(filename, rc, "%s/validation_data-rank%d-call%d.txt", getenv(OUTPUT_DIR_ENVVAR), myrank, avCalls);
-	}
-	else
+	if (_validation_store == NULL)
 	{
-		_asprintf(filename, rc, "validation_data-rank%d-call%d.txt", myrank, avCalls);
+		_validation_store = validation_store_open("alltoall", myrank);
+		assert(_validation_store);
 	}
-	assert(rc < MAX_PATH_LEN);
-
-	FILE *fh = fopen(filename, "w");
-	assert(fh);
-	int i;
-	for (i = 0; i < size; i++)
+	if (validation_store_append(_validation_store, (uint64_t)avCalls, size, sendcounts, recvcounts))
 	{
-		fprintf(fh, "%d ", sendcounts[i]);
+		fprintf(stderr, "[%s:%d][ERROR] unable to append validation data\n", __FILE__, __LINE__);
+		PMPI_Abort(MPI_COMM_WORLD, 1);
 	}
+}
 
-	fprintf(fh, "\n\n");
+// Process identity is immutable for the life of the process: the hostname -
+// whose lookup can go through NSS - and the PID are resolved once at init and
+// reused by every per-call and per-logger path.
+static char _hostname[256] = {0};
+static int _pid = 0;
 
-	for (i = 0; i < size; i++)
+static void init_process_identity(void)
+{
+	if (_pid == 0)
 	{
-		fprintf(fh, "%d ", recvcounts[i]);
+		gethostname(_hostname, sizeof(_hostname));
+		_pid = getpid();
 	}
-
-	fclose(fh);
-	free(filename);
 }
 
 static char *get_pe_id(int comm_rank)
@@ -733,10 +383,9 @@ static char *get_pe_id(int comm_rank)
 	// the *beginning* of the hostname in order to fit within 128 bytes.
 	char *id = NULL;
 	int size;
-	char hostname[128];
-	gethostname(hostname, 128);
+	const char *hostname = _hostname;
 
-	_asprintf(id, size, "%d.%d.%d", getpid(), world_rank, comm_rank);
+	_asprintf(id, size, "%d.%d.%d", _pid, world_rank, comm_rank);
 	assert(size > 0 && size < 128);
 	if (size + strlen(hostname) < 128)
 	{
@@ -784,6 +433,7 @@ int _mpi_init(int *argc, char ***argv)
 	}
 
 	ret = PMPI_Init(argc, argv);
+	init_process_identity();
 
 	MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
 	MPI_Comm_size(MPI_COMM_WORLD, &world_size);
@@ -831,6 +481,7 @@ int MPI_Finalize()
 {
 	_commit_data();
 	_finalize_profiling();
+	node_aggregate_finalize("alltoall");
 	return PMPI_Finalize();
 }
 
@@ -853,46 +504,17 @@ int mpi_init_(MPI_Fint *ierr)
 static int _release_counts_resources()
 {
 	// All data has been handled, now we can clean up
-	int i;
-	while (counts_head != NULL)
-	{
-		SRCountNode_t *c_ptr = counts_head->next;
-
-		for (i = 0; i < counts_head->send_data_size; i++)
-		{
-			delete_counter_data(&(counts_head->send_data[i]));
-		}
-
-		for (i = 0; i < counts_head->recv_data_size; i++)
-		{
-			delete_counter_data(&(counts_head->recv_data[i]));
-		}
-
-		free(counts_head->recv_data);
-		free(counts_head->send_data);
-		free(counts_head->list_calls);
-
-		free(counts_head);
-		counts_head = c_ptr;
-	}
+	counts_engine_release();
 	return 0;
 }
 
 static int _release_pattern_resources()
 {
-	while (rpatterns != NULL)
-	{
-		avPattern_t *rp = rpatterns->next;
-		free(rpatterns);
-		rpatterns = rp;
-	}
-
-	while (spatterns != NULL)
-	{
-		avPattern_t *sp = spatterns->next;
-		free(spatterns);
-		spatterns = sp;
-	}
+	free_patterns(rpatterns);
+	rpatterns = NULL;
+	free_patterns(spatterns);
+	spatterns = NULL;
+	patterns_cleanup();
 
 	return 0;
 }
@@ -962,6 +584,7 @@ static int _release_profiling_resources()
 
 static int _finalize_profiling()
 {
+	validation_store_close(&_validation_store);
 	logger_fini(&logger);
 	_release_profiling_resources();
 }
@@ -1060,12 +683,12 @@ int _mpi_alltoall(const void *sendbuf, const int sendcount, MPI_Datatype sendtyp
 	{
 		void *array[16];
 		size_t _s;
-		char **strings;
-		char *caller_trace = NULL;
 
+		// Symbol resolution is cached on the raw return addresses: see
+		// insert_caller_data_addrs(), backtrace_symbols() only runs once per
+		// unique trace.
 		_s = backtrace(array, 16);
-		strings = backtrace_symbols(array, _s);
-		insert_caller_data(collective_name, strings, _s, comm, my_comm_rank, world_rank, avCalls);
+		insert_caller_data_addrs(collective_name, array, _s, comm, my_comm_rank, world_rank, avCalls);
 	}
 #endif // ENABLE_BACKTRACE
 
@@ -1147,27 +770,51 @@ int _mpi_alltoall(const void *sendbuf, const int sendcount, MPI_Datatype sendtyp
 #endif // ENABLE_LATE_ARRIVAL_TIMING
 
 #if ENABLE_LOCATION_TRACKING
-		int my_pid = getpid();
-		int *pids = (int *)malloc(comm_size * sizeof(int));
-		assert(pids);
-		int *world_comm_ranks = (int *)malloc(comm_size * sizeof(int));
-		assert(world_comm_ranks);
-		char hostname[256];
-		gethostname(hostname, 256);
-		char *hostnames = (char *)malloc(256 * comm_size * sizeof(char));
-		assert(hostnames);
-
-		MPI_Gather(&my_pid, 1, MPI_INT, pids, 1, MPI_INT, 0, comm);
-		MPI_Gather(&world_rank, 1, MPI_INT, world_comm_ranks, 1, MPI_INT, 0, comm);
-		MPI_Gather(&hostname, 256, MPI_CHAR, hostnames, 256, MPI_CHAR, 0, comm);
-		if (my_comm_rank == 0)
+		// Locations are immutable for the life of a communicator: gather them
+		// only the first time the communicator is profiled, afterwards just
+		// reference the cached record by communicator ID.
+		comm_data_t *location_comm_data = NULL;
+		if (lookup_comm_data(comm, &location_comm_data) != 0)
 		{
-			int rc = commit_rank_locations(collective_name, comm, comm_size, world_rank, my_comm_rank, pids, world_comm_ranks, hostnames, avCalls);
-			if (rc)
+			uint32_t location_comm_id;
+			add_comm(comm, world_rank, my_comm_rank, &location_comm_id);
+			lookup_comm_data(comm, &location_comm_data);
+		}
+		assert(location_comm_data);
+		if (location_comm_data->location_tracked == 0)
+		{
+			int *pids = NULL;
+			int *world_comm_ranks = NULL;
+			char *hostnames = NULL;
+			if (my_comm_rank == 0)
 			{
-				fprintf(stderr, "save_rank_locations() failed: %d", rc);
-				MPI_Abort(MPI_COMM_WORLD, 1);
+				// The profiler frees these buffers when finalizing; only the root
+				// needs them.
+				pids = (int *)malloc(comm_size * sizeof(int));
+				assert(pids);
+				world_comm_ranks = (int *)malloc(comm_size * sizeof(int));
+				assert(world_comm_ranks);
+				hostnames = (char *)malloc(256 * comm_size * sizeof(char));
+				assert(hostnames);
 			}
+
+			MPI_Gather(&_pid, 1, MPI_INT, pids, 1, MPI_INT, 0, comm);
+			MPI_Gather(&world_rank, 1, MPI_INT, world_comm_ranks, 1, MPI_INT, 0, comm);
+			MPI_Gather(_hostname, 256, MPI_CHAR, hostnames, 256, MPI_CHAR, 0, comm);
+			if (my_comm_rank == 0)
+			{
+				int rc = commit_rank_locations(collective_name, comm, comm_size, world_rank, my_comm_rank, pids, world_comm_ranks, hostnames, avCalls);
+				if (rc)
+				{
+					fprintf(stderr, "save_rank_locations() failed: %d", rc);
+					MPI_Abort(MPI_COMM_WORLD, 1);
+				}
+			}
+			location_comm_data->location_tracked = 1;
+		}
+		else if (my_comm_rank == 0)
+		{
+			commit_rank_locations_by_id(collective_name, comm, avCalls);
 		}
 #endif // ENABLE_LOCATION_TRACKING
 
@@ -1179,9 +826,9 @@ int _mpi_alltoall(const void *sendbuf, const int sendcount, MPI_Datatype sendtyp
 
 #if ((ENABLE_RAW_DATA || ENABLE_PER_RANK_STATS || ENABLE_VALIDATION) && ENABLE_COMPACT_FORMAT)
 			int s_dt_size, r_dt_size;
-			MPI_Type_size(sendtype, &s_dt_size);
-			MPI_Type_size(recvtype, &r_dt_size);
-			if (insert_sendrecv_count_data(sbuf, rbuf, comm_size, s_dt_size, r_dt_size)) // perhaps change comm_size => 1 here??? no
+			s_dt_size = cached_type_size(sendtype);
+			r_dt_size = cached_type_size(recvtype);
+			if (insert_sendrecv_count_data(sbuf, rbuf, comm_size, s_dt_size, r_dt_size, avCalls))
 			{
 				fprintf(stderr, "[%s:%d][ERROR] unable to insert send/recv counts\n", __FILE__, __LINE__);
 				MPI_Abort(MPI_COMM_WORLD, 1);
@@ -1190,8 +837,8 @@ int _mpi_alltoall(const void *sendbuf, const int sendcount, MPI_Datatype sendtyp
 
 #if ((ENABLE_RAW_DATA || ENABLE_PER_RANK_STATS || ENABLE_VALIDATION) && !ENABLE_COMPACT_FORMAT)
 			int s_dt_size, r_dt_size;
-			MPI_Type_size(sendtype, &s_dt_size);
-			MPI_Type_size(recvtype, &r_dt_size);
+			s_dt_size = cached_type_size(sendtype);
+			r_dt_size = cached_type_size(recvtype);
 			save_counts(sbuf, rbuf, s_dt_size, r_dt_size, comm_size, avCalls);
 #endif // ((ENABLE_RAW_DATA || ENABLE_PER_RANK_STATS || ENABLE_VALIDATION) && !ENABLE_COMPACT_FORMAT)
 
@@ -1256,12 +903,112 @@ int _mpi_alltoall(const void *sendbuf, const int sendcount, MPI_Datatype sendtyp
 	return ret;
 }
 
+// The datatype cache keys on the handle, which the MPI library may recycle
+// once the type is freed.
+int MPI_Type_free(MPI_Datatype *type)
+{
+	if (type != NULL)
+	{
+		datatype_cache_invalidate(*type);
+	}
+	return PMPI_Type_free(type);
+}
+
+int MPI_Comm_free(MPI_Comm *comm)
+{
+	// Release the per-communicator profiling state: close the timing loggers
+	// early (their content is complete once the communicator goes away) and
+	// drop the handle mapping so a recycled handle gets a fresh record.
+	comm_data_t *comm_data = NULL;
+	if (lookup_comm_data(*comm, &comm_data) == 0)
+	{
+		int series;
+		for (series = 0; series < NUM_TIMING_SERIES; series++)
+		{
+			if (comm_data->timing_logger[series] != NULL)
+			{
+				comm_timing_logger_t *timing_logger = (comm_timing_logger_t *)comm_data->timing_logger[series];
+				fini_time_tracking(&timing_logger);
+			}
+		}
+		drop_comm(*comm);
+	}
+	return PMPI_Comm_free(comm);
+}
+
+// Register a newly created communicator eagerly so the first profiled
+// collective on it does not pay for the registration.
+static void register_new_comm(MPI_Comm newcomm)
+{
+	uint32_t comm_id;
+	if (newcomm == MPI_COMM_NULL || lookup_comm(newcomm, &comm_id) == 0)
+	{
+		return;
+	}
+	int my_comm_rank;
+	PMPI_Comm_rank(newcomm, &my_comm_rank);
+	add_comm(newcomm, world_rank, my_comm_rank, &comm_id);
+}
+
+int MPI_Comm_dup(MPI_Comm comm, MPI_Comm *newcomm)
+{
+	int ret = PMPI_Comm_dup(comm, newcomm);
+	if (ret == MPI_SUCCESS)
+	{
+		register_new_comm(*newcomm);
+	}
+	return ret;
+}
+
+int MPI_Comm_split(MPI_Comm comm, int color, int key, MPI_Comm *newcomm)
+{
+	int ret = PMPI_Comm_split(comm, color, key, newcomm);
+	if (ret == MPI_SUCCESS)
+	{
+		register_new_comm(*newcomm);
+	}
+	return ret;
+}
+
+int MPI_Comm_split_type(MPI_Comm comm, int split_type, int key, MPI_Info info, MPI_Comm *newcomm)
+{
+	int ret = PMPI_Comm_split_type(comm, split_type, key, info, newcomm);
+	if (ret == MPI_SUCCESS)
+	{
+		register_new_comm(*newcomm);
+	}
+	return ret;
+}
+
 int MPI_Alltoall(const void *sendbuf, const int sendcount, MPI_Datatype sendtype,
                   void *recvbuf, const int recvcount, MPI_Datatype recvtype, MPI_Comm comm)
 {
 	return _mpi_alltoall(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
 }
 
+#if defined(MPI_VERSION) && MPI_VERSION >= 4
+// MPI-4 large-count variant. Counts that fit in an int - by far the common
+// case - are narrowed and profiled through the regular path; otherwise the
+// exact 64-bit counts are saved to a per-rank sidecar file and the operation
+// runs unprofiled.
+int MPI_Alltoall_c(const void *sendbuf, MPI_Count sendcount, MPI_Datatype sendtype,
+				   void *recvbuf, MPI_Count recvcount, MPI_Datatype recvtype, MPI_Comm comm)
+{
+	int ret;
+
+	if (large_counts_fit(&sendcount, 1) && large_counts_fit(&recvcount, 1))
+	{
+		return _mpi_alltoall(sendbuf, (int)sendcount, sendtype, recvbuf, (int)recvcount, recvtype, comm);
+	}
+
+	PMPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+	save_large_counts("alltoall", world_rank, avCalls, &sendcount, 1, &recvcount, 1);
+	ret = PMPI_Alltoall_c(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+	avCalls++;
+	return ret;
+}
+#endif // MPI_VERSION >= 4
+
 void mpi_alltoall_(void *sendbuf, MPI_Fint sendcount,  MPI_Fint *sendtype,
 					void *recvbuf, MPI_Fint recvcount,  MPI_Fint *recvtype,
 					MPI_Fint *comm, MPI_Fint *ierr)
@@ -1295,4 +1042,5 @@ void calledLast()
 {
 	_commit_data();
 	_finalize_profiling();
+	node_aggregate_finalize("alltoall");
 }
\ No newline at end of file
@@ -14,10 +14,28 @@
 #define LIMIT_ALLTOALLV_CALLS_ENVVAR "A2A_LIMIT_ALLTOALLV_CALLS_ENVVAR"
 #define A2A_COMMIT_PROFILER_DATA_AT_ENVVAR "A2A_COMMIT_PROFILER_DATA_AT"
 #define A2A_RELEASE_RESOURCES_AFTER_DATA_COMMIT_ENVVAR "A2A_RELEASE_RESOURCES_AFTER_DATA_COMMIT"
+#define A2A_HIERARCHICAL_GATHER_ENVVAR "A2A_HIERARCHICAL_GATHER" // When set to 1, counts are collected through node leaders instead of a flat gather
+#define A2A_BATCHED_COLLECTION_ENVVAR "A2A_BATCHED_COLLECTION"	 // When set to 1, counts and timings are packed and collected with a single non-blocking gather
+#define A2A_ASYNC_COMMIT_ENVVAR "A2A_ASYNC_COMMIT"				 // When set to 1, mid-run data commits are handled by a background writer thread
+#define A2A_COMMIT_INTERVAL_ENVVAR "A2A_COMMIT_INTERVAL"
+#define A2A_UNCHANGED_FAST_PATH_ENVVAR "A2A_UNCHANGED_FAST_PATH"
+#define A2A_MSG_SIZE_HISTOGRAM_ENVVAR "A2A_MSG_SIZE_HISTOGRAM"
+#define A2A_ROLE_SHARDING_ENVVAR "A2A_ROLE_SHARDING"			 // When set to 1, the per-call collection roles (counts, timings, locations) are spread over different ranks instead of all landing on comm rank 0
+#define A2A_SAMPLING_RATE_ENVVAR "A2A_SAMPLING_RATE"			 // When set to K > 1, only every K-th alltoallv call is profiled
+#define A2A_DUTY_CYCLE_ENVVAR "A2A_DUTY_CYCLE"					 // "N:M": profile N consecutive calls, then skip M, repeating
+#define A2A_CLOCK_SYNC_LATE_ARRIVAL_ENVVAR "A2A_CLOCK_SYNC_LATE_ARRIVAL" // When set to 1, arrival skew is measured from clock-corrected timestamps instead of a barrier
+#define A2A_CLOCK_SYNC_INTERVAL_ENVVAR "A2A_CLOCK_SYNC_INTERVAL"		 // Number of world-spanning calls between clock-offset recalibrations (0 disables refresh)
+#define A2A_PROFILE_FEATURES_ENVVAR "A2A_PROFILE_FEATURES"				 // Comma-separated list of features to keep enabled at runtime (counts,exec_timings,late_arrival,backtrace,location); unset keeps every compiled-in feature on
+#define A2A_THREAD_SAFE_ENVVAR "A2A_THREAD_SAFE"						 // Force thread-safe profiling on (1) or off (0); defaults to on when MPI grants MPI_THREAD_MULTIPLE
+#define A2A_MEM_BUDGET_ENVVAR "A2A_MEM_BUDGET"						 // Cap, in MiB, on the in-memory count data; when exceeded the profiler commits and releases its data (0: unbounded)
+#define CLOCK_SYNC_ROUNDS (10)	 // Ping-pong rounds per rank during clock-offset calibration
 
 #define DEFAULT_LIMIT_ALLTOALLV_CALLS (-1) // Maximum number of alltoallv calls that we profile (-1 means no limit)
 #define NUM_CALL_START_PROFILING (0)       // During which call do we start profiling? By default, the very first one. Note that once started, DEFAULT_LIMIT_ALLTOALLV_CALLS says when we stop profiling
 #define DEFAULT_TRACKED_CALLS (10)
+#define COUNTS_ARENA_BLOCK_SIZE (4 * 1024 * 1024) // Block size of the arena backing the count bookkeeping structures
+#define COUNTS_HASH_BUCKETS (4096) // Number of buckets of the hash index over count signatures (power of two)
+#define REQUEST_REGISTRY_BUCKETS (256) // Number of buckets of the in-flight nonblocking request registry (power of two)
 
 
 #endif // _COLLECTIVE_PROFILER_ALLTOALLV_CONFIG_H
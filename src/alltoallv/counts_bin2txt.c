@@ -0,0 +1,98 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Converts a raw binary counts dump (counts.rank<n>.bin, produced by the
+// non-compact build when COLLECTIVE_PROFILER_BINARY_FORMAT=1) back to the old
+// per-call text layout (counts.rank<n>_call<id>.md) so existing analysis
+// scripts keep working.
+
+typedef struct counts_dump_header
+{
+	uint64_t call_id;
+	uint32_t comm_size;
+	uint32_t s_datatype_size;
+	uint32_t r_datatype_size;
+	uint32_t padding;
+} counts_dump_header_t;
+
+static void write_matrix(FILE *f, int *matrix, int comm_size)
+{
+	int i, j;
+	int idx = 0;
+	for (i = 0; i < comm_size; i++)
+	{
+		for (j = 0; j < comm_size; j++)
+		{
+			fprintf(f, "%d ", matrix[idx]);
+			idx++;
+		}
+		fprintf(f, "\n");
+	}
+}
+
+int main(int argc, char **argv)
+{
+	if (argc != 3)
+	{
+		fprintf(stderr, "Usage: %s <counts.rank<n>.bin> <rank>\n", argv[0]);
+		return 1;
+	}
+
+	FILE *in = fopen(argv[1], "r");
+	if (in == NULL)
+	{
+		fprintf(stderr, "unable to open %s\n", argv[1]);
+		return 1;
+	}
+	int rank = atoi(argv[2]);
+
+	counts_dump_header_t header;
+	while (fread(&header, sizeof(header), 1, in) == 1)
+	{
+		int comm_size = (int)header.comm_size;
+		size_t matrix_len = (size_t)comm_size * comm_size;
+		int *sendcounts = (int *)malloc(matrix_len * sizeof(int));
+		int *recvcounts = (int *)malloc(matrix_len * sizeof(int));
+		assert(sendcounts && recvcounts);
+		if (fread(sendcounts, sizeof(int), matrix_len, in) != matrix_len ||
+			fread(recvcounts, sizeof(int), matrix_len, in) != matrix_len)
+		{
+			fprintf(stderr, "truncated record for call %" PRIu64 "\n", header.call_id);
+			free(sendcounts);
+			free(recvcounts);
+			fclose(in);
+			return 1;
+		}
+
+		char filename[256];
+		snprintf(filename, sizeof(filename), "counts.rank%d_call%" PRIu64 ".md", rank, header.call_id);
+		FILE *out = fopen(filename, "w");
+		assert(out);
+
+		fprintf(out, "Send datatype size: %d\n", (int)header.s_datatype_size);
+		fprintf(out, "Recv datatype size: %d\n", (int)header.r_datatype_size);
+		fprintf(out, "Comm size: %d\n\n", comm_size);
+
+		fprintf(out, "Send counts\n");
+		write_matrix(out, sendcounts, comm_size);
+		fprintf(out, "\n\nRecv counts\n");
+		write_matrix(out, recvcounts, comm_size);
+
+		fclose(out);
+		free(sendcounts);
+		free(recvcounts);
+	}
+
+	fclose(in);
+	return 0;
+}
@@ -6,6 +6,10 @@
  ************************************************************************/
 
 #include <mpi.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 #include "alltoallv_profiler.h"
 #include "logger.h"
@@ -13,18 +17,58 @@
 #include "pattern.h"
 #include "execinfo.h"
 #include "timings.h"
+#include "comm.h"
 #include "backtrace.h"
 #include "location.h"
 #include "buff_content.h"
+#include "compress.h"
+#include "node_aggregate.h"
 #include "datatype.h"
+#include "bigcounts.h"
+#include "validation_store.h"
+#include "hash.h"
+#include "arena.h"
+#include "msg_histogram.h"
+#include "timestamp.h"
+#include "comm_filter.h"
+
+// Count collection is handled by the shared engine; for alltoallv each rank
+// contributes one full-size count vector on both sides (the default).
+#define COUNTS_ENGINE_DEBUG DEBUG_ALLTOALLV_PROFILING
+#include "counts_engine.h"
 
-static SRCountNode_t *counts_head = NULL;
 static SRDisplNode_t *displs_head = NULL;
 static avTimingsNode_t *op_timing_exec_head = NULL;
 static avTimingsNode_t *op_timing_exec_tail = NULL;
 static avPattern_t *spatterns = NULL;
 static avPattern_t *rpatterns = NULL;
 static avCallPattern_t *call_patterns = NULL;
+static avCallPattern_t *call_patterns_tail = NULL;
+
+// Runtime feature switches for the unified build (liballtoallv_full.so) where
+// all the profiling code paths are compiled in. They are selected once at init
+// from A2A_PROFILE_FEATURES so a disabled feature costs a single predictable
+// branch per call; in single-feature builds they stay at their default of 1
+// and the compile-time gates keep the other paths out entirely.
+static int _profile_counts = 1;
+static int _profile_exec_timings = 1;
+static int _profile_late_arrival = 1;
+static int _profile_backtrace = 1;
+static int _profile_location = 1;
+
+static void parse_profile_features(void)
+{
+	char *features = getenv(A2A_PROFILE_FEATURES_ENVVAR);
+	if (features == NULL)
+	{
+		return;
+	}
+	_profile_counts = (strstr(features, "counts") != NULL);
+	_profile_exec_timings = (strstr(features, "exec_timings") != NULL);
+	_profile_late_arrival = (strstr(features, "late_arrival") != NULL);
+	_profile_backtrace = (strstr(features, "backtrace") != NULL);
+	_profile_location = (strstr(features, "location") != NULL);
+}
 static caller_info_t *callers_head = NULL;
 static caller_info_t *callers_tail = NULL;
 
@@ -33,7 +77,85 @@ static int world_rank = -1;
 static uint64_t avCalls = 0;	   // Total number of alltoallv calls that we went through (indexed on 0, not 1)
 static uint64_t avCallsLogged = 0; // Total number of alltoallv calls for which we gathered data
 static uint64_t avCallStart = -1;  // Number of alltoallv call during which we started to gather data
-static uint64_t dump_call_data = -1;
+static uint64_t avCallEnd = 0;	   // Last alltoallv call for which we gathered data
+#if ENABLE_SUMMARY
+// Summary-only mode: each rank accumulates the total bytes it sends and
+// receives per call out of its own count vectors - data it already has, no
+// gather - and the per-rank totals are collected once at finalize. Constant
+// memory and a single collective for the whole run, usable at any scale.
+static uint64_t summary_send_bytes = 0;
+static uint64_t summary_recv_bytes = 0;
+static uint64_t summary_calls = 0;
+static int summary_committed = 0;
+#endif // ENABLE_SUMMARY
+// Message-size histogram mode (A2A_MSG_SIZE_HISTOGRAM=1, any build): each
+// rank bins its own per-peer message sizes into a log-scale histogram during
+// the call (see msg_histogram.h) and the histograms are merged with a single
+// reduction at finalize. Tuning-grade size distributions at near-zero
+// overhead, no count collection needed.
+static int _use_msg_histogram = 0;
+static msg_histogram_t hist_send;
+static msg_histogram_t hist_recv;
+static int msg_histogram_committed = 0;
+// Role sharding (A2A_ROLE_SHARDING=1): instead of piling the count gathers,
+// dedup insertion, pattern extraction, timing commits and location tracking
+// all on comm rank 0 every profiled call, the roles are routed to different
+// roots chosen per communicator, spreading the processing load and removing
+// the rank 0 straggler effect the SYNC barrier exists to hide.
+static int _use_role_sharding = 0;
+// Call-data dumping window. DUMP_CALL_DATA accepts a comma-separated list of
+// call IDs and ranges (e.g. "4,7,10-12"); each selected call has its datatype
+// information and buffer content dumped while the application keeps running.
+// The buffcontent descriptors stay open across the window and are flushed and
+// fsync'ed after every dump; they are only released at finalize.
+typedef struct dump_call_range
+{
+	uint64_t start;
+	uint64_t end; // inclusive
+} dump_call_range_t;
+
+static dump_call_range_t *dump_call_ranges = NULL;
+static int num_dump_call_ranges = 0;
+
+static void parse_dump_call_data(char *str)
+{
+	char *copy = strdup(str);
+	assert(copy);
+	char *token = strtok(copy, ",");
+	while (token != NULL)
+	{
+		dump_call_ranges = (dump_call_range_t *)realloc(dump_call_ranges, (num_dump_call_ranges + 1) * sizeof(dump_call_range_t));
+		assert(dump_call_ranges);
+		char *dash = strchr(token, '-');
+		if (dash != NULL)
+		{
+			*dash = '\0';
+			dump_call_ranges[num_dump_call_ranges].start = strtoull(token, NULL, 10);
+			dump_call_ranges[num_dump_call_ranges].end = strtoull(dash + 1, NULL, 10);
+		}
+		else
+		{
+			dump_call_ranges[num_dump_call_ranges].start = strtoull(token, NULL, 10);
+			dump_call_ranges[num_dump_call_ranges].end = dump_call_ranges[num_dump_call_ranges].start;
+		}
+		num_dump_call_ranges++;
+		token = strtok(NULL, ",");
+	}
+	free(copy);
+}
+
+static int dump_call_data_requested(uint64_t call_id)
+{
+	int i;
+	for (i = 0; i < num_dump_call_ranges; i++)
+	{
+		if (call_id >= dump_call_ranges[i].start && call_id <= dump_call_ranges[i].end)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
 // char myhostname[HOSTNAME_LEN];
 // char *hostnames = NULL; // Only used by rank0
 
@@ -44,112 +166,282 @@ static int _inject_delay = 0;
 static int do_send_buffs = 0; // Specify that the focus is on send buffers rather than recv buffers
 static int max_call = -1;	  // Specify when to stop when checking content of buffers
 
-// Buffers used to store data through all alltoallv calls
-int *sbuf = NULL;
-int *rbuf = NULL;
-double *op_exec_times = NULL;
-double *late_arrival_timings = NULL;
-
-static logger_t *logger = NULL;
-
-/* FORTRAN BINDINGS */
-extern int mpi_fortran_in_place_;
-#define OMPI_IS_FORTRAN_IN_PLACE(addr) \
-	(addr == (void *)&mpi_fortran_in_place_)
-extern int mpi_fortran_bottom_;
-#define OMPI_IS_FORTRAN_BOTTOM(addr) \
-	(addr == (void *)&mpi_fortran_bottom_)
-#define OMPI_INT_2_FINT(a) a
-#define OMPI_FINT_2_INT(a) a
-#define OMPI_F2C_IN_PLACE(addr) (OMPI_IS_FORTRAN_IN_PLACE(addr) ? MPI_IN_PLACE : (addr))
-#define OMPI_F2C_BOTTOM(addr) (OMPI_IS_FORTRAN_BOTTOM(addr) ? MPI_BOTTOM : (addr))
-
-static int _finalize_profiling();
-static int _commit_data();
-
-static int *lookupRankSendCounters(SRCountNode_t *call_data, int rank)
+// Sampling engine (A2A_SAMPLING_RATE and A2A_DUTY_CYCLE): long runs can
+// profile only every K-th call and/or duty-cycle windows of N profiled calls
+// followed by M skipped calls. The profiled calls are then no longer one
+// contiguous range so the disjoint windows are tracked explicitly; the call
+// lists in SRCountNode_t keep recording the exact call IDs so the compact
+// format still reconstructs which calls were sampled.
+static uint64_t _sampling_rate = 1;  // Profile every K-th call; 1 profiles them all
+static uint64_t _duty_cycle_on = 0;  // Number of consecutive calls profiled; 0 disables duty cycling
+static uint64_t _duty_cycle_off = 0; // Number of consecutive calls skipped after a profiled burst
+
+typedef struct profiling_window
 {
-	return lookup_rank_counters(call_data->send_data_size, call_data->send_data, rank);
-}
+	uint64_t start;
+	uint64_t end; // Inclusive
+} profiling_window_t;
 
-static int *lookupRankRecvCounters(SRCountNode_t *call_data, int rank)
+static profiling_window_t *profiling_windows = NULL;
+static uint64_t num_profiling_windows = 0;
+static uint64_t max_profiling_windows = 0;
+
+static void record_profiled_call(uint64_t call_id)
 {
-	return lookup_rank_counters(call_data->recv_data_size, call_data->recv_data, rank);
+	avCallEnd = call_id;
+	if (num_profiling_windows > 0 && profiling_windows[num_profiling_windows - 1].end + 1 == call_id)
+	{
+		profiling_windows[num_profiling_windows - 1].end = call_id;
+		return;
+	}
+	if (num_profiling_windows == max_profiling_windows)
+	{
+		max_profiling_windows = (max_profiling_windows == 0) ? 32 : max_profiling_windows * 2;
+		profiling_windows = (profiling_window_t *)realloc(profiling_windows, max_profiling_windows * sizeof(profiling_window_t));
+		assert(profiling_windows);
+	}
+	profiling_windows[num_profiling_windows].start = call_id;
+	profiling_windows[num_profiling_windows].end = call_id;
+	num_profiling_windows++;
 }
 
-// Compare if two arrays are identical.
-static bool same_call_counters(SRCountNode_t *call_data, int *send_counts, int *recv_counts, int size)
+#if ENABLE_LATE_ARRIVAL_TIMING
+// Clock-synchronized late-arrival measurement (A2A_CLOCK_SYNC_LATE_ARRIVAL=1):
+// instead of timing a barrier before every profiled call, each rank records
+// its entry timestamp corrected by its clock offset to world rank 0. The
+// offset comes from a short ping-pong calibration at init time (best-RTT
+// sample wins) and can be refreshed on a slow cadence.
+static int _use_clock_sync_late_arrival = 0;
+static uint64_t _clock_sync_interval = 0; // World-spanning calls between refreshes; 0 means calibrate only once
+static uint64_t _world_calls_since_sync = 0;
+static double _clock_offset = 0.0; // Add to a local timestamp to get world rank 0's clock
+
+static void calibrate_clock_offset()
 {
-	int num = 0;
-	int rank, count_num;
+	int rank, round;
 
-	DEBUG_ALLTOALLV_PROFILING("Comparing data with existing data...\n");
-	DEBUG_ALLTOALLV_PROFILING("-> Comparing send counts...\n");
-	// First compare the send counts
-	for (rank = 0; rank < size; rank++)
+	if (world_rank == 0)
 	{
-		int *_counts = lookupRankSendCounters(call_data, rank);
-		assert(_counts);
-		for (count_num = 0; count_num < size; count_num++)
+		for (rank = 1; rank < world_size; rank++)
 		{
-			if (_counts[count_num] != send_counts[num])
+			for (round = 0; round < CLOCK_SYNC_ROUNDS; round++)
 			{
-				DEBUG_ALLTOALLV_PROFILING("Data differs\n");
-				return false;
+				double t_remote;
+				double t_now;
+				PMPI_Recv(&t_remote, 1, MPI_DOUBLE, rank, 4242, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+				t_now = timestamp_now();
+				PMPI_Send(&t_now, 1, MPI_DOUBLE, rank, 4243, MPI_COMM_WORLD);
 			}
-			num++;
 		}
 	}
-	DEBUG_ALLTOALLV_PROFILING("-> Send counts are the same\n");
-
-	// Then the receive counts
-	DEBUG_ALLTOALLV_PROFILING("-> Comparing recv counts...\n");
-	num = 0;
-	for (rank = 0; rank < size; rank++)
+	else
 	{
-		int *_counts = lookupRankRecvCounters(call_data, rank);
-		for (count_num = 0; count_num < size; count_num++)
+		double best_rtt = -1.0;
+		for (round = 0; round < CLOCK_SYNC_ROUNDS; round++)
 		{
-			if (_counts[count_num] != recv_counts[num])
+			double t_send = timestamp_now();
+			PMPI_Send(&t_send, 1, MPI_DOUBLE, 0, 4242, MPI_COMM_WORLD);
+			double t_root;
+			PMPI_Recv(&t_root, 1, MPI_DOUBLE, 0, 4243, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+			double t_recv = timestamp_now();
+			double rtt = t_recv - t_send;
+			if (best_rtt < 0.0 || rtt < best_rtt)
 			{
-				DEBUG_ALLTOALLV_PROFILING("Data differs\n");
-				return false;
+				// Assume a symmetric path: rank 0 read its clock halfway
+				// through the round trip with the smallest RTT.
+				best_rtt = rtt;
+				_clock_offset = t_root - (t_send + t_recv) / 2.0;
 			}
-			num++;
 		}
 	}
+}
+#endif // ENABLE_LATE_ARRIVAL_TIMING
 
-	DEBUG_ALLTOALLV_PROFILING("Data is the same\n");
-	return true;
+static uint64_t profiled_call_span()
+{
+	// With the sampling engine the profiled calls are not contiguous anymore:
+	// the call range handed to the logger must span up to the last profiled
+	// call. Without sampling this is exactly the number of calls logged.
+	if (avCallsLogged == 0)
+		return 0;
+	return avCallEnd + 1 - avCallStart;
 }
 
-static counts_data_t *lookupCounters(int size, int num, counts_data_t **list, int *count)
+// Hierarchical gather of counts: node leaders deduplicate the rows of their node
+// and ship only unique rows plus rank lists to the root, so the incast on comm
+// rank 0 scales with the number of unique count signatures instead of comm_size^2.
+// The communicators derived from the profiled communicator are cached and rebuilt
+// whenever a call comes in on a different communicator.
+static int _use_hierarchical_gather = 0;
+
+// Batched collection: pack counts and timings into one contiguous message per
+// rank and collect it with a single non-blocking gather completed at the next
+// profiled call (see batched_collection_start/drain).
+static int _use_batched_collection = 0;
+// Unchanged-call fast path (A2A_UNCHANGED_FAST_PATH=1): each rank hashes its
+// count vectors and a one-byte flag is allreduced; when every rank repeats the
+// previous call on the same communicator, the count gather and the engine
+// dedup are skipped and rank 0 just appends the call ID to the previous node.
+static int _use_unchanged_fast_path = 0;
+static uint64_t _prev_counts_hash = 0;
+static MPI_Comm _prev_counts_comm = MPI_COMM_NULL;
+static int _prev_counts_valid = 0;
+static MPI_Comm hg_comm = MPI_COMM_NULL;		// Communicator the cached state below was built for
+static MPI_Comm hg_node_comm = MPI_COMM_NULL;	// Ranks sharing the node (MPI_COMM_TYPE_SHARED)
+static MPI_Comm hg_leader_comm = MPI_COMM_NULL; // Node leaders only; valid only on leaders
+static int hg_node_rank = -1;
+static int hg_node_size = 0;
+
+// Buffers used to store data through all alltoallv calls
+int *sbuf = NULL;
+int *rbuf = NULL;
+double *op_exec_times = NULL;
+double *late_arrival_timings = NULL;
+
+// The staging buffers are the receive areas of the per-call gathers, so only
+// ranks that are rank 0 of some profiled communicator ever need them. They are
+// allocated lazily and sized for the largest communicator profiled so far
+// instead of world_size * world_size upfront, which at scale wasted hundreds
+// of MiB of profiler memory per rank.
+static int _staging_size = 0; // Communicator size the staging buffers are sized for
+
+static void staging_reserve(int comm_size)
 {
-	int i, j;
-	for (i = 0; i < num; i++)
+	if (comm_size <= _staging_size)
 	{
-		for (j = 0; j < size; j++)
-		{
-			if (count[j] != list[i]->counters[j])
-			{
-				break;
-			}
-		}
-
-		if (j == size)
-		{
-			return list[i];
-		}
+		return;
 	}
+	sbuf = (int *)realloc(sbuf, comm_size * comm_size * sizeof(int));
+	assert(sbuf);
+	rbuf = (int *)realloc(rbuf, comm_size * comm_size * sizeof(int));
+	assert(rbuf);
+#if ENABLE_EXEC_TIMING
+	op_exec_times = (double *)realloc(op_exec_times, comm_size * sizeof(double));
+	assert(op_exec_times);
+#endif // ENABLE_EXEC_TIMING
+#if ENABLE_LATE_ARRIVAL_TIMING
+	late_arrival_timings = (double *)realloc(late_arrival_timings, comm_size * sizeof(double));
+	assert(late_arrival_timings);
+#endif // ENABLE_LATE_ARRIVAL_TIMING
+	_staging_size = comm_size;
+}
 
-	return NULL;
+static logger_t *logger = NULL;
+
+/* FORTRAN BINDINGS */
+extern int mpi_fortran_in_place_;
+#define OMPI_IS_FORTRAN_IN_PLACE(addr) \
+	(addr == (void *)&mpi_fortran_in_place_)
+extern int mpi_fortran_bottom_;
+#define OMPI_IS_FORTRAN_BOTTOM(addr) \
+	(addr == (void *)&mpi_fortran_bottom_)
+#define OMPI_INT_2_FINT(a) a
+#define OMPI_FINT_2_INT(a) a
+#define OMPI_F2C_IN_PLACE(addr) (OMPI_IS_FORTRAN_IN_PLACE(addr) ? MPI_IN_PLACE : (addr))
+#define OMPI_F2C_BOTTOM(addr) (OMPI_IS_FORTRAN_BOTTOM(addr) ? MPI_BOTTOM : (addr))
+
+static int _finalize_profiling();
+static void flush_nonblocking_timings(MPI_Comm comm);
+static int _commit_data();
+static void batched_collection_drain(void);
+#if ENABLE_SUMMARY
+static void _commit_summary();
+#endif // ENABLE_SUMMARY
+static void _commit_msg_histogram();
+
+// Asynchronous commit engine (A2A_ASYNC_COMMIT=1): mid-run commits triggered
+// through A2A_COMMIT_PROFILER_DATA_AT are handed to a writer thread as
+// immutable deep snapshots of the count data, through a lock-free
+// single-producer/single-consumer ring. The MPI rank only pays for the
+// snapshot copy and returns to the application while serialization and file
+// writes happen on the writer thread.
+typedef struct commit_snapshot
+{
+	arena_t arena; // Backs every node and array of the snapshot
+	SRCountNode_t *counts;
+	uint64_t num_calls;
+	uint64_t call_start;
+	uint64_t calls_logged;
+} commit_snapshot_t;
+
+#define ASYNC_COMMIT_QUEUE_DEPTH (4) // Must be a power of two
+
+static int _use_async_commit = 0;
+static commit_snapshot_t *commit_queue[ASYNC_COMMIT_QUEUE_DEPTH];
+static volatile uint64_t commit_queue_head = 0; // Next slot the producer (MPI rank) fills
+static volatile uint64_t commit_queue_tail = 0; // Next slot the consumer (writer thread) drains
+static volatile int commit_thread_stop = 0;
+static pthread_t commit_thread;
+static int commit_thread_started = 0;
+
+static void async_commit_fini(void);
+
+// Configuration snapshot taken once at initialization so that the per-call
+// path never goes back to the environment (getenv + atoi on every call adds
+// up over millions of operations). A commit call ID of -1 means disabled.
+static int _commit_data_at = -1;
+static int _release_resources_after_commit = 0;
+static uint64_t _commit_interval = 0;		   // Profiled calls between incremental checkpoints; 0 disables (see A2A_COMMIT_INTERVAL_ENVVAR)
+static uint64_t _calls_since_checkpoint = 0;   // Profiled calls accumulated since the last incremental checkpoint
+static size_t _mem_budget_bytes = 0; // Memory budget for the count data; see A2A_MEM_BUDGET_ENVVAR
+static int _counts_dump_fd = -1;	 // Per-rank binary counts dump of the non-compact build
+
+// Thread-safe mode for MPI_THREAD_MULTIPLE applications: the staging buffers
+// become per-thread and mutations of the shared bookkeeping (counts, patterns,
+// communicator records, timing loggers) are guarded by one mutex that is only
+// held around the in-memory inserts, never across an MPI call, so threads
+// issuing collectives on distinct communicators do not serialize behind it.
+// Enabled automatically when PMPI_Init_thread() grants MPI_THREAD_MULTIPLE;
+// A2A_THREAD_SAFE forces it either way.
+static int _thread_safe = 0;
+static pthread_mutex_t _profiler_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define PROFILER_LOCK()                          \
+	do                                           \
+	{                                            \
+		if (_thread_safe)                        \
+			pthread_mutex_lock(&_profiler_lock); \
+	} while (0)
+
+#define PROFILER_UNLOCK()                          \
+	do                                             \
+	{                                              \
+		if (_thread_safe)                          \
+			pthread_mutex_unlock(&_profiler_lock); \
+	} while (0)
+
+// Per-thread staging buffers, allocated lazily the first time a thread is
+// rank 0 of a profiled communicator and grown when a larger communicator
+// shows up; non-root threads receive NULL, MPI ignores the receive arguments
+// on non-root ranks.
+static __thread int *_tls_sbuf = NULL;
+static __thread int *_tls_rbuf = NULL;
+static __thread double *_tls_timings = NULL;
+static __thread int _tls_staging_size = 0;
+
+static void thread_staging_get(int comm_size, int my_comm_rank, int **sb, int **rb, double **exec_times, double **late_arrivals)
+{
+	if (my_comm_rank == 0 && comm_size > _tls_staging_size)
+	{
+		_tls_sbuf = (int *)realloc(_tls_sbuf, comm_size * comm_size * sizeof(int));
+		assert(_tls_sbuf);
+		_tls_rbuf = (int *)realloc(_tls_rbuf, comm_size * comm_size * sizeof(int));
+		assert(_tls_rbuf);
+		_tls_timings = (double *)realloc(_tls_timings, 2 * comm_size * sizeof(double));
+		assert(_tls_timings);
+		_tls_staging_size = comm_size;
+	}
+	*sb = _tls_sbuf;
+	*rb = _tls_rbuf;
+	*exec_times = _tls_timings;
+	*late_arrivals = (_tls_timings == NULL) ? NULL : _tls_timings + _tls_staging_size;
 }
 
 static int extract_patterns_from_counts(int *send_counts, int *recv_counts, int size)
 {
-	int i, j, num;
-	int src_ranks = 0;
-	int dst_ranks = 0;
+	int i;
+	int send_peers[size];
+	int recv_peers[size];
 	int send_patterns[size + 1];
 	int recv_patterns[size + 1];
 
@@ -158,70 +450,37 @@ static int extract_patterns_from_counts(int *send_counts, int *recv_counts, int
 	for (i = 0; i < size; i++)
 	{
 		send_patterns[i] = 0;
-	}
-
-	for (i = 0; i < size; i++)
-	{
 		recv_patterns[i] = 0;
 	}
 
-	num = 0;
+	// Bitmap + popcount streaming pass over the gathered count matrices
+	count_nonzero_peers(send_counts, size, send_peers);
+	count_nonzero_peers(recv_counts, size, recv_peers);
 	for (i = 0; i < size; i++)
 	{
-		dst_ranks = 0;
-		src_ranks = 0;
-		for (j = 0; j < size; j++)
-		{
-			if (send_counts[num] != 0)
-			{
-				dst_ranks++;
-			}
-			if (recv_counts[num] != 0)
-			{
-				src_ranks++;
-			}
-			num++;
-		}
-		// We know the current rank sends data to <dst_ranks> ranks
-		if (dst_ranks > 0)
+		// We know rank i sends data to send_peers[i] ranks and receives from recv_peers[i] ranks
+		if (send_peers[i] > 0)
 		{
-			send_patterns[dst_ranks - 1]++;
+			send_patterns[send_peers[i] - 1]++;
 		}
-
-		// We know the current rank receives data from <src_ranks> ranks
-		if (src_ranks > 0)
+		if (recv_peers[i] > 0)
 		{
-			recv_patterns[src_ranks - 1]++;
+			recv_patterns[recv_peers[i] - 1]++;
 		}
 	}
 
-	// From here we know who many ranks send to how many ranks and how many ranks receive from how many rank
 	DEBUG_ALLTOALLV_PROFILING("Handling send patterns\n");
-	for (i = 0; i < size; i++)
-	{
-		if (send_patterns[i] != 0)
-		{
-			DEBUG_ALLTOALLV_PROFILING("Add pattern where %d ranks sent data to %d other ranks\n", send_patterns[i], i + 1);
 #if COMMSIZE_BASED_PATTERNS
-			spatterns = add_pattern_for_size(spatterns, send_patterns[i], i + 1, size);
+	spatterns = add_patterns_from_buckets(spatterns, send_patterns, size, size);
 #else
-			spatterns = add_pattern(spatterns, send_patterns[i], i + 1);
+	spatterns = add_patterns_from_buckets(spatterns, send_patterns, size, -1);
 #endif // COMMSIZE_BASED_PATTERNS
-		}
-	}
 	DEBUG_ALLTOALLV_PROFILING("Handling receive patterns\n");
-	for (i = 0; i < size; i++)
-	{
-		if (recv_patterns[i] != 0)
-		{
-			DEBUG_ALLTOALLV_PROFILING("Add pattern where %d ranks received data from %d other ranks\n", recv_patterns[i], i + 1);
 #if COMMSIZE_BASED_PATTERNS
-			rpatterns = add_pattern_for_size(rpatterns, recv_patterns[i], i + 1, size);
+	rpatterns = add_patterns_from_buckets(rpatterns, recv_patterns, size, size);
 #else
-			rpatterns = add_pattern(rpatterns, recv_patterns[i], i + 1);
+	rpatterns = add_patterns_from_buckets(rpatterns, recv_patterns, size, -1);
 #endif // COMMSIZE_BASED_PATTERNS
-		}
-	}
 
 	return 0;
 }
@@ -268,30 +527,27 @@ char *alltoallv_get_full_filename(int ctxt, char *id, int jobid, int world_rank)
 int extract_call_patterns_from_counts(int callID, int *send_counts, int *recv_counts, int size)
 {
 	avCallPattern_t *cp = extract_call_patterns(callID, send_counts, recv_counts, size);
+	cp->signature = call_pattern_signature(cp);
+	avCallPattern_t *existing_cp = call_pattern_table_find(cp);
+	if (existing_cp != NULL)
+	{
+		existing_cp->n_calls++;
+		free_patterns(cp->spatterns);
+		free_patterns(cp->rpatterns);
+		free(cp);
+		return 0;
+	}
+
 	if (call_patterns == NULL)
 	{
 		call_patterns = cp;
 	}
 	else
 	{
-		avCallPattern_t *existing_cp = lookup_call_patterns(call_patterns);
-		if (existing_cp == NULL)
-		{
-			avCallPattern_t *ptr = call_patterns;
-			while (ptr->next != NULL)
-			{
-				ptr = ptr->next;
-			}
-			ptr->next = cp;
-		}
-		else
-		{
-			existing_cp->n_calls++;
-			free_patterns(cp->spatterns);
-			free_patterns(cp->rpatterns);
-			free(cp);
-		}
+		call_patterns_tail->next = cp;
 	}
+	call_patterns_tail = cp;
+	call_pattern_table_insert(cp);
 
 	return 0;
 }
@@ -305,394 +561,173 @@ static int commit_pattern_from_counts(int callID, int *send_counts, int *recv_co
 #endif
 }
 
-static counts_data_t *lookupSendCounters(int *counts, SRCountNode_t *call_data)
+static void display_per_host_data(int size)
 {
-	return lookupCounters(call_data->size, call_data->send_data_size, call_data->send_data, counts);
+	int i;
+	for (i = 0; i < world_size; i++)
+	{
+	}
 }
 
-static counts_data_t *lookupRecvCounters(int *counts, SRCountNode_t *call_data)
+static void _save_patterns(FILE *fh, avPattern_t *p, char *ctx)
 {
-	return lookupCounters(call_data->size, call_data->recv_data_size, call_data->recv_data, counts);
+	avPattern_t *ptr = p;
+	while (ptr != NULL)
+	{
+#if COMMSIZE_BASED_PATTERNS || TRACK_PATTERNS_ON_CALL_BASIS
+		fprintf(fh, "During %" PRIu64 " alltoallv calls, %d ranks %s %d other ranks; comm size: %d\n", ptr->n_calls, ptr->n_ranks, ctx, ptr->n_peers, ptr->comm_size);
+#else
+		fprintf(fh, "During %" PRIu64 " alltoallv calls, %d ranks %s %d other ranks\n", ptr->n_calls, ptr->n_ranks, ctx, ptr->n_peers);
+#endif // COMMSIZE_BASED_PATTERNS
+		ptr = ptr->next;
+	}
 }
 
-static int add_rank_to_counters_data(int rank, counts_data_t *counters_data)
+static void save_profiling_windows(int rank)
 {
-	if (counters_data->num_ranks >= counters_data->max_ranks)
+	char *filename = NULL;
+	int size;
+
+	if (num_profiling_windows == 0)
+		return;
+
+	if (getenv(OUTPUT_DIR_ENVVAR))
+	{
+		_asprintf(filename, size, "%s/profiling-windows-rank%d.txt", getenv(OUTPUT_DIR_ENVVAR), rank);
+	}
+	else
 	{
-		counters_data->max_ranks = counters_data->num_ranks + MAX_TRACKED_RANKS;
-		counters_data->ranks = (int *)realloc(counters_data->ranks, counters_data->max_ranks * sizeof(int));
-		assert(counters_data->ranks);
+		_asprintf(filename, size, "profiling-windows-rank%d.txt", rank);
 	}
+	assert(size > 0);
 
-	counters_data->ranks[counters_data->num_ranks] = rank;
-	counters_data->num_ranks++;
-	return 0;
-}
+	FILE *fh = profile_fopen(filename, "w", "patterns");
+	assert(fh);
 
-static void delete_counter_data(counts_data_t **data)
-{
-	if (*data)
+	fprintf(fh, "Number of profiling windows: %" PRIu64 "\n", num_profiling_windows);
+	uint64_t i;
+	for (i = 0; i < num_profiling_windows; i++)
 	{
-		if ((*data)->ranks)
-		{
-			free((*data)->ranks);
-		}
-		if ((*data)->counters)
-		{
-			free((*data)->counters);
-		}
-		free(*data);
-		*data = NULL;
+		fprintf(fh, "%" PRIu64 "-%" PRIu64 "\n", profiling_windows[i].start, profiling_windows[i].end);
 	}
+	fclose(fh);
+	free(filename);
 }
 
-static counts_data_t *new_counter_data(int size, int rank, int *counts)
+static void save_call_patterns(int uniqueID)
 {
-	int i;
-	counts_data_t *new_data = (counts_data_t *)malloc(sizeof(counts_data_t));
-	assert(new_data);
-	new_data->counters = (int *)malloc(size * sizeof(int));
-	assert(new_data->counters);
-	new_data->num_ranks = 0;
-	new_data->max_ranks = MAX_TRACKED_RANKS;
-	new_data->ranks = (int *)malloc(new_data->max_ranks * sizeof(int));
-	assert(new_data->ranks);
+	char *filename = NULL;
+	int size;
 
-	for (i = 0; i < size; i++)
+	DEBUG_ALLTOALLV_PROFILING("Saving call patterns...\n");
+
+	if (getenv(OUTPUT_DIR_ENVVAR))
 	{
-		new_data->counters[i] = counts[i];
+		_asprintf(filename, size, "%s/call-patterns-rank%d.txt", getenv(OUTPUT_DIR_ENVVAR), world_rank);
 	}
-	new_data->ranks[new_data->num_ranks] = rank;
-	new_data->num_ranks++;
-
-	return new_data;
-}
+	else
+	{
+		_asprintf(filename, size, "call-patterns-rank%d.txt", world_rank);
+	}
+	assert(size > 0);
 
-static int add_new_send_counters_to_counters_data(SRCountNode_t *call_data, int rank, int *counts)
-{
-	counts_data_t *new_data = new_counter_data(call_data->size, rank, counts);
-	call_data->send_data[call_data->send_data_size] = new_data;
-	call_data->send_data_size++;
+	FILE *fh = profile_fopen(filename, "w", "patterns");
+	assert(fh);
 
-	return 0;
+	avCallPattern_t *ptr = call_patterns;
+	while (ptr != NULL)
+	{
+		fprintf(fh, "For %" PRIu64 " call(s):\n", ptr->n_calls);
+		_save_patterns(fh, ptr->spatterns, "sent to");
+		_save_patterns(fh, ptr->rpatterns, "recv'd from");
+		ptr = ptr->next;
+	}
+	fclose(fh);
+	free(filename);
 }
 
-static int add_new_recv_counters_to_counters_data(SRCountNode_t *call_data, int rank, int *counts)
+static void save_patterns(int world_rank)
 {
-	counts_data_t *new_data = new_counter_data(call_data->size, rank, counts);
-	call_data->recv_data[call_data->recv_data_size] = new_data;
-	call_data->recv_data_size++;
+	char *spatterns_filename = NULL;
+	char *rpatterns_filename = NULL;
+	int size;
 
-	return 0;
-}
+	DEBUG_ALLTOALLV_PROFILING("Saving patterns...\n");
 
-static int compareAndSaveSendCounters(int rank, int *counts, SRCountNode_t *call_data)
-{
-	counts_data_t *ptr = lookupSendCounters(counts, call_data);
-	if (ptr)
+	if (getenv(OUTPUT_DIR_ENVVAR))
 	{
-		DEBUG_ALLTOALLV_PROFILING("Add send rank %d to existing count data\n", rank);
-		if (add_rank_to_counters_data(rank, ptr))
-		{
-			fprintf(stderr, "[%s:%d][ERROR] unable to add rank counters (rank: %d)\n", __FILE__, __LINE__, rank);
-			return -1;
-		}
+		_asprintf(spatterns_filename, size, "%s/patterns-send-rank%d.txt", getenv(OUTPUT_DIR_ENVVAR), world_rank);
+		assert(size > 0);
+		_asprintf(rpatterns_filename, size, "%s/patterns-recv-rank%d.txt", getenv(OUTPUT_DIR_ENVVAR), world_rank);
+		assert(size > 0);
 	}
 	else
 	{
-		DEBUG_ALLTOALLV_PROFILING("Add send new count data for rank %d\n", rank);
-		if (add_new_send_counters_to_counters_data(call_data, rank, counts))
-		{
-			fprintf(stderr, "[%s:%d][ERROR] unable to add new send counters\n", __FILE__, __LINE__);
-			return -1;
-		}
+		_asprintf(spatterns_filename, size, "patterns-send-rank%d.txt", world_rank);
+		assert(size > 0);
+		_asprintf(rpatterns_filename, size, "patterns-recv-rank%d.txt", world_rank);
+		assert(size > 0);
 	}
 
-	return 0;
+	FILE *spatterns_fh = profile_fopen(spatterns_filename, "w", "patterns");
+	assert(spatterns_fh);
+	FILE *rpatterns_fh = profile_fopen(rpatterns_filename, "w", "patterns");
+	assert(rpatterns_fh);
+	avPattern_t *ptr;
+
+	_save_patterns(spatterns_fh, spatterns, "sent to");
+	_save_patterns(rpatterns_fh, rpatterns, "recv'd from");
+
+	fclose(spatterns_fh);
+	fclose(rpatterns_fh);
+	free(spatterns_filename);
+	free(rpatterns_filename);
 }
 
-static int compareAndSaveRecvCounters(int rank, int *counts, SRCountNode_t *call_data)
+// Validation data goes to one append-only binary store per rank (with an
+// embedded call index) instead of one text file per rank per call, which at
+// scale created millions of tiny files and throttled the metadata servers.
+static validation_store_t *_validation_store = NULL;
+
+static void save_counters_for_validation(int myrank, uint64_t avCalls, int size, const int *sendcounts, const int *recvcounts)
 {
-	counts_data_t *ptr = lookupRecvCounters(counts, call_data);
-	if (ptr)
+	if (_validation_store == NULL)
 	{
-		DEBUG_ALLTOALLV_PROFILING("Add recv rank %d to existing count data\n", rank);
-		if (add_rank_to_counters_data(rank, ptr))
-		{
-			fprintf(stderr, "[ERROR] unable to add rank counters\n");
-			return -1;
-		}
+		_validation_store = validation_store_open("alltoallv", myrank);
+		assert(_validation_store);
 	}
-	else
+	if (validation_store_append(_validation_store, avCalls, size, sendcounts, recvcounts))
 	{
-		DEBUG_ALLTOALLV_PROFILING("Add recv new count data for rank %d\n", rank);
-		if (add_new_recv_counters_to_counters_data(call_data, rank, counts))
-		{
-			fprintf(stderr, "[ERROR] unable to add new recv counters\n");
-			return -1;
-		}
+		fprintf(stderr, "[%s:%d][ERROR] unable to append validation data\n", __FILE__, __LINE__);
+		PMPI_Abort(MPI_COMM_WORLD, 1);
 	}
-
-	return 0;
 }
 
-// Compare new send count data with existing data.
-// If there is a match, increas the counter. Add new data, otherwise.
-// recv count was not compared.
-static int insert_sendrecv_count_data(int *sbuf, int *rbuf, int size, int sendtype_size, int recvtype_size)
+// Process identity is immutable for the life of the process: the hostname -
+// whose lookup can go through NSS - and the PID are resolved once at init and
+// reused by every per-call and per-logger path.
+static char _hostname[256] = {0};
+static int _pid = 0;
+
+static void init_process_identity(void)
 {
-	int i, j, num = 0;
-	struct SRCountNode *newNode = NULL;
-	struct SRCountNode *temp;
+	if (_pid == 0)
+	{
+		gethostname(_hostname, sizeof(_hostname));
+		_pid = getpid();
+	}
+}
 
-	DEBUG_ALLTOALLV_PROFILING("Insert data for a new alltoallv call...\n");
+static char *get_pe_id(int comm_rank)
+{
+	// The ID of any PE is composed as follow: <pid>.<COMMWORLD_RANK>.<COMM_RANK>.<HOSTNAME>
+	// The maximum size of 128 bytes so if the ID ends up being larger than that, we truncate
+	// the *beginning* of the hostname in order to fit within 128 bytes.
+	char *id = NULL;
+	int size;
+	const char *hostname = _hostname;
 
-	assert(sbuf);
-	assert(rbuf);
-	assert(logger);
-
-	temp = counts_head;
-	while (temp != NULL)
-	{
-		if (temp->size != size || temp->recvtype_size != recvtype_size || temp->sendtype_size != sendtype_size || !same_call_counters(temp, sbuf, rbuf, size))
-		{
-			// New data
-#if DEBUG
-			fprintf(logger->f, "new data: %d\n", size);
-#endif
-			if (temp->next != NULL)
-				temp = temp->next;
-			else
-				break;
-		}
-		else
-		{
-			// Data exist, adding call info to it
-			DEBUG_ALLTOALLV_PROFILING("Data already exists, updating metadata...\n");
-			assert(temp->list_calls);
-			if (temp->count >= temp->max_calls)
-			{
-				temp->max_calls = temp->max_calls * 2;
-				temp->list_calls = (uint64_t *)realloc(temp->list_calls, temp->max_calls * sizeof(uint64_t));
-				assert(temp->list_calls);
-			}
-			temp->list_calls[temp->count] = avCalls; // Note: count starts at 1, not 0
-			temp->count++;
-#if DEBUG
-			fprintf(logger->f, "old data: %d --> %d --- %d\n", size, temp->size, temp->count);
-#endif
-			DEBUG_ALLTOALLV_PROFILING("Metadata successfully updated\n");
-			return 0;
-		}
-	}
-
-#if DEBUG
-	fprintf(logger->f, "no data: %d \n", size);
-#endif
-	newNode = (struct SRCountNode *)malloc(sizeof(SRCountNode_t));
-	assert(newNode);
-
-	newNode->size = size;
-	newNode->rank_send_vec_len = size;
-	newNode->rank_recv_vec_len = size;
-	newNode->count = 1;
-	newNode->list_calls = (uint64_t *)malloc(DEFAULT_TRACKED_CALLS * sizeof(uint64_t));
-	assert(newNode->list_calls);
-	newNode->max_calls = DEFAULT_TRACKED_CALLS;
-	// We have at most <size> different counts (one per rank) and we just allocate pointers of pointers here, not much space used
-	newNode->send_data = (counts_data_t **)malloc(size * sizeof(counts_data_t));
-	assert(newNode->send_data);
-	newNode->send_data_size = 0;
-	newNode->recv_data = (counts_data_t **)malloc(size * sizeof(counts_data_t));
-	assert(newNode->recv_data);
-	newNode->recv_data_size = 0;
-
-	// We add rank's data one by one so we can compress the data when possible
-	num = 0;
-	int _rank;
-
-	DEBUG_ALLTOALLV_PROFILING("handling send counts...\n");
-	for (_rank = 0; _rank < size; _rank++)
-	{
-		if (compareAndSaveSendCounters(_rank, &(sbuf[num * size]), newNode))
-		{
-			fprintf(stderr, "[%s:%d][ERROR] unable to add send counters\n", __FILE__, __LINE__);
-			return -1;
-		}
-		num++;
-	}
-
-	DEBUG_ALLTOALLV_PROFILING("handling recv counts...\n");
-	num = 0;
-	for (_rank = 0; _rank < size; _rank++)
-	{
-		if (compareAndSaveRecvCounters(_rank, &(rbuf[num * size]), newNode))
-		{
-			fprintf(stderr, "[%s:%d][ERROR] unable to add recv counters\n", __FILE__, __LINE__);
-			return -1;
-		}
-		num++;
-	}
-
-	newNode->sendtype_size = sendtype_size;
-	newNode->recvtype_size = recvtype_size;
-	newNode->list_calls[0] = avCalls;
-	newNode->next = NULL;
-#if DEBUG
-	fprintf(logger->f, "new entry: %d --> %d --- %d\n", size, newNode->size, newNode->count);
-#endif
-
-	DEBUG_ALLTOALLV_PROFILING("Data for the new alltoallv call has %d unique series for send counts and %d for recv counts\n", newNode->recv_data_size, newNode->send_data_size);
-
-	if (counts_head == NULL)
-	{
-		counts_head = newNode;
-	}
-	else
-	{
-		temp->next = newNode;
-	}
-
-	return 0;
-}
-
-static void display_per_host_data(int size)
-{
-	int i;
-	for (i = 0; i < world_size; i++)
-	{
-	}
-}
-
-static void _save_patterns(FILE *fh, avPattern_t *p, char *ctx)
-{
-	avPattern_t *ptr = p;
-	while (ptr != NULL)
-	{
-#if COMMSIZE_BASED_PATTERNS || TRACK_PATTERNS_ON_CALL_BASIS
-		fprintf(fh, "During %" PRIu64 " alltoallv calls, %d ranks %s %d other ranks; comm size: %d\n", ptr->n_calls, ptr->n_ranks, ctx, ptr->n_peers, ptr->comm_size);
-#else
-		fprintf(fh, "During %" PRIu64 " alltoallv calls, %d ranks %s %d other ranks\n", ptr->n_calls, ptr->n_ranks, ctx, ptr->n_peers);
-#endif // COMMSIZE_BASED_PATTERNS
-		ptr = ptr->next;
-	}
-}
-
-static void save_call_patterns(int uniqueID)
-{
-	char *filename = NULL;
-	int size;
-
-	DEBUG_ALLTOALLV_PROFILING("Saving call patterns...\n");
-
-	if (getenv(OUTPUT_DIR_ENVVAR))
-	{
-		_asprintf(filename, size, "%s/call-patterns-rank%d.txt", getenv(OUTPUT_DIR_ENVVAR), world_rank);
-	}
-	else
-	{
-		_asprintf(filename, size, "call-patterns-rank%d.txt", world_rank);
-	}
-	assert(size > 0);
-
-	FILE *fh = fopen(filename, "w");
-	assert(fh);
-
-	avCallPattern_t *ptr = call_patterns;
-	while (ptr != NULL)
-	{
-		fprintf(fh, "For %" PRIu64 " call(s):\n", ptr->n_calls);
-		_save_patterns(fh, ptr->spatterns, "sent to");
-		_save_patterns(fh, ptr->rpatterns, "recv'd from");
-		ptr = ptr->next;
-	}
-	fclose(fh);
-	free(filename);
-}
-
-static void save_patterns(int world_rank)
-{
-	char *spatterns_filename = NULL;
-	char *rpatterns_filename = NULL;
-	int size;
-
-	DEBUG_ALLTOALLV_PROFILING("Saving patterns...\n");
-
-	if (getenv(OUTPUT_DIR_ENVVAR))
-	{
-		_asprintf(spatterns_filename, size, "%s/patterns-send-rank%d.txt", getenv(OUTPUT_DIR_ENVVAR), world_rank);
-		assert(size > 0);
-		_asprintf(rpatterns_filename, size, "%s/patterns-recv-rank%d.txt", getenv(OUTPUT_DIR_ENVVAR), world_rank);
-		assert(size > 0);
-	}
-	else
-	{
-		_asprintf(spatterns_filename, size, "patterns-send-rank%d.txt", world_rank);
-		assert(size > 0);
-		_asprintf(rpatterns_filename, size, "patterns-recv-rank%d.txt", world_rank);
-		assert(size > 0);
-	}
-
-	FILE *spatterns_fh = fopen(spatterns_filename, "w");
-	assert(spatterns_fh);
-	FILE *rpatterns_fh = fopen(rpatterns_filename, "w");
-	assert(rpatterns_fh);
-	avPattern_t *ptr;
-
-	_save_patterns(spatterns_fh, spatterns, "sent to");
-	_save_patterns(rpatterns_fh, rpatterns, "recv'd from");
-
-	fclose(spatterns_fh);
-	fclose(rpatterns_fh);
-	free(spatterns_filename);
-	free(rpatterns_filename);
-}
-
-static void save_counters_for_validation(int myrank, uint64_t avCalls, int size, const int *sendcounts, const int *recvcounts)
-{
-	char *filename;
-	int rc;
-
-	if (getenv(OUTPUT_DIR_ENVVAR))
-	{
-		_asprintf(filename, rc, "%s/validation_data-rank%d-call%" PRIu64 ".txt", getenv(OUTPUT_DIR_ENVVAR), myrank, avCalls);
-	}
-	else
-	{
-		_asprintf(filename, rc, "validation_data-rank%d-call%" PRIu64 ".txt", myrank, avCalls);
-	}
-	assert(rc < MAX_PATH_LEN);
-
-	FILE *fh = fopen(filename, "w");
-	assert(fh);
-	int i;
-	for (i = 0; i < size; i++)
-	{
-		fprintf(fh, "%d ", sendcounts[i]);
-	}
-
-	fprintf(fh, "\n\n");
-
-	for (i = 0; i < size; i++)
-	{
-		fprintf(fh, "%d ", recvcounts[i]);
-	}
-
-	fclose(fh);
-	free(filename);
-}
-
-static char *get_pe_id(int comm_rank)
-{
-	// The ID of any PE is composed as follow: <pid>.<COMMWORLD_RANK>.<COMM_RANK>.<HOSTNAME>
-	// The maximum size of 128 bytes so if the ID ends up being larger than that, we truncate
-	// the *beginning* of the hostname in order to fit within 128 bytes.
-	char *id = NULL;
-	int size;
-	char hostname[128];
-	gethostname(hostname, 128);
-
-	_asprintf(id, size, "%d.%d.%d", getpid(), world_rank, comm_rank);
+	_asprintf(id, size, "%d.%d.%d", _pid, world_rank, comm_rank);
 	assert(size > 0 && size < 128);
 	if (size + strlen(hostname) < 128)
 	{
@@ -754,27 +789,32 @@ int _mpi_init(int *argc, char ***argv)
 	logger = logger_init(jobid, world_rank, world_size, &alltoallv_logger_cfg);
 	assert(logger);
 
-	// Allocate buffers reused between alltoallv calls
-	// Note the buffer may be used on a communicator that is not comm_world
-	// but in any case, it will be smaller or of the same size than comm_world.
-	// So we allocate the biggest buffers possible but reuse them during the
-	// entire execution of the application.
-	sbuf = (int *)malloc(world_size * world_size * (sizeof(int)));
-	assert(sbuf);
-	rbuf = (int *)malloc(world_size * world_size * (sizeof(int)));
-	assert(rbuf);
-#if ENABLE_EXEC_TIMING
-	op_exec_times = (double *)malloc(world_size * sizeof(double));
-	assert(op_exec_times);
-#endif // ENABLE_EXEC_TIMING
+	// The staging buffers reused between alltoallv calls are allocated lazily
+	// by staging_reserve(): only communicator roots need them and they are
+	// sized for the communicators actually profiled, not for the world.
+	init_process_identity();
+	timestamp_init();
+	comm_filter_init();
+	parse_profile_features();
+#if ENABLE_SUMMARY
+	// Summary mode collects no per-call matrices: disable the count gathers
+	// entirely, the per-call accumulation needs only local data.
+	_profile_counts = 0;
+#endif // ENABLE_SUMMARY
 #if ENABLE_LATE_ARRIVAL_TIMING
-	late_arrival_timings = (double *)malloc(world_size * sizeof(double));
-	assert(late_arrival_timings);
 	char *inject_delay = getenv("COLLECTIVE_PROFILER_INJECT_DELAY");
 	if (inject_delay != NULL)
 	{
 		_inject_delay = atoi(inject_delay);
 	}
+	char *clock_sync = getenv(A2A_CLOCK_SYNC_LATE_ARRIVAL_ENVVAR);
+	if (clock_sync != NULL)
+		_use_clock_sync_late_arrival = atoi(clock_sync);
+	char *clock_sync_interval = getenv(A2A_CLOCK_SYNC_INTERVAL_ENVVAR);
+	if (clock_sync_interval != NULL && atoi(clock_sync_interval) > 0)
+		_clock_sync_interval = atoi(clock_sync_interval);
+	if (_use_clock_sync_late_arrival)
+		calibrate_clock_offset();
 #endif // ENABLE_LATE_ARRIVAL_TIMING
 
 #if ENABLE_VALIDATION
@@ -794,8 +834,78 @@ int _mpi_init(int *argc, char ***argv)
 	}
 
 	char *dump_call_data_envvar = getenv("DUMP_CALL_DATA");
-	if (dump_call_data_envvar != NULL)
-		dump_call_data = atoi(dump_call_data_envvar);
+	if (dump_call_data_envvar != NULL && num_dump_call_ranges == 0)
+		parse_dump_call_data(dump_call_data_envvar);
+
+	char *hierarchical_gather = getenv(A2A_HIERARCHICAL_GATHER_ENVVAR);
+	if (hierarchical_gather != NULL)
+		_use_hierarchical_gather = atoi(hierarchical_gather);
+
+	char *batched_collection = getenv(A2A_BATCHED_COLLECTION_ENVVAR);
+	if (batched_collection != NULL)
+		_use_batched_collection = atoi(batched_collection);
+
+	char *unchanged_fast_path = getenv(A2A_UNCHANGED_FAST_PATH_ENVVAR);
+	if (unchanged_fast_path != NULL)
+		_use_unchanged_fast_path = atoi(unchanged_fast_path);
+
+	char *msg_histogram = getenv(A2A_MSG_SIZE_HISTOGRAM_ENVVAR);
+	if (msg_histogram != NULL)
+		_use_msg_histogram = atoi(msg_histogram);
+	msg_histogram_reset(&hist_send);
+	msg_histogram_reset(&hist_recv);
+
+	char *role_sharding = getenv(A2A_ROLE_SHARDING_ENVVAR);
+	if (role_sharding != NULL)
+		_use_role_sharding = atoi(role_sharding);
+
+	char *async_commit = getenv(A2A_ASYNC_COMMIT_ENVVAR);
+	if (async_commit != NULL)
+		_use_async_commit = atoi(async_commit);
+	char *mem_budget = getenv(A2A_MEM_BUDGET_ENVVAR);
+	if (mem_budget != NULL)
+		_mem_budget_bytes = (size_t)atoll(mem_budget) * 1024 * 1024;
+	char *thread_safe = getenv(A2A_THREAD_SAFE_ENVVAR);
+	if (thread_safe != NULL)
+		_thread_safe = atoi(thread_safe);
+	if (_thread_safe)
+	{
+		// These modes funnel every call through single global staging buffers
+		// and queues; thread-safe profiling falls back to the flat per-call
+		// gathers and synchronous commits.
+		_use_hierarchical_gather = 0;
+		_use_batched_collection = 0;
+		_use_async_commit = 0;
+		_use_unchanged_fast_path = 0;
+		_use_role_sharding = 0;
+	}
+
+	char *need_data_commit_str = getenv(A2A_COMMIT_PROFILER_DATA_AT_ENVVAR);
+	if (need_data_commit_str != NULL)
+		_commit_data_at = atoi(need_data_commit_str);
+
+	char *commit_interval_str = getenv(A2A_COMMIT_INTERVAL_ENVVAR);
+	if (commit_interval_str != NULL && atoll(commit_interval_str) > 0)
+		_commit_interval = (uint64_t)atoll(commit_interval_str);
+
+	char *need_to_free_data = getenv(A2A_RELEASE_RESOURCES_AFTER_DATA_COMMIT_ENVVAR);
+	if (need_to_free_data != NULL && strncmp(need_to_free_data, "0", 1) != 0)
+		_release_resources_after_commit = 1;
+
+	char *sampling_rate = getenv(A2A_SAMPLING_RATE_ENVVAR);
+	if (sampling_rate != NULL && atoi(sampling_rate) > 1)
+		_sampling_rate = atoi(sampling_rate);
+
+	char *duty_cycle = getenv(A2A_DUTY_CYCLE_ENVVAR);
+	if (duty_cycle != NULL)
+	{
+		int on = 0, off = 0;
+		if (sscanf(duty_cycle, "%d:%d", &on, &off) == 2 && on > 0 && off > 0)
+		{
+			_duty_cycle_on = on;
+			_duty_cycle_off = off;
+		}
+	}
 
 	// Make sure we do not create an articial imbalance between ranks.
 	PMPI_Barrier(MPI_COMM_WORLD);
@@ -835,27 +945,32 @@ int _mpi_init_thread(int *argc, char ***argv, int required, int *provided)
 	logger = logger_init(jobid, world_rank, world_size, &alltoallv_logger_cfg);
 	assert(logger);
 
-	// Allocate buffers reused between alltoallv calls
-	// Note the buffer may be used on a communicator that is not comm_world
-	// but in any case, it will be smaller or of the same size than comm_world.
-	// So we allocate the biggest buffers possible but reuse them during the
-	// entire execution of the application.
-	sbuf = (int *)malloc(world_size * world_size * (sizeof(int)));
-	assert(sbuf);
-	rbuf = (int *)malloc(world_size * world_size * (sizeof(int)));
-	assert(rbuf);
-#if ENABLE_EXEC_TIMING
-	op_exec_times = (double *)malloc(world_size * sizeof(double));
-	assert(op_exec_times);
-#endif // ENABLE_EXEC_TIMING
+	// The staging buffers reused between alltoallv calls are allocated lazily
+	// by staging_reserve(): only communicator roots need them and they are
+	// sized for the communicators actually profiled, not for the world.
+	init_process_identity();
+	timestamp_init();
+	comm_filter_init();
+	parse_profile_features();
+#if ENABLE_SUMMARY
+	// Summary mode collects no per-call matrices: disable the count gathers
+	// entirely, the per-call accumulation needs only local data.
+	_profile_counts = 0;
+#endif // ENABLE_SUMMARY
 #if ENABLE_LATE_ARRIVAL_TIMING
-	late_arrival_timings = (double *)malloc(world_size * sizeof(double));
-	assert(late_arrival_timings);
 	char *inject_delay = getenv("COLLECTIVE_PROFILER_INJECT_DELAY");
 	if (inject_delay != NULL)
 	{
 		_inject_delay = atoi(inject_delay);
 	}
+	char *clock_sync = getenv(A2A_CLOCK_SYNC_LATE_ARRIVAL_ENVVAR);
+	if (clock_sync != NULL)
+		_use_clock_sync_late_arrival = atoi(clock_sync);
+	char *clock_sync_interval = getenv(A2A_CLOCK_SYNC_INTERVAL_ENVVAR);
+	if (clock_sync_interval != NULL && atoi(clock_sync_interval) > 0)
+		_clock_sync_interval = atoi(clock_sync_interval);
+	if (_use_clock_sync_late_arrival)
+		calibrate_clock_offset();
 #endif // ENABLE_LATE_ARRIVAL_TIMING
 
 #if ENABLE_VALIDATION
@@ -875,8 +990,80 @@ int _mpi_init_thread(int *argc, char ***argv, int required, int *provided)
 	}
 
 	char *dump_call_data_envvar = getenv("DUMP_CALL_DATA");
-	if (dump_call_data_envvar != NULL)
-		dump_call_data = atoi(dump_call_data_envvar);
+	if (dump_call_data_envvar != NULL && num_dump_call_ranges == 0)
+		parse_dump_call_data(dump_call_data_envvar);
+
+	char *hierarchical_gather = getenv(A2A_HIERARCHICAL_GATHER_ENVVAR);
+	if (hierarchical_gather != NULL)
+		_use_hierarchical_gather = atoi(hierarchical_gather);
+
+	char *batched_collection = getenv(A2A_BATCHED_COLLECTION_ENVVAR);
+	if (batched_collection != NULL)
+		_use_batched_collection = atoi(batched_collection);
+
+	char *unchanged_fast_path = getenv(A2A_UNCHANGED_FAST_PATH_ENVVAR);
+	if (unchanged_fast_path != NULL)
+		_use_unchanged_fast_path = atoi(unchanged_fast_path);
+
+	char *msg_histogram = getenv(A2A_MSG_SIZE_HISTOGRAM_ENVVAR);
+	if (msg_histogram != NULL)
+		_use_msg_histogram = atoi(msg_histogram);
+	msg_histogram_reset(&hist_send);
+	msg_histogram_reset(&hist_recv);
+
+	char *role_sharding = getenv(A2A_ROLE_SHARDING_ENVVAR);
+	if (role_sharding != NULL)
+		_use_role_sharding = atoi(role_sharding);
+
+	char *async_commit = getenv(A2A_ASYNC_COMMIT_ENVVAR);
+	if (async_commit != NULL)
+		_use_async_commit = atoi(async_commit);
+	if (provided != NULL && *provided == MPI_THREAD_MULTIPLE)
+		_thread_safe = 1;
+	char *mem_budget = getenv(A2A_MEM_BUDGET_ENVVAR);
+	if (mem_budget != NULL)
+		_mem_budget_bytes = (size_t)atoll(mem_budget) * 1024 * 1024;
+	char *thread_safe = getenv(A2A_THREAD_SAFE_ENVVAR);
+	if (thread_safe != NULL)
+		_thread_safe = atoi(thread_safe);
+	if (_thread_safe)
+	{
+		// These modes funnel every call through single global staging buffers
+		// and queues; thread-safe profiling falls back to the flat per-call
+		// gathers and synchronous commits.
+		_use_hierarchical_gather = 0;
+		_use_batched_collection = 0;
+		_use_async_commit = 0;
+		_use_unchanged_fast_path = 0;
+		_use_role_sharding = 0;
+	}
+
+	char *need_data_commit_str = getenv(A2A_COMMIT_PROFILER_DATA_AT_ENVVAR);
+	if (need_data_commit_str != NULL)
+		_commit_data_at = atoi(need_data_commit_str);
+
+	char *commit_interval_str = getenv(A2A_COMMIT_INTERVAL_ENVVAR);
+	if (commit_interval_str != NULL && atoll(commit_interval_str) > 0)
+		_commit_interval = (uint64_t)atoll(commit_interval_str);
+
+	char *need_to_free_data = getenv(A2A_RELEASE_RESOURCES_AFTER_DATA_COMMIT_ENVVAR);
+	if (need_to_free_data != NULL && strncmp(need_to_free_data, "0", 1) != 0)
+		_release_resources_after_commit = 1;
+
+	char *sampling_rate = getenv(A2A_SAMPLING_RATE_ENVVAR);
+	if (sampling_rate != NULL && atoi(sampling_rate) > 1)
+		_sampling_rate = atoi(sampling_rate);
+
+	char *duty_cycle = getenv(A2A_DUTY_CYCLE_ENVVAR);
+	if (duty_cycle != NULL)
+	{
+		int on = 0, off = 0;
+		if (sscanf(duty_cycle, "%d:%d", &on, &off) == 2 && on > 0 && off > 0)
+		{
+			_duty_cycle_on = on;
+			_duty_cycle_off = off;
+		}
+	}
 
 	// Make sure we do not create an articial imbalance between ranks.
 	PMPI_Barrier(MPI_COMM_WORLD);
@@ -886,11 +1073,99 @@ int _mpi_init_thread(int *argc, char ***argv, int required, int *provided)
 
 int MPI_Finalize()
 {
+	flush_nonblocking_timings(MPI_COMM_NULL);
+	async_commit_fini();
+#if ENABLE_SUMMARY
+	_commit_summary();
+#endif // ENABLE_SUMMARY
+	_commit_msg_histogram();
 	_commit_data();
 	_finalize_profiling();
+	node_aggregate_finalize("alltoallv");
 	return PMPI_Finalize();
 }
 
+// The datatype cache keys on the handle, which the MPI library may recycle
+// once the type is freed.
+int MPI_Type_free(MPI_Datatype *type)
+{
+	if (type != NULL)
+	{
+		datatype_cache_invalidate(*type);
+	}
+	return PMPI_Type_free(type);
+}
+
+int MPI_Comm_free(MPI_Comm *comm)
+{
+	// Last point where every rank of the communicator participates: commit the
+	// completion times of its nonblocking calls before the handle goes away.
+	flush_nonblocking_timings(*comm);
+	// Release the per-communicator profiling state: close the timing logger
+	// early (its file content is complete once the communicator goes away) and
+	// drop the handle mapping so a recycled handle gets a fresh record.
+	comm_data_t *comm_data = NULL;
+	if (lookup_comm_data(*comm, &comm_data) == 0)
+	{
+		int series;
+		for (series = 0; series < NUM_TIMING_SERIES; series++)
+		{
+			if (comm_data->timing_logger[series] != NULL)
+			{
+				comm_timing_logger_t *timing_logger = (comm_timing_logger_t *)comm_data->timing_logger[series];
+				fini_time_tracking(&timing_logger);
+			}
+		}
+		release_comm_buffcontent_loggers(*comm);
+		drop_comm(*comm);
+	}
+	return PMPI_Comm_free(comm);
+}
+
+// Register a newly created communicator eagerly so the first profiled
+// collective on it does not pay for the registration.
+static void register_new_comm(MPI_Comm newcomm)
+{
+	uint32_t comm_id;
+	if (newcomm == MPI_COMM_NULL || lookup_comm(newcomm, &comm_id) == 0)
+	{
+		return;
+	}
+	int my_comm_rank;
+	PMPI_Comm_rank(newcomm, &my_comm_rank);
+	add_comm(newcomm, world_rank, my_comm_rank, &comm_id);
+}
+
+int MPI_Comm_dup(MPI_Comm comm, MPI_Comm *newcomm)
+{
+	int ret = PMPI_Comm_dup(comm, newcomm);
+	if (ret == MPI_SUCCESS)
+	{
+		register_new_comm(*newcomm);
+	}
+	return ret;
+}
+
+int MPI_Comm_split(MPI_Comm comm, int color, int key, MPI_Comm *newcomm)
+{
+	int ret = PMPI_Comm_split(comm, color, key, newcomm);
+	if (ret == MPI_SUCCESS)
+	{
+		register_new_comm(*newcomm);
+	}
+	return ret;
+}
+
+int MPI_Comm_split_type(MPI_Comm comm, int split_type, int key, MPI_Info info, MPI_Comm *newcomm)
+{
+	int ret = PMPI_Comm_split_type(comm, split_type, key, info, newcomm);
+	if (ret == MPI_SUCCESS)
+	{
+		register_new_comm(*newcomm);
+	}
+	return ret;
+}
+
 int MPI_Init_thread(int *argc, char ***argv, int required, int *provided)
 {
 	return _mpi_init_thread(argc, argv, required, provided);
@@ -929,47 +1204,18 @@ int mpi_init_(MPI_Fint *ierr)
 
 static int _release_counts_resources()
 {
-	// All data has been handled, now we can clean up
-	int i;
-	while (counts_head != NULL)
-	{
-		SRCountNode_t *c_ptr = counts_head->next;
-
-		for (i = 0; i < counts_head->send_data_size; i++)
-		{
-			delete_counter_data(&(counts_head->send_data[i]));
-		}
-
-		for (i = 0; i < counts_head->recv_data_size; i++)
-		{
-			delete_counter_data(&(counts_head->recv_data[i]));
-		}
-
-		free(counts_head->recv_data);
-		free(counts_head->send_data);
-		free(counts_head->list_calls);
-
-		free(counts_head);
-		counts_head = c_ptr;
-	}
+	// All count bookkeeping lives in the arena; drop it in one pass
+	counts_engine_release();
 	return 0;
 }
 
 static int _release_pattern_resources()
 {
-	while (rpatterns != NULL)
-	{
-		avPattern_t *rp = rpatterns->next;
-		free(rpatterns);
-		rpatterns = rp;
-	}
-
-	while (spatterns != NULL)
-	{
-		avPattern_t *sp = spatterns->next;
-		free(spatterns);
-		spatterns = sp;
-	}
+	free_patterns(rpatterns);
+	rpatterns = NULL;
+	free_patterns(spatterns);
+	spatterns = NULL;
+	patterns_cleanup();
 
 	return 0;
 }
@@ -980,6 +1226,10 @@ static int _release_profiling_resources()
 	_release_counts_resources();
 #endif // ENABLE_RAW_DATA || ENABLE_VALIDATION
 
+	// The unchanged-call fast path appends to the engine's last node, which
+	// is gone now; force the next call through the full gather and insert.
+	_prev_counts_valid = 0;
+
 	while (op_timing_exec_head != NULL)
 	{
 		avTimingsNode_t *t_ptr = op_timing_exec_head->next;
@@ -1028,6 +1278,7 @@ static int _release_profiling_resources()
 		free(late_arrival_timings);
 		late_arrival_timings = NULL;
 	}
+	_staging_size = 0; // The lazy staging allocation starts over
 #if 0
 		if (hostnames)
 		{
@@ -1039,13 +1290,283 @@ static int _release_profiling_resources()
 
 static int _finalize_profiling()
 {
+	validation_store_close(&_validation_store);
+	if (_counts_dump_fd != -1)
+	{
+		close(_counts_dump_fd);
+		_counts_dump_fd = -1;
+	}
 	logger_fini(&logger);
 	_release_profiling_resources();
+	// Only at finalize: mid-run resource releases must keep the filter
+	// configuration alive.
+	comm_filter_release();
+}
+
+// Deep-copy the count data into snapshot-owned storage so the writer thread
+// can serialize it while the MPI rank keeps mutating the live structures.
+static SRCountNode_t *snapshot_counts_list(arena_t *arena, SRCountNode_t *head)
+{
+	SRCountNode_t *copy_head = NULL;
+	SRCountNode_t *copy_tail = NULL;
+	SRCountNode_t *node;
+
+	for (node = head; node != NULL; node = node->next)
+	{
+		int i;
+		SRCountNode_t *copy = (SRCountNode_t *)arena_alloc(arena, sizeof(SRCountNode_t));
+		*copy = *node;
+		copy->next = NULL;
+		copy->hash_next = NULL;
+
+		copy->list_calls = (call_interval_t *)arena_alloc(arena, node->num_intervals * sizeof(call_interval_t));
+		memcpy(copy->list_calls, node->list_calls, node->num_intervals * sizeof(call_interval_t));
+		copy->max_intervals = node->num_intervals;
+
+		copy->send_data = (counts_data_t **)arena_alloc(arena, node->send_data_size * sizeof(counts_data_t *));
+		for (i = 0; i < node->send_data_size; i++)
+		{
+			counts_data_t *d = (counts_data_t *)arena_alloc(arena, sizeof(counts_data_t));
+			*d = *(node->send_data[i]);
+			// Sparse rows only store their (peer, count) pairs
+			int send_row_len = (d->sparse_peers != NULL) ? d->num_nonzero : node->rank_send_vec_len;
+			d->counters = (int *)arena_alloc(arena, send_row_len * sizeof(int));
+			memcpy(d->counters, node->send_data[i]->counters, send_row_len * sizeof(int));
+			if (d->sparse_peers != NULL)
+			{
+				d->sparse_peers = (int *)arena_alloc(arena, d->num_nonzero * sizeof(int));
+				memcpy(d->sparse_peers, node->send_data[i]->sparse_peers, d->num_nonzero * sizeof(int));
+			}
+			d->ranks = (int *)arena_alloc(arena, d->num_ranks * sizeof(int));
+			memcpy(d->ranks, node->send_data[i]->ranks, d->num_ranks * sizeof(int));
+			d->max_ranks = d->num_ranks;
+			copy->send_data[i] = d;
+		}
+
+		copy->recv_data = (counts_data_t **)arena_alloc(arena, node->recv_data_size * sizeof(counts_data_t *));
+		for (i = 0; i < node->recv_data_size; i++)
+		{
+			counts_data_t *d = (counts_data_t *)arena_alloc(arena, sizeof(counts_data_t));
+			*d = *(node->recv_data[i]);
+			int recv_row_len = (d->sparse_peers != NULL) ? d->num_nonzero : node->rank_recv_vec_len;
+			d->counters = (int *)arena_alloc(arena, recv_row_len * sizeof(int));
+			memcpy(d->counters, node->recv_data[i]->counters, recv_row_len * sizeof(int));
+			if (d->sparse_peers != NULL)
+			{
+				d->sparse_peers = (int *)arena_alloc(arena, d->num_nonzero * sizeof(int));
+				memcpy(d->sparse_peers, node->recv_data[i]->sparse_peers, d->num_nonzero * sizeof(int));
+			}
+			d->ranks = (int *)arena_alloc(arena, d->num_ranks * sizeof(int));
+			memcpy(d->ranks, node->recv_data[i]->ranks, d->num_ranks * sizeof(int));
+			d->max_ranks = d->num_ranks;
+			copy->recv_data[i] = d;
+		}
+
+		if (copy_head == NULL)
+		{
+			copy_head = copy;
+		}
+		else
+		{
+			copy_tail->next = copy;
+		}
+		copy_tail = copy;
+	}
+
+	return copy_head;
+}
+
+static void *commit_writer_thread(void *arg)
+{
+	while (1)
+	{
+		if (commit_queue_tail == commit_queue_head)
+		{
+			if (commit_thread_stop)
+			{
+				break;
+			}
+			usleep(1000);
+			continue;
+		}
+
+		commit_snapshot_t *snapshot = commit_queue[commit_queue_tail % ASYNC_COMMIT_QUEUE_DEPTH];
+		log_profiling_data(logger, snapshot->num_calls, snapshot->call_start, snapshot->calls_logged, snapshot->counts, NULL, NULL);
+		arena_release(&(snapshot->arena));
+		free(snapshot);
+		// Publish the slot back to the producer only once we are done with it
+		__atomic_store_n(&commit_queue_tail, commit_queue_tail + 1, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+// Enqueue a snapshot of the current count data for the writer thread. Blocks
+// only if the writer is more than ASYNC_COMMIT_QUEUE_DEPTH commits behind.
+static void _commit_data_async()
+{
+	batched_collection_drain();
+
+	if (!commit_thread_started)
+	{
+		int rc = pthread_create(&commit_thread, NULL, commit_writer_thread, NULL);
+		if (rc != 0)
+		{
+			fprintf(stderr, "[%s:%d][ERROR] unable to start the commit writer thread (rc: %d)\n", __FILE__, __LINE__, rc);
+			_commit_data();
+			return;
+		}
+		commit_thread_started = 1;
+	}
+
+	commit_snapshot_t *snapshot = (commit_snapshot_t *)calloc(1, sizeof(commit_snapshot_t));
+	assert(snapshot);
+	snapshot->counts = snapshot_counts_list(&(snapshot->arena), counts_head);
+	snapshot->num_calls = avCalls;
+	snapshot->call_start = avCallStart;
+	snapshot->calls_logged = profiled_call_span();
+
+	while (commit_queue_head - commit_queue_tail >= ASYNC_COMMIT_QUEUE_DEPTH)
+	{
+		usleep(1000);
+	}
+	commit_queue[commit_queue_head % ASYNC_COMMIT_QUEUE_DEPTH] = snapshot;
+	__atomic_store_n(&commit_queue_head, commit_queue_head + 1, __ATOMIC_RELEASE);
+}
+
+// Drain the queue and stop the writer thread; called before the final,
+// synchronous commit so file handles are no longer shared with the writer.
+static void async_commit_fini()
+{
+	if (!commit_thread_started)
+	{
+		return;
+	}
+	commit_thread_stop = 1;
+	pthread_join(commit_thread, NULL);
+	commit_thread_started = 0;
+	commit_thread_stop = 0;
+}
+
+#if ENABLE_SUMMARY
+// Collect the per-rank byte totals: one gather of two integers per rank (the
+// only communication of the whole mode), then rank 0 feeds the shared
+// sums/grouping output. Must run while MPI is alive, hence the guards - the
+// destructor path can fire after PMPI_Finalize().
+static void _commit_summary()
+{
+	int initialized = 0;
+	int finalized = 0;
+
+	if (summary_committed)
+	{
+		return;
+	}
+	PMPI_Initialized(&initialized);
+	PMPI_Finalized(&finalized);
+	if (!initialized || finalized)
+	{
+		return;
+	}
+
+	uint64_t totals[2] = {summary_send_bytes, summary_recv_bytes};
+	uint64_t *all_totals = NULL;
+	if (world_rank == 0)
+	{
+		all_totals = (uint64_t *)malloc(2 * world_size * sizeof(uint64_t));
+		assert(all_totals);
+	}
+	PMPI_Gather(totals, 2, MPI_UINT64_T, all_totals, 2, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+
+	if (world_rank == 0)
+	{
+		int i;
+		uint64_t total_send_bytes = 0;
+		uint64_t total_recv_bytes = 0;
+		int *send_sums = (int *)malloc(world_size * sizeof(int));
+		assert(send_sums);
+		int *recv_sums = (int *)malloc(world_size * sizeof(int));
+		assert(recv_sums);
+		for (i = 0; i < world_size; i++)
+		{
+			total_send_bytes += all_totals[2 * i];
+			total_recv_bytes += all_totals[2 * i + 1];
+			// The sums/grouping machinery works on ints; clamp the rare
+			// over-2GB rank so the job-wide totals above stay exact.
+			send_sums[i] = (all_totals[2 * i] > INT_MAX) ? INT_MAX : (int)all_totals[2 * i];
+			recv_sums[i] = (all_totals[2 * i + 1] > INT_MAX) ? INT_MAX : (int)all_totals[2 * i + 1];
+		}
+		log_profiling_sums(logger, world_size, send_sums, recv_sums, total_send_bytes, total_recv_bytes, summary_calls);
+		free(send_sums);
+		free(recv_sums);
+		free(all_totals);
+	}
+	summary_committed = 1;
+}
+#endif // ENABLE_SUMMARY
+
+// Merge the per-rank message-size histograms with one reduction and write the
+// job-wide result on rank 0. Must run while MPI is alive, hence the guards -
+// the destructor path can fire after PMPI_Finalize().
+static void _commit_msg_histogram()
+{
+	int initialized = 0;
+	int finalized = 0;
+
+	if (!_use_msg_histogram || msg_histogram_committed)
+	{
+		return;
+	}
+	PMPI_Initialized(&initialized);
+	PMPI_Finalized(&finalized);
+	if (!initialized || finalized)
+	{
+		return;
+	}
+
+	msg_histogram_t merged[2];
+	msg_histogram_reduce(&hist_send, &hist_recv, merged, 0, MPI_COMM_WORLD);
+
+	if (world_rank == 0)
+	{
+		char *filename = NULL;
+		int rc;
+		if (getenv(OUTPUT_DIR_ENVVAR))
+		{
+			_asprintf(filename, rc, "%s/msg-size-histogram_alltoallv.job%d.md", getenv(OUTPUT_DIR_ENVVAR), get_job_id());
+		}
+		else
+		{
+			_asprintf(filename, rc, "msg-size-histogram_alltoallv.job%d.md", get_job_id());
+		}
+		assert(rc > 0);
+
+		FILE *fh = profile_fopen(filename, "w", "counts");
+		assert(fh);
+		fprintf(fh, "# Message size distribution for alltoallv operations\n\n");
+		msg_histogram_fwrite(fh, "Send message sizes", &merged[0]);
+		msg_histogram_fwrite(fh, "Recv message sizes", &merged[1]);
+		fclose(fh);
+		free(filename);
+	}
+	msg_histogram_committed = 1;
 }
 
 static int _commit_data()
 {
-	log_profiling_data(logger, avCalls, avCallStart, avCallsLogged, counts_head, displs_head, op_timing_exec_head);
+	// Retire any in-flight batched collection so its call is part of the commit
+	batched_collection_drain();
+
+	if (_commit_interval > 0)
+	{
+		// Count data has been committed incrementally; flush only the calls
+		// above the watermarks instead of rewriting everything.
+		log_profiling_checkpoint(logger, counts_head);
+		log_profiling_data(logger, avCalls, avCallStart, profiled_call_span(), NULL, displs_head, op_timing_exec_head);
+	}
+	else
+	{
+		log_profiling_data(logger, avCalls, avCallStart, profiled_call_span(), counts_head, displs_head, op_timing_exec_head);
+	}
 
 	/*
 #if ENABLE_TIMING
@@ -1061,15 +1582,107 @@ static int _commit_data()
 	save_call_patterns(world_rank);
 #endif // ENABLE_PATTERN_DETECTION && TRACK_PATTERNS_ON_CALL_BASIS
 
+	if (_sampling_rate > 1 || _duty_cycle_on > 0)
+	{
+		save_profiling_windows(world_rank);
+	}
+
 	return 0;
 }
 
+// Raw binary dump for the non-compact build: a small per-call header followed
+// by the gathered matrices written straight from the staging buffers with
+// writev() - no per-int formatting, no copy - into one append-only file per
+// rank instead of one text file per call. counts_bin2txt converts a dump back
+// to the old text layout.
+typedef struct counts_dump_header
+{
+	uint64_t call_id;
+	uint32_t comm_size;
+	uint32_t s_datatype_size;
+	uint32_t r_datatype_size;
+	uint32_t padding;
+} counts_dump_header_t;
+
+static void save_counts_binary(int *sendcounts, int *recvcounts, int s_datatype_size, int r_datatype_size, int comm_size, uint64_t n_call)
+{
+	if (_counts_dump_fd == -1)
+	{
+		char *filename = NULL;
+		int rc;
+		if (getenv(OUTPUT_DIR_ENVVAR))
+		{
+			_asprintf(filename, rc, "%s/counts.rank%d.bin", getenv(OUTPUT_DIR_ENVVAR), world_rank);
+		}
+		else
+		{
+			_asprintf(filename, rc, "counts.rank%d.bin", world_rank);
+		}
+		assert(rc > 0);
+		_counts_dump_fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+		assert(_counts_dump_fd != -1);
+		free(filename);
+	}
+
+	counts_dump_header_t header;
+	header.call_id = n_call;
+	header.comm_size = (uint32_t)comm_size;
+	header.s_datatype_size = (uint32_t)s_datatype_size;
+	header.r_datatype_size = (uint32_t)r_datatype_size;
+	header.padding = 0;
+
+	size_t matrix_size = (size_t)comm_size * comm_size * sizeof(int);
+	struct iovec iov[3];
+	iov[0].iov_base = &header;
+	iov[0].iov_len = sizeof(header);
+	iov[1].iov_base = sendcounts;
+	iov[1].iov_len = matrix_size;
+	iov[2].iov_base = recvcounts;
+	iov[2].iov_len = matrix_size;
+
+	ssize_t expected = sizeof(header) + 2 * matrix_size;
+	ssize_t written = writev(_counts_dump_fd, iov, 3);
+	while (written >= 0 && written < expected)
+	{
+		// Partial write: fall back to write() for the remainder. Figure out
+		// where the cut landed across the three regions.
+		ssize_t skip = written;
+		int i;
+		for (i = 0; i < 3; i++)
+		{
+			if (skip < (ssize_t)iov[i].iov_len)
+			{
+				ssize_t w = write(_counts_dump_fd, (char *)iov[i].iov_base + skip, iov[i].iov_len - skip);
+				if (w < 0)
+				{
+					written = -1;
+					break;
+				}
+				written += w;
+				break;
+			}
+			skip -= iov[i].iov_len;
+		}
+	}
+	if (written != expected)
+	{
+		fprintf(stderr, "[%s:%d][ERROR] unable to write binary counts\n", __FILE__, __LINE__);
+		PMPI_Abort(MPI_COMM_WORLD, 1);
+	}
+}
+
 static void save_counts(int *sendcounts, int *recvcounts, int s_datatype_size, int r_datatype_size, int comm_size, uint64_t n_call)
 {
 	char *filename = NULL;
 	int i;
 	int rc;
 
+	if (getenv(PROFILE_BINARY_FORMAT_ENVVAR) && atoi(getenv(PROFILE_BINARY_FORMAT_ENVVAR)))
+	{
+		save_counts_binary(sendcounts, recvcounts, s_datatype_size, r_datatype_size, comm_size, n_call);
+		return;
+	}
+
 	if (getenv(OUTPUT_DIR_ENVVAR))
 	{
 		_asprintf(filename, rc, "%s/counts.rank%d_call%" PRIu64 ".md", getenv(OUTPUT_DIR_ENVVAR), world_rank, n_call);
@@ -1117,6 +1730,743 @@ static void save_counts(int *sendcounts, int *recvcounts, int s_datatype_size, i
 	free(filename);
 }
 
+static int hierarchical_gather_setup(MPI_Comm comm, int my_comm_rank)
+{
+	if (hg_comm == comm)
+	{
+		return 0;
+	}
+
+	if (hg_node_comm != MPI_COMM_NULL)
+	{
+		PMPI_Comm_free(&hg_node_comm);
+	}
+	if (hg_leader_comm != MPI_COMM_NULL)
+	{
+		PMPI_Comm_free(&hg_leader_comm);
+	}
+
+	PMPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, my_comm_rank, MPI_INFO_NULL, &hg_node_comm);
+	PMPI_Comm_rank(hg_node_comm, &hg_node_rank);
+	PMPI_Comm_size(hg_node_comm, &hg_node_size);
+	// Leaders (node rank 0) get their own communicator. Keying on the comm rank
+	// guarantees that the leader of the node hosting comm rank 0 - which is comm
+	// rank 0 itself - becomes rank 0 of the leader communicator, i.e., the final
+	// destination of the collected data.
+	PMPI_Comm_split(comm, hg_node_rank == 0 ? 0 : MPI_UNDEFINED, my_comm_rank, &hg_leader_comm);
+	hg_comm = comm;
+	return 0;
+}
+
+// Gather one counts vector (row) per rank into the dense <dest> matrix on comm
+// rank 0, funneling the data through node leaders. Each leader deduplicates its
+// node's rows (checksum plus memcmp, same scheme as the counts_data_t compaction)
+// and forwards a compact payload laid out as:
+//   [num unique rows] then, per unique row: [num ranks][ranks...][counters...]
+// The root expands the payloads back into the dense matrix the insertion path
+// expects. <dest> only needs to be valid on comm rank 0.
+static int hierarchical_gather_counts(const int *counts, int comm_size, int my_comm_rank, int *dest)
+{
+	int i, j;
+	int *node_rows = NULL;
+	int *node_ranks = NULL;
+
+	if (hg_node_rank == 0)
+	{
+		node_rows = (int *)malloc(hg_node_size * comm_size * sizeof(int));
+		assert(node_rows);
+		node_ranks = (int *)malloc(hg_node_size * sizeof(int));
+		assert(node_ranks);
+	}
+
+	// Step 1: node-local gather of the rows and the comm ranks that own them
+	PMPI_Gather(counts, comm_size, MPI_INT, node_rows, comm_size, MPI_INT, 0, hg_node_comm);
+	PMPI_Gather(&my_comm_rank, 1, MPI_INT, node_ranks, 1, MPI_INT, 0, hg_node_comm);
+
+	if (hg_node_rank != 0)
+	{
+		return 0;
+	}
+
+	// Step 2: deduplicate the node's rows
+	uint64_t *checksums = (uint64_t *)malloc(hg_node_size * sizeof(uint64_t));
+	assert(checksums);
+	int *unique_idx = (int *)malloc(hg_node_size * sizeof(int)); // Which unique row each node row maps to
+	assert(unique_idx);
+	int num_unique = 0;
+	for (i = 0; i < hg_node_size; i++)
+	{
+		int *row = &(node_rows[i * comm_size]);
+		checksums[i] = hash_fnv1a(row, comm_size * sizeof(int));
+		unique_idx[i] = -1;
+		for (j = 0; j < i; j++)
+		{
+			if (checksums[j] == checksums[i] && memcmp(row, &(node_rows[j * comm_size]), comm_size * sizeof(int)) == 0)
+			{
+				unique_idx[i] = unique_idx[j];
+				break;
+			}
+		}
+		if (unique_idx[i] == -1)
+		{
+			unique_idx[i] = num_unique;
+			num_unique++;
+		}
+	}
+
+	// Step 3: build the payload
+	int payload_len = 1 + num_unique * 2 + hg_node_size + num_unique * comm_size;
+	int *payload = (int *)malloc(payload_len * sizeof(int));
+	assert(payload);
+	int cursor = 0;
+	payload[cursor++] = num_unique;
+	int uid;
+	for (uid = 0; uid < num_unique; uid++)
+	{
+		int first_member = -1;
+		int num_members = 0;
+		for (i = 0; i < hg_node_size; i++)
+		{
+			if (unique_idx[i] == uid)
+			{
+				num_members++;
+			}
+		}
+		payload[cursor++] = num_members;
+		for (i = 0; i < hg_node_size; i++)
+		{
+			if (unique_idx[i] == uid)
+			{
+				payload[cursor++] = node_ranks[i];
+				if (first_member == -1)
+				{
+					first_member = i;
+				}
+			}
+		}
+		memcpy(&(payload[cursor]), &(node_rows[first_member * comm_size]), comm_size * sizeof(int));
+		cursor += comm_size;
+	}
+	assert(cursor <= payload_len);
+
+	free(checksums);
+	free(unique_idx);
+	free(node_rows);
+	free(node_ranks);
+
+	// Step 4: leaders funnel the compact payloads to the root
+	int num_leaders;
+	int leader_rank;
+	PMPI_Comm_size(hg_leader_comm, &num_leaders);
+	PMPI_Comm_rank(hg_leader_comm, &leader_rank);
+
+	int *payload_sizes = NULL;
+	int *payload_offsets = NULL;
+	int *all_payloads = NULL;
+	if (leader_rank == 0)
+	{
+		payload_sizes = (int *)malloc(num_leaders * sizeof(int));
+		assert(payload_sizes);
+		payload_offsets = (int *)malloc(num_leaders * sizeof(int));
+		assert(payload_offsets);
+	}
+	PMPI_Gather(&cursor, 1, MPI_INT, payload_sizes, 1, MPI_INT, 0, hg_leader_comm);
+	int total_payload = 0;
+	if (leader_rank == 0)
+	{
+		for (i = 0; i < num_leaders; i++)
+		{
+			payload_offsets[i] = total_payload;
+			total_payload += payload_sizes[i];
+		}
+		all_payloads = (int *)malloc(total_payload * sizeof(int));
+		assert(all_payloads);
+	}
+	PMPI_Gatherv(payload, cursor, MPI_INT, all_payloads, payload_sizes, payload_offsets, MPI_INT, 0, hg_leader_comm);
+	free(payload);
+
+	if (leader_rank != 0)
+	{
+		return 0;
+	}
+
+	// Step 5: expand the payloads into the dense matrix (root only)
+	assert(my_comm_rank == 0);
+	cursor = 0;
+	while (cursor < total_payload)
+	{
+		int nrows = all_payloads[cursor++];
+		for (i = 0; i < nrows; i++)
+		{
+			int num_members = all_payloads[cursor++];
+			int *members = &(all_payloads[cursor]);
+			cursor += num_members;
+			for (j = 0; j < num_members; j++)
+			{
+				memcpy(&(dest[members[j] * comm_size]), &(all_payloads[cursor]), comm_size * sizeof(int));
+			}
+			cursor += comm_size;
+		}
+	}
+
+	free(payload_sizes);
+	free(payload_offsets);
+	free(all_payloads);
+	return 0;
+}
+
+// Root-side processing of one profiled call once its data sits in the staging
+// buffers (sbuf/rbuf and, when enabled, op_exec_times/late_arrival_timings).
+// Factored out of _mpi_alltoallv() so the batched collection mode can run it
+// when the non-blocking gather completes instead of inline with the collective.
+// do_counts/do_timings select which halves to run: normally comm rank 0 runs
+// both, but in role-sharding mode the count data and the timing samples land
+// on different roots and each only processes its own share.
+static void process_collected_counts(uint64_t call_id, int comm_size, MPI_Comm comm, int my_comm_rank, int s_dt_size, int r_dt_size,
+									 int *sbuf, int *rbuf, double *op_exec_times, double *late_arrival_timings, int counts_unchanged,
+									 int do_counts, int do_timings)
+{
+	char *collective_name = "alltoallv";
+
+#if ((ENABLE_RAW_DATA || ENABLE_PER_RANK_STATS || ENABLE_VALIDATION) && ENABLE_COMPACT_FORMAT)
+	if (do_counts && _profile_counts)
+	{
+		DEBUG_ALLTOALLV_PROFILING("Saving data of call #%" PRIu64 ".\n", call_id);
+		// counts_unchanged means the gather was skipped: the staging buffers
+		// still hold the previous call's (identical) counts and the call ID
+		// only has to be appended to the previous node. The fallback covers
+		// the engine having been released since the previous call.
+		if (!counts_unchanged || counts_engine_repeat_last_call(call_id))
+		{
+			if (insert_sendrecv_count_data(sbuf, rbuf, comm_size, s_dt_size, r_dt_size, call_id))
+			{
+				fprintf(stderr, "[%s:%d][ERROR] unable to insert send/recv counts\n", __FILE__, __LINE__);
+				PMPI_Abort(MPI_COMM_WORLD, 1);
+			}
+		}
+	}
+#endif // ((ENABLE_RAW_DATA || ENABLE_PER_RANK_STATS || ENABLE_VALIDATION) && ENABLE_COMPACT_FORMAT)
+
+#if ((ENABLE_RAW_DATA || ENABLE_PER_RANK_STATS || ENABLE_VALIDATION) && !ENABLE_COMPACT_FORMAT)
+	if (do_counts && _profile_counts)
+	{
+		DEBUG_ALLTOALLV_PROFILING("Saving data of call #%" PRIu64 ".\n", call_id);
+		save_counts(sbuf, rbuf, s_dt_size, r_dt_size, comm_size, call_id);
+	}
+#endif // ((ENABLE_RAW_DATA || ENABLE_PER_RANK_STATS || ENABLE_VALIDATION) && !ENABLE_COMPACT_FORMAT)
+
+#if ENABLE_PATTERN_DETECTION
+	if (do_counts)
+	{
+		commit_pattern_from_counts(call_id, sbuf, rbuf, comm_size);
+	}
+#endif
+
+#if ENABLE_EXEC_TIMING
+	if (do_timings && _profile_exec_timings)
+	{
+		int jobid = get_job_id();
+		int rc = commit_timings_series(TIMING_SERIES_EXEC, comm, collective_name, world_rank, my_comm_rank, jobid, op_exec_times, comm_size, call_id);
+		if (rc)
+		{
+			fprintf(stderr, "commit_timings() failed: %d\n", rc);
+			PMPI_Abort(MPI_COMM_WORLD, 1);
+		}
+	}
+#endif // ENABLE_EXEC_TIMING
+
+#if ENABLE_LATE_ARRIVAL_TIMING
+	if (do_timings && _profile_late_arrival)
+	{
+		if (_use_clock_sync_late_arrival)
+		{
+			// The gathered values are corrected arrival timestamps; turn them into
+			// per-rank deltas relative to the earliest arrival.
+			double first_arrival = late_arrival_timings[0];
+			int i;
+			for (i = 1; i < comm_size; i++)
+			{
+				if (late_arrival_timings[i] < first_arrival)
+					first_arrival = late_arrival_timings[i];
+			}
+			for (i = 0; i < comm_size; i++)
+			{
+				late_arrival_timings[i] -= first_arrival;
+			}
+		}
+		int jobid = get_job_id();
+		int rc = commit_timings_series(TIMING_SERIES_LATE_ARRIVAL, comm, collective_name, world_rank, my_comm_rank, jobid, late_arrival_timings, comm_size, call_id);
+		if (rc)
+		{
+			fprintf(stderr, "commit_timings() failed: %d\n", rc);
+			PMPI_Abort(MPI_COMM_WORLD, 1);
+		}
+	}
+#endif // ENABLE_LATE_ARRIVAL_TIMING
+	if (do_counts)
+	{
+		avCallsLogged++;
+	}
+}
+
+// Batched collection: counts and timing samples of a profiled call are packed
+// into one contiguous per-rank message and collected with a single
+// PMPI_Igather. The operation is completed - and the rank 0 processing run -
+// at the next profiled call or at commit time, so collection overlaps the
+// application's compute phase instead of serializing behind the collective.
+typedef struct batched_collection
+{
+	int active;
+	MPI_Request req;
+	uint64_t call_id;
+	int comm_size;
+	int my_comm_rank;
+	int s_dt_size;
+	int r_dt_size;
+	MPI_Comm comm;
+	unsigned char *pack;	  // This rank's packed contribution
+	unsigned char *collected; // Root-side receive area (comm rank 0 only)
+} batched_collection_t;
+
+static batched_collection_t pending_collection = {0};
+
+// Number of doubles packed after the two count vectors
+#if ENABLE_EXEC_TIMING
+#define BATCHED_NUM_TIMINGS_EXEC (1)
+#else
+#define BATCHED_NUM_TIMINGS_EXEC (0)
+#endif
+#if ENABLE_LATE_ARRIVAL_TIMING
+#define BATCHED_NUM_TIMINGS_ARRIVAL (1)
+#else
+#define BATCHED_NUM_TIMINGS_ARRIVAL (0)
+#endif
+#define BATCHED_NUM_TIMINGS (BATCHED_NUM_TIMINGS_EXEC + BATCHED_NUM_TIMINGS_ARRIVAL)
+
+static size_t batched_entry_size(int comm_size)
+{
+	return 2 * comm_size * sizeof(int) + BATCHED_NUM_TIMINGS * sizeof(double);
+}
+
+// Complete the in-flight collection, if any, and run the deferred rank 0
+// processing. Must be called by every rank of the communicator the pending
+// operation was posted on, which holds since all of them post the gather and
+// all of them drain it at their next profiled call or at finalize.
+static void batched_collection_drain(void)
+{
+	if (!pending_collection.active)
+	{
+		return;
+	}
+
+	PMPI_Wait(&(pending_collection.req), MPI_STATUS_IGNORE);
+	free(pending_collection.pack);
+	pending_collection.pack = NULL;
+
+	if (pending_collection.my_comm_rank == 0)
+	{
+		// Unpack into the staging buffers the processing path expects
+		int comm_size = pending_collection.comm_size;
+		size_t entry_size = batched_entry_size(comm_size);
+		int rank;
+		for (rank = 0; rank < comm_size; rank++)
+		{
+			unsigned char *entry = pending_collection.collected + rank * entry_size;
+			memcpy(&(sbuf[rank * comm_size]), entry, comm_size * sizeof(int));
+			entry += comm_size * sizeof(int);
+			memcpy(&(rbuf[rank * comm_size]), entry, comm_size * sizeof(int));
+			entry += comm_size * sizeof(int);
+#if ENABLE_EXEC_TIMING
+			memcpy(&(op_exec_times[rank]), entry, sizeof(double));
+			entry += sizeof(double);
+#endif // ENABLE_EXEC_TIMING
+#if ENABLE_LATE_ARRIVAL_TIMING
+			memcpy(&(late_arrival_timings[rank]), entry, sizeof(double));
+#endif // ENABLE_LATE_ARRIVAL_TIMING
+		}
+		process_collected_counts(pending_collection.call_id, comm_size, pending_collection.comm,
+								 pending_collection.my_comm_rank, pending_collection.s_dt_size, pending_collection.r_dt_size,
+								 sbuf, rbuf, op_exec_times, late_arrival_timings, 0, 1, 1);
+		free(pending_collection.collected);
+		pending_collection.collected = NULL;
+	}
+	pending_collection.active = 0;
+}
+
+static void batched_collection_start(const int *sendcounts, const int *recvcounts, int comm_size,
+									 MPI_Comm comm, int my_comm_rank, MPI_Datatype sendtype, MPI_Datatype recvtype,
+									 double t_op, double t_arrival)
+{
+	size_t entry_size = batched_entry_size(comm_size);
+	unsigned char *cursor;
+
+	pending_collection.pack = (unsigned char *)malloc(entry_size);
+	assert(pending_collection.pack);
+	cursor = pending_collection.pack;
+	memcpy(cursor, sendcounts, comm_size * sizeof(int));
+	cursor += comm_size * sizeof(int);
+	memcpy(cursor, recvcounts, comm_size * sizeof(int));
+	cursor += comm_size * sizeof(int);
+#if ENABLE_EXEC_TIMING
+	memcpy(cursor, &t_op, sizeof(double));
+	cursor += sizeof(double);
+#endif // ENABLE_EXEC_TIMING
+#if ENABLE_LATE_ARRIVAL_TIMING
+	memcpy(cursor, &t_arrival, sizeof(double));
+#endif // ENABLE_LATE_ARRIVAL_TIMING
+
+	pending_collection.collected = NULL;
+	if (my_comm_rank == 0)
+	{
+		pending_collection.collected = (unsigned char *)malloc(entry_size * comm_size);
+		assert(pending_collection.collected);
+	}
+
+	pending_collection.call_id = avCalls;
+	pending_collection.comm_size = comm_size;
+	pending_collection.my_comm_rank = my_comm_rank;
+	pending_collection.comm = comm;
+	pending_collection.s_dt_size = cached_type_size(sendtype);
+	pending_collection.r_dt_size = cached_type_size(recvtype);
+
+	PMPI_Igather(pending_collection.pack, entry_size, MPI_BYTE,
+				 pending_collection.collected, entry_size, MPI_BYTE, 0, comm, &(pending_collection.req));
+	pending_collection.active = 1;
+}
+
+// Nonblocking alltoallv support. Counts are recorded at initiation - the
+// nonblocking variant is a collective too, so every rank of the communicator
+// is present and the count gather matches - while the completion time is
+// captured by shimming MPI_Wait/MPI_Test/MPI_Waitall through a registry of
+// in-flight requests. One record is appended per profiled call, in collective
+// order, which is identical on every rank of the communicator; the per-rank
+// durations are gathered and committed from flush_nonblocking_timings(), the
+// only points where all ranks of the communicator participate again
+// (MPI_Comm_free() and MPI_Finalize()).
+typedef struct nonblocking_call
+{
+	uint64_t call_id;
+	MPI_Comm comm;
+	int comm_size;
+	int my_comm_rank;
+	double t_start;
+	double duration; // 0 until a completion shim sees the request finish
+	int committed;
+	struct nonblocking_call *next;
+} nonblocking_call_t;
+
+static nonblocking_call_t *nonblocking_calls_head = NULL;
+static nonblocking_call_t *nonblocking_calls_tail = NULL;
+
+typedef struct request_registry_entry
+{
+	MPI_Request req;
+	nonblocking_call_t *call;
+	struct request_registry_entry *next;
+} request_registry_entry_t;
+
+static request_registry_entry_t *_request_registry[REQUEST_REGISTRY_BUCKETS] = {NULL};
+static int _requests_in_flight = 0;
+
+static unsigned int request_registry_bucket(MPI_Request req)
+{
+	return (unsigned int)(hash_fnv1a(&req, sizeof(req)) & (REQUEST_REGISTRY_BUCKETS - 1));
+}
+
+static void request_registry_add(MPI_Request req, nonblocking_call_t *call)
+{
+	request_registry_entry_t *entry = (request_registry_entry_t *)malloc(sizeof(request_registry_entry_t));
+	assert(entry);
+	unsigned int bucket = request_registry_bucket(req);
+	entry->req = req;
+	entry->call = call;
+	entry->next = _request_registry[bucket];
+	_request_registry[bucket] = entry;
+	_requests_in_flight++;
+}
+
+// Called by the completion shims on every completed request. Applications that
+// never issue a profiled nonblocking alltoallv only pay for the counter test.
+static void request_registry_complete(MPI_Request req)
+{
+	if (_requests_in_flight == 0 || req == MPI_REQUEST_NULL)
+	{
+		return;
+	}
+	PROFILER_LOCK();
+	unsigned int bucket = request_registry_bucket(req);
+	request_registry_entry_t *entry = _request_registry[bucket];
+	request_registry_entry_t *prev = NULL;
+	while (entry != NULL)
+	{
+		if (entry->req == req)
+		{
+			entry->call->duration = timestamp_now() - entry->call->t_start;
+			if (prev == NULL)
+			{
+				_request_registry[bucket] = entry->next;
+			}
+			else
+			{
+				prev->next = entry->next;
+			}
+			free(entry);
+			_requests_in_flight--;
+			break;
+		}
+		prev = entry;
+		entry = entry->next;
+	}
+	PROFILER_UNLOCK();
+}
+
+// Gather and commit the completion times of the nonblocking calls recorded on
+// the given communicator (every recorded communicator when comm is
+// MPI_COMM_NULL). The gathers are posted nonblocking and completed with a
+// single waitall so the per-rank lists can interleave calls on different
+// communicators without deadlocking.
+static void flush_nonblocking_timings(MPI_Comm comm)
+{
+#if ENABLE_EXEC_TIMING
+	char *collective_name = "ialltoallv";
+	nonblocking_call_t *call;
+	int num_pending = 0;
+	int finalized = 0;
+
+	PMPI_Finalized(&finalized);
+	if (finalized)
+	{
+		return;
+	}
+
+	for (call = nonblocking_calls_head; call != NULL; call = call->next)
+	{
+		if (!call->committed && (comm == MPI_COMM_NULL || call->comm == comm))
+		{
+			num_pending++;
+		}
+	}
+	if (num_pending == 0)
+	{
+		return;
+	}
+
+	MPI_Request *reqs = (MPI_Request *)malloc(num_pending * sizeof(MPI_Request));
+	assert(reqs);
+	double **durations = (double **)calloc(num_pending, sizeof(double *));
+	assert(durations);
+
+	int idx = 0;
+	for (call = nonblocking_calls_head; call != NULL; call = call->next)
+	{
+		if (call->committed || (comm != MPI_COMM_NULL && call->comm != comm))
+		{
+			continue;
+		}
+		if (call->my_comm_rank == 0)
+		{
+			durations[idx] = (double *)malloc(call->comm_size * sizeof(double));
+			assert(durations[idx]);
+		}
+		PMPI_Igather(&(call->duration), 1, MPI_DOUBLE, durations[idx], 1, MPI_DOUBLE, 0, call->comm, &(reqs[idx]));
+		idx++;
+	}
+	PMPI_Waitall(num_pending, reqs, MPI_STATUSES_IGNORE);
+
+	idx = 0;
+	for (call = nonblocking_calls_head; call != NULL; call = call->next)
+	{
+		if (call->committed || (comm != MPI_COMM_NULL && call->comm != comm))
+		{
+			continue;
+		}
+		if (call->my_comm_rank == 0)
+		{
+			int jobid = get_job_id();
+			int rc = commit_timings_series(TIMING_SERIES_EXEC, call->comm, collective_name, world_rank, call->my_comm_rank, jobid, durations[idx], call->comm_size, call->call_id);
+			if (rc)
+			{
+				fprintf(stderr, "commit_timings() failed: %d\n", rc);
+				PMPI_Abort(MPI_COMM_WORLD, 1);
+			}
+			free(durations[idx]);
+		}
+		call->committed = 1;
+		idx++;
+	}
+	free(reqs);
+	free(durations);
+#endif // ENABLE_EXEC_TIMING
+}
+
+int _mpi_ialltoallv(const void *sendbuf, const int *sendcounts, const int *sdispls,
+					MPI_Datatype sendtype, void *recvbuf, const int *recvcounts,
+					const int *rdispls, MPI_Datatype recvtype, MPI_Comm comm, MPI_Request *request)
+{
+	int comm_size;
+	int ret;
+	bool need_profile = true;
+	int my_comm_rank;
+
+	PMPI_Comm_size(comm, &comm_size);
+	PMPI_Comm_rank(comm, &my_comm_rank);
+	PMPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+	// Same gating as the blocking path so call limits and sampling apply
+	// uniformly to both variants.
+	if (avCalls < _num_call_start_profiling)
+	{
+		need_profile = false;
+	}
+	else
+	{
+		if (-1 != _limit_av_calls && avCallsLogged >= _limit_av_calls)
+		{
+			need_profile = false;
+		}
+		if (need_profile && _sampling_rate > 1 && (avCalls % _sampling_rate) != 0)
+		{
+			need_profile = false;
+		}
+		if (need_profile && _duty_cycle_on > 0 && (avCalls % (_duty_cycle_on + _duty_cycle_off)) >= _duty_cycle_on)
+		{
+			need_profile = false;
+		}
+	}
+
+	// Filtering engine: same communicator and call-site predicates as the
+	// blocking path (see comm_filter.h).
+	if (need_profile && comm_filter_active())
+	{
+		comm_data_t *filter_comm_data = NULL;
+		PROFILER_LOCK();
+		if (lookup_comm_data(comm, &filter_comm_data) != 0)
+		{
+			uint32_t filter_comm_id;
+			add_comm(comm, world_rank, my_comm_rank, &filter_comm_id);
+			lookup_comm_data(comm, &filter_comm_data);
+		}
+		PROFILER_UNLOCK();
+		assert(filter_comm_data);
+		if (!comm_filter_allow(filter_comm_data, comm_size))
+		{
+			need_profile = false;
+		}
+	}
+	if (need_profile && comm_filter_callsites_active())
+	{
+		void *trace_addrs[16];
+		size_t trace_size = backtrace(trace_addrs, 16);
+		PROFILER_LOCK();
+		int callsite_allowed = comm_filter_callsite_allow(trace_addrs, trace_size);
+		PROFILER_UNLOCK();
+		if (!callsite_allowed)
+		{
+			need_profile = false;
+		}
+	}
+
+	if (need_profile)
+	{
+		PROFILER_LOCK();
+		if (avCallStart == -1)
+		{
+			avCallStart = avCalls;
+		}
+		record_profiled_call(avCalls);
+		PROFILER_UNLOCK();
+
+#if ((ENABLE_RAW_DATA || ENABLE_PER_RANK_STATS || ENABLE_VALIDATION) && ENABLE_COMPACT_FORMAT)
+		if (_profile_counts)
+		{
+			int *call_sbuf = NULL;
+			int *call_rbuf = NULL;
+			double *unused_exec = NULL;
+			double *unused_late = NULL;
+			if (_thread_safe)
+			{
+				thread_staging_get(comm_size, my_comm_rank, &call_sbuf, &call_rbuf, &unused_exec, &unused_late);
+			}
+			else if (my_comm_rank == 0)
+			{
+				staging_reserve(comm_size);
+				call_sbuf = sbuf;
+				call_rbuf = rbuf;
+			}
+
+			PMPI_Gather(sendcounts, comm_size, MPI_INT, call_sbuf, comm_size, MPI_INT, 0, comm);
+			PMPI_Gather(recvcounts, comm_size, MPI_INT, call_rbuf, comm_size, MPI_INT, 0, comm);
+			if (my_comm_rank == 0)
+			{
+				int s_dt_size, r_dt_size;
+				s_dt_size = cached_type_size(sendtype);
+				r_dt_size = cached_type_size(recvtype);
+				PROFILER_LOCK();
+				if (insert_sendrecv_count_data(call_sbuf, call_rbuf, comm_size, s_dt_size, r_dt_size, avCalls))
+				{
+					fprintf(stderr, "[%s:%d][ERROR] unable to insert send/recv counts\n", __FILE__, __LINE__);
+					PMPI_Abort(MPI_COMM_WORLD, 1);
+				}
+				avCallsLogged++;
+				// The engine's last node is now this non-blocking call, not the
+				// last blocking one; the fast path must not append to it.
+				_prev_counts_valid = 0;
+				PROFILER_UNLOCK();
+			}
+		}
+#endif // ((ENABLE_RAW_DATA || ENABLE_PER_RANK_STATS || ENABLE_VALIDATION) && ENABLE_COMPACT_FORMAT)
+
+#if ENABLE_EXEC_TIMING
+		double t_start = 0.0;
+		if (_profile_exec_timings)
+		{
+			t_start = timestamp_now();
+		}
+#endif // ENABLE_EXEC_TIMING
+
+		ret = PMPI_Ialltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm, request);
+
+#if ENABLE_EXEC_TIMING
+		if (_profile_exec_timings && ret == MPI_SUCCESS)
+		{
+			nonblocking_call_t *call = (nonblocking_call_t *)malloc(sizeof(nonblocking_call_t));
+			assert(call);
+			call->call_id = avCalls;
+			call->comm = comm;
+			call->comm_size = comm_size;
+			call->my_comm_rank = my_comm_rank;
+			call->t_start = t_start;
+			call->duration = 0.0;
+			call->committed = 0;
+			call->next = NULL;
+			PROFILER_LOCK();
+			if (nonblocking_calls_head == NULL)
+			{
+				nonblocking_calls_head = call;
+			}
+			else
+			{
+				nonblocking_calls_tail->next = call;
+			}
+			nonblocking_calls_tail = call;
+			request_registry_add(*request, call);
+			PROFILER_UNLOCK();
+		}
+#endif // ENABLE_EXEC_TIMING
+	}
+	else
+	{
+		ret = PMPI_Ialltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm, request);
+	}
+
+	if (_thread_safe)
+		__atomic_fetch_add(&avCalls, 1, __ATOMIC_RELAXED);
+	else
+		avCalls++;
+
+	return ret;
+}
+
 int _mpi_alltoallv(const void *sendbuf, const int *sendcounts, const int *sdispls,
 				   MPI_Datatype sendtype, void *recvbuf, const int *recvcounts,
 				   const int *rdispls, MPI_Datatype recvtype, MPI_Comm comm)
@@ -1133,28 +2483,86 @@ int _mpi_alltoallv(const void *sendbuf, const int *sendcounts, const int *sdispl
 	PMPI_Comm_rank(comm, &my_comm_rank);
 	PMPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
 
+	// Filtering engine (A2A_FILTER_*, see comm_filter.h): decide once per
+	// communicator whether it is profiled at all. Evaluated ahead of the
+	// backtrace hook so a filtered-out communicator skips every collection
+	// path; the steady-state cost is a hash lookup and one compare.
+	int comm_allowed = 1;
+	if (comm_filter_active())
+	{
+		comm_data_t *filter_comm_data = NULL;
+		PROFILER_LOCK();
+		if (lookup_comm_data(comm, &filter_comm_data) != 0)
+		{
+			uint32_t filter_comm_id;
+			add_comm(comm, world_rank, my_comm_rank, &filter_comm_id);
+			lookup_comm_data(comm, &filter_comm_data);
+		}
+		PROFILER_UNLOCK();
+		assert(filter_comm_data);
+		comm_allowed = comm_filter_allow(filter_comm_data, comm_size);
+	}
+
+	// Single backtrace capture per call, shared by backtrace profiling and
+	// the call-site filter so both derive their key from the same addresses
+	// (see callsite_key()).
+	void *trace_addrs[16];
+	size_t trace_size = 0;
 #if ENABLE_BACKTRACE
-	if (my_comm_rank == 0)
+	if (comm_allowed && ((_profile_backtrace && my_comm_rank == 0) || comm_filter_callsites_active()))
+#else
+	if (comm_allowed && comm_filter_callsites_active())
+#endif // ENABLE_BACKTRACE
+	{
+		trace_size = backtrace(trace_addrs, 16);
+	}
+
+#if ENABLE_BACKTRACE
+	if (comm_allowed && _profile_backtrace && my_comm_rank == 0 && trace_size > 0)
+	{
+		// Symbol resolution is cached on the raw return addresses: see
+		// insert_caller_data_addrs(), backtrace_symbols() only runs once per
+		// unique trace.
+		PROFILER_LOCK();
+		insert_caller_data_addrs(collective_name, trace_addrs, trace_size, comm, my_comm_rank, world_rank, avCalls);
+		PROFILER_UNLOCK();
+	}
+#endif // ENABLE_BACKTRACE
+
+	// Check if we need to profile that specific call
+	if (avCalls < _num_call_start_profiling)
 	{
-		void *array[16];
-		size_t _s;
-		char **strings;
-		char *caller_trace = NULL;
+		need_profile = false;
+	}
+	else
+	{
+		if (-1 != _limit_av_calls && avCallsLogged >= _limit_av_calls)
+		{
+			need_profile = false;
+		}
 
-		_s = backtrace(array, 16);
-		strings = backtrace_symbols(array, _s);
-		insert_caller_data(collective_name, strings, _s, comm, my_comm_rank, world_rank, avCalls);
+		// Sampling engine: keep only every K-th call and/or the "on" phase of
+		// the duty cycle.
+		if (need_profile && _sampling_rate > 1 && (avCalls % _sampling_rate) != 0)
+		{
+			need_profile = false;
+		}
+		if (need_profile && _duty_cycle_on > 0 && (avCalls % (_duty_cycle_on + _duty_cycle_off)) >= _duty_cycle_on)
+		{
+			need_profile = false;
+		}
 	}
-#endif // ENABLE_BACKTRACE
 
-	// Check if we need to profile that specific call
-	if (avCalls < _num_call_start_profiling)
+	if (!comm_allowed)
 	{
 		need_profile = false;
 	}
-	else
+	if (need_profile && comm_filter_callsites_active())
 	{
-		if (-1 != _limit_av_calls && avCallsLogged >= _limit_av_calls)
+		PROFILER_LOCK();
+		int callsite_allowed = comm_filter_callsite_allow(trace_addrs, trace_size);
+		PROFILER_UNLOCK();
+		if (!callsite_allowed)
 		{
 			need_profile = false;
 		}
@@ -1162,30 +2570,29 @@ int _mpi_alltoallv(const void *sendbuf, const int *sendcounts, const int *sdispl
 
 	if (need_profile)
 	{
+		PROFILER_LOCK();
 		if (avCallStart == -1)
 		{
 			avCallStart = avCalls;
 		}
+		record_profiled_call(avCalls);
+		PROFILER_UNLOCK();
 
-		if (dump_call_data == avCalls)
+		if (dump_call_data_requested(avCalls))
 		{
 			// Save datatypes information
 			if (my_comm_rank == 0)
 			{
-				datatype_info_t sendtype_info;
-				sendtype_info.analyzed = false;
-				analyze_datatype(sendtype, &sendtype_info);
-				int rc = save_datatype_info(collective_name, comm, my_comm_rank, world_rank, avCalls, "send", &sendtype_info);
+				datatype_info_t *sendtype_info = lookup_datatype_info(sendtype);
+				int rc = save_datatype_info(collective_name, comm, my_comm_rank, world_rank, avCalls, "send", sendtype_info);
 				if (rc)
 				{
 					fprintf(stderr, "save_datatype_info() failed (rc: %d)\n", rc);
 					MPI_Abort(MPI_COMM_WORLD, 12);
 				}
 
-				datatype_info_t recvtype_info;
-				recvtype_info.analyzed = false;
-				analyze_datatype(recvtype, &recvtype_info);
-				rc = save_datatype_info(collective_name, comm, my_comm_rank, world_rank, avCalls, "recv", &recvtype_info);
+				datatype_info_t *recvtype_info = lookup_datatype_info(recvtype);
+				rc = save_datatype_info(collective_name, comm, my_comm_rank, world_rank, avCalls, "recv", recvtype_info);
 				if (rc)
 				{
 					fprintf(stderr, "save_datatype_info() failed (rc: %d)\n", rc);
@@ -1203,22 +2610,73 @@ int _mpi_alltoallv(const void *sendbuf, const int *sendcounts, const int *sdispl
 		}
 
 #if ENABLE_LATE_ARRIVAL_TIMING
-		if (_inject_delay == 1 && my_comm_rank == 0)
+		double t_barrier_start = 0.0;
+		double t_barrier_end = 0.0;
+		if (_profile_late_arrival)
 		{
-			sleep(1);
+			if (_inject_delay == 1 && my_comm_rank == 0)
+			{
+				sleep(1);
+			}
+			if (_use_clock_sync_late_arrival && _clock_sync_interval > 0 && comm == MPI_COMM_WORLD)
+			{
+				// Slow-cadence refresh of the clock offsets. Only world-spanning
+				// calls can recalibrate since every rank takes part.
+				_world_calls_since_sync++;
+				if (_world_calls_since_sync >= _clock_sync_interval)
+				{
+					calibrate_clock_offset();
+					_world_calls_since_sync = 0;
+				}
+			}
+			t_barrier_start = timestamp_now();
+			if (!_use_clock_sync_late_arrival)
+			{
+				PMPI_Barrier(comm);
+			}
+			t_barrier_end = timestamp_now();
 		}
-		double t_barrier_start = MPI_Wtime();
-		PMPI_Barrier(comm);
-		double t_barrier_end = MPI_Wtime();
 #endif // ENABLE_LATE_ARRIVAL_TIMING
 
+		if (_use_msg_histogram)
+		{
+			int i;
+			uint64_t s_dt = (uint64_t)cached_type_size(sendtype);
+			uint64_t r_dt = (uint64_t)cached_type_size(recvtype);
+			for (i = 0; i < comm_size; i++)
+			{
+				msg_histogram_add(&hist_send, (uint64_t)sendcounts[i] * s_dt);
+				msg_histogram_add(&hist_recv, (uint64_t)recvcounts[i] * r_dt);
+			}
+		}
+
+#if ENABLE_SUMMARY
+		{
+			int i;
+			uint64_t call_send = 0;
+			uint64_t call_recv = 0;
+			for (i = 0; i < comm_size; i++)
+			{
+				call_send += (uint64_t)sendcounts[i];
+				call_recv += (uint64_t)recvcounts[i];
+			}
+			summary_send_bytes += call_send * (uint64_t)cached_type_size(sendtype);
+			summary_recv_bytes += call_recv * (uint64_t)cached_type_size(recvtype);
+			summary_calls++;
+		}
+#endif // ENABLE_SUMMARY
+
 #if ENABLE_EXEC_TIMING
-		double t_start = MPI_Wtime();
+		double t_start = 0.0;
+		if (_profile_exec_timings)
+		{
+			t_start = timestamp_now();
+		}
 #endif // ENABLE_EXEC_TIMING
 
 		ret = PMPI_Alltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm);
 
-		if (dump_call_data == avCalls)
+		if (dump_call_data_requested(avCalls))
 		{
 			int rc = store_call_data(collective_name, RECV_CONTEXT_IDX, comm, my_comm_rank, world_rank, avCalls, (void *)recvbuf, (int *)recvcounts, (int *)rdispls, recvtype);
 			if (rc)
@@ -1227,45 +2685,173 @@ int _mpi_alltoallv(const void *sendbuf, const int *sendcounts, const int *sdispl
 				MPI_Abort(MPI_COMM_WORLD, 11);
 			}
 			save_buf_content(recvbuf, recvcounts, rdispls, recvtype, comm, world_rank, "recv");
-			release_buffcontent_loggers();
-			PMPI_Barrier(comm);
-			if (my_comm_rank == 0)
-				fprintf(stderr, "All data acquired, aborting...\n");
-			MPI_Abort(MPI_COMM_WORLD, 22);
+			// Push the dumped content out right away; the descriptors stay
+			// open so the next dumped call does not pay for a reopen.
+			sync_buffcontent_loggers();
 		}
 
 #if ENABLE_EXEC_TIMING
-		double t_end = MPI_Wtime();
-		double t_op = t_end - t_start;
+		double t_op = 0.0;
+		if (_profile_exec_timings)
+		{
+			t_op = timestamp_now() - t_start;
+		}
 #endif // ENABLE_EXEC_TIMING
 
 #if ENABLE_LATE_ARRIVAL_TIMING
-		double t_arrival = t_barrier_end - t_barrier_start;
+		// In clock-sync mode the sample is the corrected entry timestamp;
+		// rank 0 converts the gathered timestamps to arrival deltas.
+		double t_arrival = 0.0;
+		if (_profile_late_arrival)
+		{
+			if (_use_clock_sync_late_arrival)
+			{
+				t_arrival = t_barrier_start + _clock_offset;
+			}
+			else
+			{
+				t_arrival = t_barrier_end - t_barrier_start;
+			}
+		}
 #endif // ENABLE_LATE_ARRIVAL_TIMING
 
+		// Collection roles for this call. Everything normally lands on comm
+		// rank 0; in role-sharding mode the counts gather, the timing gathers
+		// and the location processing go to three different ranks so a single
+		// rank does not absorb all of the collection work of a busy
+		// communicator. The base root is agreed once per communicator through
+		// a broadcast from comm rank 0 and cached on the communicator record:
+		// local communicator IDs are assigned in creation order and are not
+		// consistent across ranks, so the base cannot be derived independently.
+		// Sharding only applies to the plain blocking gathers; the batched and
+		// hierarchical modes are built around a rank 0 root.
+		int counts_root = 0;
+		int timings_root = 0;
+		int location_root = 0;
+		if (_use_role_sharding && !_use_batched_collection && !_use_hierarchical_gather && comm_size > 1)
+		{
+			comm_data_t *sharding_comm_data = NULL;
+			PROFILER_LOCK();
+			if (lookup_comm_data(comm, &sharding_comm_data) != 0)
+			{
+				uint32_t sharding_comm_id;
+				add_comm(comm, world_rank, my_comm_rank, &sharding_comm_id);
+				lookup_comm_data(comm, &sharding_comm_data);
+			}
+			PROFILER_UNLOCK();
+			assert(sharding_comm_data);
+			if (sharding_comm_data->sharding_base < 0)
+			{
+				int base = 0;
+				if (my_comm_rank == 0)
+				{
+					base = (int)(sharding_comm_data->id % (uint32_t)comm_size);
+				}
+				PMPI_Bcast(&base, 1, MPI_INT, 0, comm);
+				sharding_comm_data->sharding_base = base;
+			}
+			counts_root = sharding_comm_data->sharding_base;
+			timings_root = (counts_root + 1) % comm_size;
+			location_root = (counts_root + 2) % comm_size;
+		}
+
+		// Staging buffers for this call: the shared globals normally, this
+		// thread's private buffers in thread-safe mode so concurrent calls on
+		// distinct communicators do not race on the gathers. Only the roots of
+		// the communicator receive the gathered data so only the roots
+		// allocate; MPI ignores the receive arguments on the other ranks.
+		int *call_sbuf = NULL;
+		int *call_rbuf = NULL;
+		double *call_exec_times = NULL;
+		double *call_late_arrivals = NULL;
+		if (_thread_safe)
+		{
+			thread_staging_get(comm_size, my_comm_rank, &call_sbuf, &call_rbuf, &call_exec_times, &call_late_arrivals);
+		}
+		else
+		{
+			if (my_comm_rank == counts_root || my_comm_rank == timings_root)
+			{
+				staging_reserve(comm_size);
+			}
+			call_sbuf = sbuf;
+			call_rbuf = rbuf;
+			call_exec_times = op_exec_times;
+			call_late_arrivals = late_arrival_timings;
+		}
+
+		// Unchanged-call fast path: hash this rank's count vectors and compare
+		// with the previous profiled call on the same communicator. One
+		// allreduced byte decides whether every rank repeats itself; when it
+		// does the count gather and the engine dedup are skipped entirely and
+		// rank 0 only appends the call ID to the previous node. Steady-state
+		// phases then pay a single one-byte allreduce per call.
+		signed char counts_unchanged = 0;
+		if (_use_unchanged_fast_path && _profile_counts && !_use_batched_collection)
+		{
+			uint64_t counts_hash = hash_fnv1a_init();
+			counts_hash = hash_fnv1a_update(counts_hash, sendcounts, comm_size * sizeof(int));
+			counts_hash = hash_fnv1a_update(counts_hash, recvcounts, comm_size * sizeof(int));
+			signed char local_unchanged = (_prev_counts_valid && _prev_counts_comm == comm && _prev_counts_hash == counts_hash) ? 1 : 0;
+			PMPI_Allreduce(&local_unchanged, &counts_unchanged, 1, MPI_SIGNED_CHAR, MPI_MIN, comm);
+			_prev_counts_hash = counts_hash;
+			_prev_counts_comm = comm;
+			_prev_counts_valid = 1;
+		}
+
 		// Gather a bunch of counters
-		PMPI_Gather(sendcounts, comm_size, MPI_INT, sbuf, comm_size, MPI_INT, 0, comm);
-		PMPI_Gather(recvcounts, comm_size, MPI_INT, rbuf, comm_size, MPI_INT, 0, comm);
+		if (_use_batched_collection && _profile_counts)
+		{
+			double _t_op = 0.0;
+			double _t_arrival = 0.0;
+#if ENABLE_EXEC_TIMING
+			_t_op = t_op;
+#endif // ENABLE_EXEC_TIMING
+#if ENABLE_LATE_ARRIVAL_TIMING
+			_t_arrival = t_arrival;
+#endif // ENABLE_LATE_ARRIVAL_TIMING
+			// Retire the previous in-flight collection before posting a new one
+			batched_collection_drain();
+			batched_collection_start(sendcounts, recvcounts, comm_size, comm, my_comm_rank, sendtype, recvtype, _t_op, _t_arrival);
+		}
+		else if (_use_hierarchical_gather && _profile_counts && !counts_unchanged)
+		{
+			hierarchical_gather_setup(comm, my_comm_rank);
+			hierarchical_gather_counts(sendcounts, comm_size, my_comm_rank, call_sbuf);
+			hierarchical_gather_counts(recvcounts, comm_size, my_comm_rank, call_rbuf);
+		}
+		else if (_profile_counts && !counts_unchanged)
+		{
+			PMPI_Gather(sendcounts, comm_size, MPI_INT, call_sbuf, comm_size, MPI_INT, counts_root, comm);
+			PMPI_Gather(recvcounts, comm_size, MPI_INT, call_rbuf, comm_size, MPI_INT, counts_root, comm);
+		}
 
 #if ENABLE_EXEC_TIMING
-		PMPI_Gather(&t_op, 1, MPI_DOUBLE, op_exec_times, 1, MPI_DOUBLE, 0, comm);
+		// The batched collection carries the timings only when counts are on
+		if (_profile_exec_timings && (!_use_batched_collection || !_profile_counts))
+		{
+			PMPI_Gather(&t_op, 1, MPI_DOUBLE, call_exec_times, 1, MPI_DOUBLE, timings_root, comm);
+		}
 #endif // ENABLE_EXEC_TIMING
 
 #if ENABLE_LATE_ARRIVAL_TIMING
-		PMPI_Gather(&t_arrival, 1, MPI_DOUBLE, late_arrival_timings, 1, MPI_DOUBLE, 0, comm);
+		if (_profile_late_arrival && (!_use_batched_collection || !_profile_counts))
+		{
+			PMPI_Gather(&t_arrival, 1, MPI_DOUBLE, call_late_arrivals, 1, MPI_DOUBLE, timings_root, comm);
+		}
 #endif // ENABLE_LATE_ARRIVAL_TIMING
 
 #if ENABLE_SAVE_DATA_VALIDATION
 		if (do_send_buffs > 0)
 		{
 			int dtsize;
-			PMPI_Type_size(sendtype, &dtsize);
+			dtsize = cached_type_size(sendtype);
 			store_call_data(collective_name, SEND_CONTEXT_IDX, comm, my_comm_rank, world_rank, avCalls, (void *)sendbuf, (int *)sendcounts, (int *)sdispls, sendtype);
 		}
 		else
 		{
 			int dtsize;
-			PMPI_Type_size(recvtype, &dtsize);
+			dtsize = cached_type_size(recvtype);
 			store_call_data(collective_name, RECV_CONTEXT_IDX, comm, my_comm_rank, world_rank, avCalls, (void *)recvbuf, (int *)recvcounts, (int *)rdispls, recvtype);
 		}
 
@@ -1316,87 +2902,111 @@ int _mpi_alltoallv(const void *sendbuf, const int *sendcounts, const int *sdispl
 #endif // ENABLE_COMPARE_DATA_VALIDATION
 
 #if ENABLE_LOCATION_TRACKING
-		int my_pid = getpid();
-		// Note that the library will free all the allocated memory. We hand over the pointer
-		// and the profiler frees the memory when finalizing
-		int *pids = (int *)malloc(comm_size * sizeof(int));
-		assert(pids);
-		int *world_comm_ranks = (int *)malloc(comm_size * sizeof(int));
-		assert(world_comm_ranks);
-		char hostname[256];
-		gethostname(hostname, 256);
-		char *hostnames = (char *)malloc(256 * comm_size * sizeof(char));
-		assert(hostnames);
-
-		PMPI_Gather(&my_pid, 1, MPI_INT, pids, 1, MPI_INT, 0, comm);
-		PMPI_Gather(&world_rank, 1, MPI_INT, world_comm_ranks, 1, MPI_INT, 0, comm);
-		PMPI_Gather(&hostname, 256, MPI_CHAR, hostnames, 256, MPI_CHAR, 0, comm);
-		if (my_comm_rank == 0)
+		// Locations are immutable for the life of a communicator: gather them
+		// only the first time the communicator is profiled, afterwards just
+		// reference the cached record by communicator ID.
+		comm_data_t *location_comm_data = NULL;
+		if (_profile_location)
 		{
-			int rc = commit_rank_locations(collective_name, comm, comm_size, world_rank, my_comm_rank, pids, world_comm_ranks, hostnames, avCalls);
-			if (rc)
+			PROFILER_LOCK();
+			if (lookup_comm_data(comm, &location_comm_data) != 0)
 			{
-				fprintf(stderr, "save_rank_locations() failed: %d", rc);
-				PMPI_Abort(MPI_COMM_WORLD, 1);
+				uint32_t location_comm_id;
+				add_comm(comm, world_rank, my_comm_rank, &location_comm_id);
+				lookup_comm_data(comm, &location_comm_data);
 			}
+			PROFILER_UNLOCK();
 		}
-#endif // ENABLE_LOCATION_TRACKING
-
-		if (my_comm_rank == 0)
+		assert(!_profile_location || location_comm_data);
+		if (_profile_location && location_comm_data->location_tracked == 0)
 		{
-#if DEBUG
-			fprintf(logger->f, "Root: global %d - %d   local %d - %d\n", world_size, myrank, size, localrank);
-#endif
+			int *pids = NULL;
+			int *world_comm_ranks = NULL;
+			char *hostnames = NULL;
+			if (my_comm_rank == location_root)
+			{
+				// The profiler frees these buffers when finalizing; only the root
+				// needs them.
+				pids = (int *)malloc(comm_size * sizeof(int));
+				assert(pids);
+				world_comm_ranks = (int *)malloc(comm_size * sizeof(int));
+				assert(world_comm_ranks);
+				hostnames = (char *)malloc(256 * comm_size * sizeof(char));
+				assert(hostnames);
+			}
 
-#if ((ENABLE_RAW_DATA || ENABLE_PER_RANK_STATS || ENABLE_VALIDATION) && ENABLE_COMPACT_FORMAT)
-			DEBUG_ALLTOALLV_PROFILING("Saving data of call #%" PRIu64 ".\n", avCalls);
-			int s_dt_size, r_dt_size;
-			PMPI_Type_size(sendtype, &s_dt_size);
-			PMPI_Type_size(recvtype, &r_dt_size);
-			if (insert_sendrecv_count_data(sbuf, rbuf, comm_size, s_dt_size, r_dt_size))
+			PMPI_Gather(&_pid, 1, MPI_INT, pids, 1, MPI_INT, location_root, comm);
+			PMPI_Gather(&world_rank, 1, MPI_INT, world_comm_ranks, 1, MPI_INT, location_root, comm);
+			PMPI_Gather(_hostname, 256, MPI_CHAR, hostnames, 256, MPI_CHAR, location_root, comm);
+			if (my_comm_rank == location_root)
 			{
-				fprintf(stderr, "[%s:%d][ERROR] unable to insert send/recv counts\n", __FILE__, __LINE__);
-				PMPI_Abort(MPI_COMM_WORLD, 1);
+				PROFILER_LOCK();
+				int rc = commit_rank_locations(collective_name, comm, comm_size, world_rank, my_comm_rank, pids, world_comm_ranks, hostnames, avCalls);
+				PROFILER_UNLOCK();
+				if (rc)
+				{
+					fprintf(stderr, "save_rank_locations() failed: %d", rc);
+					PMPI_Abort(MPI_COMM_WORLD, 1);
+				}
 			}
-#endif // ((ENABLE_RAW_DATA || ENABLE_PER_RANK_STATS || ENABLE_VALIDATION) && ENABLE_COMPACT_FORMAT)
+			location_comm_data->location_tracked = 1;
+		}
+		else if (_profile_location && my_comm_rank == location_root)
+		{
+			PROFILER_LOCK();
+			commit_rank_locations_by_id(collective_name, comm, avCalls);
+			PROFILER_UNLOCK();
+		}
+#endif // ENABLE_LOCATION_TRACKING
 
-#if ((ENABLE_RAW_DATA || ENABLE_PER_RANK_STATS || ENABLE_VALIDATION) && !ENABLE_COMPACT_FORMAT)
-			DEBUG_ALLTOALLV_PROFILING("Saving data of call #%" PRIu64 ".\n", avCalls);
+		if (!_use_batched_collection && (my_comm_rank == counts_root || my_comm_rank == timings_root))
+		{
 			int s_dt_size, r_dt_size;
-			PMPI_Type_size(sendtype, &s_dt_size);
-			PMPI_Type_size(recvtype, &r_dt_size);
-			save_counts(sbuf, rbuf, s_dt_size, r_dt_size, comm_size, avCalls);
-#endif // ((ENABLE_RAW_DATA || ENABLE_PER_RANK_STATS || ENABLE_VALIDATION) && !ENABLE_COMPACT_FORMAT)
-
-#if ENABLE_PATTERN_DETECTION
-			commit_pattern_from_counts(avCalls, sbuf, rbuf, size);
-#endif
+			s_dt_size = cached_type_size(sendtype);
+			r_dt_size = cached_type_size(recvtype);
+			PROFILER_LOCK();
+			// With sharding off both roots are rank 0 and one call does
+			// everything; with sharding on each root only processes the data
+			// it actually received.
+			process_collected_counts(avCalls, comm_size, comm, my_comm_rank, s_dt_size, r_dt_size,
+									 call_sbuf, call_rbuf, call_exec_times, call_late_arrivals, counts_unchanged,
+									 my_comm_rank == counts_root, my_comm_rank == timings_root);
+			PROFILER_UNLOCK();
+		}
 
-#if ENABLE_EXEC_TIMING
-			int jobid = get_job_id();
-			int rc = commit_timings(comm, collective_name, world_rank, my_comm_rank, jobid, op_exec_times, comm_size, avCalls);
-			if (rc)
-			{
-				fprintf(stderr, "commit_timings() failed: %d\n", rc);
-				PMPI_Abort(MPI_COMM_WORLD, 1);
-			}
-#endif // ENABLE_EXEC_TIMING
+		// Memory-budget engine: once the in-memory count data exceeds the
+		// budget, commit it and release the profiling resources. The profile
+		// files act as the spill - mid-run commits append to them and the
+		// post-processing tools merge the generations - so the heap stays
+		// bounded no matter how many unique count signatures the run produces.
+		if (_mem_budget_bytes > 0 && counts_engine_mem_used() > _mem_budget_bytes)
+		{
+			PROFILER_LOCK();
+			_commit_data();
+			_release_profiling_resources();
+			PROFILER_UNLOCK();
+		}
 
-#if ENABLE_LATE_ARRIVAL_TIMING
-			int jobid = get_job_id();
-			int rc = commit_timings(comm, collective_name, world_rank, my_comm_rank, jobid, late_arrival_timings, comm_size, avCalls);
-			if (rc)
-			{
-				fprintf(stderr, "commit_timings() failed: %d\n", rc);
-				PMPI_Abort(MPI_COMM_WORLD, 1);
-			}
-#endif // ENABLE_LATE_ARRIVAL_TIMING
-			avCallsLogged++;
+		// Incremental checkpoint engine: every _commit_interval profiled
+		// calls, flush only the count data appended since the previous
+		// checkpoint (per-node watermarks track what is already on disk), so
+		// a crash costs at most one interval without the cost of rewriting
+		// the accumulated state.
+		if (_commit_interval > 0 && ++_calls_since_checkpoint >= _commit_interval)
+		{
+			PROFILER_LOCK();
+			batched_collection_drain();
+			log_profiling_checkpoint(logger, counts_head);
+			PROFILER_UNLOCK();
+			_calls_since_checkpoint = 0;
 		}
 
 #if ENABLE_LATE_ARRIVAL_TIMING
 		// All ranks sync so that if we have I/O happening for some ranks during the data commit, it would not skew the next timings
-		PMPI_Barrier(comm);
+		if (_profile_late_arrival && !_use_clock_sync_late_arrival)
+		{
+			PMPI_Barrier(comm);
+		}
 #endif // ENABLE_LATE_ARRIVAL_TIMING
 	}
 	else
@@ -1411,25 +3021,28 @@ int _mpi_alltoallv(const void *sendbuf, const int *sendcounts, const int *sdispl
 	PMPI_Barrier(comm);
 #endif // SYNC
 
-	char *need_data_commit_str = getenv(A2A_COMMIT_PROFILER_DATA_AT_ENVVAR);
-	char *need_to_free_data = getenv(A2A_RELEASE_RESOURCES_AFTER_DATA_COMMIT_ENVVAR);
-
-	if (need_data_commit_str != NULL)
+	if (avCalls == (uint64_t)_commit_data_at)
 	{
-		int targetCallID = atoi(need_data_commit_str);
-		if (avCalls == targetCallID)
+		if (_use_async_commit)
+		{
+			_commit_data_async();
+		}
+		else
 		{
 			_commit_data();
 		}
 	}
 
-	if (need_to_free_data != NULL && strncmp(need_to_free_data, "0", 1) != 0)
+	if (_release_resources_after_commit)
 	{
 		_release_profiling_resources();
 	}
 
 	// avCalls is the absolute number of calls that the rank is dealing with
-	avCalls++;
+	if (_thread_safe)
+		__atomic_fetch_add(&avCalls, 1, __ATOMIC_RELAXED);
+	else
+		avCalls++;
 
 	return ret;
 }
@@ -1441,6 +3054,49 @@ int MPI_Alltoallv(const void *sendbuf, const int *sendcounts, const int *sdispls
 	return _mpi_alltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm);
 }
 
+#if defined(MPI_VERSION) && MPI_VERSION >= 4
+// MPI-4 large-count variant. When every count and displacement fits in an int
+// - by far the common case - the call is narrowed and goes through the regular
+// profiled path, so it costs nothing extra; otherwise the exact 64-bit count
+// rows are saved to a per-rank sidecar file and the operation runs unprofiled.
+int MPI_Alltoallv_c(const void *sendbuf, const MPI_Count sendcounts[], const MPI_Aint sdispls[],
+					MPI_Datatype sendtype, void *recvbuf, const MPI_Count recvcounts[],
+					const MPI_Aint rdispls[], MPI_Datatype recvtype, MPI_Comm comm)
+{
+	int comm_size;
+	int ret;
+
+	PMPI_Comm_size(comm, &comm_size);
+
+	if (large_counts_fit(sendcounts, comm_size) && large_counts_fit(recvcounts, comm_size) &&
+		large_displs_fit(sdispls, comm_size) && large_displs_fit(rdispls, comm_size))
+	{
+		int *narrow_sendcounts = (int *)malloc(4 * comm_size * sizeof(int));
+		assert(narrow_sendcounts);
+		int *narrow_sdispls = narrow_sendcounts + comm_size;
+		int *narrow_recvcounts = narrow_sendcounts + 2 * comm_size;
+		int *narrow_rdispls = narrow_sendcounts + 3 * comm_size;
+		narrow_large_counts(sendcounts, narrow_sendcounts, comm_size);
+		narrow_large_displs(sdispls, narrow_sdispls, comm_size);
+		narrow_large_counts(recvcounts, narrow_recvcounts, comm_size);
+		narrow_large_displs(rdispls, narrow_rdispls, comm_size);
+		ret = _mpi_alltoallv(sendbuf, narrow_sendcounts, narrow_sdispls, sendtype,
+							 recvbuf, narrow_recvcounts, narrow_rdispls, recvtype, comm);
+		free(narrow_sendcounts);
+		return ret;
+	}
+
+	PMPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+	save_large_counts("alltoallv", world_rank, avCalls, sendcounts, comm_size, recvcounts, comm_size);
+	ret = PMPI_Alltoallv_c(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm);
+	if (_thread_safe)
+		__atomic_fetch_add(&avCalls, 1, __ATOMIC_RELAXED);
+	else
+		avCalls++;
+	return ret;
+}
+#endif // MPI_VERSION >= 4
+
 void mpi_alltoallv_(void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sdispls, MPI_Fint *sendtype,
 					void *recvbuf, MPI_Fint *recvcount, MPI_Fint *rdispls, MPI_Fint *recvtype,
 					MPI_Fint *comm, MPI_Fint *ierr)
@@ -1469,10 +3125,218 @@ void mpi_alltoallv_(void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sdispls, MPI_F
 		*ierr = OMPI_INT_2_FINT(c_ierr);
 }
 
+int MPI_Ialltoallv(const void *sendbuf, const int sendcounts[], const int sdispls[],
+				   MPI_Datatype sendtype, void *recvbuf, const int recvcounts[],
+				   const int rdispls[], MPI_Datatype recvtype, MPI_Comm comm, MPI_Request *request)
+{
+	return _mpi_ialltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm, request);
+}
+
+void mpi_ialltoallv_(void *sendbuf, MPI_Fint *sendcount, MPI_Fint *sdispls, MPI_Fint *sendtype,
+					 void *recvbuf, MPI_Fint *recvcount, MPI_Fint *rdispls, MPI_Fint *recvtype,
+					 MPI_Fint *comm, MPI_Fint *request, MPI_Fint *ierr)
+{
+	int c_ierr;
+	MPI_Comm c_comm;
+	MPI_Datatype c_sendtype, c_recvtype;
+	MPI_Request c_request;
+
+	c_comm = PMPI_Comm_f2c(*comm);
+	c_sendtype = PMPI_Type_f2c(*sendtype);
+	c_recvtype = PMPI_Type_f2c(*recvtype);
+
+	sendbuf = (char *)OMPI_F2C_IN_PLACE(sendbuf);
+	sendbuf = (char *)OMPI_F2C_BOTTOM(sendbuf);
+	recvbuf = (char *)OMPI_F2C_BOTTOM(recvbuf);
+
+	c_ierr = MPI_Ialltoallv(sendbuf,
+							(int *)OMPI_FINT_2_INT(sendcount),
+							(int *)OMPI_FINT_2_INT(sdispls),
+							c_sendtype,
+							recvbuf,
+							(int *)OMPI_FINT_2_INT(recvcount),
+							(int *)OMPI_FINT_2_INT(rdispls),
+							c_recvtype, c_comm, &c_request);
+	if (MPI_SUCCESS == c_ierr)
+		*request = PMPI_Request_c2f(c_request);
+	if (NULL != ierr)
+		*ierr = OMPI_INT_2_FINT(c_ierr);
+}
+
+#if defined(MPI_VERSION) && MPI_VERSION >= 4
+// Persistent variant: counts are recorded once at initialization time, which
+// is collective. Per-cycle completion timing is not tracked - a persistent
+// request is started many times and the registry attributes a request to a
+// single call record.
+int MPI_Alltoallv_init(const void *sendbuf, const int sendcounts[], const int sdispls[],
+					   MPI_Datatype sendtype, void *recvbuf, const int recvcounts[],
+					   const int rdispls[], MPI_Datatype recvtype, MPI_Comm comm,
+					   MPI_Info info, MPI_Request *request)
+{
+	int comm_size;
+	int my_comm_rank;
+
+	PMPI_Comm_size(comm, &comm_size);
+	PMPI_Comm_rank(comm, &my_comm_rank);
+	PMPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+#if ((ENABLE_RAW_DATA || ENABLE_PER_RANK_STATS || ENABLE_VALIDATION) && ENABLE_COMPACT_FORMAT)
+	if (_profile_counts)
+	{
+		int *call_sbuf = NULL;
+		int *call_rbuf = NULL;
+		if (my_comm_rank == 0)
+		{
+			staging_reserve(comm_size);
+			call_sbuf = sbuf;
+			call_rbuf = rbuf;
+		}
+		PMPI_Gather(sendcounts, comm_size, MPI_INT, call_sbuf, comm_size, MPI_INT, 0, comm);
+		PMPI_Gather(recvcounts, comm_size, MPI_INT, call_rbuf, comm_size, MPI_INT, 0, comm);
+		if (my_comm_rank == 0)
+		{
+			int s_dt_size, r_dt_size;
+			s_dt_size = cached_type_size(sendtype);
+			r_dt_size = cached_type_size(recvtype);
+			PROFILER_LOCK();
+			if (insert_sendrecv_count_data(call_sbuf, call_rbuf, comm_size, s_dt_size, r_dt_size, avCalls))
+			{
+				fprintf(stderr, "[%s:%d][ERROR] unable to insert send/recv counts\n", __FILE__, __LINE__);
+				PMPI_Abort(MPI_COMM_WORLD, 1);
+			}
+			avCallsLogged++;
+			// The engine's last node is now this persistent-init call, not
+			// the last blocking one; the fast path must not append to it.
+			_prev_counts_valid = 0;
+			PROFILER_UNLOCK();
+		}
+	}
+#endif // ((ENABLE_RAW_DATA || ENABLE_PER_RANK_STATS || ENABLE_VALIDATION) && ENABLE_COMPACT_FORMAT)
+
+	if (_thread_safe)
+		__atomic_fetch_add(&avCalls, 1, __ATOMIC_RELAXED);
+	else
+		avCalls++;
+
+	return PMPI_Alltoallv_init(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm, info, request);
+}
+#endif // MPI_VERSION >= 4
+
+// The neighborhood variant exchanges with topology neighbors, so its counts
+// are indexed by neighbor instead of communicator rank and do not fit the
+// rank-indexed count structures; only execution timing is recorded, under its
+// own call counter so it does not disturb the alltoallv sampling sequence.
+static uint64_t neighborCalls = 0;
+
+int MPI_Neighbor_alltoallv(const void *sendbuf, const int sendcounts[], const int sdispls[],
+						   MPI_Datatype sendtype, void *recvbuf, const int recvcounts[],
+						   const int rdispls[], MPI_Datatype recvtype, MPI_Comm comm)
+{
+	int ret;
+#if ENABLE_EXEC_TIMING
+	if (_profile_exec_timings)
+	{
+		int comm_size;
+		int my_comm_rank;
+		double *times = NULL;
+
+		PMPI_Comm_size(comm, &comm_size);
+		PMPI_Comm_rank(comm, &my_comm_rank);
+		PMPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+		double t_start = timestamp_now();
+		ret = PMPI_Neighbor_alltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm);
+		double t_op = timestamp_now() - t_start;
+
+		if (my_comm_rank == 0)
+		{
+			times = (double *)malloc(comm_size * sizeof(double));
+			assert(times);
+		}
+		PMPI_Gather(&t_op, 1, MPI_DOUBLE, times, 1, MPI_DOUBLE, 0, comm);
+		if (my_comm_rank == 0)
+		{
+			int jobid = get_job_id();
+			int rc = commit_timings_series(TIMING_SERIES_EXEC, comm, "neighbor_alltoallv", world_rank, my_comm_rank, jobid, times, comm_size, neighborCalls);
+			if (rc)
+			{
+				fprintf(stderr, "commit_timings() failed: %d\n", rc);
+				PMPI_Abort(MPI_COMM_WORLD, 1);
+			}
+			free(times);
+		}
+	}
+	else
+#endif // ENABLE_EXEC_TIMING
+	{
+		ret = PMPI_Neighbor_alltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm);
+	}
+	neighborCalls++;
+	return ret;
+}
+
+// Completion shims feeding the in-flight request registry. The request handle
+// is snapshotted before the PMPI call since MPI sets it to MPI_REQUEST_NULL on
+// completion.
+int MPI_Wait(MPI_Request *request, MPI_Status *status)
+{
+	MPI_Request req = (request != NULL) ? *request : MPI_REQUEST_NULL;
+	int ret = PMPI_Wait(request, status);
+	if (ret == MPI_SUCCESS)
+	{
+		request_registry_complete(req);
+	}
+	return ret;
+}
+
+int MPI_Test(MPI_Request *request, int *flag, MPI_Status *status)
+{
+	MPI_Request req = (request != NULL) ? *request : MPI_REQUEST_NULL;
+	int ret = PMPI_Test(request, flag, status);
+	if (ret == MPI_SUCCESS && flag != NULL && *flag)
+	{
+		request_registry_complete(req);
+	}
+	return ret;
+}
+
+int MPI_Waitall(int count, MPI_Request array_of_requests[], MPI_Status *array_of_statuses)
+{
+	int i;
+	int ret;
+	MPI_Request *snapshot = NULL;
+
+	if (_requests_in_flight == 0 || count <= 0 || array_of_requests == NULL)
+	{
+		return PMPI_Waitall(count, array_of_requests, array_of_statuses);
+	}
+
+	snapshot = (MPI_Request *)malloc(count * sizeof(MPI_Request));
+	assert(snapshot);
+	memcpy(snapshot, array_of_requests, count * sizeof(MPI_Request));
+	ret = PMPI_Waitall(count, array_of_requests, array_of_statuses);
+	if (ret == MPI_SUCCESS)
+	{
+		for (i = 0; i < count; i++)
+		{
+			request_registry_complete(snapshot[i]);
+		}
+	}
+	free(snapshot);
+	return ret;
+}
+
 // This is a duplicate of MPI_Finalize() just in case we face a failure or
 // if the app never calls MPI_Finalize().
 __attribute__((destructor)) void calledLast()
 {
+	flush_nonblocking_timings(MPI_COMM_NULL);
+	async_commit_fini();
+#if ENABLE_SUMMARY
+	_commit_summary();
+#endif // ENABLE_SUMMARY
+	_commit_msg_histogram();
 	_commit_data();
 	_finalize_profiling();
+	node_aggregate_finalize("alltoallv");
 }
@@ -0,0 +1,28 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef ALLTOALLW_PROFILER_H
+#define ALLTOALLW_PROFILER_H
+
+#include <stdbool.h>
+#include <assert.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "config.h"
+
+#if DEBUG
+#define DEBUG_ALLTOALLW_PROFILING(fmt, ...) \
+    fprintf(stdout, "A2AW - [%s:%d]" fmt, __FILE__, __LINE__, __VA_ARGS__)
+#else
+#define DEBUG_ALLTOALLW_PROFILING(fmt, ...) \
+    do                                      \
+    {                                       \
+    } while (0)
+#endif // DEBUG
+
+#endif // ALLTOALLW_PROFILER_H
@@ -0,0 +1,30 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef _COLLECTIVE_PROFILER_ALLTOALLW_CONFIG_H
+#define _COLLECTIVE_PROFILER_ALLTOALLW_CONFIG_H
+
+#define DEBUG (0)
+
+// A few environment variables to control a few things at runtime
+#define NUM_CALL_START_PROFILING_ENVVAR "A2A_NUM_CALL_START_PROFILING"
+#define LIMIT_ALLTOALLW_CALLS_ENVVAR "A2A_LIMIT_ALLTOALLW_CALLS_ENVVAR"
+#define A2A_COMMIT_PROFILER_DATA_AT_ENVVAR "A2A_COMMIT_PROFILER_DATA_AT"
+#define A2A_RELEASE_RESOURCES_AFTER_DATA_COMMIT_ENVVAR "A2A_RELEASE_RESOURCES_AFTER_DATA_COMMIT"
+
+#define DEFAULT_LIMIT_ALLTOALLW_CALLS (-1) // Maximum number of alltoallw calls that we profile (-1 means no limit)
+#define NUM_CALL_START_PROFILING (0)       // During which call do we start profiling? By default, the very first one. Note that once started, DEFAULT_LIMIT_ALLTOALLW_CALLS says when we stop profiling
+#define DEFAULT_TRACKED_CALLS (10)
+
+// Alltoallw uses a datatype per peer, so raw counts from different ranks are
+// not comparable. The profiler normalizes every count into bytes with the
+// per-peer datatype size before the gather, which is what makes the shared
+// count compaction, grouping and pattern machinery apply unchanged. The
+// recorded datatype size of every section is therefore 1: a "Datatype size: 1"
+// header is the flag that the counts of this library are byte-based.
+#define ALLTOALLW_COUNTS_IN_BYTES (1)
+
+#endif // _COLLECTIVE_PROFILER_ALLTOALLW_CONFIG_H
@@ -0,0 +1,879 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#include <sys/stat.h>
+#include <mpi.h>
+
+#include "alltoallw_profiler.h"
+#include "logger.h"
+#include "grouping.h"
+#include "pattern.h"
+#include "execinfo.h"
+#include "timings.h"
+#include "comm.h"
+#include "backtrace.h"
+#include "location.h"
+#include "datatype.h"
+#include "bigcounts.h"
+#include "compress.h"
+#include "node_aggregate.h"
+
+// Alltoallw takes a datatype per peer, so the raw counts of different ranks
+// are not comparable with each other: the same count can mean anything from a
+// byte to a large struct. Every count is normalized into bytes with the
+// per-peer datatype size before the gather (see config.h), after which the
+// rows behave exactly like alltoallv rows and the shared count engine -
+// compaction, grouping, pattern detection - applies unchanged. The recorded
+// datatype size is always 1, flagging byte-based counts in the output.
+#define COUNTS_ENGINE_SEND_VEC_LEN(size) (size)
+#define COUNTS_ENGINE_RECV_VEC_LEN(size) (size)
+#define COUNTS_ENGINE_DEBUG DEBUG_ALLTOALLW_PROFILING
+#include "counts_engine.h"
+
+static SRDisplNode_t *displs_head = NULL;
+static avTimingsNode_t *op_timing_exec_head = NULL;
+static avPattern_t *spatterns = NULL;
+static avPattern_t *rpatterns = NULL;
+static avCallPattern_t *call_patterns = NULL;
+
+static int world_size = -1;
+static int world_rank = -1;
+static uint64_t avCalls = 0;	   // Total number of alltoallw calls that we went through (indexed on 0, not 1)
+static uint64_t avCallsLogged = 0; // Total number of alltoallw calls for which we gathered data
+static uint64_t avCallStart = -1;  // Number of alltoallw call during which we started to gather data
+
+static uint64_t _num_call_start_profiling = NUM_CALL_START_PROFILING;
+static uint64_t _limit_av_calls = DEFAULT_LIMIT_ALLTOALLW_CALLS;
+
+// Staging buffers reused between alltoallw calls: the normalized byte rows of
+// this rank and, on communicator roots, the gathered matrices. Sized lazily
+// for the largest communicator actually profiled.
+static int *sbuf = NULL;		   // Root: gathered send byte matrix (comm_size * comm_size)
+static int *rbuf = NULL;		   // Root: gathered recv byte matrix
+static int *my_send_bytes = NULL;  // This rank's normalized send row
+static int *my_recv_bytes = NULL;  // This rank's normalized recv row
+static int staging_size = 0;	   // Communicator size the buffers are sized for
+double *op_exec_times = NULL;
+double *late_arrival_timings = NULL;
+
+static logger_t *logger = NULL;
+
+/* FORTRAN BINDINGS */
+extern int mpi_fortran_in_place_;
+#define OMPI_IS_FORTRAN_IN_PLACE(addr) \
+	(addr == (void *)&mpi_fortran_in_place_)
+extern int mpi_fortran_bottom_;
+#define OMPI_IS_FORTRAN_BOTTOM(addr) \
+	(addr == (void *)&mpi_fortran_bottom_)
+#define OMPI_INT_2_FINT(a) a
+#define OMPI_FINT_2_INT(a) a
+#define OMPI_F2C_IN_PLACE(addr) (OMPI_IS_FORTRAN_IN_PLACE(addr) ? MPI_IN_PLACE : (addr))
+#define OMPI_F2C_BOTTOM(addr) (OMPI_IS_FORTRAN_BOTTOM(addr) ? MPI_BOTTOM : (addr))
+
+static int _finalize_profiling();
+static int _commit_data();
+
+static void staging_reserve(int comm_size, int is_root)
+{
+	if (comm_size <= staging_size)
+	{
+		return;
+	}
+	my_send_bytes = (int *)realloc(my_send_bytes, comm_size * sizeof(int));
+	assert(my_send_bytes);
+	my_recv_bytes = (int *)realloc(my_recv_bytes, comm_size * sizeof(int));
+	assert(my_recv_bytes);
+	if (is_root)
+	{
+		sbuf = (int *)realloc(sbuf, comm_size * comm_size * sizeof(int));
+		assert(sbuf);
+		rbuf = (int *)realloc(rbuf, comm_size * comm_size * sizeof(int));
+		assert(rbuf);
+	}
+	staging_size = comm_size;
+}
+
+static int extract_patterns_from_counts(int *send_counts, int *recv_counts, int size)
+{
+	int i, j, num;
+	int src_ranks = 0;
+	int dst_ranks = 0;
+	int send_patterns[size + 1];
+	int recv_patterns[size + 1];
+
+	DEBUG_ALLTOALLW_PROFILING("Extracting patterns\n");
+
+	for (i = 0; i < size; i++)
+	{
+		send_patterns[i] = 0;
+		recv_patterns[i] = 0;
+	}
+
+	num = 0;
+	for (i = 0; i < size; i++)
+	{
+		dst_ranks = 0;
+		src_ranks = 0;
+		for (j = 0; j < size; j++)
+		{
+			if (send_counts[num] != 0)
+			{
+				dst_ranks++;
+			}
+			if (recv_counts[num] != 0)
+			{
+				src_ranks++;
+			}
+			num++;
+		}
+		if (dst_ranks > 0)
+		{
+			send_patterns[dst_ranks - 1]++;
+		}
+		if (src_ranks > 0)
+		{
+			recv_patterns[src_ranks - 1]++;
+		}
+	}
+
+	for (i = 0; i < size; i++)
+	{
+		if (send_patterns[i] != 0)
+		{
+#if COMMSIZE_BASED_PATTERNS
+			spatterns = add_pattern_for_size(spatterns, send_patterns[i], i + 1, size);
+#else
+			spatterns = add_pattern(spatterns, send_patterns[i], i + 1);
+#endif // COMMSIZE_BASED_PATTERNS
+		}
+	}
+	for (i = 0; i < size; i++)
+	{
+		if (recv_patterns[i] != 0)
+		{
+#if COMMSIZE_BASED_PATTERNS
+			rpatterns = add_pattern_for_size(rpatterns, recv_patterns[i], i + 1, size);
+#else
+			rpatterns = add_pattern(rpatterns, recv_patterns[i], i + 1);
+#endif // COMMSIZE_BASED_PATTERNS
+		}
+	}
+
+	return 0;
+}
+
+char *alltoallw_get_full_filename(int ctxt, char *id, int jobid, int world_rank)
+{
+	char *filename = NULL;
+	int size;
+	char *dir = get_output_dir();
+
+	if (ctxt == MAIN_CTX)
+	{
+		if (id == NULL)
+		{
+			_asprintf(filename, size, "profile_alltoallw_job%d.rank%d.md", jobid, world_rank);
+			assert(size > 0);
+		}
+		else
+		{
+			_asprintf(filename, size, "%s.job%d.rank%d.md", id, jobid, world_rank);
+			assert(size > 0);
+		}
+	}
+	else
+	{
+		char *context = ctx_to_string(ctxt);
+		_asprintf(filename, size, "%s-%s.job%d.rank%d.txt", context, id, jobid, world_rank);
+		assert(size > 0);
+	}
+
+	if (dir != NULL)
+	{
+		char *path = NULL;
+		_asprintf(path, size, "%s/%s", dir, filename);
+		assert(size > 0);
+		free(filename);
+		return path;
+	}
+
+	return filename;
+}
+
+int extract_call_patterns_from_counts(int callID, int *send_counts, int *recv_counts, int size)
+{
+	avCallPattern_t *cp = extract_call_patterns(callID, send_counts, recv_counts, size);
+	if (call_patterns == NULL)
+	{
+		call_patterns = cp;
+	}
+	else
+	{
+		avCallPattern_t *existing_cp = lookup_call_patterns(call_patterns);
+		if (existing_cp == NULL)
+		{
+			avCallPattern_t *ptr = call_patterns;
+			while (ptr->next != NULL)
+			{
+				ptr = ptr->next;
+			}
+			ptr->next = cp;
+		}
+		else
+		{
+			existing_cp->n_calls++;
+			free_patterns(cp->spatterns);
+			free_patterns(cp->rpatterns);
+			free(cp);
+		}
+	}
+
+	return 0;
+}
+
+static int commit_pattern_from_counts(int callID, int *send_counts, int *recv_counts, int size)
+{
+#if TRACK_PATTERNS_ON_CALL_BASIS
+	return extract_call_patterns_from_counts(callID, send_counts, recv_counts, size);
+#else
+	return extract_patterns_from_counts(send_counts, recv_counts, size);
+#endif
+}
+
+static void _save_patterns(FILE *fh, avPattern_t *p, char *ctx)
+{
+	avPattern_t *ptr = p;
+	while (ptr != NULL)
+	{
+#if COMMSIZE_BASED_PATTERNS || TRACK_PATTERNS_ON_CALL_BASIS
+		fprintf(fh, "During %" PRIu64 " alltoallw calls, %d ranks %s %d other ranks; comm size: %d\n", ptr->n_calls, ptr->n_ranks, ctx, ptr->n_peers, ptr->comm_size);
+#else
+		fprintf(fh, "During %" PRIu64 " alltoallw calls, %d ranks %s %d other ranks\n", ptr->n_calls, ptr->n_ranks, ctx, ptr->n_peers);
+#endif // COMMSIZE_BASED_PATTERNS
+		ptr = ptr->next;
+	}
+}
+
+static void save_call_patterns(int uniqueID)
+{
+	char *filename = NULL;
+	int size;
+
+	DEBUG_ALLTOALLW_PROFILING("Saving call patterns...\n");
+
+	if (getenv(OUTPUT_DIR_ENVVAR))
+	{
+		_asprintf(filename, size, "%s/call-patterns-rank%d.txt", getenv(OUTPUT_DIR_ENVVAR), world_rank);
+	}
+	else
+	{
+		_asprintf(filename, size, "call-patterns-rank%d.txt", world_rank);
+	}
+	assert(size > 0);
+
+	FILE *fh = profile_fopen(filename, "w", "patterns");
+	assert(fh);
+
+	avCallPattern_t *ptr = call_patterns;
+	while (ptr != NULL)
+	{
+		fprintf(fh, "For %" PRIu64 " call(s):\n", ptr->n_calls);
+		_save_patterns(fh, ptr->spatterns, "sent to");
+		_save_patterns(fh, ptr->rpatterns, "recv'd from");
+		ptr = ptr->next;
+	}
+	fclose(fh);
+	free(filename);
+}
+
+static void save_patterns(int world_rank)
+{
+	char *spatterns_filename = NULL;
+	char *rpatterns_filename = NULL;
+	int size;
+
+	DEBUG_ALLTOALLW_PROFILING("Saving patterns...\n");
+
+	if (getenv(OUTPUT_DIR_ENVVAR))
+	{
+		_asprintf(spatterns_filename, size, "%s/patterns-send-rank%d.txt", getenv(OUTPUT_DIR_ENVVAR), world_rank);
+		assert(size > 0);
+		_asprintf(rpatterns_filename, size, "%s/patterns-recv-rank%d.txt", getenv(OUTPUT_DIR_ENVVAR), world_rank);
+		assert(size > 0);
+	}
+	else
+	{
+		_asprintf(spatterns_filename, size, "patterns-send-rank%d.txt", world_rank);
+		assert(size > 0);
+		_asprintf(rpatterns_filename, size, "patterns-recv-rank%d.txt", world_rank);
+		assert(size > 0);
+	}
+
+	FILE *spatterns_fh = profile_fopen(spatterns_filename, "w", "patterns");
+	assert(spatterns_fh);
+	FILE *rpatterns_fh = profile_fopen(rpatterns_filename, "w", "patterns");
+	assert(rpatterns_fh);
+
+	_save_patterns(spatterns_fh, spatterns, "sent to");
+	_save_patterns(rpatterns_fh, rpatterns, "recv'd from");
+
+	fclose(spatterns_fh);
+	fclose(rpatterns_fh);
+	free(spatterns_filename);
+	free(rpatterns_filename);
+}
+
+// Process identity is immutable for the life of the process: the hostname -
+// whose lookup can go through NSS - and the PID are resolved once at init and
+// reused by every per-call and per-logger path.
+static char _hostname[256] = {0};
+static int _pid = 0;
+
+static void init_process_identity(void)
+{
+	if (_pid == 0)
+	{
+		gethostname(_hostname, sizeof(_hostname));
+		_pid = getpid();
+	}
+}
+
+int _mpi_init(int *argc, char ***argv)
+{
+	int ret;
+
+	char *num_call_envvar = getenv(NUM_CALL_START_PROFILING_ENVVAR);
+	if (num_call_envvar != NULL)
+	{
+		_num_call_start_profiling = atoi(num_call_envvar);
+	}
+
+	char *limit_a2aw_calls = getenv(LIMIT_ALLTOALLW_CALLS_ENVVAR);
+	if (limit_a2aw_calls != NULL)
+	{
+		_limit_av_calls = atoi(limit_a2aw_calls);
+	}
+
+	ret = PMPI_Init(argc, argv);
+	init_process_identity();
+
+	MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+	// We do not know what rank will gather alltoallw data since alltoallw can
+	// be called on any communicator
+	int jobid = get_job_id();
+	logger_config_t alltoallw_logger_cfg;
+	alltoallw_logger_cfg.get_full_filename = &alltoallw_get_full_filename;
+	alltoallw_logger_cfg.collective_name = "Alltoallw";
+	alltoallw_logger_cfg.limit_number_calls = DEFAULT_LIMIT_ALLTOALLW_CALLS;
+	logger = logger_init(jobid, world_rank, world_size, &alltoallw_logger_cfg);
+	assert(logger);
+
+#if ENABLE_EXEC_TIMING
+	op_exec_times = (double *)malloc(world_size * sizeof(double));
+	assert(op_exec_times);
+#endif // ENABLE_EXEC_TIMING
+#if ENABLE_LATE_ARRIVAL_TIMING
+	late_arrival_timings = (double *)malloc(world_size * sizeof(double));
+	assert(late_arrival_timings);
+#endif // ENABLE_LATE_ARRIVAL_TIMING
+
+	// Make sure we do not create an articial imbalance between ranks.
+	MPI_Barrier(MPI_COMM_WORLD);
+
+	return ret;
+}
+
+int MPI_Finalize()
+{
+	_commit_data();
+	_finalize_profiling();
+	node_aggregate_finalize("alltoallw");
+	return PMPI_Finalize();
+}
+
+int MPI_Init(int *argc, char ***argv)
+{
+	return _mpi_init(argc, argv);
+}
+
+int mpi_init_(MPI_Fint *ierr)
+{
+	int c_ierr;
+	int argc = 0;
+	char **argv = NULL;
+
+	c_ierr = _mpi_init(&argc, &argv);
+	if (NULL != ierr)
+		*ierr = OMPI_INT_2_FINT(c_ierr);
+}
+
+static int _release_pattern_resources()
+{
+	free_patterns(rpatterns);
+	rpatterns = NULL;
+	free_patterns(spatterns);
+	spatterns = NULL;
+	patterns_cleanup();
+
+	return 0;
+}
+
+static int _release_profiling_resources()
+{
+#if ENABLE_RAW_DATA
+	counts_engine_release();
+#endif // ENABLE_RAW_DATA
+
+	while (op_timing_exec_head != NULL)
+	{
+		avTimingsNode_t *t_ptr = op_timing_exec_head->next;
+		free(op_timing_exec_head->timings);
+		free(op_timing_exec_head);
+		op_timing_exec_head = t_ptr;
+	}
+
+	_release_pattern_resources();
+
+	// Free all the memory allocated for profiling purposes
+	if (rbuf != NULL)
+	{
+		free(rbuf);
+		rbuf = NULL;
+	}
+	if (sbuf != NULL)
+	{
+		free(sbuf);
+		sbuf = NULL;
+	}
+	if (my_send_bytes != NULL)
+	{
+		free(my_send_bytes);
+		my_send_bytes = NULL;
+	}
+	if (my_recv_bytes != NULL)
+	{
+		free(my_recv_bytes);
+		my_recv_bytes = NULL;
+	}
+	staging_size = 0;
+	if (op_exec_times != NULL)
+	{
+		free(op_exec_times);
+		op_exec_times = NULL;
+	}
+	if (late_arrival_timings != NULL)
+	{
+		free(late_arrival_timings);
+		late_arrival_timings = NULL;
+	}
+	return 0;
+}
+
+static int _finalize_profiling()
+{
+	logger_fini(&logger);
+	_release_profiling_resources();
+}
+
+static int _commit_data()
+{
+	log_profiling_data(logger, avCalls, avCallStart, avCallsLogged, counts_head, displs_head, op_timing_exec_head);
+
+#if ENABLE_PATTERN_DETECTION && !TRACK_PATTERNS_ON_CALL_BASIS
+	save_patterns(world_rank);
+#endif // ENABLE_PATTERN_DETECTION && !TRACK_PATTERNS_ON_CALL_BASIS
+
+#if ENABLE_PATTERN_DETECTION && TRACK_PATTERNS_ON_CALL_BASIS
+	save_call_patterns(world_rank);
+#endif // ENABLE_PATTERN_DETECTION && TRACK_PATTERNS_ON_CALL_BASIS
+
+	return 0;
+}
+
+int _mpi_alltoallw(const void *sendbuf, const int sendcounts[], const int sdispls[], const MPI_Datatype sendtypes[],
+				   void *recvbuf, const int recvcounts[], const int rdispls[], const MPI_Datatype recvtypes[], MPI_Comm comm)
+{
+	int comm_size;
+	int i;
+	int ret;
+	bool need_profile = true;
+	int my_comm_rank;
+	char *collective_name = "alltoallw";
+
+	MPI_Comm_size(comm, &comm_size);
+	MPI_Comm_rank(comm, &my_comm_rank);
+	MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+#if ENABLE_BACKTRACE
+	if (my_comm_rank == 0)
+	{
+		void *array[16];
+		size_t _s;
+
+		// Symbol resolution is cached on the raw return addresses: see
+		// insert_caller_data_addrs(), backtrace_symbols() only runs once per
+		// unique trace.
+		_s = backtrace(array, 16);
+		insert_caller_data_addrs(collective_name, array, _s, comm, my_comm_rank, world_rank, avCalls);
+	}
+#endif // ENABLE_BACKTRACE
+
+	// Check if we need to profile that specific call
+	if (avCalls < _num_call_start_profiling)
+	{
+		need_profile = false;
+	}
+	else
+	{
+		if (-1 != _limit_av_calls && avCallsLogged >= _limit_av_calls)
+		{
+			need_profile = false;
+		}
+	}
+
+	if (need_profile)
+	{
+		if (avCallStart == -1)
+		{
+			avCallStart = avCalls;
+		}
+
+#if ENABLE_LATE_ARRIVAL_TIMING
+		double t_barrier_start = MPI_Wtime();
+		PMPI_Barrier(comm);
+		double t_barrier_end = MPI_Wtime();
+#endif // ENABLE_LATE_ARRIVAL_TIMING
+
+#if ENABLE_EXEC_TIMING
+		double t_start = MPI_Wtime();
+#endif // ENABLE_EXEC_TIMING
+
+		ret = PMPI_Alltoallw(sendbuf, sendcounts, sdispls, sendtypes, recvbuf, recvcounts, rdispls, recvtypes, comm);
+
+#if ENABLE_EXEC_TIMING
+		double t_end = MPI_Wtime();
+		double t_op = t_end - t_start;
+#endif // ENABLE_EXEC_TIMING
+
+#if ENABLE_LATE_ARRIVAL_TIMING
+		double t_arrival = t_barrier_end - t_barrier_start;
+#endif // ENABLE_LATE_ARRIVAL_TIMING
+
+		staging_reserve(comm_size, my_comm_rank == 0);
+
+		// Normalize the per-peer counts into bytes before the gather: each
+		// rank resolves its own datatype handles (they are only meaningful
+		// locally), so the gathered matrices are directly comparable rows.
+		for (i = 0; i < comm_size; i++)
+		{
+			my_send_bytes[i] = sendcounts[i] * cached_type_size(sendtypes[i]);
+			my_recv_bytes[i] = recvcounts[i] * cached_type_size(recvtypes[i]);
+		}
+		MPI_Gather(my_send_bytes, comm_size, MPI_INT, sbuf, comm_size, MPI_INT, 0, comm);
+		MPI_Gather(my_recv_bytes, comm_size, MPI_INT, rbuf, comm_size, MPI_INT, 0, comm);
+
+#if ENABLE_EXEC_TIMING
+		MPI_Gather(&t_op, 1, MPI_DOUBLE, op_exec_times, 1, MPI_DOUBLE, 0, comm);
+#endif // ENABLE_EXEC_TIMING
+
+#if ENABLE_LATE_ARRIVAL_TIMING
+		MPI_Gather(&t_arrival, 1, MPI_DOUBLE, late_arrival_timings, 1, MPI_DOUBLE, 0, comm);
+#endif // ENABLE_LATE_ARRIVAL_TIMING
+
+#if ENABLE_LOCATION_TRACKING
+		// Locations are immutable for the life of a communicator: gather them
+		// only the first time the communicator is profiled, afterwards just
+		// reference the cached record by communicator ID.
+		comm_data_t *location_comm_data = NULL;
+		if (lookup_comm_data(comm, &location_comm_data) != 0)
+		{
+			uint32_t location_comm_id;
+			add_comm(comm, world_rank, my_comm_rank, &location_comm_id);
+			lookup_comm_data(comm, &location_comm_data);
+		}
+		assert(location_comm_data);
+		if (location_comm_data->location_tracked == 0)
+		{
+			int *pids = NULL;
+			int *world_comm_ranks = NULL;
+			char *hostnames = NULL;
+			if (my_comm_rank == 0)
+			{
+				pids = (int *)malloc(comm_size * sizeof(int));
+				assert(pids);
+				world_comm_ranks = (int *)malloc(comm_size * sizeof(int));
+				assert(world_comm_ranks);
+				hostnames = (char *)malloc(256 * comm_size * sizeof(char));
+				assert(hostnames);
+			}
+
+			MPI_Gather(&_pid, 1, MPI_INT, pids, 1, MPI_INT, 0, comm);
+			MPI_Gather(&world_rank, 1, MPI_INT, world_comm_ranks, 1, MPI_INT, 0, comm);
+			MPI_Gather(_hostname, 256, MPI_CHAR, hostnames, 256, MPI_CHAR, 0, comm);
+			if (my_comm_rank == 0)
+			{
+				int rc = commit_rank_locations(collective_name, comm, comm_size, world_rank, my_comm_rank, pids, world_comm_ranks, hostnames, avCalls);
+				if (rc)
+				{
+					fprintf(stderr, "save_rank_locations() failed: %d", rc);
+					MPI_Abort(MPI_COMM_WORLD, 1);
+				}
+			}
+			location_comm_data->location_tracked = 1;
+		}
+		else if (my_comm_rank == 0)
+		{
+			commit_rank_locations_by_id(collective_name, comm, avCalls);
+		}
+#endif // ENABLE_LOCATION_TRACKING
+
+		if (my_comm_rank == 0)
+		{
+#if ENABLE_RAW_DATA
+			// The rows are already byte-normalized; the recorded datatype
+			// size of 1 is the byte-based flag of this library's output.
+			if (insert_sendrecv_count_data(sbuf, rbuf, comm_size, 1, 1, avCalls))
+			{
+				fprintf(stderr, "[%s:%d][ERROR] unable to insert send/recv counts\n", __FILE__, __LINE__);
+				MPI_Abort(MPI_COMM_WORLD, 1);
+			}
+#endif // ENABLE_RAW_DATA
+
+#if ENABLE_PATTERN_DETECTION
+			commit_pattern_from_counts(avCalls, sbuf, rbuf, comm_size);
+#endif
+
+#if ENABLE_EXEC_TIMING
+			int jobid = get_job_id();
+			int rc = commit_timings(comm, collective_name, world_rank, my_comm_rank, jobid, op_exec_times, comm_size, avCalls);
+			if (rc)
+			{
+				fprintf(stderr, "commit_timings() failed: %d\n", rc);
+				MPI_Abort(MPI_COMM_WORLD, 1);
+			}
+#endif // ENABLE_EXEC_TIMING
+
+#if ENABLE_LATE_ARRIVAL_TIMING
+			int jobid = get_job_id();
+			int rc = commit_timings(comm, collective_name, world_rank, my_comm_rank, jobid, late_arrival_timings, comm_size, avCalls);
+			if (rc)
+			{
+				fprintf(stderr, "commit_timings() failed: %d\n", rc);
+				MPI_Abort(MPI_COMM_WORLD, 1);
+			}
+#endif // ENABLE_LATE_ARRIVAL_TIMING
+			avCallsLogged++;
+		} // end of: if (my_comm_rank == 0)
+	} // end of: if (need_profile)
+	else
+	{
+		// No need to profile that call but we still count the number of alltoallw calls
+		ret = PMPI_Alltoallw(sendbuf, sendcounts, sdispls, sendtypes, recvbuf, recvcounts, rdispls, recvtypes, comm);
+	}
+
+#if SYNC
+	// We sync all the ranks again to make sure that rank 0, who does some calculations,
+	// does not artificially fall behind.
+	MPI_Barrier(comm);
+#endif
+
+	char *need_data_commit_str = getenv(A2A_COMMIT_PROFILER_DATA_AT_ENVVAR);
+	char *need_to_free_data = getenv(A2A_RELEASE_RESOURCES_AFTER_DATA_COMMIT_ENVVAR);
+
+	if (need_data_commit_str != NULL)
+	{
+		int targetCallID = atoi(need_data_commit_str);
+		if (avCalls == targetCallID)
+		{
+			_commit_data();
+		}
+	}
+
+	if (need_to_free_data != NULL && strncmp(need_to_free_data, "0", 1) != 0)
+	{
+		_release_profiling_resources();
+	}
+
+	// avCalls is the absolute number of calls that the rank is dealing with
+	avCalls++;
+
+	return ret;
+}
+
+// The datatype cache keys on the handle, which the MPI library may recycle
+// once the type is freed. With a datatype per peer, alltoallw leans on the
+// cache much harder than the other collectives.
+int MPI_Type_free(MPI_Datatype *type)
+{
+	if (type != NULL)
+	{
+		datatype_cache_invalidate(*type);
+	}
+	return PMPI_Type_free(type);
+}
+
+int MPI_Comm_free(MPI_Comm *comm)
+{
+	// Release the per-communicator profiling state: close the timing loggers
+	// early (their content is complete once the communicator goes away) and
+	// drop the handle mapping so a recycled handle gets a fresh record.
+	comm_data_t *comm_data = NULL;
+	if (lookup_comm_data(*comm, &comm_data) == 0)
+	{
+		int series;
+		for (series = 0; series < NUM_TIMING_SERIES; series++)
+		{
+			if (comm_data->timing_logger[series] != NULL)
+			{
+				comm_timing_logger_t *timing_logger = (comm_timing_logger_t *)comm_data->timing_logger[series];
+				fini_time_tracking(&timing_logger);
+			}
+		}
+		drop_comm(*comm);
+	}
+	return PMPI_Comm_free(comm);
+}
+
+// Register a newly created communicator eagerly so the first profiled
+// collective on it does not pay for the registration.
+static void register_new_comm(MPI_Comm newcomm)
+{
+	uint32_t comm_id;
+	if (newcomm == MPI_COMM_NULL || lookup_comm(newcomm, &comm_id) == 0)
+	{
+		return;
+	}
+	int my_comm_rank;
+	PMPI_Comm_rank(newcomm, &my_comm_rank);
+	add_comm(newcomm, world_rank, my_comm_rank, &comm_id);
+}
+
+int MPI_Comm_dup(MPI_Comm comm, MPI_Comm *newcomm)
+{
+	int ret = PMPI_Comm_dup(comm, newcomm);
+	if (ret == MPI_SUCCESS)
+	{
+		register_new_comm(*newcomm);
+	}
+	return ret;
+}
+
+int MPI_Comm_split(MPI_Comm comm, int color, int key, MPI_Comm *newcomm)
+{
+	int ret = PMPI_Comm_split(comm, color, key, newcomm);
+	if (ret == MPI_SUCCESS)
+	{
+		register_new_comm(*newcomm);
+	}
+	return ret;
+}
+
+int MPI_Comm_split_type(MPI_Comm comm, int split_type, int key, MPI_Info info, MPI_Comm *newcomm)
+{
+	int ret = PMPI_Comm_split_type(comm, split_type, key, info, newcomm);
+	if (ret == MPI_SUCCESS)
+	{
+		register_new_comm(*newcomm);
+	}
+	return ret;
+}
+
+int MPI_Alltoallw(const void *sendbuf, const int sendcounts[], const int sdispls[], const MPI_Datatype sendtypes[],
+				  void *recvbuf, const int recvcounts[], const int rdispls[], const MPI_Datatype recvtypes[], MPI_Comm comm)
+{
+	return _mpi_alltoallw(sendbuf, sendcounts, sdispls, sendtypes, recvbuf, recvcounts, rdispls, recvtypes, comm);
+}
+
+#if defined(MPI_VERSION) && MPI_VERSION >= 4
+// MPI-4 large-count variant. When every count and displacement fits in an int
+// - by far the common case - the call is narrowed and goes through the regular
+// profiled path; otherwise the exact 64-bit count rows are saved to a per-rank
+// sidecar file and the operation runs unprofiled.
+int MPI_Alltoallw_c(const void *sendbuf, const MPI_Count sendcounts[], const MPI_Aint sdispls[],
+					const MPI_Datatype sendtypes[], void *recvbuf, const MPI_Count recvcounts[],
+					const MPI_Aint rdispls[], const MPI_Datatype recvtypes[], MPI_Comm comm)
+{
+	int comm_size;
+	int ret;
+
+	PMPI_Comm_size(comm, &comm_size);
+
+	if (large_counts_fit(sendcounts, comm_size) && large_counts_fit(recvcounts, comm_size) &&
+		large_displs_fit(sdispls, comm_size) && large_displs_fit(rdispls, comm_size))
+	{
+		int *narrow_sendcounts = (int *)malloc(4 * comm_size * sizeof(int));
+		assert(narrow_sendcounts);
+		int *narrow_sdispls = narrow_sendcounts + comm_size;
+		int *narrow_recvcounts = narrow_sendcounts + 2 * comm_size;
+		int *narrow_rdispls = narrow_sendcounts + 3 * comm_size;
+		narrow_large_counts(sendcounts, narrow_sendcounts, comm_size);
+		narrow_large_displs(sdispls, narrow_sdispls, comm_size);
+		narrow_large_counts(recvcounts, narrow_recvcounts, comm_size);
+		narrow_large_displs(rdispls, narrow_rdispls, comm_size);
+		ret = _mpi_alltoallw(sendbuf, narrow_sendcounts, narrow_sdispls, sendtypes,
+							 recvbuf, narrow_recvcounts, narrow_rdispls, recvtypes, comm);
+		free(narrow_sendcounts);
+		return ret;
+	}
+
+	PMPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+	save_large_counts("alltoallw", world_rank, avCalls, sendcounts, comm_size, recvcounts, comm_size);
+	ret = PMPI_Alltoallw_c(sendbuf, sendcounts, sdispls, sendtypes, recvbuf, recvcounts, rdispls, recvtypes, comm);
+	avCalls++;
+	return ret;
+}
+#endif // MPI_VERSION >= 4
+
+void mpi_alltoallw_(void *sendbuf, MPI_Fint *sendcounts, MPI_Fint *sdispls, MPI_Fint *sendtypes,
+					void *recvbuf, MPI_Fint *recvcounts, MPI_Fint *rdispls, MPI_Fint *recvtypes,
+					MPI_Fint *comm, MPI_Fint *ierr)
+{
+	int c_ierr;
+	int i, size;
+	MPI_Comm c_comm;
+
+	c_comm = PMPI_Comm_f2c(*comm);
+	PMPI_Comm_size(c_comm, &size);
+
+	// Unlike the other collectives, the datatype arguments are arrays and
+	// every handle has to be converted.
+	MPI_Datatype *c_sendtypes = (MPI_Datatype *)malloc(2 * size * sizeof(MPI_Datatype));
+	assert(c_sendtypes);
+	MPI_Datatype *c_recvtypes = c_sendtypes + size;
+	for (i = 0; i < size; i++)
+	{
+		c_sendtypes[i] = PMPI_Type_f2c(sendtypes[i]);
+		c_recvtypes[i] = PMPI_Type_f2c(recvtypes[i]);
+	}
+
+	sendbuf = (char *)OMPI_F2C_IN_PLACE(sendbuf);
+	sendbuf = (char *)OMPI_F2C_BOTTOM(sendbuf);
+	recvbuf = (char *)OMPI_F2C_BOTTOM(recvbuf);
+
+	c_ierr = MPI_Alltoallw(sendbuf,
+						   (const int *)sendcounts,
+						   (const int *)sdispls,
+						   c_sendtypes,
+						   recvbuf,
+						   (const int *)recvcounts,
+						   (const int *)rdispls,
+						   c_recvtypes, c_comm);
+	free(c_sendtypes);
+	if (NULL != ierr)
+		*ierr = OMPI_INT_2_FINT(c_ierr);
+}
+
+// This is a duplicate of MPI_Finalize() just in case we face a failure or
+// if the app never calls MPI_Finalize().
+void __attribute__((destructor)) calledLast();
+void calledLast()
+{
+	_commit_data();
+	_finalize_profiling();
+	node_aggregate_finalize("alltoallw");
+}
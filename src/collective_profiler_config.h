@@ -14,6 +14,18 @@
 // A few environment variables to control a few things at runtime
 #define MSG_SIZE_THRESHOLD_ENVVAR "MSG_SIZE_THRESHOLD" // Name of the environment variable to change the value used to differentiate small and large messages
 #define OUTPUT_DIR_ENVVAR "A2A_PROFILING_OUTPUT_DIR"   // Name of the environment variable to specify where output files will be created
+#define PROFILE_BINARY_FORMAT_ENVVAR "COLLECTIVE_PROFILER_BINARY_FORMAT" // When set to 1, counts are committed in the binary profile format (see DATA_FORMAT.md)
+#define A2A_COMPRESS_ENVVAR "A2A_COMPRESS"                                  // Comma-separated list of output classes to compress ("counts", "timings", or "all"); outputs gain a .gz suffix
+#define A2A_NODE_AGGREGATION_ENVVAR "A2A_NODE_AGGREGATION"                  // When set, per-rank profile outputs are merged into one deduplicated file per node at finalize time
+#define A2A_SINGLE_FILE_ENVVAR "A2A_SINGLE_FILE"                              // When set, the whole job writes one shared, self-indexed profile file with collective MPI-IO
+#define COMMIT_THREADS_ENVVAR "A2A_COMMIT_THREADS" // Number of threads used to render counter data sets at commit time (default: number of online cores)
+#define TIMINGS_FLUSH_THRESHOLD_ENVVAR "COLLECTIVE_PROFILER_TIMINGS_FLUSH_THRESHOLD" // Number of buffered timing values that triggers a flush of a timing file
+#define TIMINGS_STATS_ENVVAR "COLLECTIVE_PROFILER_TIMINGS_STATS" // When set to 1, only online per-rank timing aggregates are kept and written at finalize
+#define BUFFCONTENT_HASH_ENVVAR "COLLECTIVE_PROFILER_BUFFCONTENT_HASH" // Digest engine for buffer-content capture: "xxh64" for the fast non-cryptographic hash, anything else for SHA256
+#define BUFFCONTENT_PIPELINE_ENVVAR "COLLECTIVE_PROFILER_BUFFCONTENT_PIPELINE" // When set to 1, buffer-content capture is double-buffered and processed by a worker thread
+
+#define DEFAULT_TIMINGS_FLUSH_THRESHOLD (131072) // Buffered timing values per communicator before flushing (1 MiB of doubles)
+#define TIMINGS_HISTOGRAM_BINS (32) // Number of log-scale bins of the timing histogram in statistics mode
 
 #ifndef FORMAT_VERSION
 #define FORMAT_VERSION (0)
@@ -63,6 +75,13 @@
 #define ENABLE_COMPARE_DATA_VALIDATION (0)
 #endif // ENABLE_COMPARE_DATA_VALIDATION
 
+// Switch to enable/disable the lightweight summary mode: per-rank byte totals
+// accumulated locally (no count gather, constant memory) and collected once at
+// finalize. Meant for very large runs where full count matrices are overkill.
+#ifndef ENABLE_SUMMARY
+#define ENABLE_SUMMARY (0)
+#endif // ENABLE_SUMMARY
+
 // A few switches that are less commonly used by users and that cannot be set a compiling time from the compiler command
 #define ENABLE_LIVE_GROUPING (0)         // Switch to enable/disable live grouping (can be very time consuming)
 #define ENABLE_POSTMORTEM_GROUPING (0)   // Switch to enable/disable post-mortem grouping analysis (when enabled, data will be saved to a file)
@@ -75,6 +94,9 @@
 
 #define MAX_TRACKED_RANKS (1024)
 
+#define COUNTS_SPARSE_MIN_VEC_LEN (64)  // Count rows shorter than this are always stored dense
+#define COUNTS_SPARSE_DENSITY_DENOM (4) // A row is stored as sparse (peer, count) pairs when its nonzeros <= vec_len / this
+
 #define VALIDATION_THRESHOLD (1) // The lower, the less validation data
 
 #include "alltoallv/config.h"
@@ -0,0 +1,76 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#include <assert.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define ARENA_ALIGNMENT (16)
+#define ARENA_DEFAULT_BLOCK_SIZE (1 << 20)
+
+static size_t arena_align(size_t size)
+{
+    return (size + (ARENA_ALIGNMENT - 1)) & ~((size_t)ARENA_ALIGNMENT - 1);
+}
+
+static arena_block_t *arena_new_block(arena_t *arena, size_t min_size)
+{
+    size_t block_size = arena->default_block_size;
+    if (block_size == 0)
+    {
+        block_size = ARENA_DEFAULT_BLOCK_SIZE;
+    }
+    if (block_size < min_size)
+    {
+        block_size = min_size;
+    }
+
+    arena_block_t *block = (arena_block_t *)malloc(sizeof(arena_block_t) + block_size);
+    assert(block);
+    block->size = block_size;
+    block->used = 0;
+    block->next = arena->blocks;
+    arena->blocks = block;
+    return block;
+}
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+    size = arena_align(size);
+    arena_block_t *block = arena->blocks;
+    if (block == NULL || block->used + size > block->size)
+    {
+        block = arena_new_block(arena, size);
+    }
+
+    void *ptr = (char *)(block + 1) + block->used;
+    block->used += size;
+    return ptr;
+}
+
+void *arena_grow(arena_t *arena, void *old, size_t old_size, size_t new_size)
+{
+    assert(new_size >= old_size);
+    void *ptr = arena_alloc(arena, new_size);
+    if (old != NULL && old_size > 0)
+    {
+        memcpy(ptr, old, old_size);
+    }
+    return ptr;
+}
+
+void arena_release(arena_t *arena)
+{
+    arena_block_t *block = arena->blocks;
+    while (block != NULL)
+    {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+}
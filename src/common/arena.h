@@ -0,0 +1,52 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef COLLECTIVE_PROFILER_ARENA_H
+#define COLLECTIVE_PROFILER_ARENA_H
+
+#include <stdlib.h>
+
+// Simple arena allocator for profiler bookkeeping structures. Objects are
+// bump-allocated out of large blocks and are never freed individually: the
+// whole arena is released in one pass at finalize (or when the profiler is
+// asked to drop its resources mid-run). This keeps the hot insertion paths
+// away from per-object malloc/realloc/free and avoids the heap fragmentation
+// that per-node allocation causes on long runs.
+
+typedef struct arena_block
+{
+    struct arena_block *next;
+    size_t size; // Usable bytes in this block (excluding this header)
+    size_t used; // Bytes already handed out
+} arena_block_t;
+
+typedef struct arena
+{
+    arena_block_t *blocks;     // Head is the block currently allocated from
+    size_t default_block_size; // Size of new blocks (allocations larger than this get their own block)
+} arena_t;
+
+// Arenas are statically initializable: arena_t a = ARENA_INITIALIZER(1 << 20);
+#define ARENA_INITIALIZER(_block_size)     \
+    {                                      \
+        NULL, (_block_size)                \
+    }
+
+// Allocate <size> bytes from the arena. Memory is suitably aligned for any
+// standard type and is not zeroed. Never returns NULL (asserts on OOM, like
+// the rest of the profiler's allocation paths).
+void *arena_alloc(arena_t *arena, size_t size);
+
+// Grow an array previously obtained from the arena: allocates <new_size>
+// bytes and copies the first <old_size> bytes over. The old storage stays in
+// the arena until release (the usual arena trade-off).
+void *arena_grow(arena_t *arena, void *old, size_t old_size, size_t new_size);
+
+// Free every block at once. The arena remains usable: the next allocation
+// simply starts a new block.
+void arena_release(arena_t *arena);
+
+#endif // COLLECTIVE_PROFILER_ARENA_H
@@ -4,18 +4,24 @@
  * See LICENSE.txt for license information
  ************************************************************************/
 
+#define _GNU_SOURCE // dladdr
+
 #include <sys/stat.h>
 #include <stdbool.h>
+#include <dlfcn.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <execinfo.h>
+
 #include "backtrace.h"
 #include "collective_profiler_config.h"
 #include "common_utils.h"
 #include "comm.h"
+#include "hash.h"
 #include "format.h"
 
 #include "mpi.h"
@@ -24,6 +30,23 @@ backtrace_logger_t *trace_loggers_head = NULL;
 backtrace_logger_t *trace_loggers_tail = NULL;
 uint64_t trace_id = 0;
 
+// Cache keyed on the raw return-address array coming out of backtrace(): the
+// same few call sites produce the same addresses over and over, so on a hit we
+// skip backtrace_symbols() entirely and go straight to the cached logger.
+// Symbols are resolved only once per unique trace, at first insertion.
+#define TRACE_CACHE_BUCKETS (64)
+
+typedef struct trace_cache_entry
+{
+    uint64_t hash;
+    void **addrs;
+    size_t trace_size;
+    backtrace_logger_t *logger;
+    struct trace_cache_entry *next;
+} trace_cache_entry_t;
+
+static trace_cache_entry_t *trace_cache[TRACE_CACHE_BUCKETS];
+
 static inline void _write_backtrace_info(FILE *f)
 {
     assert(f);
@@ -64,6 +87,12 @@ int write_backtrace_to_file(backtrace_logger_t *logger)
     assert(logger);
     assert(logger->fd);
     _write_backtrace_info(logger->fd);
+    if (logger->key != 0)
+    {
+        // Feed this key to A2A_FILTER_CALLSITES to confine profiling to this
+        // call site (see comm_filter.h).
+        fprintf(logger->fd, "Call-site key: 0x%016" PRIx64 "\n", logger->key);
+    }
 
     uint64_t i;
     fprintf(logger->fd, "\n# Trace\n\n");
@@ -77,7 +106,7 @@ int write_backtrace_to_file(backtrace_logger_t *logger)
     for (i = 0; i < logger->num_contexts; i++)
     {
         fprintf(logger->fd, "# Context %" PRIu64 "\n\n", i);
-        char *str = compress_uint64_array(logger->contexts[i].calls, logger->contexts[i].calls_count, 1);
+        char *str = compress_call_intervals(logger->contexts[i].calls, logger->contexts[i].num_intervals);
         assert(str);
         fprintf(logger->fd, "Communicator: %"PRIu32"\n", logger->contexts[i].comm_id);
         fprintf(logger->fd, "Communicator rank: %d\n", logger->contexts[i].comm_rank);
@@ -163,11 +192,12 @@ int init_backtrace_context(MPI_Comm comm, int comm_rank, int world_rank, uint64_
 
     trace_context_t *new_ctxt = malloc(sizeof(trace_context_t));
     assert(new_ctxt);
-    // At the moment, we hardcode the initial size of the calls array as size of 2.
-    new_ctxt->max_calls = 2;
-    new_ctxt->calls = malloc(new_ctxt->max_calls * sizeof(uint64_t));
+    // At the moment, we hardcode the initial size of the intervals array as size of 2.
+    new_ctxt->max_intervals = 2;
+    new_ctxt->calls = malloc(new_ctxt->max_intervals * sizeof(call_interval_t));
     assert(new_ctxt->calls);
-    new_ctxt->calls[0] = n_call;
+    new_ctxt->num_intervals = 0;
+    call_interval_list_push(new_ctxt->calls, &new_ctxt->num_intervals, n_call);
     new_ctxt->calls_count = 1;
     new_ctxt->comm_id = comm_id;
     new_ctxt->next = NULL;
@@ -189,6 +219,7 @@ static inline int init_backtrace_logger(char *collective_name, char **trace, siz
     new_logger->id = trace_id;
     trace_id++;
     new_logger->world_rank = world_rank;
+    new_logger->key = 0;
     new_logger->contexts = trace_ctxt;
     new_logger->fd = NULL;
     new_logger->filename = NULL;
@@ -301,6 +332,172 @@ int release_backtrace_loggers()
     }
     trace_loggers_head = NULL;
     trace_loggers_tail = NULL;
+
+    int i;
+    for (i = 0; i < TRACE_CACHE_BUCKETS; i++)
+    {
+        trace_cache_entry_t *entry = trace_cache[i];
+        while (entry != NULL)
+        {
+            trace_cache_entry_t *next = entry->next;
+            free(entry->addrs);
+            free(entry);
+            entry = next;
+        }
+        trace_cache[i] = NULL;
+    }
+    return 0;
+}
+
+// Append a call to a trace logger we already know, creating the context for
+// the communicator/rank pair if needed.
+static int add_trace_call(backtrace_logger_t *trace_logger, MPI_Comm comm, int comm_rank, int world_rank, uint64_t n_call)
+{
+    int rc;
+    uint32_t comm_id;
+    GET_COMM_LOGGER(comm, world_rank, comm_rank, comm_id);
+
+    trace_context_t *trace_ctxt = NULL;
+    rc = lookup_trace_context(trace_logger, comm_id, comm_rank, &trace_ctxt);
+    if (rc)
+    {
+        fprintf(stderr, "lookup_trace_context() failed: %d\n", rc);
+        return 1;
+    }
+
+    if (trace_ctxt)
+    {
+        if (!call_interval_list_absorb(trace_ctxt->calls, trace_ctxt->num_intervals, n_call))
+        {
+            if (trace_ctxt->num_intervals >= trace_ctxt->max_intervals)
+            {
+                trace_ctxt->max_intervals = trace_ctxt->max_intervals * 2;
+                trace_ctxt->calls = (call_interval_t *)realloc(trace_ctxt->calls, trace_ctxt->max_intervals * sizeof(call_interval_t));
+                assert(trace_ctxt->calls);
+            }
+            call_interval_list_push(trace_ctxt->calls, &trace_ctxt->num_intervals, n_call);
+        }
+        trace_ctxt->calls_count++;
+    }
+    else
+    {
+        trace_context_t *new_trace_ctxt = NULL;
+        rc = init_backtrace_context(comm, comm_rank, world_rank, n_call, &new_trace_ctxt);
+        if (rc)
+        {
+            fprintf(stderr, "init_backtrace_context() failed: %d\n", rc);
+            return 1;
+        }
+
+        assert(trace_logger->contexts);
+        trace_context_t *ptr = trace_logger->contexts;
+        while (ptr->next != NULL)
+            ptr = ptr->next;
+        ptr->next = new_trace_ctxt;
+        trace_logger->num_contexts++;
+    }
+    return 0;
+}
+
+// Position-independent digest of a call site, stable across ranks and runs:
+// frames inside the profiler library itself are skipped (they are the same
+// for every call site and their addresses change with the library variant)
+// and the remaining frames are hashed as (module name, offset from the
+// module base) pairs so ASLR does not leak into the key. Frames that dladdr
+// cannot attribute to a module fall back to their raw address. The key is
+// written to the backtrace files ("Call-site key:") and matched by the
+// call-site filter (see comm_filter.h).
+uint64_t callsite_key(void **addrs, size_t trace_size)
+{
+    static void *self_base = NULL;
+    if (self_base == NULL)
+    {
+        Dl_info self_info;
+        if (dladdr((void *)&callsite_key, &self_info))
+            self_base = self_info.dli_fbase;
+    }
+
+    uint64_t key = hash_fnv1a_init();
+    size_t i;
+    for (i = 0; i < trace_size; i++)
+    {
+        Dl_info info;
+        if (dladdr(addrs[i], &info) && info.dli_fbase != NULL)
+        {
+            if (info.dli_fbase == self_base)
+                continue;
+            const char *name = info.dli_fname;
+            if (name != NULL)
+            {
+                const char *base = strrchr(name, '/');
+                if (base != NULL)
+                    name = base + 1;
+                key = hash_fnv1a_update(key, name, strlen(name));
+            }
+            key = hash_fnv1a_update_u64(key, (uint64_t)((char *)addrs[i] - (char *)info.dli_fbase));
+        }
+        else
+        {
+            key = hash_fnv1a_update_u64(key, (uint64_t)(uintptr_t)addrs[i]);
+        }
+    }
+    return key;
+}
+
+int insert_caller_data_addrs(char *collective_name, void **addrs, size_t trace_size, MPI_Comm comm, int comm_rank, int world_rank, uint64_t n_call)
+{
+    int rc;
+    uint64_t hash = hash_fnv1a(addrs, trace_size * sizeof(void *));
+    trace_cache_entry_t *entry = trace_cache[hash % TRACE_CACHE_BUCKETS];
+    while (entry != NULL)
+    {
+        if (entry->hash == hash && entry->trace_size == trace_size &&
+            memcmp(entry->addrs, addrs, trace_size * sizeof(void *)) == 0)
+        {
+            return add_trace_call(entry->logger, comm, comm_rank, world_rank, n_call);
+        }
+        entry = entry->next;
+    }
+
+    // First time we see this address array: resolve the symbols (once) and go
+    // through the regular insertion path, then remember the resulting logger.
+    char **strings = backtrace_symbols(addrs, trace_size);
+    assert(strings);
+    rc = insert_caller_data(collective_name, strings, trace_size, comm, comm_rank, world_rank, n_call);
+    if (rc)
+    {
+        free(strings);
+        return rc;
+    }
+
+    backtrace_logger_t *trace_logger = NULL;
+    rc = lookup_backtrace(collective_name, strings, trace_size, &trace_logger);
+    if (rc || trace_logger == NULL)
+    {
+        free(strings);
+        return 1;
+    }
+    if (trace_logger->trace != strings)
+    {
+        // Different addresses resolving to the same symbols: the logger keeps
+        // its own copy of the strings.
+        free(strings);
+    }
+    if (trace_logger->key == 0)
+    {
+        trace_logger->key = callsite_key(addrs, trace_size);
+    }
+
+    trace_cache_entry_t *new_entry = malloc(sizeof(trace_cache_entry_t));
+    assert(new_entry);
+    new_entry->hash = hash;
+    new_entry->trace_size = trace_size;
+    new_entry->addrs = malloc(trace_size * sizeof(void *));
+    assert(new_entry->addrs);
+    memcpy(new_entry->addrs, addrs, trace_size * sizeof(void *));
+    new_entry->logger = trace_logger;
+    new_entry->next = trace_cache[hash % TRACE_CACHE_BUCKETS];
+    trace_cache[hash % TRACE_CACHE_BUCKETS] = new_entry;
     return 0;
 }
 
@@ -348,43 +545,8 @@ int insert_caller_data(char *collective_name, char **trace, size_t trace_size, M
     }
     else
     {
-        // we already know that trace, we now lookup the context
-        trace_context_t *trace_ctxt = NULL;
-        rc = lookup_trace_context(trace_logger, comm_id, comm_rank, &trace_ctxt);
-        if (rc)
-        {
-            fprintf(stderr, "lookup_trace_context() failed: %d\n", rc);
-            return 1;
-        }
-
-        if (trace_ctxt)
-        {
-            if (trace_ctxt->calls_count >= trace_ctxt->max_calls)
-            {
-                trace_ctxt->max_calls = trace_ctxt->max_calls * 2;
-                trace_ctxt->calls = (uint64_t *)realloc(trace_ctxt->calls, trace_ctxt->max_calls * sizeof(uint64_t));
-                assert(trace_ctxt->calls);
-            }
-            trace_ctxt->calls[trace_ctxt->calls_count] = n_call;
-            trace_ctxt->calls_count++;
-        }
-        else
-        {
-            trace_context_t *new_trace_ctxt = NULL;
-            rc = init_backtrace_context(comm, comm_rank, world_rank, n_call, &new_trace_ctxt);
-            if (rc)
-            {
-                fprintf(stderr, "init_backtrace_context() failed: %d\n", rc);
-                return 1;
-            }
-
-            assert(trace_logger->contexts);
-            trace_context_t *ptr = trace_logger->contexts;
-            while (ptr->next != NULL)
-                ptr = ptr->next;
-            ptr->next = new_trace_ctxt;
-            trace_logger->num_contexts++;
-        }
+        // we already know that trace, append the call to the right context
+        return add_trace_call(trace_logger, comm, comm_rank, world_rank, n_call);
     }
     return 0;
 }
@@ -12,15 +12,17 @@
 #include <stdio.h>
 
 #include "mpi.h"
+#include "call_list.h"
 
-typedef struct trace_context 
+typedef struct trace_context
 {
     uint32_t comm_id; // Communicator ID for the associated trace
     int comm_rank; // Rank on the communicator
     int world_rank;
-    uint64_t *calls; // All the calls associated to this backtrace
-    size_t calls_count;
-    size_t max_calls;
+    call_interval_t *calls; // All the calls associated to this backtrace, as inclusive [start, end] intervals (see call_list.h)
+    size_t calls_count; // Total number of calls covered by the intervals
+    uint64_t num_intervals;
+    uint64_t max_intervals;
     struct trace_context *next;
     struct trace_context *prev;
 } trace_context_t;
@@ -33,6 +35,7 @@ typedef struct backtrace_logger
     char *collective_name;
     trace_context_t *contexts;
     uint64_t id;
+    uint64_t key; // Position-independent call-site digest (see callsite_key()); 0 until the first insertion through the address cache
     int world_rank;
     size_t num_contexts;
     size_t max_contexts;
@@ -45,6 +48,8 @@ typedef struct backtrace_logger
 } backtrace_logger_t;
 
 int insert_caller_data(char *collective_name, char **trace, size_t trace_size, MPI_Comm comm, int comm_rank, int world_rank, uint64_t n_call);
+int insert_caller_data_addrs(char *collective_name, void **addrs, size_t trace_size, MPI_Comm comm, int comm_rank, int world_rank, uint64_t n_call);
+uint64_t callsite_key(void **addrs, size_t trace_size);
 int release_backtrace_loggers();
 
 #endif // MPI_COLLECTIVE_PROFILER_BACKTRACE_H
\ No newline at end of file
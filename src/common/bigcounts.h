@@ -0,0 +1,114 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#include <assert.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mpi.h"
+
+#include "collective_profiler_config.h"
+#include "common_utils.h"
+
+#ifndef _COLLECTIVE_PROFILER_BIGCOUNTS_H
+#define _COLLECTIVE_PROFILER_BIGCOUNTS_H
+
+// Helpers for the MPI-4 large-count (_c) collectives. The compact count
+// structures store int values, which is exact for every count up to INT_MAX -
+// by far the common case even in big-buffer runs. When all counts and
+// displacements of a call fit, the call is narrowed and profiled through the
+// regular int path at no extra memory or file cost; when any value overflows,
+// the full 64-bit rows are saved to a per-rank sidecar file instead so no data
+// is lost.
+
+static inline int large_counts_fit(const MPI_Count *counts, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+    {
+        if (counts[i] > (MPI_Count)INT_MAX || counts[i] < 0)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static inline int large_displs_fit(const MPI_Aint *displs, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+    {
+        if (displs[i] > (MPI_Aint)INT_MAX || displs[i] < (MPI_Aint)INT_MIN)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static inline void narrow_large_counts(const MPI_Count *counts, int *dest, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+    {
+        dest[i] = (int)counts[i];
+    }
+}
+
+static inline void narrow_large_displs(const MPI_Aint *displs, int *dest, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+    {
+        dest[i] = (int)displs[i];
+    }
+}
+
+// Save the exact 64-bit count rows of a large-count call that could not be
+// narrowed. One file per rank and call, in the same spirit as the
+// counts.rank<n>_call<id>.md dumps of the int path.
+static inline void save_large_counts(char *collective_name, int world_rank, uint64_t call_id,
+                                     const MPI_Count *sendcounts, int n_send,
+                                     const MPI_Count *recvcounts, int n_recv)
+{
+    char *filename = NULL;
+    int rc;
+    int i;
+
+    if (getenv(OUTPUT_DIR_ENVVAR))
+    {
+        _asprintf(filename, rc, "%s/%s_counts_c.rank%d_call%" PRIu64 ".md", getenv(OUTPUT_DIR_ENVVAR), collective_name, world_rank, call_id);
+    }
+    else
+    {
+        _asprintf(filename, rc, "%s_counts_c.rank%d_call%" PRIu64 ".md", collective_name, world_rank, call_id);
+    }
+    assert(rc > 0);
+
+    FILE *f = fopen(filename, "w");
+    assert(f);
+
+    fprintf(f, "Send counts\n");
+    for (i = 0; i < n_send; i++)
+    {
+        fprintf(f, "%lld ", (long long)sendcounts[i]);
+    }
+    fprintf(f, "\n\nRecv counts\n");
+    for (i = 0; i < n_recv; i++)
+    {
+        fprintf(f, "%lld ", (long long)recvcounts[i]);
+    }
+    fprintf(f, "\n");
+
+    fclose(f);
+    free(filename);
+}
+
+#endif // _COLLECTIVE_PROFILER_BIGCOUNTS_H
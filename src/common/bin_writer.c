@@ -0,0 +1,64 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "bin_writer.h"
+
+bin_writer_t *bin_writer_open(const char *filename)
+{
+    bin_writer_t *writer = (bin_writer_t *)malloc(sizeof(bin_writer_t));
+    assert(writer);
+
+    writer->f = fopen(filename, "w");
+    if (writer->f == NULL)
+    {
+        free(writer);
+        return NULL;
+    }
+
+    writer->buffer = (char *)malloc(BIN_WRITER_BUFFER_SIZE);
+    assert(writer->buffer);
+    setvbuf(writer->f, writer->buffer, _IOFBF, BIN_WRITER_BUFFER_SIZE);
+
+    return writer;
+}
+
+int bin_writer_write(bin_writer_t *writer, const void *data, size_t size)
+{
+    assert(writer);
+    assert(writer->f);
+    if (fwrite(data, 1, size, writer->f) != size)
+    {
+        return 1;
+    }
+    return 0;
+}
+
+int bin_writer_u32(bin_writer_t *writer, uint32_t value)
+{
+    return bin_writer_write(writer, &value, sizeof(value));
+}
+
+int bin_writer_u64(bin_writer_t *writer, uint64_t value)
+{
+    return bin_writer_write(writer, &value, sizeof(value));
+}
+
+int bin_writer_close(bin_writer_t **writer)
+{
+    if (writer == NULL || *writer == NULL)
+    {
+        return 0;
+    }
+
+    fclose((*writer)->f);
+    free((*writer)->buffer);
+    free(*writer);
+    *writer = NULL;
+    return 0;
+}
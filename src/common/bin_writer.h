@@ -0,0 +1,38 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef COLLECTIVE_PROFILER_BIN_WRITER_H
+#define COLLECTIVE_PROFILER_BIN_WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Buffered writer for the binary profile format. All writes go through a
+// large user-space buffer (setvbuf) so that committing a profile is a few
+// sequential bulk writes instead of millions of tiny formatted ones.
+// Records are fixed-width little-endian; the profiler only targets
+// little-endian platforms so values are written in host order.
+
+#define BIN_WRITER_BUFFER_SIZE (8 * 1024 * 1024)
+
+typedef struct bin_writer
+{
+    FILE *f;
+    char *buffer; // Buffer handed to setvbuf; owned by the writer
+} bin_writer_t;
+
+// Open <filename> for writing with a BIN_WRITER_BUFFER_SIZE buffer.
+// Returns NULL on failure.
+bin_writer_t *bin_writer_open(const char *filename);
+
+int bin_writer_write(bin_writer_t *writer, const void *data, size_t size);
+int bin_writer_u32(bin_writer_t *writer, uint32_t value);
+int bin_writer_u64(bin_writer_t *writer, uint64_t value);
+
+// Flush, close and free the writer.
+int bin_writer_close(bin_writer_t **writer);
+
+#endif // COLLECTIVE_PROFILER_BIN_WRITER_H
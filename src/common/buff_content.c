@@ -13,15 +13,307 @@
 #include <unistd.h>
 
 #include <openssl/sha.h>
+#include <pthread.h>
 
 #include "buff_content.h"
 #include "collective_profiler_config.h"
 #include "common_utils.h"
+#include "hash.h"
 
 buffcontent_logger_t *buffcontent_loggers_head = NULL;
 buffcontent_logger_t *buffcontent_loggers_tail = NULL;
+buffcontent_logger_t *buffcontent_logger_index[BUFFCONTENT_INDEX_BUCKETS] = {NULL};
 uint64_t buffcontent_id = 0;
 
+// Unlink a logger from its hash index bucket; the caller still owns the list
+// unlinking and the actual release.
+static void buffcontent_index_remove(buffcontent_logger_t *logger)
+{
+    uint64_t key = buffcontent_logger_key(logger->collective_name, logger->comm);
+    buffcontent_logger_t **slot = &buffcontent_logger_index[key % BUFFCONTENT_INDEX_BUCKETS];
+    while (*slot != NULL)
+    {
+        if (*slot == logger)
+        {
+            *slot = logger->hash_next;
+            logger->hash_next = NULL;
+            return;
+        }
+        slot = &(*slot)->hash_next;
+    }
+}
+
+// Digest engine used for buffer-content capture. SHA256 remains the default
+// for compatibility; COLLECTIVE_PROFILER_BUFFCONTENT_HASH=xxh64 switches to
+// the much faster non-cryptographic xxHash64 (see hash.h), which is plenty for
+// integrity checks. Files must be written and compared with the same engine.
+static int buffcontent_fast_hash()
+{
+    static int fast = -1;
+    if (fast == -1)
+    {
+        char *engine = getenv(BUFFCONTENT_HASH_ENVVAR);
+        fast = (engine != NULL && strcmp(engine, "xxh64") == 0) ? 1 : 0;
+    }
+    return fast;
+}
+
+// Pipelined capture (COLLECTIVE_PROFILER_BUFFCONTENT_PIPELINE=1): the payload
+// blocks are copied into one of two pre-allocated staging buffers and a worker
+// thread does the hashing, file writes or read-and-compare concurrently with
+// the application. The caller flips buffers each call and only blocks when
+// both stages are still in flight.
+typedef struct buffcontent_stage
+{
+    int busy;
+    int compare; // 0: digest and write, 1: read the reference digests and compare
+    bool check;
+    buffcontent_logger_t *logger;
+    int ctxt;
+    uint64_t n_call;
+    int world_rank;
+    MPI_Comm comm;
+    unsigned char *data; // Packed copies of the non-empty blocks
+    size_t capacity;
+    size_t *block_sizes;
+    int num_blocks;
+    int max_blocks;
+} buffcontent_stage_t;
+
+static buffcontent_stage_t buffcontent_stages[2];
+static int buffcontent_submit_stage = 0;
+static pthread_t buffcontent_thread;
+static int buffcontent_thread_started = 0;
+static int buffcontent_thread_stop = 0;
+static pthread_mutex_t buffcontent_stage_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t buffcontent_stage_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t buffcontent_stage_done = PTHREAD_COND_INITIALIZER;
+
+static int buffcontent_pipeline_enabled()
+{
+    static int enabled = -1;
+    if (enabled == -1)
+    {
+        char *pipeline = getenv(BUFFCONTENT_PIPELINE_ENVVAR);
+        enabled = (pipeline != NULL && atoi(pipeline) == 1) ? 1 : 0;
+    }
+    return enabled;
+}
+
+// Digest a data block into a NUL-terminated hex string (out must hold at
+// least 65 characters). One single write of the result replaces the old
+// per-byte fprintf loop.
+static void digest_data(const void *data, size_t size, char *out)
+{
+    if (buffcontent_fast_hash())
+    {
+        snprintf(out, 17, "%016" PRIx64, hash_xxh64(data, size));
+        return;
+    }
+
+    static const char hex[] = "0123456789abcdef";
+    unsigned char sha256_buff[32];
+    size_t j;
+    SHA256(data, size, sha256_buff);
+    for (j = 0; j < 32; j++)
+    {
+        out[j * 2] = hex[sha256_buff[j] >> 4];
+        out[j * 2 + 1] = hex[sha256_buff[j] & 0xf];
+    }
+    out[64] = '\0';
+}
+
+static void process_buffcontent_stage(buffcontent_stage_t *stage)
+{
+    FILE *fd = stage->logger->ctxt[stage->ctxt].fd;
+    unsigned char *cursor = stage->data;
+    int i;
+
+    if (stage->compare == 0)
+    {
+        fprintf(fd, "Call %" PRIu64 "\n", stage->n_call);
+        for (i = 0; i < stage->num_blocks; i++)
+        {
+            char digest[65];
+            digest_data(cursor, stage->block_sizes[i], digest);
+            fprintf(fd, "%s\n", digest);
+            cursor += stage->block_sizes[i];
+        }
+        fprintf(fd, "\n");
+    }
+    else
+    {
+        uint64_t num_call;
+        fscanf(fd, "Call %" PRIu64 "\n", &num_call);
+        for (i = 0; i < stage->num_blocks; i++)
+        {
+            char buff[255];
+            fscanf(fd, "%254s\n", buff);
+            if (stage->check)
+            {
+                char digest[65];
+                digest_data(cursor, stage->block_sizes[i], digest);
+                if (strcmp(digest, buff) != 0)
+                {
+                    fprintf(stderr, "Rank %d: Content differ for call %" PRIu64 " (%s vs. %s)\n", stage->world_rank, stage->n_call, digest, buff);
+                    PMPI_Abort(stage->comm, 1);
+                }
+            }
+            cursor += stage->block_sizes[i];
+        }
+        fscanf(fd, "\n");
+    }
+}
+
+static void *buffcontent_worker(void *arg)
+{
+    int worker_stage = 0;
+    while (1)
+    {
+        pthread_mutex_lock(&buffcontent_stage_lock);
+        while (!buffcontent_stages[worker_stage].busy && !buffcontent_thread_stop)
+        {
+            pthread_cond_wait(&buffcontent_stage_ready, &buffcontent_stage_lock);
+        }
+        if (!buffcontent_stages[worker_stage].busy && buffcontent_thread_stop)
+        {
+            pthread_mutex_unlock(&buffcontent_stage_lock);
+            break;
+        }
+        pthread_mutex_unlock(&buffcontent_stage_lock);
+
+        process_buffcontent_stage(&buffcontent_stages[worker_stage]);
+
+        pthread_mutex_lock(&buffcontent_stage_lock);
+        buffcontent_stages[worker_stage].busy = 0;
+        pthread_cond_signal(&buffcontent_stage_done);
+        pthread_mutex_unlock(&buffcontent_stage_lock);
+        worker_stage = (worker_stage + 1) % 2;
+    }
+    return NULL;
+}
+
+// Copy the non-empty payload blocks into a free staging buffer and hand it to
+// the worker thread. counts/displs may be NULL for the single-count variant.
+static int enqueue_buffcontent_work(buffcontent_logger_t *logger, int ctxt, int compare, bool check,
+                                    MPI_Comm comm, int world_rank, uint64_t n_call,
+                                    void *buf, int counts[], int displs[], int count, int dtsize, int comm_size)
+{
+    int i;
+
+    if (!buffcontent_thread_started)
+    {
+        if (pthread_create(&buffcontent_thread, NULL, buffcontent_worker, NULL) != 0)
+        {
+            return 1; // Caller falls back to the synchronous path
+        }
+        buffcontent_thread_started = 1;
+    }
+
+    pthread_mutex_lock(&buffcontent_stage_lock);
+    buffcontent_stage_t *stage = &buffcontent_stages[buffcontent_submit_stage];
+    while (stage->busy)
+    {
+        pthread_cond_wait(&buffcontent_stage_done, &buffcontent_stage_lock);
+    }
+    pthread_mutex_unlock(&buffcontent_stage_lock);
+
+    size_t total_size = 0;
+    int num_blocks = 0;
+    if (counts != NULL)
+    {
+        for (i = 0; i < comm_size; i++)
+        {
+            if (counts[i] == 0)
+                continue;
+            total_size += (size_t)counts[i] * dtsize;
+            num_blocks++;
+        }
+    }
+    else if (count != 0)
+    {
+        total_size = (size_t)count * dtsize;
+        num_blocks = 1;
+    }
+
+    if (stage->capacity < total_size)
+    {
+        stage->data = realloc(stage->data, total_size);
+        assert(stage->data);
+        stage->capacity = total_size;
+    }
+    if (stage->max_blocks < num_blocks)
+    {
+        stage->block_sizes = realloc(stage->block_sizes, num_blocks * sizeof(size_t));
+        assert(stage->block_sizes);
+        stage->max_blocks = num_blocks;
+    }
+
+    unsigned char *cursor = stage->data;
+    stage->num_blocks = 0;
+    if (counts != NULL)
+    {
+        for (i = 0; i < comm_size; i++)
+        {
+            if (counts[i] == 0)
+                continue;
+            size_t block_size = (size_t)counts[i] * dtsize;
+            memcpy(cursor, (void *)((uintptr_t)buf + (uintptr_t)(displs[i] * dtsize)), block_size);
+            stage->block_sizes[stage->num_blocks] = block_size;
+            stage->num_blocks++;
+            cursor += block_size;
+        }
+    }
+    else if (count != 0)
+    {
+        memcpy(cursor, buf, total_size);
+        stage->block_sizes[0] = total_size;
+        stage->num_blocks = 1;
+    }
+
+    stage->compare = compare;
+    stage->check = check;
+    stage->logger = logger;
+    stage->ctxt = ctxt;
+    stage->n_call = n_call;
+    stage->world_rank = world_rank;
+    stage->comm = comm;
+
+    pthread_mutex_lock(&buffcontent_stage_lock);
+    stage->busy = 1;
+    pthread_cond_signal(&buffcontent_stage_ready);
+    pthread_mutex_unlock(&buffcontent_stage_lock);
+    buffcontent_submit_stage = (buffcontent_submit_stage + 1) % 2;
+    return 0;
+}
+
+// Drain the pipeline and stop the worker; called before the loggers (and
+// their file descriptors) are released.
+static void buffcontent_pipeline_fini()
+{
+    if (!buffcontent_thread_started)
+    {
+        return;
+    }
+    pthread_mutex_lock(&buffcontent_stage_lock);
+    while (buffcontent_stages[0].busy || buffcontent_stages[1].busy)
+    {
+        pthread_cond_wait(&buffcontent_stage_done, &buffcontent_stage_lock);
+    }
+    buffcontent_thread_stop = 1;
+    pthread_cond_broadcast(&buffcontent_stage_ready);
+    pthread_mutex_unlock(&buffcontent_stage_lock);
+    pthread_join(buffcontent_thread, NULL);
+    buffcontent_thread_started = 0;
+    buffcontent_thread_stop = 0;
+
+    free(buffcontent_stages[0].data);
+    free(buffcontent_stages[0].block_sizes);
+    free(buffcontent_stages[1].data);
+    free(buffcontent_stages[1].block_sizes);
+    memset(buffcontent_stages, 0, sizeof(buffcontent_stages));
+}
+
 static inline int _close_buffcontent_file(buffcontent_logger_t *logger)
 {
     if (logger->ctxt[0].fd)
@@ -89,8 +381,44 @@ int fini_buffcontent_logger(buffcontent_logger_t **logger)
     return 0;
 }
 
+// Release the loggers of a single communicator when it is freed, so the list
+// tracks live communicators instead of growing for the whole run. The node is
+// unlinked and freed; a later call on a recycled handle gets a fresh logger.
+int release_comm_buffcontent_loggers(MPI_Comm comm)
+{
+    buffcontent_logger_t *ptr = buffcontent_loggers_head;
+    while (ptr)
+    {
+        buffcontent_logger_t *next = ptr->next;
+        if (ptr->comm == comm)
+        {
+            if (ptr->prev)
+                ptr->prev->next = ptr->next;
+            else
+                buffcontent_loggers_head = ptr->next;
+            if (ptr->next)
+                ptr->next->prev = ptr->prev;
+            else
+                buffcontent_loggers_tail = ptr->prev;
+            buffcontent_index_remove(ptr);
+
+            buffcontent_logger_t *doomed = ptr;
+            int rc = fini_buffcontent_logger(&doomed);
+            if (rc)
+            {
+                fprintf(stderr, "fini_buffcontent_logger() failed: %d\n", rc);
+                return rc;
+            }
+            free(ptr);
+        }
+        ptr = next;
+    }
+    return 0;
+}
+
 int release_buffcontent_loggers()
 {
+    buffcontent_pipeline_fini();
     buffcontent_logger_t *ptr = buffcontent_loggers_head;
     while (ptr)
     {
@@ -106,6 +434,35 @@ int release_buffcontent_loggers()
     }
     buffcontent_loggers_head = NULL;
     buffcontent_loggers_tail = NULL;
+    memset(buffcontent_logger_index, 0, sizeof(buffcontent_logger_index));
+    return 0;
+}
+
+// Flush the open descriptors at a window boundary. Descriptors now stay open
+// across the whole window - the open/close pair per dumped call is gone from
+// the hot path - so this is where buffered content is pushed out: stdio
+// buffers are flushed for every context and files opened for writing are
+// fsync'ed so a completed window survives a crash of the application.
+int sync_buffcontent_loggers()
+{
+    buffcontent_logger_t *ptr = buffcontent_loggers_head;
+    while (ptr)
+    {
+        int ctxt;
+        for (ctxt = 0; ctxt < MAX_LOGGER_CONTEXTS; ctxt++)
+        {
+            if (ptr->ctxt[ctxt].fd == NULL)
+            {
+                continue;
+            }
+            fflush(ptr->ctxt[ctxt].fd);
+            if (ptr->ctxt[ctxt].write_mode)
+            {
+                fsync(fileno(ptr->ctxt[ctxt].fd));
+            }
+        }
+        ptr = ptr->next;
+    }
     return 0;
 }
 
@@ -132,6 +489,13 @@ int store_call_data(char *collective_name, int ctxt, MPI_Comm comm, int comm_ran
     int i;
     int comm_size;
     PMPI_Comm_size(comm, &comm_size);
+
+    if (buffcontent_pipeline_enabled() &&
+        enqueue_buffcontent_work(buffcontent_logger, ctxt, 0, false, comm, world_rank, n_call, buf, counts, displs, 0, dtsize, comm_size) == 0)
+    {
+        return 0;
+    }
+
     fprintf(buffcontent_logger->ctxt[ctxt].fd, "Call %" PRIu64 "\n", n_call);
     for (i = 0; i < comm_size; i++)
     {
@@ -142,14 +506,9 @@ int store_call_data(char *collective_name, int ctxt, MPI_Comm comm, int comm_ran
 
         size_t data_size = counts[i] * dtsize;
         void *ptr = (void *)((uintptr_t)buf + (uintptr_t)(displs[i] * dtsize));
-        size_t j;
-        unsigned char sha256_buff[32];
-        SHA256(ptr, data_size, sha256_buff);
-        for (j = 0; j < 32; j++)
-        {
-            fprintf(buffcontent_logger->ctxt[ctxt].fd, "%02x", sha256_buff[j]);
-        }
-        fprintf(buffcontent_logger->ctxt[ctxt].fd, "\n");
+        char digest[65];
+        digest_data(ptr, data_size, digest);
+        fprintf(buffcontent_logger->ctxt[ctxt].fd, "%s\n", digest);
     }
     fprintf(buffcontent_logger->ctxt[ctxt].fd, "\n");
     // fflush(buffcontent_logger->ctxt[ctxt].fd);
@@ -180,18 +539,20 @@ int store_call_data_single_count(char *collective_name, int ctxt, MPI_Comm comm,
     int i;
     int comm_size;
     PMPI_Comm_size(comm, &comm_size);
+
+    if (buffcontent_pipeline_enabled() &&
+        enqueue_buffcontent_work(buffcontent_logger, ctxt, 0, false, comm, world_rank, n_call, buf, NULL, NULL, count, dtsize, comm_size) == 0)
+    {
+        return 0;
+    }
+
     fprintf(buffcontent_logger->ctxt[ctxt].fd, "Call %" PRIu64 "\n", n_call);
     if (count != 0)
     {
         size_t data_size = count * dtsize;
-        size_t j;
-        unsigned char sha256_buff[32];
-        SHA256(buf, data_size, sha256_buff);
-        for (j = 0; j < 32; j++)
-        {
-            fprintf(buffcontent_logger->ctxt[ctxt].fd, "%02x", sha256_buff[j]);
-        }
-        fprintf(buffcontent_logger->ctxt[ctxt].fd, "\n");
+        char digest[65];
+        digest_data(buf, data_size, digest);
+        fprintf(buffcontent_logger->ctxt[ctxt].fd, "%s\n", digest);
     }
     fprintf(buffcontent_logger->ctxt[ctxt].fd, "\n");
     return 0;
@@ -217,6 +578,12 @@ int read_and_compare_call_data(char *collective_name, int ctxt, MPI_Comm comm, i
     int comm_size;
     PMPI_Comm_size(comm, &comm_size);
 
+    if (buffcontent_pipeline_enabled() &&
+        enqueue_buffcontent_work(buffcontent_logger, ctxt, 1, check, comm, world_rank, n_call, buf, counts, displs, 0, dtsize, comm_size) == 0)
+    {
+        return 0;
+    }
+
     // Read header ("Call X\n")
     uint64_t num_call;
     fscanf(buffcontent_logger->ctxt[ctxt].fd, "Call %" PRIu64 "\n", &num_call);
@@ -233,15 +600,8 @@ int read_and_compare_call_data(char *collective_name, int ctxt, MPI_Comm comm, i
         fscanf(buffcontent_logger->ctxt[ctxt].fd, "%254s\n", buff);
         if (check)
         {
-            unsigned char sha256_buff[32];
-            SHA256(ptr, data_size, sha256_buff);
-            char data[255];
-            size_t j;
-            for (j = 0; j < 32; j++)
-            {
-                // 3 because it adds EOC
-                snprintf(&data[j * 2], 3, "%02x", sha256_buff[j]);
-            }
+            char data[65];
+            digest_data(ptr, data_size, data);
 
             if (strcmp(data, buff) != 0)
             {
@@ -8,6 +8,7 @@
 #define MPI_COLLECTIVE_PROFILER_BUFFCONTENT_H
 
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 #include <stdbool.h>
 
@@ -17,6 +18,7 @@
 #include "common_utils.h"
 #include "format.h"
 #include "comm.h"
+#include "hash.h"
 
 #define COLLECTIVE_PROFILER_MAX_CALL_CHECK_BUFF_CONTENT_ENVVAR "COLLECTIVE_PROFILER_MAX_CALL_CHECK_BUFF_CONTENT"
 #define COLLECTIVE_PROFILER_CHECK_SEND_BUFF_ENVVAR "COLLECTIVE_PROFILER_CHECK_SEND_BUFF"
@@ -32,6 +34,7 @@ typedef struct logger_context
     char *name;
     FILE *fd;
     char *filename;
+    int write_mode; // 1 when the file was opened for writing; only those are fsync'ed
 } logger_context_t;
 
 // buffcontent_logger is the central structure to track and profile backtrace in
@@ -47,11 +50,29 @@ typedef struct buffcontent_logger
     logger_context_t ctxt[MAX_LOGGER_CONTEXTS];
     struct buffcontent_logger *next;
     struct buffcontent_logger *prev;
+    struct buffcontent_logger *hash_next; // Chaining within the hash index bucket
 } buffcontent_logger_t;
 
 extern buffcontent_logger_t *buffcontent_loggers_head;
 extern buffcontent_logger_t *buffcontent_loggers_tail;
 
+// Hash index over the logger list, keyed on collective name plus communicator,
+// so per-call logger resolution does not scan the list. The list remains the
+// canonical enumeration order (release paths, id assignment); the index only
+// accelerates lookups and is rebuilt trivially since nodes chain through
+// hash_next.
+#define BUFFCONTENT_INDEX_BUCKETS (64)
+extern buffcontent_logger_t *buffcontent_logger_index[BUFFCONTENT_INDEX_BUCKETS];
+
+static inline uint64_t
+buffcontent_logger_key(char *collective_name, MPI_Comm comm)
+{
+    uint64_t key = hash_fnv1a_init();
+    key = hash_fnv1a_update(key, collective_name, strlen(collective_name));
+    key = hash_fnv1a_update(key, &comm, sizeof(comm));
+    return key;
+}
+
 static inline void
 _display_config(int dt_num_intergers, int dt_num_addresses, int dt_num_datatypes, int dt_combiner)
 {
@@ -158,16 +179,16 @@ _display_config(int dt_num_intergers, int dt_num_addresses, int dt_num_datatypes
 static inline int
 lookup_buffcontent_logger(char *collective_name, MPI_Comm comm, buffcontent_logger_t **logger)
 {
-    buffcontent_logger_t *ptr = buffcontent_loggers_head;
+    uint64_t key = buffcontent_logger_key(collective_name, comm);
+    buffcontent_logger_t *ptr = buffcontent_logger_index[key % BUFFCONTENT_INDEX_BUCKETS];
     while (ptr != NULL)
     {
-        if (strcmp(ptr->collective_name, collective_name) == 0 && ptr->comm == comm)
+        if (ptr->comm == comm && strcmp(ptr->collective_name, collective_name) == 0)
         {
-
             *logger = ptr;
             return 0;
         }
-        ptr = ptr->next;
+        ptr = ptr->hash_next;
     }
 
     *logger = NULL;
@@ -233,6 +254,12 @@ init_buffcontent_logger(char *collective_name, int world_rank, MPI_Comm comm, ui
     new_logger->ctxt[1].fd = NULL;
     new_logger->ctxt[0].filename = NULL;
     new_logger->ctxt[1].filename = NULL;
+    new_logger->ctxt[0].write_mode = 0;
+    new_logger->ctxt[1].write_mode = 0;
+
+    uint64_t key = buffcontent_logger_key(collective_name, comm);
+    new_logger->hash_next = buffcontent_logger_index[key % BUFFCONTENT_INDEX_BUCKETS];
+    buffcontent_logger_index[key % BUFFCONTENT_INDEX_BUCKETS] = new_logger;
 
     if (buffcontent_loggers_head == NULL)
     {
@@ -300,6 +327,7 @@ get_buffcontent_logger(char *collective_name, int ctxt, char *mode, MPI_Comm com
         }
         if (strcmp(mode, "w") == 0)
         {
+            logger->ctxt[ctxt].write_mode = 1;
             // Write the format version at the begining of the file
             FORMAT_VERSION_WRITE(logger->ctxt[ctxt].fd);
         }
@@ -376,5 +404,7 @@ int store_call_data(char *collective_name, int ctxt, MPI_Comm comm, int comm_ran
 int store_call_data_single_count(char *collective_name, int ctxt, MPI_Comm comm, int comm_rank, int world_rank, uint64_t n_call, void *buf, int count, MPI_Datatype dt);
 int read_and_compare_call_data(char *collective_name, int ctxt, MPI_Comm comm, int comm_rank, int world_rank, uint64_t n_call, void *buf, int counts[], int displs[], MPI_Datatype dt, bool check);
 int release_buffcontent_loggers();
+int release_comm_buffcontent_loggers(MPI_Comm comm);
+int sync_buffcontent_loggers();
 
 #endif // MPI_COLLECTIVE_PROFILER_BUFFCONTENT_H
@@ -0,0 +1,76 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#include <stdint.h>
+
+#ifndef _COLLECTIVE_PROFILER_CALL_LIST_H
+#define _COLLECTIVE_PROFILER_CALL_LIST_H
+
+// Interval-compressed call lists. Call memberships used to be stored as one
+// uint64_t per occurrence; a phase repeating the same pattern for millions of
+// iterations then accumulated megabytes of consecutive integers per signature
+// that the finalize-time range compression collapsed anyway. Storing the
+// membership as inclusive [start, end] intervals from the start bounds the
+// memory by the number of gaps instead of the number of calls, keeps the
+// overwhelmingly common consecutive append O(1) with no reallocation, and
+// makes rendering the "a-b, c, d-e" form of the profiles a direct walk of
+// the stored data.
+//
+// Growth stays with the caller - the count engine bump-allocates out of its
+// arena while the backtrace tracker uses realloc - so the helpers below only
+// cover the append logic: try call_interval_list_absorb() first and, when it
+// reports that a new interval is needed, ensure capacity for one more entry
+// and call call_interval_list_push().
+
+typedef struct call_interval
+{
+    uint64_t start;
+    uint64_t end; // Inclusive
+} call_interval_t;
+
+// Extend the last interval in place when call_id directly follows it.
+// Returns 0 when a new interval must be pushed instead.
+static inline int call_interval_list_absorb(call_interval_t *intervals, uint64_t num_intervals, uint64_t call_id)
+{
+    if (num_intervals > 0 && intervals[num_intervals - 1].end + 1 == call_id)
+    {
+        intervals[num_intervals - 1].end = call_id;
+        return 1;
+    }
+    return 0;
+}
+
+// Start a new interval holding only call_id. The caller guarantees capacity
+// for one more entry.
+static inline void call_interval_list_push(call_interval_t *intervals, uint64_t *num_intervals, uint64_t call_id)
+{
+    intervals[*num_intervals].start = call_id;
+    intervals[*num_intervals].end = call_id;
+    (*num_intervals)++;
+}
+
+// Locate the call after the first <skip> ones: returns the index of the
+// interval holding it and, through offset, its position within that interval.
+// Used by the incremental checkpoint to list only the calls above its
+// count-based watermark.
+static inline uint64_t call_interval_list_skip(call_interval_t *intervals, uint64_t num_intervals, uint64_t skip, uint64_t *offset)
+{
+    uint64_t i;
+    for (i = 0; i < num_intervals; i++)
+    {
+        uint64_t len = intervals[i].end - intervals[i].start + 1;
+        if (skip < len)
+        {
+            *offset = skip;
+            return i;
+        }
+        skip -= len;
+    }
+    *offset = 0;
+    return num_intervals;
+}
+
+#endif // _COLLECTIVE_PROFILER_CALL_LIST_H
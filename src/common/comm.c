@@ -12,53 +12,231 @@
 
 #include "comm.h"
 #include "common_utils.h"
+#include "arena.h"
+#include "hash.h"
 #include "collective_profiler_config.h"
 #include "format.h"
+#include "compress.h"
+
+// Communicator records are small, never individually freed and live for the
+// duration of the run, so they come out of an arena released as a whole in
+// release_comm_data().
+static arena_t comm_arena = ARENA_INITIALIZER(64 * 1024);
 
 comm_data_t *comm_data_head = NULL;
 comm_data_t *comm_data_tail = NULL;
 uint32_t next_id = 0;
 
+// Records of freed communicators are recycled through this pool (they are
+// arena-backed so they cannot be returned individually); only the few fields
+// needed at finalize time are kept, in the compact retired array below, so
+// the state tracked per communicator is proportional to the number of live
+// communicators, not to how many the application created over its lifetime.
+static comm_data_t *comm_free_pool = NULL;
+
+typedef struct retired_comm
+{
+    uint32_t id;
+    int world_rank;
+    int comm_rank;
+} retired_comm_t;
+
+#define RETIRED_COMMS_GROWTH (256)
+static retired_comm_t *retired_comms = NULL;
+static size_t num_retired_comms = 0;
+static size_t max_retired_comms = 0;
+
+// Open-addressing hash table on the MPI_Comm handle so that resolving a
+// communicator stays O(1) no matter how many sub-communicators the
+// application creates. The linked list above is kept as the insertion-ordered
+// view used when saving communicator data at finalize time. Slots whose data
+// pointer is COMM_SLOT_DELETED are tombstones left by drop_comm(): the MPI
+// implementation may recycle a freed handle so stale entries must not be
+// allowed to alias a new communicator.
+#define COMM_TABLE_MIN_CAPACITY (256) // Must be a power of two
+#define COMM_SLOT_DELETED ((comm_data_t *)-1)
+
+typedef struct comm_slot
+{
+    MPI_Comm comm;
+    comm_data_t *data;
+} comm_slot_t;
+
+static comm_slot_t *comm_table = NULL;
+static size_t comm_table_capacity = 0;
+static size_t comm_table_used = 0; // Live entries plus tombstones
+
+static size_t hash_comm(MPI_Comm comm, size_t capacity)
+{
+    return (size_t)(hash_fnv1a(&comm, sizeof(MPI_Comm)) & (capacity - 1));
+}
+
+static void comm_table_grow(void)
+{
+    // Size the new table to the live entries, not to the historical peak:
+    // rebuilding clears the tombstones, so a workload that frees as many
+    // communicators as it creates stays at a small, constant capacity.
+    size_t live = 0;
+    size_t j;
+    for (j = 0; j < comm_table_capacity; j++)
+    {
+        if (comm_table[j].data != NULL && comm_table[j].data != COMM_SLOT_DELETED)
+            live++;
+    }
+    size_t new_capacity = COMM_TABLE_MIN_CAPACITY;
+    while ((live + 1) * 2 > new_capacity / 2)
+        new_capacity *= 2;
+    comm_slot_t *new_table = calloc(new_capacity, sizeof(comm_slot_t));
+    assert(new_table);
+
+    size_t i;
+    size_t used = 0;
+    for (i = 0; i < comm_table_capacity; i++)
+    {
+        if (comm_table[i].data == NULL || comm_table[i].data == COMM_SLOT_DELETED)
+            continue;
+        size_t slot = hash_comm(comm_table[i].comm, new_capacity);
+        while (new_table[slot].data != NULL)
+            slot = (slot + 1) & (new_capacity - 1);
+        new_table[slot] = comm_table[i];
+        used++;
+    }
+    free(comm_table);
+    comm_table = new_table;
+    comm_table_capacity = new_capacity;
+    comm_table_used = used;
+}
+
+static void comm_table_insert(MPI_Comm comm, comm_data_t *data)
+{
+    // Keep the load factor below 50% so probe sequences stay short
+    if (comm_table == NULL || (comm_table_used + 1) * 2 > comm_table_capacity)
+        comm_table_grow();
+
+    size_t slot = hash_comm(comm, comm_table_capacity);
+    while (comm_table[slot].data != NULL && comm_table[slot].data != COMM_SLOT_DELETED)
+        slot = (slot + 1) & (comm_table_capacity - 1);
+    if (comm_table[slot].data == NULL)
+        comm_table_used++;
+    comm_table[slot].comm = comm;
+    comm_table[slot].data = data;
+}
+
+static comm_slot_t *comm_table_find(MPI_Comm comm)
+{
+    if (comm_table == NULL)
+        return NULL;
+
+    size_t slot = hash_comm(comm, comm_table_capacity);
+    while (comm_table[slot].data != NULL)
+    {
+        if (comm_table[slot].data != COMM_SLOT_DELETED && comm_table[slot].comm == comm)
+            return &comm_table[slot];
+        slot = (slot + 1) & (comm_table_capacity - 1);
+    }
+    return NULL;
+}
+
 int lookup_comm(MPI_Comm comm, uint32_t *id)
 {
-    comm_data_t *data = comm_data_head;
-    while (data != NULL)
+    comm_slot_t *slot = comm_table_find(comm);
+    if (slot != NULL)
     {
-        if (data->comm == comm)
-        {
-            *id = data->id;
-            return 0;
-        }
-        data = data->next;
+        *id = slot->data->id;
+        return 0;
+    }
+    return 1;
+}
+
+int lookup_comm_data(MPI_Comm comm, comm_data_t **data)
+{
+    comm_slot_t *slot = comm_table_find(comm);
+    if (slot != NULL)
+    {
+        *data = slot->data;
+        return 0;
     }
+    *data = NULL;
     return 1;
 }
 
+int drop_comm(MPI_Comm comm)
+{
+    comm_slot_t *slot = comm_table_find(comm);
+    if (slot == NULL)
+        return 1;
+    comm_data_t *data = slot->data;
+
+    // The ID and lead rank are still needed when communicator data is saved
+    // at finalize time; keep them in the compact retired array, then unlink
+    // the full record and recycle it through the free pool.
+    if (num_retired_comms == max_retired_comms)
+    {
+        max_retired_comms += RETIRED_COMMS_GROWTH;
+        retired_comms = (retired_comm_t *)realloc(retired_comms, max_retired_comms * sizeof(retired_comm_t));
+        assert(retired_comms);
+    }
+    retired_comms[num_retired_comms].id = data->id;
+    retired_comms[num_retired_comms].world_rank = data->world_rank;
+    retired_comms[num_retired_comms].comm_rank = data->comm_rank;
+    num_retired_comms++;
+
+    if (comm_data_head == data)
+    {
+        comm_data_head = data->next;
+    }
+    else
+    {
+        comm_data_t *prev = comm_data_head;
+        while (prev != NULL && prev->next != data)
+            prev = prev->next;
+        assert(prev);
+        prev->next = data->next;
+        if (comm_data_tail == data)
+            comm_data_tail = prev;
+    }
+    if (comm_data_head == NULL)
+        comm_data_tail = NULL;
+
+    data->next = comm_free_pool;
+    comm_free_pool = data;
+    slot->data = COMM_SLOT_DELETED;
+    return 0;
+}
+
 int add_comm(MPI_Comm comm, int world_rank, int comm_rank, uint32_t *id)
 {
+    comm_data_t *new_data = comm_free_pool;
+    if (new_data != NULL)
+    {
+        comm_free_pool = new_data->next;
+    }
+    else
+    {
+        new_data = arena_alloc(&comm_arena, sizeof(comm_data_t));
+    }
+    assert(new_data);
+    new_data->id = next_id;
+    new_data->next = NULL;
+    new_data->comm = comm;
+    new_data->world_rank = world_rank;
+    new_data->comm_rank = comm_rank;
+    new_data->timing_logger[0] = NULL;
+    new_data->timing_logger[1] = NULL;
+    new_data->location_tracked = 0;
+    new_data->sharding_base = -1;
+    new_data->filter_verdict = -1;
     if (comm_data_head == NULL)
     {
-        comm_data_head = malloc(sizeof(comm_data_t));
-        assert(comm_data_head);
-        comm_data_head->id = next_id;
-        comm_data_head->next = NULL;
-        comm_data_head->comm = comm;
-        comm_data_head->world_rank = world_rank;
-        comm_data_head->comm_rank = comm_rank;
-        comm_data_tail = comm_data_head;
+        comm_data_head = new_data;
+        comm_data_tail = new_data;
     }
     else
     {
-        comm_data_t *new_data = malloc(sizeof(comm_data_t));
-        assert(new_data);
-        new_data->id = next_id;
-        new_data->next = NULL;
-        new_data->comm = comm;
-        new_data->world_rank = world_rank;
-        new_data->comm_rank = comm_rank;
         comm_data_tail->next = new_data;
         comm_data_tail = new_data;
     }
+    comm_table_insert(comm, new_data);
     *id = next_id;
     next_id++;
     return 0;
@@ -79,12 +257,58 @@ int save_logger_data(comm_data_t *comm, FILE *fd)
     return 0;
 }
 
+// Lazily open the communicator data file; shared between the retired entries
+// and the communicators still live at finalize time.
+static FILE *open_comm_data_file(char *collective_name, int lead_rank, char **filename, char **name)
+{
+    int rc;
+    FILE *fd = NULL;
+
+    // Convert the collective name to a all-lower case string for consistency
+    *name = strdup(collective_name);
+    (*name)[0] = tolower((*name)[0]);
+
+    if (getenv(OUTPUT_DIR_ENVVAR))
+    {
+        _asprintf(*filename, rc, "%s/%s_comm_data_rank%d.md", getenv(OUTPUT_DIR_ENVVAR), *name, lead_rank);
+        assert(rc > 0);
+    }
+    else
+    {
+        _asprintf(*filename, rc, "%s_comm_data_rank%d.md", *name, lead_rank);
+        assert(rc > 0);
+    }
+
+    assert(*filename);
+    fd = profile_fopen(*filename, "w", "counts");
+    assert(fd);
+    FORMAT_VERSION_WRITE(fd);
+    return fd;
+}
+
 int release_comm_data(char *collective_name, int lead_rank)
 {
     int rc;
     char *filename = NULL;
     char *name = NULL;
     FILE *fd = NULL;
+    size_t r;
+
+    // Communicators freed during the run were unlinked by drop_comm(); their
+    // identification lives in the retired array.
+    for (r = 0; r < num_retired_comms; r++)
+    {
+        if (retired_comms[r].comm_rank != 0)
+            continue;
+        if (fd == NULL)
+            fd = open_comm_data_file(collective_name, lead_rank, &filename, &name);
+        assert(lead_rank == retired_comms[r].world_rank);
+        fprintf(fd, "ID: %" PRIu32 "; world rank: %d\n", retired_comms[r].id, retired_comms[r].world_rank);
+    }
+    free(retired_comms);
+    retired_comms = NULL;
+    num_retired_comms = 0;
+    max_retired_comms = 0;
 
     while (comm_data_head != NULL)
     {
@@ -92,29 +316,7 @@ int release_comm_data(char *collective_name, int lead_rank)
         if (comm_data_head->comm_rank == 0)
         {
             if (fd == NULL)
-            {
-
-                // Convert the collective name to a all-lower case string for consistency
-                name = strdup(collective_name);
-                name[0] = tolower(name[0]);
-
-                //int lead_rank = comm_data_head->lead_rank;
-                if (getenv(OUTPUT_DIR_ENVVAR))
-                {
-                    _asprintf(filename, rc, "%s/%s_comm_data_rank%d.md", getenv(OUTPUT_DIR_ENVVAR), name, lead_rank);
-                    assert(rc > 0);
-                }
-                else
-                {
-                    _asprintf(filename, rc, "%s_comm_data_rank%d.md", name, lead_rank);
-                    assert(rc > 0);
-                }
-
-                assert(filename);
-                fd = fopen(filename, "w");
-                assert(fd);
-                FORMAT_VERSION_WRITE(fd);
-            }
+                fd = open_comm_data_file(collective_name, lead_rank, &filename, &name);
             assert(lead_rank == comm_data_head->world_rank);
             rc = save_logger_data(comm_data_head, fd);
             if (rc)
@@ -125,9 +327,15 @@ int release_comm_data(char *collective_name, int lead_rank)
                 return rc;
             }
         }
-        free(comm_data_head);
         comm_data_head = ptr;
     }
+    comm_data_tail = NULL;
+    comm_free_pool = NULL; // The records are arena-backed: released with the arena
+    arena_release(&comm_arena);
+    free(comm_table);
+    comm_table = NULL;
+    comm_table_capacity = 0;
+    comm_table_used = 0;
 
     if (fd)
     {
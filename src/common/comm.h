@@ -16,11 +16,26 @@ typedef struct comm_data
     MPI_Comm comm;
     int world_rank;
     int comm_rank;
+    // Per-communicator profiling state cached on the record so users do not
+    // need their own communicator-indexed lookups (e.g. the timing loggers,
+    // see timings.c; one slot per timing series). Opaque here to avoid
+    // circular includes.
+    void *timing_logger[2];
+    int location_tracked; // Set once rank locations have been gathered for this communicator
+    // Role-sharding base root for this communicator, agreed once through a
+    // broadcast from comm rank 0 (local comm IDs are not consistent across
+    // ranks, so the base cannot be derived independently). -1 until set.
+    int sharding_base;
+    // Cached decision of the filtering engine (see comm_filter.h): -1 until
+    // evaluated, then 1 (profile this communicator) or 0 (skip it).
+    int filter_verdict;
     struct comm_data *next;
 } comm_data_t;
 
 int lookup_comm(MPI_Comm comm, uint32_t *id);
+int lookup_comm_data(MPI_Comm comm, comm_data_t **data);
 int add_comm(MPI_Comm comm, int world_rank, int comm_rank, uint32_t *id);
+int drop_comm(MPI_Comm comm);
 int release_comm_data();
 
 #define GET_COMM_LOGGER(_comm, _world_rank, _comm_rank, _comm_id)                  \
@@ -0,0 +1,304 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef COLLECTIVE_PROFILER_COMM_FILTER_H
+#define COLLECTIVE_PROFILER_COMM_FILTER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <execinfo.h>
+
+#include "mpi.h"
+#include "comm.h"
+#include "hash.h"
+#include "backtrace.h"
+
+// Filtering engine: confine profiling to the communicators (and optionally
+// the call sites) that matter instead of paying full collection cost on
+// every collective call. The predicates are parsed once at init from the
+// environment; the per-communicator verdict is evaluated the first time a
+// communicator is seen and cached on its record (comm_data_t.filter_verdict),
+// so the steady-state cost of an accepted or rejected communicator is a
+// lookup and one integer compare. The call-site filter hashes the raw
+// return-address array of the current call and caches the verdict per unique
+// trace, the same way the backtrace symbol cache works (see backtrace.c).
+//
+// All predicates that are set must hold for a communicator to be profiled.
+// Every rank evaluates them independently, so they must resolve identically
+// everywhere: sizes do by construction, names do as long as the application
+// sets them on all ranks (MPI_Comm_set_name is local), and IDs do as long
+// as ranks register their communicators in the same order - the same
+// assumption the rest of the ID-keyed output already makes.
+
+#define A2A_FILTER_COMM_MIN_SIZE_ENVVAR "A2A_FILTER_COMM_MIN_SIZE" // Only profile communicators with at least that many ranks
+#define A2A_FILTER_COMM_MAX_SIZE_ENVVAR "A2A_FILTER_COMM_MAX_SIZE" // Only profile communicators with at most that many ranks
+#define A2A_FILTER_COMM_IDS_ENVVAR "A2A_FILTER_COMM_IDS"		   // Comma-separated list of communicator IDs and ranges (e.g. "0,3-5"), matching the IDs reported in the comm_data output files
+#define A2A_FILTER_COMM_NAMES_ENVVAR "A2A_FILTER_COMM_NAMES"	   // Comma-separated list of names set through MPI_Comm_set_name; exact match
+#define A2A_FILTER_CALLSITES_ENVVAR "A2A_FILTER_CALLSITES"		   // Comma-separated list of call-site keys (hex), as reported in the backtrace files
+
+#define COMM_FILTER_CALLSITE_BUCKETS (64) // Number of buckets of the per-trace verdict cache (power of two)
+
+typedef struct comm_filter_id_range
+{
+    uint32_t start;
+    uint32_t end; // Inclusive
+} comm_filter_id_range_t;
+
+// Verdict cache for the call-site filter, keyed on the raw return-address
+// array so the normalization in callsite_key() runs once per unique trace.
+typedef struct comm_filter_trace_verdict
+{
+    uint64_t hash; // hash_fnv1a over the raw addresses (same key as the backtrace symbol cache)
+    void **addrs;
+    size_t trace_size;
+    int allowed;
+    struct comm_filter_trace_verdict *next;
+} comm_filter_trace_verdict_t;
+
+static int _comm_filter_active = 0; // Any communicator predicate set
+static int _comm_filter_min_size = -1;
+static int _comm_filter_max_size = -1;
+static comm_filter_id_range_t *_comm_filter_ids = NULL;
+static int _comm_filter_num_ids = 0;
+static char **_comm_filter_names = NULL;
+static int _comm_filter_num_names = 0;
+static uint64_t *_comm_filter_callsites = NULL;
+static int _comm_filter_num_callsites = 0;
+static comm_filter_trace_verdict_t *_comm_filter_trace_cache[COMM_FILTER_CALLSITE_BUCKETS];
+
+static inline int comm_filter_active(void)
+{
+    return _comm_filter_active;
+}
+
+static inline int comm_filter_callsites_active(void)
+{
+    return _comm_filter_num_callsites > 0;
+}
+
+__attribute__((unused)) static void comm_filter_release(void)
+{
+    int i;
+    free(_comm_filter_ids);
+    _comm_filter_ids = NULL;
+    _comm_filter_num_ids = 0;
+    for (i = 0; i < _comm_filter_num_names; i++)
+        free(_comm_filter_names[i]);
+    free(_comm_filter_names);
+    _comm_filter_names = NULL;
+    _comm_filter_num_names = 0;
+    free(_comm_filter_callsites);
+    _comm_filter_callsites = NULL;
+    _comm_filter_num_callsites = 0;
+    for (i = 0; i < COMM_FILTER_CALLSITE_BUCKETS; i++)
+    {
+        comm_filter_trace_verdict_t *entry = _comm_filter_trace_cache[i];
+        while (entry != NULL)
+        {
+            comm_filter_trace_verdict_t *next = entry->next;
+            free(entry->addrs);
+            free(entry);
+            entry = next;
+        }
+        _comm_filter_trace_cache[i] = NULL;
+    }
+    _comm_filter_active = 0;
+    _comm_filter_min_size = -1;
+    _comm_filter_max_size = -1;
+}
+
+// Compile the predicates from the environment into flat tables. Called once
+// at init (and harmless to call again: the previous tables are released).
+__attribute__((unused)) static void comm_filter_init(void)
+{
+    comm_filter_release();
+
+    char *min_size = getenv(A2A_FILTER_COMM_MIN_SIZE_ENVVAR);
+    if (min_size != NULL && atoi(min_size) > 0)
+        _comm_filter_min_size = atoi(min_size);
+
+    char *max_size = getenv(A2A_FILTER_COMM_MAX_SIZE_ENVVAR);
+    if (max_size != NULL && atoi(max_size) > 0)
+        _comm_filter_max_size = atoi(max_size);
+
+    char *ids = getenv(A2A_FILTER_COMM_IDS_ENVVAR);
+    if (ids != NULL)
+    {
+        char *copy = strdup(ids);
+        assert(copy);
+        char *token = strtok(copy, ",");
+        while (token != NULL)
+        {
+            _comm_filter_ids = (comm_filter_id_range_t *)realloc(_comm_filter_ids, (_comm_filter_num_ids + 1) * sizeof(comm_filter_id_range_t));
+            assert(_comm_filter_ids);
+            char *dash = strchr(token, '-');
+            if (dash != NULL)
+            {
+                *dash = '\0';
+                _comm_filter_ids[_comm_filter_num_ids].start = (uint32_t)strtoul(token, NULL, 10);
+                _comm_filter_ids[_comm_filter_num_ids].end = (uint32_t)strtoul(dash + 1, NULL, 10);
+            }
+            else
+            {
+                _comm_filter_ids[_comm_filter_num_ids].start = (uint32_t)strtoul(token, NULL, 10);
+                _comm_filter_ids[_comm_filter_num_ids].end = _comm_filter_ids[_comm_filter_num_ids].start;
+            }
+            _comm_filter_num_ids++;
+            token = strtok(NULL, ",");
+        }
+        free(copy);
+    }
+
+    char *names = getenv(A2A_FILTER_COMM_NAMES_ENVVAR);
+    if (names != NULL)
+    {
+        char *copy = strdup(names);
+        assert(copy);
+        char *token = strtok(copy, ",");
+        while (token != NULL)
+        {
+            _comm_filter_names = (char **)realloc(_comm_filter_names, (_comm_filter_num_names + 1) * sizeof(char *));
+            assert(_comm_filter_names);
+            _comm_filter_names[_comm_filter_num_names] = strdup(token);
+            assert(_comm_filter_names[_comm_filter_num_names]);
+            _comm_filter_num_names++;
+            token = strtok(NULL, ",");
+        }
+        free(copy);
+    }
+
+    char *callsites = getenv(A2A_FILTER_CALLSITES_ENVVAR);
+    if (callsites != NULL)
+    {
+        char *copy = strdup(callsites);
+        assert(copy);
+        char *token = strtok(copy, ",");
+        while (token != NULL)
+        {
+            _comm_filter_callsites = (uint64_t *)realloc(_comm_filter_callsites, (_comm_filter_num_callsites + 1) * sizeof(uint64_t));
+            assert(_comm_filter_callsites);
+            _comm_filter_callsites[_comm_filter_num_callsites] = strtoull(token, NULL, 16);
+            _comm_filter_num_callsites++;
+            token = strtok(NULL, ",");
+        }
+        free(copy);
+    }
+
+    _comm_filter_active = (_comm_filter_min_size >= 0 || _comm_filter_max_size >= 0 ||
+                           _comm_filter_num_ids > 0 || _comm_filter_num_names > 0);
+}
+
+// Pure predicate check; name may be NULL when no name predicate is set.
+__attribute__((unused)) static int comm_filter_match(uint32_t comm_id, int comm_size, const char *name)
+{
+    int i;
+    if (_comm_filter_min_size >= 0 && comm_size < _comm_filter_min_size)
+        return 0;
+    if (_comm_filter_max_size >= 0 && comm_size > _comm_filter_max_size)
+        return 0;
+    if (_comm_filter_num_ids > 0)
+    {
+        int found = 0;
+        for (i = 0; i < _comm_filter_num_ids; i++)
+        {
+            if (comm_id >= _comm_filter_ids[i].start && comm_id <= _comm_filter_ids[i].end)
+            {
+                found = 1;
+                break;
+            }
+        }
+        if (!found)
+            return 0;
+    }
+    if (_comm_filter_num_names > 0)
+    {
+        int found = 0;
+        if (name != NULL)
+        {
+            for (i = 0; i < _comm_filter_num_names; i++)
+            {
+                if (strcmp(name, _comm_filter_names[i]) == 0)
+                {
+                    found = 1;
+                    break;
+                }
+            }
+        }
+        if (!found)
+            return 0;
+    }
+    return 1;
+}
+
+__attribute__((unused)) static int comm_filter_evaluate(MPI_Comm comm, uint32_t comm_id, int comm_size)
+{
+    char name[MPI_MAX_OBJECT_NAME];
+    char *name_ptr = NULL;
+    if (_comm_filter_num_names > 0)
+    {
+        int name_len = 0;
+        name[0] = '\0';
+        PMPI_Comm_get_name(comm, name, &name_len);
+        name_ptr = name;
+    }
+    return comm_filter_match(comm_id, comm_size, name_ptr);
+}
+
+// Cached per-communicator verdict. The write is idempotent (every rank
+// computes the same value) so it does not need the profiler lock.
+__attribute__((unused)) static int comm_filter_allow(comm_data_t *comm_data, int comm_size)
+{
+    if (comm_data->filter_verdict < 0)
+        comm_data->filter_verdict = comm_filter_evaluate(comm_data->comm, comm_data->id, comm_size);
+    return comm_data->filter_verdict;
+}
+
+// Per-call check of the call-site filter: hash the raw addresses, look the
+// verdict up, and only normalize the trace (callsite_key()) on the first
+// sighting of a call site.
+__attribute__((unused)) static int comm_filter_callsite_allow(void **addrs, size_t trace_size)
+{
+    int i;
+    uint64_t hash = hash_fnv1a(addrs, trace_size * sizeof(void *));
+    comm_filter_trace_verdict_t *entry = _comm_filter_trace_cache[hash % COMM_FILTER_CALLSITE_BUCKETS];
+    while (entry != NULL)
+    {
+        if (entry->hash == hash && entry->trace_size == trace_size &&
+            memcmp(entry->addrs, addrs, trace_size * sizeof(void *)) == 0)
+        {
+            return entry->allowed;
+        }
+        entry = entry->next;
+    }
+
+    uint64_t key = callsite_key(addrs, trace_size);
+    int allowed = 0;
+    for (i = 0; i < _comm_filter_num_callsites; i++)
+    {
+        if (_comm_filter_callsites[i] == key)
+        {
+            allowed = 1;
+            break;
+        }
+    }
+
+    comm_filter_trace_verdict_t *new_entry = (comm_filter_trace_verdict_t *)malloc(sizeof(comm_filter_trace_verdict_t));
+    assert(new_entry);
+    new_entry->hash = hash;
+    new_entry->trace_size = trace_size;
+    new_entry->addrs = (void **)malloc(trace_size * sizeof(void *));
+    assert(new_entry->addrs);
+    memcpy(new_entry->addrs, addrs, trace_size * sizeof(void *));
+    new_entry->allowed = allowed;
+    new_entry->next = _comm_filter_trace_cache[hash % COMM_FILTER_CALLSITE_BUCKETS];
+    _comm_filter_trace_cache[hash % COMM_FILTER_CALLSITE_BUCKETS] = new_entry;
+    return allowed;
+}
+
+#endif // COLLECTIVE_PROFILER_COMM_FILTER_H
@@ -7,16 +7,25 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "call_list.h"
+
 #ifndef _COLLECTIVE_PROFILER_COMMON_TYPES_H
 #define _COLLECTIVE_PROFILER_COMMON_TYPES_H
 
-// Compact way to save send/recv counts of ranks within a single MPI collective
+// Compact way to save send/recv counts of ranks within a single MPI collective.
+// Mostly-zero rows (sparse communication patterns such as halo exchanges over
+// alltoallv) are stored as (peer, count) pairs instead of a dense vector; the
+// checksum is always computed over the dense representation so row
+// deduplication is unaffected by how a row happens to be stored.
 typedef struct counts_data
 {
-    int *counters; // the actual counters (i.e., send/recv counts)
-    int num_ranks; // The number of ranks having that series of counters
-    int max_ranks; // The current size of the ranks array
-    int *ranks;    // The list of ranks having that series of counters
+    int *counters;     // the actual counters (i.e., send/recv counts); only the nonzero values when the row is sparse
+    uint64_t checksum; // Digest of the dense counters; lets comparisons reject mismatches with one integer compare
+    int num_ranks;     // The number of ranks having that series of counters
+    int max_ranks;     // The current size of the ranks array
+    int *ranks;        // The list of ranks having that series of counters
+    int num_nonzero;   // Number of stored (peer, count) pairs when the row is sparse
+    int *sparse_peers; // Peer index of each stored counter; NULL for dense rows
 } counts_data_t;
 
 // Data type for storing comm size, alltoallv counts, send/recv count, etc
@@ -25,9 +34,11 @@ typedef struct SRCountNode
     int size;
     int rank_send_vec_len; // =1 for alltoall and allgatherv, = comm_size for alltoallv
     int rank_recv_vec_len; // =1 for alltoall, = comm_size for alltoallv and allgatherv
-    uint64_t count; // How many time we detected the pattern; also size of list_calls
-    uint64_t max_calls;
-    uint64_t *list_calls; // Which calls produced the pattern
+    uint64_t count; // How many times we detected the pattern, i.e., total calls covered by list_calls
+    uint64_t num_intervals; // Number of intervals of list_calls in use
+    uint64_t max_intervals; // Current capacity of list_calls
+    call_interval_t *list_calls; // Which calls produced the pattern, as inclusive [start, end] intervals (see call_list.h)
+    uint64_t flushed_count; // How many of the calls were already written by an incremental checkpoint (see log_profiling_checkpoint)
     int comm;
     int sendtype_size;
     int recvtype_size;
@@ -37,6 +48,8 @@ typedef struct SRCountNode
     counts_data_t **recv_data; // Array of unique series of recv counters
     double *op_exec_times;
     double *late_arrival_timings;
+    uint64_t signature;             // Digest of (size, type sizes, send/recv matrices); used to index the node
+    struct SRCountNode *hash_next;  // Next node in the same hash bucket (collision chain)
     struct SRCountNode *next;
 } SRCountNode_t;
 
@@ -49,6 +62,7 @@ typedef struct displs_data
     int num_ranks; // The number of ranks having that series of displacements
     int max_ranks; // The current size of the ranks array
     int *ranks;    // The list of ranks having that series of displacements
+    int derived_from_counts; // When set, displs is NULL: these ranks' displacements are the exclusive prefix sum of their counts and can be rebuilt from the counts data for the same calls
 } displs_data_t;
 
 // Data type for storing comm size, alltoallv counts, send/recv count, etc
@@ -57,9 +71,10 @@ typedef struct SRDisplNode
     int size;
     int rank_send_vec_len; // =1 for alltoall and allgatherv, = comm_size for alltoallv
     int rank_recv_vec_len; // =1 for alltoall, = comm_size for alltoallv and allgatherv
-    uint64_t count; // How many time we detected the pattern; also size of list_calls
-    uint64_t max_calls;
-    uint64_t *list_calls; // Which calls produced the pattern
+    uint64_t count; // How many times we detected the pattern, i.e., total calls covered by list_calls
+    uint64_t num_intervals; // Number of intervals of list_calls in use
+    uint64_t max_intervals; // Current capacity of list_calls
+    call_interval_t *list_calls; // Which calls produced the pattern, as inclusive [start, end] intervals (see call_list.h)
     int comm;
     int sendtype_size;
     int recvtype_size;
@@ -99,6 +114,8 @@ typedef struct avCallPattern  // TODO is this anything to do with counts? What i
     uint64_t *calls;
     avPattern_t *spatterns;
     avPattern_t *rpatterns;
+    uint64_t signature;              // Digest of the normalized (n_ranks, n_peers) pattern sets; used to index the node
+    struct avCallPattern *hash_next; // Next node in the same hash bucket (collision chain)
     struct avCallPattern *next;
 } avCallPattern_t;
 
@@ -107,7 +124,9 @@ typedef avCallPattern_t CallPattern_t;
 typedef struct caller_info
 {
     uint64_t n_calls;
-    uint64_t *calls;
+    uint64_t num_intervals;
+    uint64_t max_intervals;
+    call_interval_t *calls; // Inclusive [start, end] intervals (see call_list.h)
     char *caller;
     struct caller_info *next;
 } caller_info_t;
@@ -0,0 +1,174 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#define _GNU_SOURCE // fopencookie
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+
+#include "collective_profiler_config.h"
+#include "common_utils.h"
+#include "compress.h"
+#include "node_aggregate.h"
+
+#define COMPRESS_CHUNK_SIZE (64 * 1024)
+#define COMPRESS_FLUSH_INTERVAL (4 * 1024 * 1024) // Bytes of input between embedded sync flush points
+
+typedef struct compress_cookie
+{
+    FILE *f;
+    z_stream strm;
+    size_t since_flush;
+    unsigned char out[COMPRESS_CHUNK_SIZE];
+} compress_cookie_t;
+
+int compression_enabled(const char *output_class)
+{
+    static char *selection = NULL;
+    static int parsed = 0;
+
+    if (!parsed)
+    {
+        selection = getenv(A2A_COMPRESS_ENVVAR);
+        parsed = 1;
+    }
+    if (selection == NULL)
+    {
+        return 0;
+    }
+    if (strcmp(selection, "all") == 0)
+    {
+        return 1;
+    }
+
+    // Look for the class as a comma-separated token
+    const char *cursor = selection;
+    size_t len = strlen(output_class);
+    while ((cursor = strstr(cursor, output_class)) != NULL)
+    {
+        int starts = (cursor == selection || cursor[-1] == ',');
+        int ends = (cursor[len] == '\0' || cursor[len] == ',');
+        if (starts && ends)
+        {
+            return 1;
+        }
+        cursor += len;
+    }
+    return 0;
+}
+
+static int compress_drain(compress_cookie_t *cookie, int flush)
+{
+    do
+    {
+        cookie->strm.next_out = cookie->out;
+        cookie->strm.avail_out = COMPRESS_CHUNK_SIZE;
+        int rc = deflate(&(cookie->strm), flush);
+        if (rc == Z_STREAM_ERROR)
+        {
+            return -1;
+        }
+        size_t have = COMPRESS_CHUNK_SIZE - cookie->strm.avail_out;
+        if (have > 0 && fwrite(cookie->out, 1, have, cookie->f) != have)
+        {
+            return -1;
+        }
+    } while (cookie->strm.avail_out == 0);
+    return 0;
+}
+
+static ssize_t compress_cookie_write(void *c, const char *buf, size_t size)
+{
+    compress_cookie_t *cookie = (compress_cookie_t *)c;
+
+    cookie->strm.next_in = (unsigned char *)buf;
+    cookie->strm.avail_in = size;
+    if (compress_drain(cookie, Z_NO_FLUSH))
+    {
+        return -1;
+    }
+
+    cookie->since_flush += size;
+    if (cookie->since_flush >= COMPRESS_FLUSH_INTERVAL)
+    {
+        // Embedded flush point: the file is readable up to here even if the
+        // job dies before the stream is finished.
+        if (compress_drain(cookie, Z_SYNC_FLUSH))
+        {
+            return -1;
+        }
+        cookie->since_flush = 0;
+    }
+    return size;
+}
+
+static int compress_cookie_close(void *c)
+{
+    compress_cookie_t *cookie = (compress_cookie_t *)c;
+    int rc = compress_drain(cookie, Z_FINISH);
+    deflateEnd(&(cookie->strm));
+    if (fclose(cookie->f) != 0)
+    {
+        rc = -1;
+    }
+    free(cookie);
+    return rc;
+}
+
+FILE *profile_fopen(const char *filename, const char *mode, const char *output_class)
+{
+    // Node aggregation captures the output as an in-memory section; the
+    // per-node writer owns the actual file (and its possible compression).
+    if (node_aggregation_enabled() || single_file_enabled())
+    {
+        return node_aggregate_fopen(filename);
+    }
+    if (!compression_enabled(output_class))
+    {
+        return fopen(filename, mode);
+    }
+
+    char *gz_filename = NULL;
+    int rc;
+    _asprintf(gz_filename, rc, "%s.gz", filename);
+    assert(rc > 0);
+
+    compress_cookie_t *cookie = (compress_cookie_t *)malloc(sizeof(compress_cookie_t));
+    assert(cookie);
+    memset(&(cookie->strm), 0, sizeof(cookie->strm));
+    cookie->since_flush = 0;
+    // windowBits 15 + 16 selects the gzip wrapper; appending starts a new gzip
+    // member, which readers concatenate transparently.
+    if (deflateInit2(&(cookie->strm), Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        free(cookie);
+        free(gz_filename);
+        return NULL;
+    }
+
+    cookie->f = fopen(gz_filename, mode);
+    free(gz_filename);
+    if (cookie->f == NULL)
+    {
+        deflateEnd(&(cookie->strm));
+        free(cookie);
+        return NULL;
+    }
+
+    cookie_io_functions_t io = {NULL, compress_cookie_write, NULL, compress_cookie_close};
+    FILE *f = fopencookie(cookie, mode, io);
+    if (f == NULL)
+    {
+        deflateEnd(&(cookie->strm));
+        fclose(cookie->f);
+        free(cookie);
+        return NULL;
+    }
+    return f;
+}
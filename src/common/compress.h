@@ -0,0 +1,34 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef COLLECTIVE_PROFILER_COMPRESS_H
+#define COLLECTIVE_PROFILER_COMPRESS_H
+
+#include <stdio.h>
+
+// Optional transparent compression stage between the profile serializers and
+// the file system. When a given output class is selected via A2A_COMPRESS
+// (comma-separated list of classes, or "all"), profile_fopen() returns a
+// stream - built with fopencookie() - whose writes go through a chunked
+// deflate encoder emitting a gzip file, so the loggers keep using plain
+// fprintf/fwrite and the commit phase writes far fewer bytes. A sync flush
+// point is embedded every few MiB so a truncated file (killed job) is still
+// readable up to the last flush. Appending opens a new gzip member, which
+// standard readers handle transparently.
+//
+// The encoder is deliberately hidden behind this interface: the deflate calls
+// live in compress.c only, so a zstd or LZ4 backend can be slotted in on
+// systems that ship those libraries.
+
+// Returns 1 when A2A_COMPRESS selects <output_class> (or "all").
+int compression_enabled(const char *output_class);
+
+// fopen() replacement for profile outputs. When compression is enabled for
+// <output_class>, opens <filename>.gz and returns a compressing stream;
+// otherwise a plain fopen(filename, mode). mode must be "w" or "a".
+FILE *profile_fopen(const char *filename, const char *mode, const char *output_class);
+
+#endif // COLLECTIVE_PROFILER_COMPRESS_H
@@ -0,0 +1,504 @@
+/*************************************************************************
+ * Copyright (c) 2020-2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef MPI_COLLECTIVE_PROFILER_COUNTS_ENGINE_H
+#define MPI_COLLECTIVE_PROFILER_COUNTS_ENGINE_H
+
+// Shared count-collection engine. The per-collective profilers used to carry
+// their own copy of the count bookkeeping (unique-row deduplication, rank
+// lists, call lists); the only real difference between them is the length of
+// the count vector each rank contributes: comm_size for alltoallv, 1 for
+// alltoall and the send side of allgatherv. This header is included by each
+// profiler translation unit after it defined the specialization macros below,
+// so the vector lengths are compile-time constants in every build and the
+// alltoall libraries store a single int per rank instead of full-size rows.
+// Optimizations and fixes made here benefit every collective at once.
+//
+// Macros a translation unit can define before including this header:
+//   COUNTS_ENGINE_SEND_VEC_LEN(size)  ints each rank contributes on the send
+//                                     side (default: (size))
+//   COUNTS_ENGINE_RECV_VEC_LEN(size)  same for the receive side (default: (size))
+//   COUNTS_ENGINE_DEBUG               debug printf-like macro of the collective
+//
+// All state and functions are static: each profiler library embeds its own
+// engine instance, sized for exactly one collective.
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "collective_profiler_config.h"
+#include "common_types.h"
+#include "arena.h"
+#include "hash.h"
+
+#ifndef COUNTS_ENGINE_SEND_VEC_LEN
+#define COUNTS_ENGINE_SEND_VEC_LEN(size) (size)
+#endif
+
+#ifndef COUNTS_ENGINE_RECV_VEC_LEN
+#define COUNTS_ENGINE_RECV_VEC_LEN(size) (size)
+#endif
+
+#ifndef COUNTS_ENGINE_DEBUG
+#define COUNTS_ENGINE_DEBUG(...)
+#endif
+
+
+static SRCountNode_t *counts_head = NULL;
+static SRCountNode_t *counts_tail = NULL;
+// All count bookkeeping (nodes, unique rows, rank lists, call lists) is
+// bump-allocated out of one arena and released as a whole, so the hot
+// insertion path never goes through per-object malloc/realloc and finalize
+// does not need to walk the structures to free them.
+static arena_t counts_arena = ARENA_INITIALIZER(COUNTS_ARENA_BLOCK_SIZE);
+
+// Approximate bytes of live count data, used by the memory-budget engine of
+// the collectives to trigger a commit-and-release cycle when a cap is set.
+// Grown storage leaves its old copy in the arena until release, so that cost
+// is counted as well.
+static size_t counts_engine_bytes = 0;
+
+static void *counts_arena_alloc(size_t size)
+{
+    counts_engine_bytes += size;
+    return arena_alloc(&counts_arena, size);
+}
+
+static void *counts_arena_grow(void *old, size_t old_size, size_t new_size)
+{
+    counts_engine_bytes += new_size;
+    return arena_grow(&counts_arena, old, old_size, new_size);
+}
+
+__attribute__((unused)) static size_t counts_engine_mem_used(void)
+{
+    return counts_engine_bytes;
+}
+// Hash index over the SRCountNode_t list: nodes are bucketized on a digest of
+// (size, type sizes, count matrices) so that a repeated call is matched with a
+// single bucket probe instead of a walk of the full list with per-node matrix
+// comparisons.
+static SRCountNode_t *counts_hash_index[COUNTS_HASH_BUCKETS] = {NULL};
+
+// Node that recorded the most recent call, for the unchanged-call fast path:
+// when the caller has established that a call's counts are identical to the
+// previous one, the call ID can be appended here without the count matrices.
+static SRCountNode_t *counts_last_node = NULL;
+
+static counts_data_t *lookup_rank_counts_data(int data_size, counts_data_t **data, int rank)
+{
+    int i, j;
+    for (i = 0; i < data_size; i++)
+    {
+        for (j = 0; j < data[i]->num_ranks; j++)
+        {
+            if (rank == data[i]->ranks[j])
+            {
+                return data[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+// Compare a stored row - dense or sparse - with a dense candidate row.
+// Dense rows are contiguous int arrays so we let memcmp do the heavy lifting
+// (vectorized by libc) instead of a scalar int-by-int loop; sparse rows are
+// walked against the candidate's nonzeros.
+static bool counter_row_matches(counts_data_t *data, int *count, int vec_len)
+{
+    if (data->sparse_peers == NULL)
+    {
+        return memcmp(data->counters, count, vec_len * sizeof(int)) == 0;
+    }
+
+    int i, n = 0;
+    for (i = 0; i < vec_len; i++)
+    {
+        if (count[i] == 0)
+        {
+            continue;
+        }
+        if (n >= data->num_nonzero || data->sparse_peers[n] != i || data->counters[n] != count[i])
+        {
+            return false;
+        }
+        n++;
+    }
+    return n == data->num_nonzero;
+}
+
+static bool same_call_counters(SRCountNode_t *call_data, int *send_counts, int *recv_counts, int size)
+{
+    int rank;
+
+    COUNTS_ENGINE_DEBUG("Comparing data with existing data...\n");
+    COUNTS_ENGINE_DEBUG("-> Comparing send counts...\n");
+    // First compare the send counts
+    for (rank = 0; rank < size; rank++)
+    {
+        counts_data_t *data = lookup_rank_counts_data(call_data->send_data_size, call_data->send_data, rank);
+        assert(data);
+        if (!counter_row_matches(data, &(send_counts[rank * COUNTS_ENGINE_SEND_VEC_LEN(size)]), COUNTS_ENGINE_SEND_VEC_LEN(size)))
+        {
+            COUNTS_ENGINE_DEBUG("Data differs\n");
+            return false;
+        }
+    }
+    COUNTS_ENGINE_DEBUG("-> Send counts are the same\n");
+
+    // Then the receive counts
+    COUNTS_ENGINE_DEBUG("-> Comparing recv counts...\n");
+    for (rank = 0; rank < size; rank++)
+    {
+        counts_data_t *data = lookup_rank_counts_data(call_data->recv_data_size, call_data->recv_data, rank);
+        assert(data);
+        if (!counter_row_matches(data, &(recv_counts[rank * COUNTS_ENGINE_RECV_VEC_LEN(size)]), COUNTS_ENGINE_RECV_VEC_LEN(size)))
+        {
+            COUNTS_ENGINE_DEBUG("Data differs\n");
+            return false;
+        }
+    }
+
+    COUNTS_ENGINE_DEBUG("Data is the same\n");
+    return true;
+}
+
+static counts_data_t *lookupCounters(int vec_len, int num, counts_data_t **list, int *count)
+{
+    int i;
+    // Most candidates are rejected by the stored per-row checksum with a single
+    // integer compare; only rows with a matching digest are fully compared.
+    uint64_t checksum = hash_fnv1a(count, vec_len * sizeof(int));
+    for (i = 0; i < num; i++)
+    {
+        if (list[i]->checksum != checksum)
+        {
+            continue;
+        }
+
+        if (counter_row_matches(list[i], count, vec_len))
+        {
+            return list[i];
+        }
+    }
+
+    return NULL;
+}
+
+static counts_data_t *lookupSendCounters(int *counts, SRCountNode_t *call_data)
+{
+    return lookupCounters(call_data->rank_send_vec_len, call_data->send_data_size, call_data->send_data, counts);
+}
+
+static counts_data_t *lookupRecvCounters(int *counts, SRCountNode_t *call_data)
+{
+    return lookupCounters(call_data->rank_recv_vec_len, call_data->recv_data_size, call_data->recv_data, counts);
+}
+
+static int add_rank_to_counters_data(int rank, counts_data_t *counters_data)
+{
+    if (counters_data->num_ranks >= counters_data->max_ranks)
+    {
+        int new_max = counters_data->num_ranks + MAX_TRACKED_RANKS;
+        counters_data->ranks = (int *)counts_arena_grow(counters_data->ranks, counters_data->max_ranks * sizeof(int), new_max * sizeof(int));
+        counters_data->max_ranks = new_max;
+    }
+
+    counters_data->ranks[counters_data->num_ranks] = rank;
+    counters_data->num_ranks++;
+    return 0;
+}
+
+static counts_data_t *new_counter_data(int vec_len, int rank, int *counts)
+{
+    counts_data_t *new_data = (counts_data_t *)counts_arena_alloc(sizeof(counts_data_t));
+    new_data->num_ranks = 0;
+    new_data->max_ranks = MAX_TRACKED_RANKS;
+    new_data->ranks = (int *)counts_arena_alloc(new_data->max_ranks * sizeof(int));
+
+    // Mostly-zero rows (sparse patterns such as halo exchanges) are stored as
+    // (peer, count) pairs: on a 4096-rank communicator where each rank talks
+    // to a couple dozen neighbors this shrinks the row by the actual sparsity
+    // factor. Short rows and dense rows keep the flat vector.
+    int i, num_nonzero = 0;
+    for (i = 0; i < vec_len; i++)
+    {
+        if (counts[i] != 0)
+        {
+            num_nonzero++;
+        }
+    }
+    if (vec_len >= COUNTS_SPARSE_MIN_VEC_LEN && num_nonzero <= vec_len / COUNTS_SPARSE_DENSITY_DENOM)
+    {
+        new_data->num_nonzero = num_nonzero;
+        new_data->counters = (int *)counts_arena_alloc(num_nonzero * sizeof(int));
+        new_data->sparse_peers = (int *)counts_arena_alloc(num_nonzero * sizeof(int));
+        int n = 0;
+        for (i = 0; i < vec_len; i++)
+        {
+            if (counts[i] != 0)
+            {
+                new_data->sparse_peers[n] = i;
+                new_data->counters[n] = counts[i];
+                n++;
+            }
+        }
+    }
+    else
+    {
+        new_data->num_nonzero = 0;
+        new_data->sparse_peers = NULL;
+        new_data->counters = (int *)counts_arena_alloc(vec_len * sizeof(int));
+        memcpy(new_data->counters, counts, vec_len * sizeof(int));
+    }
+
+    // Always digest the dense representation so deduplication is independent
+    // of how the row ends up being stored.
+    new_data->checksum = hash_fnv1a(counts, vec_len * sizeof(int));
+    new_data->ranks[new_data->num_ranks] = rank;
+    new_data->num_ranks++;
+
+    return new_data;
+}
+
+static int add_new_send_counters_to_counters_data(SRCountNode_t *call_data, int rank, int *counts)
+{
+    counts_data_t *new_data = new_counter_data(call_data->rank_send_vec_len, rank, counts);
+    call_data->send_data[call_data->send_data_size] = new_data;
+    call_data->send_data_size++;
+
+    return 0;
+}
+
+static int add_new_recv_counters_to_counters_data(SRCountNode_t *call_data, int rank, int *counts)
+{
+    counts_data_t *new_data = new_counter_data(call_data->rank_recv_vec_len, rank, counts);
+    call_data->recv_data[call_data->recv_data_size] = new_data;
+    call_data->recv_data_size++;
+
+    return 0;
+}
+
+static int compareAndSaveSendCounters(int rank, int *counts, SRCountNode_t *call_data)
+{
+    counts_data_t *ptr = lookupSendCounters(counts, call_data);
+    if (ptr)
+    {
+        COUNTS_ENGINE_DEBUG("Add send rank %d to existing count data\n", rank);
+        if (add_rank_to_counters_data(rank, ptr))
+        {
+            fprintf(stderr, "[%s:%d][ERROR] unable to add rank counters (rank: %d)\n", __FILE__, __LINE__, rank);
+            return -1;
+        }
+    }
+    else
+    {
+        COUNTS_ENGINE_DEBUG("Add send new count data for rank %d\n", rank);
+        if (add_new_send_counters_to_counters_data(call_data, rank, counts))
+        {
+            fprintf(stderr, "[%s:%d][ERROR] unable to add new send counters\n", __FILE__, __LINE__);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int compareAndSaveRecvCounters(int rank, int *counts, SRCountNode_t *call_data)
+{
+    counts_data_t *ptr = lookupRecvCounters(counts, call_data);
+    if (ptr)
+    {
+        COUNTS_ENGINE_DEBUG("Add recv rank %d to existing count data\n", rank);
+        if (add_rank_to_counters_data(rank, ptr))
+        {
+            fprintf(stderr, "[ERROR] unable to add rank counters\n");
+            return -1;
+        }
+    }
+    else
+    {
+        COUNTS_ENGINE_DEBUG("Add recv new count data for rank %d\n", rank);
+        if (add_new_recv_counters_to_counters_data(call_data, rank, counts))
+        {
+            fprintf(stderr, "[ERROR] unable to add new recv counters\n");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// Compute the digest identifying a unique (size, type sizes, send matrix, recv matrix)
+// combination. Used to index the SRCountNode_t list so repeated calls are matched with
+// a single bucket probe rather than a full list traversal.
+static uint64_t sendrecv_count_signature(int *sbuf, int *rbuf, int size, int sendtype_size, int recvtype_size)
+{
+    uint64_t sig = hash_fnv1a_init();
+    sig = hash_fnv1a_update(sig, &size, sizeof(size));
+    sig = hash_fnv1a_update(sig, &sendtype_size, sizeof(sendtype_size));
+    sig = hash_fnv1a_update(sig, &recvtype_size, sizeof(recvtype_size));
+    sig = hash_fnv1a_update(sig, sbuf, size * COUNTS_ENGINE_SEND_VEC_LEN(size) * sizeof(int));
+    sig = hash_fnv1a_update(sig, rbuf, size * COUNTS_ENGINE_RECV_VEC_LEN(size) * sizeof(int));
+    return sig;
+}
+
+// Compare new send/recv count data with existing data.
+// If there is a match, add the call to the existing node. Add new data, otherwise.
+// Some library variants compile the engine in without collecting counts, hence
+// the unused attribute.
+__attribute__((unused)) static int insert_sendrecv_count_data(int *sbuf, int *rbuf, int size, int sendtype_size, int recvtype_size, uint64_t call_id)
+{
+    SRCountNode_t *newNode = NULL;
+    SRCountNode_t *temp;
+
+    COUNTS_ENGINE_DEBUG("Insert data for a new call...\n");
+
+    assert(sbuf);
+    assert(rbuf);
+
+    // Look the signature up in the hash index; the digest only narrows the search
+    // down to a bucket, so nodes with a matching digest still go through the full
+    // comparison to guard against collisions.
+    uint64_t sig = sendrecv_count_signature(sbuf, rbuf, size, sendtype_size, recvtype_size);
+    temp = counts_hash_index[sig % COUNTS_HASH_BUCKETS];
+    while (temp != NULL)
+    {
+        if (temp->signature == sig && temp->size == size && temp->recvtype_size == recvtype_size && temp->sendtype_size == sendtype_size && same_call_counters(temp, sbuf, rbuf, size))
+        {
+            // Data exist, adding call info to it
+            COUNTS_ENGINE_DEBUG("Data already exists, updating metadata...\n");
+            assert(temp->list_calls);
+            // A call directly following the previous one extends the last
+            // interval in place; only the rarer non-consecutive case needs a
+            // new interval (and possibly storage).
+            if (!call_interval_list_absorb(temp->list_calls, temp->num_intervals, call_id))
+            {
+                if (temp->num_intervals >= temp->max_intervals)
+                {
+                    uint64_t new_max = temp->max_intervals * 2;
+                    temp->list_calls = (call_interval_t *)counts_arena_grow(temp->list_calls, temp->max_intervals * sizeof(call_interval_t), new_max * sizeof(call_interval_t));
+                    temp->max_intervals = new_max;
+                }
+                call_interval_list_push(temp->list_calls, &temp->num_intervals, call_id);
+            }
+            temp->count++;
+            counts_last_node = temp;
+            COUNTS_ENGINE_DEBUG("Metadata successfully updated\n");
+            return 0;
+        }
+        temp = temp->hash_next;
+    }
+
+    newNode = (SRCountNode_t *)counts_arena_alloc(sizeof(SRCountNode_t));
+
+    newNode->size = size;
+    newNode->rank_send_vec_len = COUNTS_ENGINE_SEND_VEC_LEN(size);
+    newNode->rank_recv_vec_len = COUNTS_ENGINE_RECV_VEC_LEN(size);
+    newNode->count = 1;
+    newNode->list_calls = (call_interval_t *)counts_arena_alloc(DEFAULT_TRACKED_CALLS * sizeof(call_interval_t));
+    newNode->max_intervals = DEFAULT_TRACKED_CALLS;
+    newNode->num_intervals = 0;
+    newNode->flushed_count = 0;
+    // We have at most <size> different counts (one per rank) and we just allocate pointers of pointers here, not much space used
+    newNode->send_data = (counts_data_t **)counts_arena_alloc(size * sizeof(counts_data_t));
+    newNode->send_data_size = 0;
+    newNode->recv_data = (counts_data_t **)counts_arena_alloc(size * sizeof(counts_data_t));
+    newNode->recv_data_size = 0;
+
+    // We add rank's data one by one so we can compress the data when possible
+    int _rank;
+
+    COUNTS_ENGINE_DEBUG("handling send counts...\n");
+    for (_rank = 0; _rank < size; _rank++)
+    {
+        if (compareAndSaveSendCounters(_rank, &(sbuf[_rank * COUNTS_ENGINE_SEND_VEC_LEN(size)]), newNode))
+        {
+            fprintf(stderr, "[%s:%d][ERROR] unable to add send counters\n", __FILE__, __LINE__);
+            return -1;
+        }
+    }
+
+    COUNTS_ENGINE_DEBUG("handling recv counts...\n");
+    for (_rank = 0; _rank < size; _rank++)
+    {
+        if (compareAndSaveRecvCounters(_rank, &(rbuf[_rank * COUNTS_ENGINE_RECV_VEC_LEN(size)]), newNode))
+        {
+            fprintf(stderr, "[%s:%d][ERROR] unable to add recv counters\n", __FILE__, __LINE__);
+            return -1;
+        }
+    }
+
+    newNode->sendtype_size = sendtype_size;
+    newNode->recvtype_size = recvtype_size;
+    call_interval_list_push(newNode->list_calls, &newNode->num_intervals, call_id);
+    newNode->next = NULL;
+
+    COUNTS_ENGINE_DEBUG("Data for the new call has %d unique series for send counts and %d for recv counts\n", newNode->recv_data_size, newNode->send_data_size);
+
+    // Append to the list (the logger relies on insertion order) and index the node
+    if (counts_head == NULL)
+    {
+        counts_head = newNode;
+    }
+    else
+    {
+        counts_tail->next = newNode;
+    }
+    counts_tail = newNode;
+
+    newNode->signature = sig;
+    newNode->hash_next = counts_hash_index[sig % COUNTS_HASH_BUCKETS];
+    counts_hash_index[sig % COUNTS_HASH_BUCKETS] = newNode;
+    counts_last_node = newNode;
+
+    return 0;
+}
+
+// Unchanged-call fast path: append a call to the node that recorded the
+// previous one without supplying the count matrices. Only correct when the
+// caller has proven - e.g. with an allreduced per-rank "unchanged" flag - that
+// every rank's counts are identical to the previous profiled call. Returns
+// non-zero when there is no previous node (first call, or the engine was
+// released since); callers must then fall back to a full insert.
+__attribute__((unused)) static int counts_engine_repeat_last_call(uint64_t call_id)
+{
+    SRCountNode_t *node = counts_last_node;
+    if (node == NULL)
+    {
+        return -1;
+    }
+    if (!call_interval_list_absorb(node->list_calls, node->num_intervals, call_id))
+    {
+        if (node->num_intervals >= node->max_intervals)
+        {
+            uint64_t new_max = node->max_intervals * 2;
+            node->list_calls = (call_interval_t *)counts_arena_grow(node->list_calls, node->max_intervals * sizeof(call_interval_t), new_max * sizeof(call_interval_t));
+            node->max_intervals = new_max;
+        }
+        call_interval_list_push(node->list_calls, &node->num_intervals, call_id);
+    }
+    node->count++;
+    return 0;
+}
+
+// Drop all the count data at once: the arena backs every structure so no
+// walk of the lists is needed.
+__attribute__((unused)) static void counts_engine_release(void)
+{
+    counts_head = NULL;
+    counts_tail = NULL;
+    counts_last_node = NULL;
+    arena_release(&counts_arena);
+    counts_engine_bytes = 0;
+    memset(counts_hash_index, 0, sizeof(counts_hash_index));
+}
+
+#endif // MPI_COLLECTIVE_PROFILER_COUNTS_ENGINE_H
@@ -351,6 +351,86 @@ analyze_datatype(MPI_Datatype type, datatype_info_t *i)
     return 0;
 }
 
+// Cache of datatype analysis keyed on the MPI_Datatype handle. Applications
+// reuse the same handful of committed datatypes across millions of calls, so
+// the envelope decoding and the type-size query of the per-call paths are
+// paid once per datatype instead of once per call. Entries are dropped by the
+// MPI_Type_free shims of the profilers. The table is per translation unit,
+// like the rest of this header's state.
+#define DATATYPE_CACHE_BUCKETS (64)
+
+typedef struct datatype_cache_entry
+{
+    MPI_Datatype type;
+    datatype_info_t info;
+    struct datatype_cache_entry *next;
+} datatype_cache_entry_t;
+
+static datatype_cache_entry_t *_datatype_cache[DATATYPE_CACHE_BUCKETS] = {NULL};
+
+static inline unsigned int datatype_cache_bucket(MPI_Datatype type)
+{
+    // The handle is an integer or a pointer depending on the MPI; either way
+    // the low bits (above alignment) spread fine over a small table.
+    return (unsigned int)(((size_t)type >> 3) & (DATATYPE_CACHE_BUCKETS - 1));
+}
+
+static inline datatype_info_t *lookup_datatype_info(MPI_Datatype type)
+{
+    unsigned int bucket = datatype_cache_bucket(type);
+    datatype_cache_entry_t *entry = _datatype_cache[bucket];
+    while (entry != NULL)
+    {
+        if (entry->type == type)
+        {
+            return &(entry->info);
+        }
+        entry = entry->next;
+    }
+
+    entry = (datatype_cache_entry_t *)malloc(sizeof(datatype_cache_entry_t));
+    assert(entry);
+    entry->type = type;
+    entry->info.analyzed = false;
+    analyze_datatype(type, &(entry->info));
+    entry->next = _datatype_cache[bucket];
+    _datatype_cache[bucket] = entry;
+    return &(entry->info);
+}
+
+// Cached replacement for the per-call PMPI_Type_size queries.
+static inline int cached_type_size(MPI_Datatype type)
+{
+    return lookup_datatype_info(type)->size;
+}
+
+// Drop the cached analysis of a datatype; the handle may be recycled by the
+// MPI library after MPI_Type_free.
+static inline void datatype_cache_invalidate(MPI_Datatype type)
+{
+    unsigned int bucket = datatype_cache_bucket(type);
+    datatype_cache_entry_t *entry = _datatype_cache[bucket];
+    datatype_cache_entry_t *prev = NULL;
+    while (entry != NULL)
+    {
+        if (entry->type == type)
+        {
+            if (prev == NULL)
+            {
+                _datatype_cache[bucket] = entry->next;
+            }
+            else
+            {
+                prev->next = entry->next;
+            }
+            free(entry);
+            return;
+        }
+        prev = entry;
+        entry = entry->next;
+    }
+}
+
 static inline int
 save_datatype_info(char *collective_name, MPI_Comm comm, int comm_rank, int world_rank, uint64_t call_id, char *ctxt, datatype_info_t *dt_info)
 {
@@ -11,286 +11,78 @@
 #include "format.h"
 #include "common_utils.h"
 
-static char *add_range_uint64(char *str, uint64_t start, uint64_t end)
-{
-    int size;
-    if (str == NULL)
-    {
-        size = MAX_STRING_LEN;
-    }
-    else
-    {
-        size = strlen(str) + (MAX_STRING_LEN - get_remainder(strlen(str), MAX_STRING_LEN));
-    }
-    int ret = size;
-
-    if (str == NULL)
-    {
-        str = (char *)malloc(size * sizeof(char));
-        assert(str);
-        while (ret >= size)
-        {
-            ret = snprintf(str, size, "%" PRIu64 "-%" PRIu64, start, end);
-            if (ret < 0)
-            {
-                fprintf(stderr, "[%s:%d] snprintf failed\n", __FILE__, __LINE__);
-                return NULL;
-            }
-            if (ret >= size)
-            {
-                // truncated result, increasing the size of the buffer and trying again
-                size = size * 2;
-                str = (char *)realloc(str, size);
-                assert(str);
-            }
-        }
-        return str;
-    }
-    else
-    {
-        // We make sure we do not get a truncated result
-        char *s = NULL;
-        while (ret >= size)
-        {
-            if (s == NULL)
-            {
-                s = (char *)malloc(size * sizeof(char));
-                assert(s);
-            }
-            else
-            {
-                // truncated result, increasing the size of the buffer and trying again
-                size = size * 2;
-                char *tmp = (char *)realloc(s, size);
-                assert(tmp);
-                s = tmp;
-            }
-            ret = snprintf(s, size, "%s, %" PRIu64 "-%" PRIu64, str, start, end);
-            if (ret < 0)
-            {
-                fprintf(stderr, "[%s:%d] snprintf failed\n", __FILE__, __LINE__);
-                return NULL;
-            }
-        }
+// Range compression engine. The arrays are encoded in a single forward pass
+// into a growable buffer with a tracked write cursor: no strlen over the
+// accumulated output, no per-range allocation. Buffers can be reused across
+// rows (and calls) by the loggers to amortize the allocations.
 
-        if (s != NULL)
-        {
-            free(str);
-            str = s;
-        }
-
-        return str;
-    }
-}
+#define FORMAT_INT_MAX_CHARS (21) // Enough for a 64-bit integer in decimal, sign included
 
-static char *add_range(char *str, int start, int end)
+static void format_buf_reserve(format_buf_t *buf, size_t extra)
 {
-    int size;
-    if (str == NULL)
+    if (buf->len + extra + 1 <= buf->capacity)
     {
-        size = MAX_STRING_LEN;
+        return;
     }
-    else
-    {
-        size = strlen(str) + (MAX_STRING_LEN - get_remainder(strlen(str), MAX_STRING_LEN));
-    }
-    int ret = size;
 
-    if (str == NULL)
+    size_t new_capacity = (buf->capacity == 0) ? MAX_STRING_LEN : buf->capacity;
+    while (buf->len + extra + 1 > new_capacity)
     {
-        str = (char *)malloc(size * sizeof(char));
-        assert(str);
-        while (ret >= size)
-        {
-            ret = snprintf(str, size, "%d-%d", start, end);
-            if (ret < 0)
-            {
-                fprintf(stderr, "[%s:%d] snprintf failed\n", __FILE__, __LINE__);
-                return NULL;
-            }
-            if (ret >= size)
-            {
-                // truncated result, increasing the size of the buffer and trying again
-                size = size * 2;
-                str = (char *)realloc(str, size);
-                assert(str);
-            }
-        }
-        return str;
-    }
-    else
-    {
-        // We make sure we do not get a truncated result
-        char *s = NULL;
-        while (ret >= size)
-        {
-            if (s == NULL)
-            {
-                s = (char *)malloc(size * sizeof(char));
-                assert(s);
-            }
-            else
-            {
-                // truncated result, increasing the size of the buffer and trying again
-                size = size * 2;
-                char *tmp = (char *)realloc(s, size);
-                assert(tmp);
-                s = tmp;
-            }
-            ret = snprintf(s, size, "%s, %d-%d", str, start, end);
-            if (ret < 0)
-            {
-                fprintf(stderr, "[%s:%d] snprintf failed\n", __FILE__, __LINE__);
-                return NULL;
-            }
-        }
-
-        if (s != NULL)
-        {
-            free(str);
-            str = s;
-        }
-
-        return str;
+        new_capacity *= 2;
     }
+    buf->data = (char *)realloc(buf->data, new_capacity);
+    assert(buf->data);
+    buf->capacity = new_capacity;
 }
 
-static char *add_singleton_uint64(char *str, uint64_t n)
+void format_buf_release(format_buf_t *buf)
 {
-
-    int size;
-    if (str == NULL)
-    {
-        size = MAX_STRING_LEN;
-    }
-    else
-    {
-        size = strlen(str) + (MAX_STRING_LEN - get_remainder(strlen(str), MAX_STRING_LEN));
-    }
-    if (str == NULL)
+    if (buf->data != NULL)
     {
-        str = (char *)malloc(size * sizeof(char));
-        assert(str);
-        int rc = sprintf(str, "%" PRIu64, n);
-        assert(rc <= size);
-        return str;
+        free(buf->data);
     }
-
-    // We make sure we do not get a truncated result
-    char *s = NULL;
-    int ret = size;
-    while (ret >= size)
-    {
-        if (s == NULL)
-        {
-            s = (char *)malloc(size * sizeof(char));
-            assert(s);
-        }
-        else
-        {
-            // truncated result, increasing the size of the buffer and trying again
-            size = size * 2;
-            char *tmp = (char *)realloc(s, size);
-            assert(tmp);
-            s = tmp;
-        }
-        ret = snprintf(s, size, "%s, %" PRIu64, str, n);
-        if (ret < 0)
-        {
-            fprintf(stderr, "[%s:%d] snprintf failed\n", __FILE__, __LINE__);
-            return NULL;
-        }
-    }
-
-    if (s != NULL)
-    {
-        if (str != NULL)
-        {
-            free(str);
-        }
-        str = s;
-    }
-
-    return str;
+    buf->data = NULL;
+    buf->len = 0;
+    buf->capacity = 0;
 }
 
-static char *add_singleton(char *str, int n)
+static void compress_uint64_vec(format_buf_t *buf, uint64_t *array, size_t start_idx, size_t size)
 {
+    size_t i, start;
+    size_t end_idx = start_idx + size;
 
-    int size;
-    if (str == NULL)
-    {
-        size = MAX_STRING_LEN;
-    }
-    else
-    {
-        size = strlen(str) + (MAX_STRING_LEN - get_remainder(strlen(str), MAX_STRING_LEN));
-    }
-    int ret = size;
-    if (str == NULL)
-    {
-        str = (char *)malloc(size * sizeof(char));
-        assert(str);
-        int rc = sprintf(str, "%d", n);
-        assert(rc <= size);
-        return str;
-    }
-
-    // We make sure we do not get a truncated result
-    char *s = NULL;
-    while (ret >= size)
+    for (i = start_idx; i < end_idx; i++)
     {
-        if (s == NULL)
-        {
-            s = (char *)malloc(size * sizeof(char));
-            assert(s);
-        }
-        else
+        start = i;
+        while (i + 1 < end_idx && array[i] + 1 == array[i + 1])
         {
-            // truncated result, increasing the size of the buffer and trying again
-            size = size * 2;
-            char *tmp = (char *)realloc(s, size);
-            assert(tmp);
-            s = tmp;
+            i++;
         }
-        ret = snprintf(s, size, "%s, %d", str, n);
-        if (ret < 0)
+
+        // A separator, at most two values and a dash
+        format_buf_reserve(buf, 2 * FORMAT_INT_MAX_CHARS + 3);
+        if (i != start)
         {
-            fprintf(stderr, "[%s:%d] snprintf failed\n", __FILE__, __LINE__);
-            return NULL;
+            // We found a range
+            buf->len += sprintf(buf->data + buf->len,
+                                (start == start_idx) ? "%" PRIu64 "-%" PRIu64 : ", %" PRIu64 "-%" PRIu64,
+                                array[start], array[i]);
         }
-    }
-
-    if (s != NULL)
-    {
-        if (str != NULL)
+        else
         {
-            free(str);
+            // We found a singleton
+            buf->len += sprintf(buf->data + buf->len,
+                                (start == start_idx) ? "%" PRIu64 : ", %" PRIu64,
+                                array[i]);
         }
-        str = s;
     }
-
-    return str;
 }
 
-static char *_compress_uint64_vec(uint64_t *array, size_t start_idx, size_t size)
+static void compress_int_vec(format_buf_t *buf, int *array, size_t start_idx, size_t size)
 {
     size_t i, start;
-    char *compressedRep = NULL;
-
-    if (size == 0)
-        return NULL;
-
-#if DEBUG
-    fprintf(stderr, "Compressing:");
-    for (i = 0; i < size; i++)
-    {
-        fprintf(stderr, " %" PRIu64, array[i]);
-    }
-    fprintf(stderr, "\n");
-#endif // DEBUG
-
     size_t end_idx = start_idx + size;
+
     for (i = start_idx; i < end_idx; i++)
     {
         start = i;
@@ -298,131 +90,151 @@ static char *_compress_uint64_vec(uint64_t *array, size_t start_idx, size_t size
         {
             i++;
         }
+
+        // A separator, at most two values and a dash
+        format_buf_reserve(buf, 2 * FORMAT_INT_MAX_CHARS + 3);
         if (i != start)
         {
             // We found a range
-            compressedRep = add_range_uint64(compressedRep, array[start], array[i]);
+            buf->len += sprintf(buf->data + buf->len,
+                                (start == start_idx) ? "%d-%d" : ", %d-%d",
+                                array[start], array[i]);
         }
         else
         {
             // We found a singleton
-            compressedRep = add_singleton_uint64(compressedRep, array[i]);
+            buf->len += sprintf(buf->data + buf->len,
+                                (start == start_idx) ? "%d" : ", %d",
+                                array[i]);
         }
     }
-#if DEBUG
-    fprintf(stderr, "Compressed version is: %s\n", compressedRep);
-#endif // DEBUG
-    return compressedRep;
 }
 
-// compress_uint64_array compresses a matrix or a vector of uint64_t
+// compress_uint64_array_into compresses a matrix or a vector of uint64_t into
+// a caller-provided buffer, overwriting its previous content. The returned
+// string is owned by the buffer and remains valid until the next call.
 // The distinction between a matrix and a vector must be specified through the xsize and ysize parameters
-char *compress_uint64_array(uint64_t *array, size_t xsize, size_t ysize)
+char *compress_uint64_array_into(format_buf_t *buf, uint64_t *array, size_t xsize, size_t ysize)
 {
     size_t idx;
-    char *compressedRep = NULL;
+
+    buf->len = 0;
+    if (xsize == 0 || ysize == 0)
+    {
+        return NULL;
+    }
+
     for (idx = 0; idx < xsize * ysize; idx += xsize)
     {
-        char *compressed_line = _compress_uint64_vec(array, idx, xsize);
-        if (compressedRep == NULL)
+        if (idx > 0)
         {
-            compressedRep = strdup(compressed_line);
+            format_buf_reserve(buf, 1);
+            buf->data[buf->len] = '\n';
+            buf->len++;
         }
-        else
-        {
-            char *tmp = realloc(compressedRep, strlen(compressedRep) + strlen(compressed_line) + 2);
-            assert(tmp);
-            compressedRep = tmp;
-            size_t n;
-            size_t copy_idx = strlen(compressedRep);
-            compressedRep[copy_idx] = '\n';
-            copy_idx++;
-            for (n = 0; n < strlen(compressed_line); n++)
-            {
-                compressedRep[copy_idx] = compressed_line[n];
-                copy_idx++;
-            }
-            compressedRep[copy_idx] = '\0';
-        }
-        free(compressed_line);
+        compress_uint64_vec(buf, array, idx, xsize);
     }
-    return compressedRep;
+    buf->data[buf->len] = '\0';
+    return buf->data;
 }
 
-static char *_compress_int_vec(int *array, size_t start_idx, size_t size)
+// compress_int_array_into compresses a matrix or a vector of int into a
+// caller-provided buffer, overwriting its previous content. The returned
+// string is owned by the buffer and remains valid until the next call.
+// The distinction between a matrix and a vector must be specified through the xsize and ysize parameters
+char *compress_int_array_into(format_buf_t *buf, int *array, int xsize, int ysize)
 {
-    int i, start;
-    char *compressedRep = NULL;
+    size_t idx;
 
-    if (size == 0)
+    buf->len = 0;
+    if (xsize <= 0 || ysize <= 0)
     {
         return NULL;
     }
 
-#if DEBUG
-    fprintf(stderr, "Compressing:");
-    for (i = 0; i < size; i++)
+    for (idx = 0; idx < (size_t)xsize * (size_t)ysize; idx += xsize)
     {
-        fprintf(stderr, " %d", array[i]);
+        if (idx > 0)
+        {
+            format_buf_reserve(buf, 1);
+            buf->data[buf->len] = '\n';
+            buf->len++;
+        }
+        compress_int_vec(buf, array, idx, xsize);
     }
-    fprintf(stderr, "\n");
-#endif // DEBUG
+    buf->data[buf->len] = '\0';
+    return buf->data;
+}
 
-    size_t end_idx = start_idx + size;
-    for (i = start_idx; i < end_idx; i++)
+// compress_call_intervals_into renders an interval-compressed call list (see
+// call_list.h) into a caller-provided buffer, overwriting its previous
+// content. The output is identical to what compress_uint64_array_into
+// produces on the expanded list - the data is simply already in range form.
+char *compress_call_intervals_into(format_buf_t *buf, call_interval_t *intervals, uint64_t num_intervals)
+{
+    uint64_t i;
+
+    buf->len = 0;
+    if (num_intervals == 0)
     {
-        start = i;
-        while (i + 1 < end_idx && array[i] + 1 == array[i + 1])
+        return NULL;
+    }
+
+    for (i = 0; i < num_intervals; i++)
+    {
+        // A separator, at most two values and a dash
+        format_buf_reserve(buf, 2 * FORMAT_INT_MAX_CHARS + 3);
+        if (intervals[i].start != intervals[i].end)
         {
-            i++;
-        }
-        if (i != start)
-        {
-            // We found a range
-            compressedRep = add_range(compressedRep, array[start], array[i]);
+            buf->len += sprintf(buf->data + buf->len,
+                                (i == 0) ? "%" PRIu64 "-%" PRIu64 : ", %" PRIu64 "-%" PRIu64,
+                                intervals[i].start, intervals[i].end);
         }
         else
         {
-            // We found a singleton
-            compressedRep = add_singleton(compressedRep, array[i]);
+            buf->len += sprintf(buf->data + buf->len,
+                                (i == 0) ? "%" PRIu64 : ", %" PRIu64,
+                                intervals[i].start);
         }
     }
-#if DEBUG
-    fprintf(stderr, "Compressed version is: %s\n", compressedRep);
-#endif // DEBUG
-    return compressedRep;
+    buf->data[buf->len] = '\0';
+    return buf->data;
+}
+
+// compress_call_intervals renders an interval-compressed call list.
+char *compress_call_intervals(call_interval_t *intervals, uint64_t num_intervals)
+{
+    format_buf_t buf = FORMAT_BUF_INITIALIZER;
+    if (compress_call_intervals_into(&buf, intervals, num_intervals) == NULL)
+    {
+        format_buf_release(&buf);
+        return NULL;
+    }
+    return buf.data; // The caller owns and frees the string
+}
+
+// compress_uint64_array compresses a matrix or a vector of uint64_t
+// The distinction between a matrix and a vector must be specified through the xsize and ysize parameters
+char *compress_uint64_array(uint64_t *array, size_t xsize, size_t ysize)
+{
+    format_buf_t buf = FORMAT_BUF_INITIALIZER;
+    if (compress_uint64_array_into(&buf, array, xsize, ysize) == NULL)
+    {
+        format_buf_release(&buf);
+        return NULL;
+    }
+    return buf.data; // The caller owns and frees the string
 }
 
 // compress_int_array compresses a matrix or a vector of int.
 // The distinction between a matrix and a vector must be specified through the xsize and ysize parameters
 char *compress_int_array(int *array, int xsize, int ysize)
 {
-    size_t idx;
-    char *compressedRep = NULL;
-    for (idx = 0; idx < xsize * ysize; idx += xsize)
+    format_buf_t buf = FORMAT_BUF_INITIALIZER;
+    if (compress_int_array_into(&buf, array, xsize, ysize) == NULL)
     {
-        char *compressed_line = _compress_int_vec(array, idx, xsize);
-        if (compressedRep == NULL)
-        {
-            compressedRep = strdup(compressed_line);
-        }
-        else
-        {
-            char *tmp = realloc(compressedRep, strlen(compressedRep) + strlen(compressed_line) + 2);
-            assert(tmp);
-            compressedRep = tmp;
-            size_t n;
-            size_t copy_idx = strlen(compressedRep);
-            compressedRep[copy_idx] = '\n';
-            copy_idx++;
-            for (n = 0; n < strlen(compressed_line); n++)
-            {
-                compressedRep[copy_idx] = compressed_line[n];
-                copy_idx++;
-            }
-            compressedRep[copy_idx] = '\0';
-        }
-        free(compressed_line);
+        format_buf_release(&buf);
+        return NULL;
     }
-    return compressedRep;
+    return buf.data; // The caller owns and frees the string
 }
@@ -11,10 +11,30 @@
 #include <string.h>
 
 #include "collective_profiler_config.h"
+#include "call_list.h"
 
 #define FORMAT_VERSION_WRITE(_fd) (fprintf(_fd, "FORMAT_VERSION: %d\n\n", FORMAT_VERSION))
 
+// Growable output buffer with a tracked write cursor used by the range
+// compression engine. Reuse one buffer across rows to amortize allocations.
+typedef struct format_buf
+{
+    char *data;
+    size_t len; // Write cursor (excludes the terminating NUL)
+    size_t capacity;
+} format_buf_t;
+
+#define FORMAT_BUF_INITIALIZER \
+    {                          \
+        NULL, 0, 0             \
+    }
+
 char *compress_int_array(int *array, int xsize,  int ysize);
 char *compress_uint64_array(uint64_t *array, size_t xsize,  size_t ysize);
+char *compress_int_array_into(format_buf_t *buf, int *array, int xsize, int ysize);
+char *compress_uint64_array_into(format_buf_t *buf, uint64_t *array, size_t xsize, size_t ysize);
+char *compress_call_intervals(call_interval_t *intervals, uint64_t num_intervals);
+char *compress_call_intervals_into(format_buf_t *buf, call_interval_t *intervals, uint64_t num_intervals);
+void format_buf_release(format_buf_t *buf);
 
 #endif // MPI_COLLECTIVE_PROFILER_FORMAT_H
\ No newline at end of file
@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "grouping.h"
 
@@ -125,16 +126,28 @@ static group_t *lookup_group(grouping_engine_t *e, int val)
     return NULL;
 }
 
-static int add_and_shift(group_t *gp, int rank, int index)
+// Binary search over the group's sorted elements. Returns the first index
+// whose value is greater than val (upper bound) when after_equal is set, the
+// first index whose value is greater or equal (lower bound) otherwise.
+static int group_search(group_t *gp, int val, int *values, bool after_equal)
 {
-    int i = gp->size;
-    while (i > index)
+    int lo = 0;
+    int hi = gp->size;
+
+    while (lo < hi)
     {
-        gp->elts[i] = gp->elts[i - 1];
-        i--;
+        int mid = lo + (hi - lo) / 2;
+        int mid_val = values[gp->elts[mid]];
+        if (mid_val < val || (after_equal && mid_val == val))
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
     }
-    gp->elts[index] = rank;
-    return 0;
+    return lo;
 }
 
 static int add_elt_to_group(group_t *gp, int rank, int *values)
@@ -160,7 +173,7 @@ static int add_elt_to_group(group_t *gp, int rank, int *values)
     if (gp->size == gp->max_size)
     {
         DEBUG_GROUPING("[%s:%d] Growing group to %d\n", __FILE__, __LINE__, gp->max_size + DEFAULT_GP_SIZE)
-        gp->elts = (int *)realloc(gp->elts, gp->max_size + DEFAULT_GP_SIZE);
+        gp->elts = (int *)realloc(gp->elts, (gp->max_size + DEFAULT_GP_SIZE) * sizeof(int));
         if (gp->elts == NULL)
         {
             fprintf(stderr, "[%s:%d][ERROR] unable to grow group\n", __FILE__, __LINE__);
@@ -171,42 +184,17 @@ static int add_elt_to_group(group_t *gp, int rank, int *values)
 
     // The array is ordered
     DEBUG_GROUPING("[%s:%d] Inserting new element in group's elements\n", __FILE__, __LINE__);
-    int i = 0;
+    int i;
     // It is not unusual to have the same values coming over and over
     // so we check with the max value of the group, it actually saves
     // time quite often
-    if (val >= gp->max)
+    if (gp->size > 0 && val >= gp->max)
     {
         i = gp->size;
     }
     else
     {
-#if 0
-        // binary search
-        bool converged = false;
-        int idx = gp->size / 2;
-        fprintf(stderr, "-> checking index %d (size: %d)\n", idx, gp->size);
-        while (!converged && idx != 0) {
-            if (values[gp->elts[idx]] == val) {
-                converged = true;
-                i = idx;
-            }
-            if (values[gp->elts[idx + 1]] == val) {
-                converged = true;
-                i = idx + 2;
-            }
-            if (values[gp->elts[idx]] < val && values[gp->elts[idx + 1]] > val) {
-                converged = true;
-                i = idx + 1;
-            }
-            idx = idx / 2;
-        }
-#else
-        while (i < gp->size && values[gp->elts[i]] <= values[rank])
-        {
-            i++;
-        }
-#endif
+        i = group_search(gp, val, values, true);
     }
 
     if (i == gp->size)
@@ -218,7 +206,8 @@ static int add_elt_to_group(group_t *gp, int rank, int *values)
     else
     {
         DEBUG_GROUPING("[%s:%d] Shifting elements within the group at index %d...\n", __FILE__, __LINE__, i);
-        add_and_shift(gp, rank, i);
+        memmove(&gp->elts[i + 1], &gp->elts[i], (gp->size - i) * sizeof(int));
+        gp->elts[i] = rank;
     }
 
     DEBUG_GROUPING("[%s:%d] Updating group's metadata (first rank is %d)...\n", __FILE__, __LINE__, rank);
@@ -565,11 +554,7 @@ static int balance_group_with_new_element(grouping_engine_t *e, group_t *gp, int
     else
     {
         // We figure out where we need to split the group
-        int i = 0;
-        while (i < gp->size && values[gp->elts[i]] < values[rank])
-        {
-            i++;
-        }
+        int i = group_search(gp, values[rank], values, false);
 
         if (i < gp->size)
         {
@@ -633,6 +618,69 @@ int add_datapoint(grouping_engine_t *e, int rank, int *values)
     return 0;
 }
 
+typedef struct datapoint_sort
+{
+    int rank;
+    int val;
+} datapoint_sort_t;
+
+static int compare_datapoints(const void *a, const void *b)
+{
+    const datapoint_sort_t *dp1 = (const datapoint_sort_t *)a;
+    const datapoint_sort_t *dp2 = (const datapoint_sort_t *)b;
+    if (dp1->val != dp2->val)
+    {
+        return (dp1->val < dp2->val) ? -1 : 1;
+    }
+    return dp1->rank - dp2->rank;
+}
+
+// Bulk-load path: sort all the data points once and build the groups in a
+// single left-to-right sweep. Because values arrive in increasing order,
+// every insertion targets the tail group, so the engine never scans the
+// group list; the result matches feeding the sorted points to
+// add_datapoint() one at a time.
+int add_datapoints(grouping_engine_t *e, int num_ranks, int *values)
+{
+    int i;
+    datapoint_sort_t *points = (datapoint_sort_t *)malloc(num_ranks * sizeof(datapoint_sort_t));
+    if (points == NULL)
+    {
+        fprintf(stderr, "[%s:%d] out of resources\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    for (i = 0; i < num_ranks; i++)
+    {
+        points[i].rank = i;
+        points[i].val = values[i];
+    }
+    qsort(points, num_ranks, sizeof(datapoint_sort_t), compare_datapoints);
+
+    for (i = 0; i < num_ranks; i++)
+    {
+        if (e->tail_gp == NULL)
+        {
+            group_t *gp = create_group(points[i].rank, points[i].val, values);
+            if (gp == NULL || add_group(e, gp))
+            {
+                fprintf(stderr, "[%s:%d][ERROR] unable to add group\n", __FILE__, __LINE__);
+                free(points);
+                return -1;
+            }
+        }
+        else if (balance_group_with_new_element(e, e->tail_gp, points[i].rank, points[i].val, values))
+        {
+            fprintf(stderr, "[%s:%d][ERROR] unable to balance group\n", __FILE__, __LINE__);
+            free(points);
+            return -1;
+        }
+    }
+
+    free(points);
+    return 0;
+}
+
 int grouping_init(grouping_engine_t **e)
 {
     grouping_engine_t *new_engine = calloc(1, sizeof(grouping_engine_t));
@@ -57,6 +57,7 @@ typedef struct grouping_engine
 } grouping_engine_t;
 
 extern int add_datapoint(grouping_engine_t *e, int rank, int *values);
+extern int add_datapoints(grouping_engine_t *e, int num_ranks, int *values);
 extern int get_groups(grouping_engine_t *e, group_t **gps, int *num_group);
 extern int grouping_init(grouping_engine_t **e);
 extern int grouping_fini(grouping_engine_t **e);
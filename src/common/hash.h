@@ -0,0 +1,149 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef COLLECTIVE_PROFILER_HASH_H
+#define COLLECTIVE_PROFILER_HASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// 64-bit FNV-1a. Not cryptographic but fast and good enough to index
+// profiler data (count signatures, backtraces, ...); users of these
+// helpers are expected to handle collisions with a full comparison.
+
+#define HASH_FNV1A_OFFSET (0xcbf29ce484222325ULL)
+#define HASH_FNV1A_PRIME (0x100000001b3ULL)
+
+static inline uint64_t hash_fnv1a_init()
+{
+    return HASH_FNV1A_OFFSET;
+}
+
+static inline uint64_t hash_fnv1a_update(uint64_t hash, const void *data, size_t len)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    size_t i;
+    for (i = 0; i < len; i++)
+    {
+        hash ^= (uint64_t)bytes[i];
+        hash *= HASH_FNV1A_PRIME;
+    }
+    return hash;
+}
+
+static inline uint64_t hash_fnv1a_update_u64(uint64_t hash, uint64_t value)
+{
+    return hash_fnv1a_update(hash, &value, sizeof(value));
+}
+
+static inline uint64_t hash_fnv1a(const void *data, size_t len)
+{
+    return hash_fnv1a_update(hash_fnv1a_init(), data, len);
+}
+
+// Fast block hash for large payloads (xxHash64). Byte-at-a-time FNV is fine
+// for the small keys above but too slow for multi-megabyte buffers; xxHash64
+// processes 32-byte stripes with four independent accumulators and reaches
+// memory bandwidth on large inputs. Not cryptographic: only meant for
+// integrity checks within a single job.
+
+#define HASH_XXH64_PRIME1 (0x9E3779B185EBCA87ULL)
+#define HASH_XXH64_PRIME2 (0xC2B2AE3D27D4EB4FULL)
+#define HASH_XXH64_PRIME3 (0x165667B19E3779F9ULL)
+#define HASH_XXH64_PRIME4 (0x85EBCA77C2B2AE63ULL)
+#define HASH_XXH64_PRIME5 (0x27D4EB2F165667C5ULL)
+
+static inline uint64_t _hash_rotl64(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t _hash_xxh64_round(uint64_t acc, uint64_t lane)
+{
+    acc += lane * HASH_XXH64_PRIME2;
+    acc = _hash_rotl64(acc, 31);
+    return acc * HASH_XXH64_PRIME1;
+}
+
+static inline uint64_t _hash_xxh64_merge(uint64_t hash, uint64_t acc)
+{
+    hash ^= _hash_xxh64_round(0, acc);
+    return hash * HASH_XXH64_PRIME1 + HASH_XXH64_PRIME4;
+}
+
+static inline uint64_t _hash_read_u64(const unsigned char *p)
+{
+    uint64_t value;
+    __builtin_memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t hash_xxh64(const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    const unsigned char *end = p + len;
+    uint64_t hash;
+
+    if (len >= 32)
+    {
+        uint64_t acc1 = HASH_XXH64_PRIME1 + HASH_XXH64_PRIME2;
+        uint64_t acc2 = HASH_XXH64_PRIME2;
+        uint64_t acc3 = 0;
+        uint64_t acc4 = (uint64_t)0 - HASH_XXH64_PRIME1;
+        const unsigned char *limit = end - 32;
+        do
+        {
+            acc1 = _hash_xxh64_round(acc1, _hash_read_u64(p));
+            acc2 = _hash_xxh64_round(acc2, _hash_read_u64(p + 8));
+            acc3 = _hash_xxh64_round(acc3, _hash_read_u64(p + 16));
+            acc4 = _hash_xxh64_round(acc4, _hash_read_u64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        hash = _hash_rotl64(acc1, 1) + _hash_rotl64(acc2, 7) + _hash_rotl64(acc3, 12) + _hash_rotl64(acc4, 18);
+        hash = _hash_xxh64_merge(hash, acc1);
+        hash = _hash_xxh64_merge(hash, acc2);
+        hash = _hash_xxh64_merge(hash, acc3);
+        hash = _hash_xxh64_merge(hash, acc4);
+    }
+    else
+    {
+        hash = HASH_XXH64_PRIME5;
+    }
+
+    hash += (uint64_t)len;
+
+    while (p + 8 <= end)
+    {
+        hash ^= _hash_xxh64_round(0, _hash_read_u64(p));
+        hash = _hash_rotl64(hash, 27) * HASH_XXH64_PRIME1 + HASH_XXH64_PRIME4;
+        p += 8;
+    }
+    if (p + 4 <= end)
+    {
+        uint32_t lane32;
+        __builtin_memcpy(&lane32, p, sizeof(lane32));
+        hash ^= (uint64_t)lane32 * HASH_XXH64_PRIME1;
+        hash = _hash_rotl64(hash, 23) * HASH_XXH64_PRIME2 + HASH_XXH64_PRIME3;
+        p += 4;
+    }
+    while (p < end)
+    {
+        hash ^= (uint64_t)(*p) * HASH_XXH64_PRIME5;
+        hash = _hash_rotl64(hash, 11) * HASH_XXH64_PRIME1;
+        p++;
+    }
+
+    // Final avalanche
+    hash ^= hash >> 33;
+    hash *= HASH_XXH64_PRIME2;
+    hash ^= hash >> 29;
+    hash *= HASH_XXH64_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+#endif // COLLECTIVE_PROFILER_HASH_H
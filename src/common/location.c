@@ -5,6 +5,8 @@
  ************************************************************************/
 
 #include <stdlib.h>
+#include <assert.h>
+#include <string.h>
 
 #include "location.h"
 #include "comm.h"
@@ -15,30 +17,8 @@
 location_logger_t *location_loggers_head = NULL;
 location_logger_t *location_loggers_tail = NULL;
 
-static inline int _open_location_file(location_logger_t *logger)
-{
-    int rc;
-    assert(logger);
-    assert(logger->collective_name);
-    if (getenv(OUTPUT_DIR_ENVVAR))
-    {
-        _asprintf(logger->filename, rc, "%s/%s_locations_comm%" PRIu64 "_rank%d.md", getenv(OUTPUT_DIR_ENVVAR), logger->collective_name, logger->commid, logger->world_rank);
-    }
-    else
-    {
-        _asprintf(logger->filename, rc, "%s_locations_comm%" PRIu64 "_rank%d.md", logger->collective_name, logger->commid, logger->world_rank);
-    }
-    assert(rc > 0);
-
-    logger->fd = fopen(logger->filename, "w");
-    assert(logger->fd);
-    return 0;
-}
-
 int init_location_logger(char *collective_name, int world_rank, uint64_t comm_id, size_t comm_size, char *hostnames, int *pids, int *world_comm_ranks, uint64_t callID, location_logger_t **logger)
 {
-    int rc;
-
     location_logger_t *new_logger = malloc(sizeof(location_logger_t));
     assert(new_logger);
     new_logger->world_rank = world_rank;
@@ -58,14 +38,6 @@ int init_location_logger(char *collective_name, int world_rank, uint64_t comm_id
     new_logger->next = NULL;
     new_logger->prev = NULL;
 
-    rc = _open_location_file(new_logger);
-    if (rc)
-    {
-        fprintf(stderr, "_open_location_file() failed: %d\n", rc);
-        return -1;
-    }
-    assert(new_logger->fd);
-
     if (location_loggers_head == NULL)
     {
         location_loggers_head = new_logger;
@@ -78,8 +50,6 @@ int init_location_logger(char *collective_name, int world_rank, uint64_t comm_id
         location_loggers_tail = new_logger;
     }
 
-    // Write the format version at the begining of the file
-    FORMAT_VERSION_WRITE(new_logger->fd);
     *logger = new_logger;
 
     return 0;
@@ -120,36 +90,37 @@ static inline int _close_location_file(location_logger_t *logger)
     return 0;
 }
 
-static inline int _write_location_to_file(location_logger_t *logger)
+static inline int _write_location_to_file(location_logger_t *logger, FILE *fd)
 {
     assert(logger);
-    assert(logger->fd);
+    assert(fd);
 
-    fprintf(logger->fd, "Communicator ID: %"PRIu64"\n", logger->commid);
+    fprintf(fd, "Communicator ID: %"PRIu64"\n", logger->commid);
     char *strCalls = compress_uint64_array(logger->calls, logger->calls_count, 1);
     assert(strCalls);
-    fprintf(logger->fd, "Calls: %s\n", strCalls);
+    fprintf(fd, "Calls: %s\n", strCalls);
     char *strRanks = compress_int_array(logger->world_comm_ranks, logger->comm_size, 1);
     assert(strRanks);
-    fprintf(logger->fd, "COMM_WORLD ranks: %s\n", strRanks);
+    fprintf(fd, "COMM_WORLD ranks: %s\n", strRanks);
     char *strPIDs = compress_int_array(logger->pids, logger->comm_size, 1);
     assert(strPIDs);
-    fprintf(logger->fd, "PIDs: %s\n", strPIDs);
-    fprintf(logger->fd, "Hostnames:\n");
+    fprintf(fd, "PIDs: %s\n", strPIDs);
+    fprintf(fd, "Hostnames:\n");
     int i;
     for(i = 0; i < logger->comm_size; i++)
     {
-        fprintf(logger->fd, "\tRank %d: %s\n", i, &(logger->locations[i * 256]));
+        fprintf(fd, "\tRank %d: %s\n", i, &(logger->locations[i * 256]));
     }
+    fprintf(fd, "\n");
     free(strCalls);
     free(strPIDs);
     free(strRanks);
     return 0;
 }
 
-int fini_location_tracking(location_logger_t **logger)
+int fini_location_tracking(location_logger_t **logger, FILE *fd)
 {
-    _write_location_to_file(*logger);
+    _write_location_to_file(*logger, fd);
     _close_location_file(*logger);
 
     if ((*logger)->fd)
@@ -186,11 +157,34 @@ int fini_location_tracking(location_logger_t **logger)
 
 int release_location_loggers()
 {
-    
+    int rc;
+    char *filename = NULL;
+    FILE *fd = NULL;
+
+    if (location_loggers_head == NULL)
+    {
+        return 0;
+    }
+
+    // All the location records of the rank go into a single compact file,
+    // written once here instead of one file per communicator during the run.
+    if (getenv(OUTPUT_DIR_ENVVAR))
+    {
+        _asprintf(filename, rc, "%s/%s_locations_rank%d.md", getenv(OUTPUT_DIR_ENVVAR), location_loggers_head->collective_name, location_loggers_head->world_rank);
+    }
+    else
+    {
+        _asprintf(filename, rc, "%s_locations_rank%d.md", location_loggers_head->collective_name, location_loggers_head->world_rank);
+    }
+    assert(rc > 0);
+    fd = fopen(filename, "w");
+    assert(fd);
+    FORMAT_VERSION_WRITE(fd);
+
     while (location_loggers_head)
     {
         location_logger_t *ptr = location_loggers_head->next;
-        int rc = fini_location_tracking(&location_loggers_head);
+        rc = fini_location_tracking(&location_loggers_head, fd);
         if (rc)
         {
             fprintf(stderr, "fini_location_tracking() failed: %d\n", rc);
@@ -198,6 +192,39 @@ int release_location_loggers()
         }
         location_loggers_head = ptr;
     }
+
+    fclose(fd);
+    free(filename);
+    return 0;
+}
+
+// Fast path once a communicator's locations have been gathered: only append
+// the call ID to the cached record, no gathers and no allocation.
+int commit_rank_locations_by_id(char *collective_name, MPI_Comm comm, uint64_t n_call)
+{
+    int rc;
+    location_logger_t *logger = NULL;
+    uint32_t comm_id;
+
+    rc = lookup_comm(comm, &comm_id);
+    if (rc)
+    {
+        return 1;
+    }
+    rc = lookup_location_logger(comm_id, &logger);
+    if (rc || logger == NULL)
+    {
+        return 1;
+    }
+
+    if (logger->calls_count == logger->calls_max)
+    {
+        logger->calls_max *= 2;
+        logger->calls = realloc(logger->calls, logger->calls_max * sizeof(uint64_t));
+        assert(logger->calls);
+    }
+    logger->calls[logger->calls_count] = n_call;
+    logger->calls_count++;
     return 0;
 }
 
@@ -33,6 +33,7 @@ typedef struct location_logger
 } location_logger_t;
 
 int commit_rank_locations(char *collective_name, MPI_Comm comm, int comm_size, int world_rank, int comm_rank, int *pids, int *world_comm_ranks, char *hostnames, uint64_t n_call);
+int commit_rank_locations_by_id(char *collective_name, MPI_Comm comm, uint64_t n_call);
 int release_location_loggers();
 
 
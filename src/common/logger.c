@@ -8,8 +8,11 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "logger.h"
+#include "compress.h"
 #include "grouping.h"
 #include "format.h"
 #include "comm.h"
@@ -17,6 +20,8 @@
 #include "backtrace.h"
 #include "location.h"
 #include "buff_content.h"
+#include "bin_writer.h"
+#include "common_utils.h"
 
 #if ENABLE_COUNTS
 extern int log_counts(logger_t *logger,
@@ -24,12 +29,28 @@ extern int log_counts(logger_t *logger,
                       uint64_t endcall,
                       int ctx,
                       uint64_t count,
-                      uint64_t *calls,
+                      call_interval_t *calls,
+                      uint64_t num_intervals,
                       uint64_t num_counts_data,
                       counts_data_t **counters,
                       int size,
                       int rank_vec_len,
                       int type_size);
+
+extern FILE *counts_output_fh(logger_t *logger, int ctx);
+
+extern int render_counts(logger_t *logger,
+                         uint64_t startcall,
+                         uint64_t endcall,
+                         uint64_t count,
+                         call_interval_t *calls,
+                         uint64_t num_intervals,
+                         uint64_t num_counts_data,
+                         counts_data_t **counters,
+                         int size,
+                         int rank_vec_len,
+                         int type_size,
+                         FILE *fh);
 #endif // ENABLE_COUNTS
 
 #if ENABLE_DISPLS
@@ -48,6 +69,16 @@ extern int log_displs(logger_t *logger,
 
 char *get_output_dir()
 {
+    // The environment does not change during the run so we resolve the
+    // directory only once instead of re-reading the environment and checking
+    // the directory every time a filename is built.
+    static char *cached_dirpath = NULL;
+    static int resolved = 0;
+    if (resolved)
+    {
+        return cached_dirpath;
+    }
+
     char *dirpath = NULL;
     if (getenv(OUTPUT_DIR_ENVVAR))
     {
@@ -62,8 +93,14 @@ char *get_output_dir()
             // by the user.
             mkdir(dirpath, 0744);
         }
+        else if (dir != NULL)
+        {
+            closedir(dir);
+        }
     }
-    return dirpath;
+    cached_dirpath = dirpath;
+    resolved = 1;
+    return cached_dirpath;
 }
 
 void log_groups(logger_t *logger, group_t *gps, int num_gps)
@@ -102,7 +139,7 @@ static void log_sums(logger_t *logger, int ctx, int *sums, int size)
     if (logger->sums_fh == NULL)
     {
         logger->sums_filename = logger->get_full_filename(MAIN_CTX, "sums", logger->jobid, logger->rank);
-        logger->sums_fh = fopen(logger->sums_filename, "w");
+        logger->sums_fh = profile_fopen(logger->sums_filename, "w", "counts");
     }
 
     fprintf(logger->sums_fh, "# Rank\tAmount of data (bytes)\n");
@@ -115,17 +152,23 @@ static void log_sums(logger_t *logger, int ctx, int *sums, int size)
 // _log_data is the low-level function to write the data to file.
 // Note that the list can either be a list of counts or displacements based on the
 // context (only one at a time, i.e., it can only be counts or displacements during a given execution)
+// When the raw-counters section was pre-rendered by the commit thread pool,
+// it is handed in through prerendered/prerendered_len and written verbatim
+// instead of being serialized again here.
 static void _log_data(logger_t *logger,
                       uint64_t startcall,
                       uint64_t endcall,
                       int ctx,
                       uint64_t count,
-                      uint64_t *calls,
+                      call_interval_t *call_intervals,
+                      uint64_t num_intervals,
                       uint64_t num_data,
                       void **list,
                       int size,
                       int rank_vec_len,
-                      int type_size)
+                      int type_size,
+                      const char *prerendered,
+                      size_t prerendered_len)
 {
     FILE *fh = NULL;
     counts_data_t **counters = NULL;
@@ -170,16 +213,38 @@ static void _log_data(logger_t *logger,
     if (logger->f == NULL)
     {
         logger->main_filename = logger->get_full_filename(MAIN_CTX, NULL, logger->jobid, logger->rank);
-        logger->f = fopen(logger->main_filename, "w");
+        logger->f = profile_fopen(logger->main_filename, "w", "counts");
     }
     assert(logger->f);
 
 #if ENABLE_COUNTS
-    log_counts(logger, startcall, endcall, ctx, count, calls, num_data, counters, size, rank_vec_len, type_size);
+    if (prerendered != NULL)
+    {
+        fwrite(prerendered, 1, prerendered_len, counts_output_fh(logger, ctx));
+    }
+    else
+    {
+        log_counts(logger, startcall, endcall, ctx, count, call_intervals, num_intervals, num_data, counters, size, rank_vec_len, type_size);
+    }
 #endif // ENABLE_COUNTS
 
 #if ENABLE_DISPLS
+    // The displacement tracking (legacy allgatherv path) still keeps its call
+    // lists as one uint64_t per occurrence: expand the intervals on the way
+    // out so log_displs() keeps its flat-array interface.
+    uint64_t *calls = (uint64_t *)malloc(count * sizeof(uint64_t));
+    assert(calls);
+    uint64_t _iv, _n = 0;
+    for (_iv = 0; _iv < num_intervals; _iv++)
+    {
+        uint64_t _c;
+        for (_c = call_intervals[_iv].start; _c <= call_intervals[_iv].end && _n < count; _c++)
+        {
+            calls[_n++] = _c;
+        }
+    }
     log_displs(logger, startcall, endcall, ctx, count, calls, num_data, displs, size, rank_vec_len, type_size);
+    free(calls);
 #endif // ENABLE_DISPLS
 
 // TO DO check the rest of this function for alltoallv to alltoall conversion
@@ -286,13 +351,10 @@ static void _log_data(logger_t *logger,
     }
     else
     {
-        for (j = 0; j < size; j++)
+        if (add_datapoints(e, size, sums))
         {
-            if (add_datapoint(e, j, sums))
-            {
-                fprintf(stderr, "[ERROR] unable to group send data\n");
-                return;
-            }
+            fprintf(stderr, "[ERROR] unable to group send data\n");
+            return;
         }
         int num_gps = 0;
         group_t *gps = NULL;
@@ -334,7 +396,7 @@ static void log_timings(logger_t *logger, int num_call, double *timings, int siz
 #if ENABLE_LATE_ARRIVAL_TIMING
         logger->timing_filename = logger->get_full_filename(MAIN_CTX, "late-arrivals-timings", logger->jobid, logger->rank);
 #endif // ENABLE_LATE_ARRIVAL_TIMING
-        logger->timing_fh = fopen(logger->timing_filename, "w");
+        logger->timing_fh = profile_fopen(logger->timing_filename, "w", "timings");
     }
 
     fprintf(logger->timing_fh, "%s call #%d\n", logger->collective_name, num_call);
@@ -345,6 +407,377 @@ static void log_timings(logger_t *logger, int num_call, double *timings, int siz
     fprintf(logger->timing_fh, "\n");
 }
 
+// Binary profile format: fixed-width little-endian records streamed through a
+// large buffered writer, so the commit phase is sequential bulk I/O instead of
+// millions of formatted writes. The layout is versioned independently of the
+// text format and documented in DATA_FORMAT.md.
+#define BINARY_PROFILE_MAGIC (0x46425043) // "CPBF" read as a little-endian uint32_t
+#define BINARY_PROFILE_VERSION (1)
+
+static int binary_format_enabled()
+{
+    static int enabled = -1;
+    if (enabled == -1)
+    {
+        char *str = getenv(PROFILE_BINARY_FORMAT_ENVVAR);
+        enabled = (str != NULL) ? atoi(str) : 0;
+    }
+    return enabled;
+}
+
+static void log_binary_counts_block(bin_writer_t *writer, int num_data, counts_data_t **data, int rank_vec_len)
+{
+    int i;
+    bin_writer_u32(writer, (uint32_t)num_data);
+    for (i = 0; i < num_data; i++)
+    {
+        bin_writer_u32(writer, (uint32_t)data[i]->num_ranks);
+        bin_writer_write(writer, data[i]->ranks, data[i]->num_ranks * sizeof(int));
+        if (data[i]->sparse_peers != NULL)
+        {
+            // The binary format stores dense rows; expand the sparse pairs
+            int n, idx = 0;
+            for (n = 0; n < rank_vec_len; n++)
+            {
+                int value = 0;
+                if (idx < data[i]->num_nonzero && data[i]->sparse_peers[idx] == n)
+                {
+                    value = data[i]->counters[idx];
+                    idx++;
+                }
+                bin_writer_write(writer, &value, sizeof(int));
+            }
+        }
+        else
+        {
+            bin_writer_write(writer, data[i]->counters, rank_vec_len * sizeof(int));
+        }
+    }
+}
+
+static void log_binary_counts(logger_t *logger, uint64_t startcall, uint64_t endcall, SRCountNode_t *counters_list)
+{
+    char *filename = NULL;
+    int rc;
+    SRCountNode_t *ptr;
+    uint64_t num_datasets = 0;
+    char *dir = get_output_dir();
+
+    if (dir != NULL)
+    {
+        _asprintf(filename, rc, "%s/%s_counts.rank%d.job%d.bin", dir, logger->collective_name, logger->rank, logger->jobid);
+    }
+    else
+    {
+        _asprintf(filename, rc, "%s_counts.rank%d.job%d.bin", logger->collective_name, logger->rank, logger->jobid);
+    }
+    assert(rc > 0);
+
+    bin_writer_t *writer = bin_writer_open(filename);
+    assert(writer);
+    free(filename);
+
+    for (ptr = counters_list; ptr != NULL; ptr = ptr->next)
+    {
+        num_datasets++;
+    }
+
+    // Header
+    bin_writer_u32(writer, BINARY_PROFILE_MAGIC);
+    bin_writer_u32(writer, BINARY_PROFILE_VERSION);
+    bin_writer_u32(writer, FORMAT_VERSION);
+    bin_writer_u32(writer, (uint32_t)logger->world_size);
+    bin_writer_u64(writer, startcall);
+    bin_writer_u64(writer, endcall);
+    bin_writer_u64(writer, num_datasets);
+
+    // One record per dataset (i.e., per unique count signature)
+    for (ptr = counters_list; ptr != NULL; ptr = ptr->next)
+    {
+        bin_writer_u32(writer, (uint32_t)ptr->size);
+        bin_writer_u32(writer, (uint32_t)ptr->rank_send_vec_len);
+        bin_writer_u32(writer, (uint32_t)ptr->rank_recv_vec_len);
+        bin_writer_u32(writer, (uint32_t)ptr->sendtype_size);
+        bin_writer_u32(writer, (uint32_t)ptr->recvtype_size);
+        bin_writer_u64(writer, ptr->count);
+        // The binary format stores the flat call list; stream the intervals
+        // back out as individual IDs so the layout stays unchanged.
+        uint64_t iv;
+        for (iv = 0; iv < ptr->num_intervals; iv++)
+        {
+            uint64_t c;
+            for (c = ptr->list_calls[iv].start; c <= ptr->list_calls[iv].end; c++)
+            {
+                bin_writer_u64(writer, c);
+            }
+        }
+        log_binary_counts_block(writer, ptr->send_data_size, ptr->send_data, ptr->rank_send_vec_len);
+        log_binary_counts_block(writer, ptr->recv_data_size, ptr->recv_data, ptr->rank_recv_vec_len);
+    }
+
+    bin_writer_close(&writer);
+}
+
+#if ENABLE_RAW_DATA && ENABLE_COUNTS
+// Committing the counters at finalize time serializes every data set - count
+// compression and formatted writes - one after the other on a single core. The
+// data sets are independent, so a small thread pool renders each one's send
+// and recv raw-counters sections into per-set memory streams; the main commit
+// loop then writes the buffers out in list order, keeping the files
+// byte-identical to the sequential path.
+typedef struct rendered_counts
+{
+    char *send_buf;
+    size_t send_size;
+    char *recv_buf;
+    size_t recv_size;
+} rendered_counts_t;
+
+typedef struct render_pool_args
+{
+    logger_t *logger;
+    uint64_t startcall;
+    uint64_t endcall;
+    SRCountNode_t **nodes;
+    rendered_counts_t *rendered;
+    size_t num_nodes;
+    size_t next_node; // Shared work cursor, advanced with an atomic fetch-add
+} render_pool_args_t;
+
+static void render_node_section(render_pool_args_t *args, SRCountNode_t *node, int ctx, char **buf, size_t *buf_size)
+{
+    FILE *mem = open_memstream(buf, buf_size);
+    assert(mem);
+    if (ctx == SEND_CTX)
+    {
+        render_counts(args->logger, args->startcall, args->endcall,
+                      node->count, node->list_calls, node->num_intervals,
+                      node->send_data_size, node->send_data, node->size, node->rank_send_vec_len, node->sendtype_size,
+                      mem);
+    }
+    else
+    {
+        render_counts(args->logger, args->startcall, args->endcall,
+                      node->count, node->list_calls, node->num_intervals,
+                      node->recv_data_size, node->recv_data, node->size, node->rank_recv_vec_len, node->recvtype_size,
+                      mem);
+    }
+    fclose(mem);
+}
+
+static void *render_pool_worker(void *data)
+{
+    render_pool_args_t *args = (render_pool_args_t *)data;
+    size_t n;
+    while ((n = __atomic_fetch_add(&args->next_node, 1, __ATOMIC_RELAXED)) < args->num_nodes)
+    {
+        render_node_section(args, args->nodes[n], SEND_CTX, &args->rendered[n].send_buf, &args->rendered[n].send_size);
+        render_node_section(args, args->nodes[n], RECV_CTX, &args->rendered[n].recv_buf, &args->rendered[n].recv_size);
+    }
+    return NULL;
+}
+
+static int commit_num_threads(size_t num_nodes)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (getenv(COMMIT_THREADS_ENVVAR) != NULL)
+    {
+        n = atoi(getenv(COMMIT_THREADS_ENVVAR));
+    }
+    if (n > (long)num_nodes)
+    {
+        n = (long)num_nodes;
+    }
+    if (n < 1)
+    {
+        n = 1;
+    }
+    return (int)n;
+}
+
+// Render the raw-counters sections of every data set in parallel. Returns an
+// array indexed like the list, or NULL when the pool would not help (a single
+// data set, one core, or COMMIT_THREADS=1), in which case the caller falls
+// back to the sequential path.
+static rendered_counts_t *render_counts_parallel(logger_t *logger, uint64_t startcall, uint64_t endcall, SRCountNode_t *counters_list)
+{
+    size_t num_nodes = 0;
+    SRCountNode_t *ptr = counters_list;
+    while (ptr != NULL)
+    {
+        num_nodes++;
+        ptr = ptr->next;
+    }
+    if (num_nodes < 2)
+    {
+        return NULL;
+    }
+    int num_threads = commit_num_threads(num_nodes);
+    if (num_threads < 2)
+    {
+        return NULL;
+    }
+
+    render_pool_args_t args;
+    args.logger = logger;
+    args.startcall = startcall;
+    args.endcall = endcall;
+    args.nodes = (SRCountNode_t **)malloc(num_nodes * sizeof(SRCountNode_t *));
+    args.rendered = (rendered_counts_t *)calloc(num_nodes, sizeof(rendered_counts_t));
+    args.num_nodes = num_nodes;
+    args.next_node = 0;
+    assert(args.nodes);
+    assert(args.rendered);
+    size_t n = 0;
+    for (ptr = counters_list; ptr != NULL; ptr = ptr->next)
+    {
+        args.nodes[n++] = ptr;
+    }
+
+    pthread_t *threads = (pthread_t *)malloc(num_threads * sizeof(pthread_t));
+    assert(threads);
+    int t;
+    for (t = 0; t < num_threads; t++)
+    {
+        int rc = pthread_create(&threads[t], NULL, render_pool_worker, &args);
+        assert(rc == 0);
+    }
+    for (t = 0; t < num_threads; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+    free(threads);
+    free(args.nodes);
+    return args.rendered;
+}
+
+static void release_rendered_counts(rendered_counts_t *rendered, size_t num_nodes)
+{
+    if (rendered == NULL)
+    {
+        return;
+    }
+    size_t n;
+    for (n = 0; n < num_nodes; n++)
+    {
+        free(rendered[n].send_buf);
+        free(rendered[n].recv_buf);
+    }
+    free(rendered);
+}
+#endif // ENABLE_RAW_DATA && ENABLE_COUNTS
+
+// log_profiling_checkpoint writes an incremental commit of the count data:
+// only the data sets that gained calls since the previous checkpoint are
+// written, and only the calls above the per-node watermark are listed. Each
+// section is a complete "# Raw counters" block, so the counters files stay
+// parseable by the post-processing tools, which already merge the generations
+// produced by mid-run commits. The watermark is then advanced, so the next
+// checkpoint - and the final commit - writes O(new data) instead of
+// rewriting the accumulated state from scratch.
+int log_profiling_checkpoint(logger_t *logger, SRCountNode_t *counters_list)
+{
+    // Like log_profiling_data: the final flush can run from the library
+    // destructor, including in the mpirun process, where the logger is NULL.
+    if (logger == NULL)
+        return 0;
+#if ENABLE_RAW_DATA && ENABLE_COUNTS
+    SRCountNode_t *ptr = counters_list;
+    while (ptr != NULL)
+    {
+        if (ptr->count > ptr->flushed_count)
+        {
+            uint64_t new_calls = ptr->count - ptr->flushed_count;
+            // The watermark counts calls, the storage is intervals: locate the
+            // first unflushed call and render from a trimmed copy of the tail
+            // of the interval list (its first interval may be partly flushed).
+            uint64_t offset;
+            uint64_t first = call_interval_list_skip(ptr->list_calls, ptr->num_intervals, ptr->flushed_count, &offset);
+            uint64_t num_new_intervals = ptr->num_intervals - first;
+            call_interval_t *calls = (call_interval_t *)malloc(num_new_intervals * sizeof(call_interval_t));
+            assert(calls);
+            memcpy(calls, &(ptr->list_calls[first]), num_new_intervals * sizeof(call_interval_t));
+            calls[0].start += offset;
+            uint64_t startcall = calls[0].start;
+            uint64_t endcall = calls[num_new_intervals - 1].end + 1; // render prints endcall - 1
+            log_counts(logger, startcall, endcall, SEND_CTX, new_calls, calls, num_new_intervals,
+                       ptr->send_data_size, ptr->send_data, ptr->size, ptr->rank_send_vec_len, ptr->sendtype_size);
+            log_counts(logger, startcall, endcall, RECV_CTX, new_calls, calls, num_new_intervals,
+                       ptr->recv_data_size, ptr->recv_data, ptr->size, ptr->rank_recv_vec_len, ptr->recvtype_size);
+            free(calls);
+            ptr->flushed_count = ptr->count;
+        }
+        ptr = ptr->next;
+    }
+    // A checkpoint is a crash-safety point: push the sections to the
+    // filesystem so an interrupted run loses at most one interval.
+    if (logger->sendcounters_fh != NULL)
+    {
+        fflush(logger->sendcounters_fh);
+    }
+    if (logger->recvcounters_fh != NULL)
+    {
+        fflush(logger->recvcounters_fh);
+    }
+#endif // ENABLE_RAW_DATA && ENABLE_COUNTS
+    return 0;
+}
+
+int log_profiling_sums(logger_t *logger, int size, int *send_sums, int *recv_sums, uint64_t total_send_bytes, uint64_t total_recv_bytes, uint64_t num_calls)
+{
+    // Like log_profiling_data: can run from the library destructor, including
+    // in the mpirun process, where the logger is NULL.
+    if (logger == NULL)
+        return 0;
+
+    if (logger->f == NULL)
+    {
+        logger->main_filename = logger->get_full_filename(MAIN_CTX, NULL, logger->jobid, logger->rank);
+        logger->f = profile_fopen(logger->main_filename, "w", "counts");
+    }
+    assert(logger->f);
+
+    fprintf(logger->f, "# Summary of %s operations\n\n", logger->collective_name);
+    fprintf(logger->f, "Number of ranks: %d\n", size);
+    fprintf(logger->f, "Profiled calls: %" PRIu64 "\n", num_calls);
+    fprintf(logger->f, "Total data sent: %" PRIu64 " bytes\n", total_send_bytes);
+    fprintf(logger->f, "Total data received: %" PRIu64 " bytes\n", total_recv_bytes);
+    fprintf(logger->f, "\n");
+
+    // The sums file holds the send table first, then the recv table, each
+    // introduced by the usual header line.
+    log_sums(logger, SEND_CTX, send_sums, size);
+    log_sums(logger, RECV_CTX, recv_sums, size);
+
+#if ENABLE_LIVE_GROUPING
+    grouping_engine_t *e;
+    if (grouping_init(&e))
+    {
+        fprintf(stderr, "[ERROR] unable to initialize grouping\n");
+    }
+    else
+    {
+        if (add_datapoints(e, size, send_sums))
+        {
+            fprintf(stderr, "[ERROR] unable to group send data\n");
+            return 1;
+        }
+        int num_gps = 0;
+        group_t *gps = NULL;
+        if (get_groups(e, &gps, &num_gps))
+        {
+            fprintf(stderr, "[ERROR] unable to get groups\n");
+            return 1;
+        }
+        log_groups(logger, gps, num_gps);
+        grouping_fini(&e);
+        fprintf(logger->f, "\n");
+    }
+#endif // ENABLE_LIVE_GROUPING
+
+    return 0;
+}
+
 // called with log_data(logger, avCallStart, avCallStart + avCallsLogged, counters_list, times_list);
 static void log_data(logger_t *logger, uint64_t startcall, uint64_t endcall, SRCountNode_t *counters_list, SRDisplNode_t *displs_list, avTimingsNode_t *times_list)
 {
@@ -358,7 +791,7 @@ static void log_data(logger_t *logger, uint64_t startcall, uint64_t endcall, SRC
         if (logger->f == NULL)
         {
             logger->main_filename = logger->get_full_filename(MAIN_CTX, NULL, logger->jobid, logger->rank);
-            logger->f = fopen(logger->main_filename, "w");
+            logger->f = profile_fopen(logger->main_filename, "w", "counts");
         }
         assert(logger->f);
         fprintf(logger->f, "# Send/recv displacements for %s operations:\n", logger->collective_name);
@@ -377,15 +810,17 @@ static void log_data(logger_t *logger, uint64_t startcall, uint64_t endcall, SRC
             fprintf(logger->f, "### Data sent per rank - Type size: %d\n\n", srDisplPtr->sendtype_size);
 
             _log_data(logger, startcall, endcall,
-                      SEND_CTX, srDisplPtr->count, srDisplPtr->list_calls,
-                      srDisplPtr->send_data_size, srDisplPtr->send_data, srDisplPtr->size, srDisplPtr->rank_send_vec_len, srDisplPtr->sendtype_size);
+                      SEND_CTX, srDisplPtr->count, srDisplPtr->list_calls, srDisplPtr->num_intervals,
+                      srDisplPtr->send_data_size, srDisplPtr->send_data, srDisplPtr->size, srDisplPtr->rank_send_vec_len, srDisplPtr->sendtype_size,
+                      NULL, 0);
 
             DEBUG_LOGGER("Logging recv displacements (number of displacement series: %d)\n", srDisplPtr->recv_data_size);
             fprintf(logger->f, "### Data received per rank - Type size: %d\n\n", srDisplPtr->recvtype_size);
 
             _log_data(logger, startcall, endcall,
-                      RECV_CTX, srDisplPtr->count, srDisplPtr->list_calls,
-                      srDisplPtr->recv_data_size, srDisplPtr->recv_data, srDisplPtr->size, srDisplPtr->rank_recv_vec_len, srDisplPtr->recvtype_size);
+                      RECV_CTX, srDisplPtr->count, srDisplPtr->list_calls, srDisplPtr->num_intervals,
+                      srDisplPtr->recv_data_size, srDisplPtr->recv_data, srDisplPtr->size, srDisplPtr->rank_recv_vec_len, srDisplPtr->recvtype_size,
+                      NULL, 0);
 
             DEBUG_LOGGER("%s call %" PRIu64 " logged\n", logger->collective_name, srDisplPtr->count);
             srDisplPtr = srDisplPtr->next;
@@ -399,16 +834,26 @@ static void log_data(logger_t *logger, uint64_t startcall, uint64_t endcall, SRC
     /* LOG COUNTERS */
 
     // Display the send/receive counts data
-    if (counters_list != NULL)
+    if (counters_list != NULL && binary_format_enabled())
+    {
+        log_binary_counts(logger, startcall, endcall, counters_list);
+    }
+    else if (counters_list != NULL)
     {
         SRCountNode_t *srCountPtr = counters_list;
         if (logger->f == NULL)
         {
             logger->main_filename = logger->get_full_filename(MAIN_CTX, NULL, logger->jobid, logger->rank);
-            logger->f = fopen(logger->main_filename, "w");
+            logger->f = profile_fopen(logger->main_filename, "w", "counts");
         }
         assert(logger->f);
         fprintf(logger->f, "# Send/recv counts for %s operations:\n", logger->collective_name);
+#if ENABLE_COUNTS
+        // Render the raw-counters sections of the independent data sets with
+        // the thread pool; the loop below then only writes the buffers out in
+        // deterministic list order.
+        rendered_counts_t *rendered = render_counts_parallel(logger, startcall, endcall, counters_list);
+#endif // ENABLE_COUNTS
         uint64_t count = 0;
         while (srCountPtr != NULL)
         {
@@ -424,20 +869,38 @@ static void log_data(logger_t *logger, uint64_t startcall, uint64_t endcall, SRC
             fprintf(logger->f, "### Data sent per rank - Type size: %d\n\n", srCountPtr->sendtype_size);
 
             _log_data(logger, startcall, endcall,
-                      SEND_CTX, srCountPtr->count, (void *)srCountPtr->list_calls,
-                      srCountPtr->send_data_size, srCountPtr->send_data, srCountPtr->size, srCountPtr->rank_send_vec_len, srCountPtr->sendtype_size);
+                      SEND_CTX, srCountPtr->count, srCountPtr->list_calls, srCountPtr->num_intervals,
+                      srCountPtr->send_data_size, srCountPtr->send_data, srCountPtr->size, srCountPtr->rank_send_vec_len, srCountPtr->sendtype_size,
+#if ENABLE_COUNTS
+                      rendered != NULL ? rendered[count].send_buf : NULL,
+                      rendered != NULL ? rendered[count].send_size : 0);
+#else
+                      NULL, 0);
+#endif // ENABLE_COUNTS
 
             DEBUG_LOGGER("Logging recv counts (number of count series: %d)\n", srCountPtr->recv_data_size);
             fprintf(logger->f, "### Data received per rank - Type size: %d\n\n", srCountPtr->recvtype_size);
 
             _log_data(logger, startcall, endcall,
-                      RECV_CTX, srCountPtr->count, (void *)srCountPtr->list_calls,
-                      srCountPtr->recv_data_size, srCountPtr->recv_data, srCountPtr->size, srCountPtr->rank_recv_vec_len, srCountPtr->recvtype_size);
+                      RECV_CTX, srCountPtr->count, srCountPtr->list_calls, srCountPtr->num_intervals,
+                      srCountPtr->recv_data_size, srCountPtr->recv_data, srCountPtr->size, srCountPtr->rank_recv_vec_len, srCountPtr->recvtype_size,
+#if ENABLE_COUNTS
+                      rendered != NULL ? rendered[count].recv_buf : NULL,
+                      rendered != NULL ? rendered[count].recv_size : 0);
+#else
+                      NULL, 0);
+#endif // ENABLE_COUNTS
 
             DEBUG_LOGGER("%s call %" PRIu64 " logged\n", logger->collective_name, srCountPtr->count);
+            // A full commit covers everything, so later incremental
+            // checkpoints must not rewrite these calls.
+            srCountPtr->flushed_count = srCountPtr->count;
             srCountPtr = srCountPtr->next;
             count++;
         }
+#if ENABLE_COUNTS
+        release_rendered_counts(rendered, (size_t)count);
+#endif // ENABLE_COUNTS
     }
 #endif
 
@@ -589,7 +1052,7 @@ void log_profiling_data(logger_t *logger, uint64_t avCalls, uint64_t avCallStart
         if (logger->f == NULL)
         {
             logger->main_filename = logger->get_full_filename(MAIN_CTX, NULL, logger->jobid, logger->rank);
-            logger->f = fopen(logger->main_filename, "w");
+            logger->f = profile_fopen(logger->main_filename, "w", "counts");
         }
         fprintf(logger->f, "# Summary\n");
         fprintf(logger->f, "COMM_WORLD size: %d\n", logger->world_size);
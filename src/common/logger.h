@@ -78,6 +78,31 @@ extern void logger_fini(logger_t **l);
  * @param times_list List of timings associated to the collective executions
  */
 extern void log_profiling_data(logger_t *logger, uint64_t coll_calls, uint64_t callStart, uint64_t callsLogged, SRCountNode_t *counters_list, SRDisplNode_t *displs_list, avTimingsNode_t *times_list);
+
+/**
+ * @brief log_profiling_checkpoint incrementally commits the count data: only data sets
+ * with calls above their flushed watermark are written, listing only the new calls,
+ * and the watermark is advanced so each periodic flush costs O(new data).
+ *
+ * @param logger Pointer to the logger object
+ * @param counters_list List of the collective counters
+ */
+extern int log_profiling_checkpoint(logger_t *logger, SRCountNode_t *counters_list);
+
+/**
+ * @brief log_profiling_sums saves the summary-only profile: per-rank byte
+ * totals (accumulated locally by each rank, gathered once at finalize) are fed
+ * to the shared sums/grouping output and job-wide totals go to the main file.
+ *
+ * @param logger Pointer to the logger object
+ * @param size Number of ranks in the job
+ * @param send_sums Per-rank total of bytes sent (size elements)
+ * @param recv_sums Per-rank total of bytes received (size elements)
+ * @param total_send_bytes Job-wide total of bytes sent
+ * @param total_recv_bytes Job-wide total of bytes received
+ * @param num_calls Number of profiled calls on this rank
+ */
+extern int log_profiling_sums(logger_t *logger, int size, int *send_sums, int *recv_sums, uint64_t total_send_bytes, uint64_t total_recv_bytes, uint64_t num_calls);
 extern void log_timing_data(logger_t *logger, avTimingsNode_t *times_list);
 extern int *lookup_rank_counters(int data_size, counts_data_t **data, int rank);
 extern int *lookup_rank_displs(int data_size, displs_data_t **data, int rank);
@@ -19,6 +19,7 @@
 #include "logger.h"
 #include "grouping.h"
 #include "format.h"
+#include "compress.h"
 
 int *lookup_rank_counters(int data_size, counts_data_t **data, int rank)
 {
@@ -43,29 +44,18 @@ int *lookup_rank_counters(int data_size, counts_data_t **data, int rank)
     return NULL;
 }
 
-int log_counts(logger_t *logger,
-               uint64_t startcall,
-               uint64_t endcall,
-               int ctx,
-               uint64_t count,
-               uint64_t *calls,
-               uint64_t num_counts_data,
-               counts_data_t **counters,
-               int size,
-               int rank_vec_len,
-               int type_size)
+// Resolve (and lazily open) the output stream for a given context.
+FILE *counts_output_fh(logger_t *logger, int ctx)
 {
     FILE *fh = NULL;
     assert(logger);
-    assert(calls);
-    assert(counters);
     switch (ctx)
     {
     case RECV_CTX:
         if (logger->recvcounters_fh == NULL)
         {
             logger->recvcounts_filename = logger->get_full_filename(RECV_CTX, "counters", logger->jobid, logger->rank);
-            logger->recvcounters_fh = fopen(logger->recvcounts_filename, "w");
+            logger->recvcounters_fh = profile_fopen(logger->recvcounts_filename, "w", "counts");
         }
         fh = logger->recvcounters_fh;
         break;
@@ -74,7 +64,7 @@ int log_counts(logger_t *logger,
         if (logger->sendcounters_fh == NULL)
         {
             logger->sendcounts_filename = logger->get_full_filename(SEND_CTX, "counters", logger->jobid, logger->rank);
-            logger->sendcounters_fh = fopen(logger->sendcounts_filename, "w");
+            logger->sendcounters_fh = profile_fopen(logger->sendcounts_filename, "w", "counts");
         }
         fh = logger->sendcounters_fh;
         break;
@@ -84,12 +74,38 @@ int log_counts(logger_t *logger,
         break;
     }
     assert(fh);
+    return fh;
+}
+
+// Write one context's raw-counters section to an arbitrary stream. Touches the
+// logger only for read-only metadata (collective name), so independent data
+// sets can be rendered concurrently into in-memory streams (see logger.c).
+int render_counts(logger_t *logger,
+                  uint64_t startcall,
+                  uint64_t endcall,
+                  uint64_t count,
+                  call_interval_t *calls,
+                  uint64_t num_intervals,
+                  uint64_t num_counts_data,
+                  counts_data_t **counters,
+                  int size,
+                  int rank_vec_len,
+                  int type_size,
+                  FILE *fh)
+{
+    assert(logger);
+    assert(calls);
+    assert(counters);
+    assert(fh);
 
     fprintf(fh, "# Raw counters\n\n");
     fprintf(fh, "Number of ranks: %d\n", size);
     fprintf(fh, "Datatype size: %d\n", type_size);
     fprintf(fh, "%s calls %" PRIu64 "-%" PRIu64 "\n", logger->collective_name, startcall, endcall - 1); // endcall is one ahead so we substract 1
-    char *calls_str = compress_uint64_array(calls, count, 1);
+    format_buf_t compress_buf = FORMAT_BUF_INITIALIZER; // Reused across the calls list and all rank rows
+    // The call list is stored as intervals, so this is a direct walk of the
+    // stored ranges rather than a compression pass.
+    char *calls_str = compress_call_intervals_into(&compress_buf, calls, num_intervals);
     fprintf(fh, "Count: %" PRIu64 " calls - %s\n", count, calls_str);
     fprintf(fh, "\n\nBEGINNING DATA\n");
     DEBUG_LOGGER_NOARGS("Saving counts...\n");
@@ -99,19 +115,57 @@ int log_counts(logger_t *logger,
     {
         DEBUG_LOGGER("Number of ranks: %d\n", (counters[count_data_number])->num_ranks);
 
-        char *str = compress_int_array((counters[count_data_number])->ranks, (counters[count_data_number])->num_ranks, 1);
+        counts_data_t *row = counters[count_data_number];
+        char *str = compress_int_array_into(&compress_buf, row->ranks, row->num_ranks, 1);
         assert(str);
         fprintf(fh, "Rank(s) %s: ", str);
-        free(str);
-        str = NULL;
 
-        for (n = 0; n < rank_vec_len; n++)
+        if (row->sparse_peers != NULL)
         {
-            fprintf(fh, "%d ", (counters[count_data_number])->counters[n]);
+            // Sparse rows store only the (peer, count) pairs; the file format
+            // stays dense so expand the zeros back on the way out.
+            int idx = 0;
+            for (n = 0; n < rank_vec_len; n++)
+            {
+                if (idx < row->num_nonzero && row->sparse_peers[idx] == n)
+                {
+                    fprintf(fh, "%d ", row->counters[idx]);
+                    idx++;
+                }
+                else
+                {
+                    fprintf(fh, "0 ");
+                }
+            }
+        }
+        else
+        {
+            for (n = 0; n < rank_vec_len; n++)
+            {
+                fprintf(fh, "%d ", row->counters[n]);
+            }
         }
         fprintf(fh, "\n");
     }
+    format_buf_release(&compress_buf);
     DEBUG_LOGGER_NOARGS("Counts saved\n");
     fprintf(fh, "END DATA\n");
     return 0;
 }
+
+int log_counts(logger_t *logger,
+               uint64_t startcall,
+               uint64_t endcall,
+               int ctx,
+               uint64_t count,
+               call_interval_t *calls,
+               uint64_t num_intervals,
+               uint64_t num_counts_data,
+               counts_data_t **counters,
+               int size,
+               int rank_vec_len,
+               int type_size)
+{
+    FILE *fh = counts_output_fh(logger, ctx);
+    return render_counts(logger, startcall, endcall, count, calls, num_intervals, num_counts_data, counters, size, rank_vec_len, type_size, fh);
+}
@@ -19,6 +19,7 @@
 #include "logger.h"
 #include "grouping.h"
 #include "format.h"
+#include "compress.h"
 
 int *lookup_rank_displs(int data_size, displs_data_t **data, int rank)
 {
@@ -63,7 +64,7 @@ int log_displs(logger_t *logger,
         if (logger->recvdispls_fh == NULL)
         {
             logger->recvdispls_filename = logger->get_full_filename(RECV_CTX, "displs", logger->jobid, logger->rank);
-            logger->recvdispls_fh = fopen(logger->recvdispls_filename, "w");
+            logger->recvdispls_fh = profile_fopen(logger->recvdispls_filename, "w", "counts");
         }
         fh = logger->recvdispls_fh;
         break;
@@ -72,7 +73,7 @@ int log_displs(logger_t *logger,
         if (logger->senddispls_fh == NULL)
         {
             logger->senddispls_filename = logger->get_full_filename(SEND_CTX, "displs", logger->jobid, logger->rank);
-            logger->senddispls_fh = fopen(logger->senddispls_filename, "w");
+            logger->senddispls_fh = profile_fopen(logger->senddispls_filename, "w", "counts");
         }
         fh = logger->senddispls_fh;
         break;
@@ -87,7 +88,8 @@ int log_displs(logger_t *logger,
     fprintf(fh, "Number of ranks: %d\n", size);
     fprintf(fh, "Datatype size: %d\n", type_size);
     fprintf(fh, "%s calls %" PRIu64 "-%" PRIu64 "\n", logger->collective_name, startcall, endcall - 1); // endcall is one ahead so we substract 1
-    char *calls_str = compress_uint64_array(calls, count, 1);
+    format_buf_t compress_buf = FORMAT_BUF_INITIALIZER; // Reused across the calls list and all rank rows
+    char *calls_str = compress_uint64_array_into(&compress_buf, calls, count, 1);
     fprintf(fh, "Count: %" PRIu64 " calls - %s\n", count, calls_str);
     fprintf(fh, "\n\nBEGINNING DATA\n");
     DEBUG_LOGGER_NOARGS("Saving displacements...\n");
@@ -97,11 +99,17 @@ int log_displs(logger_t *logger,
     {
         DEBUG_LOGGER("Number of ranks: %d\n", (counters[count_data_number])->num_ranks);
 
-        char *str = compress_int_array((displs[count_data_number])->ranks, (displs[count_data_number])->num_ranks, 1);
+        char *str = compress_int_array_into(&compress_buf, (displs[count_data_number])->ranks, (displs[count_data_number])->num_ranks, 1);
         assert(str);
         fprintf(fh, "Rank(s) %s: ", str);
-        free(str);
-        str = NULL;
+
+        if ((displs[count_data_number])->derived_from_counts)
+        {
+            // Marker: these ranks' displacements are the exclusive prefix sum
+            // of their counts; rebuild them from the counts profile.
+            fprintf(fh, "D\n");
+            continue;
+        }
 
         for (n = 0; n < rank_vec_len; n++)
         {
@@ -109,6 +117,7 @@ int log_displs(logger_t *logger,
         }
         fprintf(fh, "\n");
     }
+    format_buf_release(&compress_buf);
     DEBUG_LOGGER_NOARGS("Displacements saved\n");
     fprintf(fh, "END DATA\n");
     return 0;
@@ -0,0 +1,89 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "mpi.h"
+
+#ifndef _COLLECTIVE_PROFILER_MSG_HISTOGRAM_H
+#define _COLLECTIVE_PROFILER_MSG_HISTOGRAM_H
+
+// Log-scale histogram of individual message sizes (count x type size per
+// peer). Each rank bins its own messages during the call - the counters are a
+// few cache lines and the binning is branch-free - and the per-rank histograms
+// are merged with a single reduction since the structure is a flat array of
+// uint64 that adds element-wise. Bin k holds the messages with
+// 2^(k-1) < size <= ... i.e. sizes whose highest set bit is k-1, so bin 1 is
+// exactly 1 byte, bin 11 is 1KB-class messages, and 48 bins cover any
+// realistic size. Zero counts mean "no message to that peer" and are not
+// binned.
+#define MSG_HISTOGRAM_NUM_BINS (48)
+
+typedef struct msg_histogram
+{
+    uint64_t num_msgs;
+    uint64_t total_bytes;
+    uint64_t bins[MSG_HISTOGRAM_NUM_BINS];
+} msg_histogram_t;
+
+// Number of uint64 elements a histogram reduces as
+#define MSG_HISTOGRAM_NUM_ELTS (sizeof(msg_histogram_t) / sizeof(uint64_t))
+
+static inline void msg_histogram_reset(msg_histogram_t *h)
+{
+    memset(h, 0, sizeof(msg_histogram_t));
+}
+
+static inline void msg_histogram_add(msg_histogram_t *h, uint64_t bytes)
+{
+    // Branch-free: a zero-byte entry contributes 0 to every counter. The |1
+    // keeps __builtin_clzll defined for bytes == 0.
+    uint64_t present = (bytes != 0);
+    int bin = (int)(present * (uint64_t)(64 - __builtin_clzll(bytes | 1)));
+    bin = (bin < MSG_HISTOGRAM_NUM_BINS) ? bin : (MSG_HISTOGRAM_NUM_BINS - 1);
+    h->bins[bin] += present;
+    h->num_msgs += present;
+    h->total_bytes += bytes;
+}
+
+// Merge the per-rank histograms onto rank root with one reduction. send and
+// recv travel in the same message; merged (both histograms, only read on the
+// root) may alias nothing with the inputs.
+static inline void msg_histogram_reduce(msg_histogram_t *send, msg_histogram_t *recv,
+                                        msg_histogram_t merged[2], int root, MPI_Comm comm)
+{
+    msg_histogram_t local[2];
+    local[0] = *send;
+    local[1] = *recv;
+    PMPI_Reduce(local, merged, 2 * MSG_HISTOGRAM_NUM_ELTS, MPI_UINT64_T, MPI_SUM, root, comm);
+}
+
+static inline void msg_histogram_fwrite(FILE *f, const char *label, msg_histogram_t *h)
+{
+    int bin;
+
+    fprintf(f, "## %s\n\n", label);
+    fprintf(f, "Messages: %" PRIu64 "\n", h->num_msgs);
+    fprintf(f, "Total: %" PRIu64 " bytes\n\n", h->total_bytes);
+    fprintf(f, "# Size range (bytes)\tMessages\n");
+    for (bin = 0; bin < MSG_HISTOGRAM_NUM_BINS; bin++)
+    {
+        if (h->bins[bin] == 0)
+        {
+            continue;
+        }
+        uint64_t low = (bin == 0) ? 0 : (1ULL << (bin - 1));
+        uint64_t high = (1ULL << bin) - 1;
+        fprintf(f, "%" PRIu64 "-%" PRIu64 "\t%" PRIu64 "\n", low, high, h->bins[bin]);
+    }
+    fprintf(f, "\n");
+}
+
+#endif // _COLLECTIVE_PROFILER_MSG_HISTOGRAM_H
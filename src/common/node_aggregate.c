@@ -0,0 +1,474 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <mpi.h>
+
+#include "collective_profiler_config.h"
+#include "common_utils.h"
+#include "hash.h"
+#include "node_aggregate.h"
+
+// The shared segment starts with a single allocation cursor on its own cache
+// line; records follow. Depositing a section is one atomic fetch-add on the
+// cursor plus a memcpy, so any number of ranks can deposit concurrently
+// without a lock.
+#define SHM_DATA_OFFSET (64)
+
+typedef struct section_record
+{
+    uint64_t record_len; // Total record size including this header, 8-byte aligned
+    uint32_t rank;       // World rank that deposited the section
+    uint32_t seq;        // Deposit order within the rank, to keep append-style flushes ordered
+    uint32_t label_len;
+    uint32_t padding;
+    uint64_t content_len;
+    // label bytes, then content bytes
+} section_record_t;
+
+typedef struct pending_section
+{
+    char *label;
+    char *buf;   // Filled in by the memstream when the writer closes the stream
+    size_t size;
+    struct pending_section *next;
+} pending_section_t;
+
+static pending_section_t *pending_sections_head = NULL;
+static pending_section_t *pending_sections_tail = NULL;
+
+int node_aggregation_enabled(void)
+{
+    static int parsed = 0;
+    static int enabled = 0;
+
+    if (!parsed)
+    {
+        enabled = (getenv(A2A_NODE_AGGREGATION_ENVVAR) != NULL);
+        parsed = 1;
+    }
+    return enabled;
+}
+
+int single_file_enabled(void)
+{
+    static int parsed = 0;
+    static int enabled = 0;
+
+    if (!parsed)
+    {
+        enabled = (getenv(A2A_SINGLE_FILE_ENVVAR) != NULL);
+        parsed = 1;
+    }
+    return enabled;
+}
+
+FILE *node_aggregate_fopen(const char *filename)
+{
+    pending_section_t *section = (pending_section_t *)malloc(sizeof(pending_section_t));
+    assert(section);
+
+    const char *base = strrchr(filename, '/');
+    base = (base != NULL) ? base + 1 : filename;
+    section->label = strdup(base);
+    assert(section->label);
+    section->buf = NULL;
+    section->size = 0;
+    section->next = NULL;
+
+    if (pending_sections_head == NULL)
+    {
+        pending_sections_head = section;
+        pending_sections_tail = section;
+    }
+    else
+    {
+        pending_sections_tail->next = section;
+        pending_sections_tail = section;
+    }
+
+    FILE *f = open_memstream(&(section->buf), &(section->size));
+    assert(f);
+    return f;
+}
+
+static uint64_t section_record_size(pending_section_t *section)
+{
+    uint64_t len = sizeof(section_record_t) + strlen(section->label) + section->size;
+    return (len + 7) & ~(uint64_t)7;
+}
+
+static int compare_records(const void *a, const void *b)
+{
+    const section_record_t *ra = *(const section_record_t *const *)a;
+    const section_record_t *rb = *(const section_record_t *const *)b;
+    const char *la = (const char *)(ra + 1);
+    const char *lb = (const char *)(rb + 1);
+    size_t min_len = (ra->label_len < rb->label_len) ? ra->label_len : rb->label_len;
+    int cmp = memcmp(la, lb, min_len);
+    if (cmp != 0)
+        return cmp;
+    if (ra->label_len != rb->label_len)
+        return (ra->label_len < rb->label_len) ? -1 : 1;
+    if (ra->rank != rb->rank)
+        return (ra->rank < rb->rank) ? -1 : 1;
+    return (ra->seq < rb->seq) ? -1 : (ra->seq > rb->seq);
+}
+
+// Merge the deposited records and write the per-node file. Identical contents
+// are written once; duplicates only reference the section that carries the
+// bytes.
+static int merge_and_write(char *map, uint64_t end_offset, const char *collective_name, int jobid)
+{
+    int rc;
+    uint64_t offset = SHM_DATA_OFFSET;
+    size_t num_records = 0, max_records = 0;
+    section_record_t **records = NULL;
+
+    while (offset < end_offset)
+    {
+        section_record_t *record = (section_record_t *)(map + offset);
+        if (num_records == max_records)
+        {
+            max_records = max_records ? max_records * 2 : 256;
+            records = (section_record_t **)realloc(records, max_records * sizeof(section_record_t *));
+            assert(records);
+        }
+        records[num_records++] = record;
+        offset += record->record_len;
+    }
+    qsort(records, num_records, sizeof(section_record_t *), compare_records);
+
+    char hostname[256] = {0};
+    gethostname(hostname, sizeof(hostname));
+
+    char *filename = NULL;
+    if (getenv(OUTPUT_DIR_ENVVAR))
+    {
+        _asprintf(filename, rc, "%s/%s_profile_node_%s_job%d.md", getenv(OUTPUT_DIR_ENVVAR), collective_name, hostname, jobid);
+    }
+    else
+    {
+        _asprintf(filename, rc, "%s_profile_node_%s_job%d.md", collective_name, hostname, jobid);
+    }
+    assert(rc > 0);
+
+    FILE *fd = fopen(filename, "w");
+    assert(fd);
+    free(filename);
+
+    fprintf(fd, "# Node-aggregated %s profiles - host: %s\n", collective_name, hostname);
+    fprintf(fd, "Number of sections: %zu\n\n", num_records);
+
+    // Content hashes of the sections written so far, for deduplication
+    uint64_t *seen_hashes = (uint64_t *)malloc(num_records * sizeof(uint64_t));
+    size_t *seen_sections = (size_t *)malloc(num_records * sizeof(size_t));
+    section_record_t **seen_records = (section_record_t **)malloc(num_records * sizeof(section_record_t *));
+    assert(seen_hashes);
+    assert(seen_sections);
+    assert(seen_records);
+    size_t num_seen = 0;
+
+    size_t i, j;
+    for (i = 0; i < num_records; i++)
+    {
+        section_record_t *record = records[i];
+        const char *label = (const char *)(record + 1);
+        const char *content = label + record->label_len;
+        uint64_t content_hash = hash_fnv1a((void *)content, record->content_len);
+
+        size_t duplicate_of = (size_t)-1;
+        for (j = 0; j < num_seen; j++)
+        {
+            if (seen_hashes[j] == content_hash &&
+                seen_records[j]->content_len == record->content_len &&
+                memcmp((const char *)(seen_records[j] + 1) + seen_records[j]->label_len, content, record->content_len) == 0)
+            {
+                duplicate_of = seen_sections[j];
+                break;
+            }
+        }
+
+        fprintf(fd, "## Section %zu: %.*s (rank %" PRIu32 ")\n", i, (int)record->label_len, label, record->rank);
+        if (duplicate_of != (size_t)-1)
+        {
+            fprintf(fd, "Identical to section %zu\n\n", duplicate_of);
+            continue;
+        }
+        seen_hashes[num_seen] = content_hash;
+        seen_sections[num_seen] = i;
+        seen_records[num_seen] = record;
+        num_seen++;
+
+        fwrite(content, 1, record->content_len, fd);
+        fprintf(fd, "\nEND SECTION\n\n");
+    }
+
+    fclose(fd);
+    free(seen_hashes);
+    free(seen_sections);
+    free(seen_records);
+    free(records);
+    return 0;
+}
+
+static void release_pending_sections(void)
+{
+    while (pending_sections_head != NULL)
+    {
+        pending_section_t *next = pending_sections_head->next;
+        free(pending_sections_head->label);
+        free(pending_sections_head->buf);
+        free(pending_sections_head);
+        pending_sections_head = next;
+    }
+    pending_sections_tail = NULL;
+}
+
+// Single shared profile file for the whole job, written with MPI-IO. Each
+// rank serializes its sections into one local buffer, the ranks agree on
+// offsets with an exscan over the (stripe-aligned) buffer sizes, and the data
+// region is written with a single MPI_File_write_at_all. Rank 0 then adds the
+// header and a per-rank offset table as a footer, so downstream tools get one
+// seekable file and can jump straight to any rank's sections.
+#define SINGLE_FILE_MAGIC (0x41324150) // "A2AP"
+#define SINGLE_FILE_VERSION (1)
+#define SINGLE_FILE_HEADER_SIZE (64)
+#define SINGLE_FILE_ALIGNMENT (4096) // Per-rank regions start on this boundary
+
+static int single_file_finalize(const char *collective_name, int jobid)
+{
+    int rc;
+    int world_rank, world_size;
+    PMPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    PMPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+    uint64_t my_bytes = 0;
+    uint64_t num_sections = 0;
+    pending_section_t *section;
+    for (section = pending_sections_head; section != NULL; section = section->next)
+    {
+        my_bytes += section_record_size(section);
+        num_sections++;
+    }
+
+    // Serialize the sections into one contiguous buffer
+    char *buffer = NULL;
+    if (my_bytes > 0)
+    {
+        buffer = (char *)malloc(my_bytes);
+        assert(buffer);
+    }
+    uint64_t fill = 0;
+    uint32_t seq = 0;
+    for (section = pending_sections_head; section != NULL; section = section->next)
+    {
+        section_record_t *record = (section_record_t *)(buffer + fill);
+        record->record_len = section_record_size(section);
+        record->rank = (uint32_t)world_rank;
+        record->seq = seq++;
+        record->label_len = (uint32_t)strlen(section->label);
+        record->padding = 0;
+        record->content_len = section->size;
+        memcpy((char *)(record + 1), section->label, record->label_len);
+        memcpy((char *)(record + 1) + record->label_len, section->buf, section->size);
+        fill += record->record_len;
+    }
+
+    uint64_t padded_bytes = (my_bytes + SINGLE_FILE_ALIGNMENT - 1) & ~(uint64_t)(SINGLE_FILE_ALIGNMENT - 1);
+    uint64_t my_offset = 0;
+    PMPI_Exscan(&padded_bytes, &my_offset, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (world_rank == 0)
+    {
+        my_offset = 0; // Exscan leaves rank 0's recv buffer undefined
+    }
+    my_offset += SINGLE_FILE_HEADER_SIZE;
+
+    char *filename = NULL;
+    if (getenv(OUTPUT_DIR_ENVVAR))
+    {
+        _asprintf(filename, rc, "%s/%s_profile_job%d.a2ap", getenv(OUTPUT_DIR_ENVVAR), collective_name, jobid);
+    }
+    else
+    {
+        _asprintf(filename, rc, "%s_profile_job%d.a2ap", collective_name, jobid);
+    }
+    assert(rc > 0);
+
+    MPI_File fh;
+    rc = PMPI_File_open(MPI_COMM_WORLD, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+    free(filename);
+    if (rc != MPI_SUCCESS)
+    {
+        free(buffer);
+        return 1;
+    }
+
+    // One collective write covers every rank's data region
+    MPI_Status status;
+    PMPI_File_write_at_all(fh, (MPI_Offset)my_offset, buffer, (int)my_bytes, MPI_BYTE, &status);
+    free(buffer);
+
+    // Rank 0 appends the per-rank offset table and fills in the header
+    uint64_t triple[3] = {my_offset, my_bytes, num_sections};
+    uint64_t *table = NULL;
+    if (world_rank == 0)
+    {
+        table = (uint64_t *)malloc(3 * world_size * sizeof(uint64_t));
+        assert(table);
+    }
+    PMPI_Gather(triple, 3, MPI_UINT64_T, table, 3, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+
+    if (world_rank == 0)
+    {
+        uint64_t footer_offset = SINGLE_FILE_HEADER_SIZE;
+        int i;
+        for (i = 0; i < world_size; i++)
+        {
+            uint64_t end = table[3 * i] + table[3 * i + 1];
+            if (end > footer_offset)
+                footer_offset = end;
+        }
+        footer_offset = (footer_offset + 7) & ~(uint64_t)7;
+        PMPI_File_write_at(fh, (MPI_Offset)footer_offset, table, 3 * world_size * sizeof(uint64_t), MPI_BYTE, &status);
+
+        uint64_t header[8] = {0};
+        header[0] = ((uint64_t)SINGLE_FILE_VERSION << 32) | SINGLE_FILE_MAGIC;
+        header[1] = (uint64_t)world_size;
+        header[2] = footer_offset;
+        PMPI_File_write_at(fh, 0, header, sizeof(header), MPI_BYTE, &status);
+        free(table);
+    }
+
+    PMPI_File_close(&fh);
+    release_pending_sections();
+    return 0;
+}
+
+int node_aggregate_finalize(const char *collective_name)
+{
+    if (!node_aggregation_enabled() && !single_file_enabled())
+    {
+        return 0;
+    }
+
+    // The destructor path can run after PMPI_Finalize - or in a process that
+    // never initialized MPI at all, such as the launcher daemons inheriting
+    // LD_PRELOAD. No MPI traffic is possible in either case.
+    int mpi_initialized = 0;
+    int mpi_finalized = 0;
+    PMPI_Initialized(&mpi_initialized);
+    PMPI_Finalized(&mpi_finalized);
+    if (!mpi_initialized || mpi_finalized)
+    {
+        release_pending_sections();
+        return 0;
+    }
+
+    if (single_file_enabled())
+    {
+        return single_file_finalize(collective_name, get_job_id());
+    }
+
+    MPI_Comm node_comm;
+    PMPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+    int node_rank, world_rank;
+    PMPI_Comm_rank(node_comm, &node_rank);
+    PMPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+    uint64_t my_bytes = 0;
+    pending_section_t *section;
+    for (section = pending_sections_head; section != NULL; section = section->next)
+    {
+        my_bytes += section_record_size(section);
+    }
+    uint64_t node_bytes = 0;
+    PMPI_Allreduce(&my_bytes, &node_bytes, 1, MPI_UINT64_T, MPI_SUM, node_comm);
+    if (node_bytes == 0)
+    {
+        PMPI_Comm_free(&node_comm);
+        release_pending_sections();
+        return 0;
+    }
+
+    // The segment name only needs to be unique on this node: include the
+    // node-local leader's PID so concurrent jobs cannot collide.
+    int jobid = get_job_id();
+    int leader_pid = getpid();
+    PMPI_Bcast(&leader_pid, 1, MPI_INT, 0, node_comm);
+    char shm_name[64];
+    snprintf(shm_name, sizeof(shm_name), "/a2a_profiler_%d_%d", jobid, leader_pid);
+
+    size_t segment_size = SHM_DATA_OFFSET + node_bytes;
+    int fd = -1;
+    char *map = NULL;
+    if (node_rank == 0)
+    {
+        shm_unlink(shm_name); // In case a crashed job left one behind
+        fd = shm_open(shm_name, O_CREAT | O_EXCL | O_RDWR, 0600);
+        assert(fd != -1);
+        int rc = ftruncate(fd, segment_size);
+        assert(rc == 0);
+        map = (char *)mmap(NULL, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        assert(map != MAP_FAILED);
+        *((uint64_t *)map) = SHM_DATA_OFFSET;
+    }
+    PMPI_Barrier(node_comm);
+    if (node_rank != 0)
+    {
+        fd = shm_open(shm_name, O_RDWR, 0600);
+        assert(fd != -1);
+        map = (char *)mmap(NULL, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        assert(map != MAP_FAILED);
+    }
+
+    uint64_t *alloc_cursor = (uint64_t *)map;
+    uint32_t seq = 0;
+    for (section = pending_sections_head; section != NULL; section = section->next)
+    {
+        uint64_t record_len = section_record_size(section);
+        uint64_t offset = __atomic_fetch_add(alloc_cursor, record_len, __ATOMIC_RELAXED);
+        assert(offset + record_len <= segment_size);
+
+        section_record_t *record = (section_record_t *)(map + offset);
+        record->record_len = record_len;
+        record->rank = (uint32_t)world_rank;
+        record->seq = seq++;
+        record->label_len = (uint32_t)strlen(section->label);
+        record->padding = 0;
+        record->content_len = section->size;
+        memcpy((char *)(record + 1), section->label, record->label_len);
+        memcpy((char *)(record + 1) + record->label_len, section->buf, section->size);
+    }
+    PMPI_Barrier(node_comm);
+
+    int rc = 0;
+    if (node_rank == 0)
+    {
+        rc = merge_and_write(map, *alloc_cursor, collective_name, jobid);
+    }
+    PMPI_Barrier(node_comm);
+
+    munmap(map, segment_size);
+    close(fd);
+    if (node_rank == 0)
+    {
+        shm_unlink(shm_name);
+    }
+    PMPI_Comm_free(&node_comm);
+    release_pending_sections();
+    return rc;
+}
@@ -0,0 +1,44 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef COLLECTIVE_PROFILER_NODE_AGGREGATE_H
+#define COLLECTIVE_PROFILER_NODE_AGGREGATE_H
+
+#include <stdio.h>
+
+// Node-level aggregation of the per-rank profile outputs. On systems with
+// hundreds of ranks per node the per-rank files (counters, patterns, timings)
+// are an I/O and metadata disaster: with A2A_NODE_AGGREGATION set,
+// profile_fopen() captures each would-be file as an in-memory section instead
+// of opening it, and at finalize time the ranks of a node - discovered with
+// MPI_Comm_split_type(SHARED) - deposit their sections into a shared-memory
+// segment through a lock-free offset allocator. The node-local rank 0 then
+// merges everything, deduplicates identical section contents (identical count
+// signatures recur across the ranks of a node) and writes one file per node.
+
+// Returns 1 when A2A_NODE_AGGREGATION is set.
+int node_aggregation_enabled(void);
+
+// Returns 1 when A2A_SINGLE_FILE is set: instead of the per-node merge, the
+// whole job writes one shared, self-indexed profile file. Ranks agree on
+// offsets with an exscan over their serialized section sizes and the data is
+// written with a single MPI_File_write_at_all; a per-rank offset table is
+// appended as a footer. Takes precedence over node aggregation.
+int single_file_enabled(void);
+
+// Capture a profile output as a pending in-memory section labeled with the
+// basename of <filename>. The returned stream behaves like a regular FILE*;
+// its content is deposited at finalize time. Opening the same filename again
+// (append-style flushes) creates a new section, concatenated during the merge.
+FILE *node_aggregate_fopen(const char *filename);
+
+// Collective over MPI_COMM_WORLD: deposit this rank's sections into the
+// node's shared segment and, on the node-local rank 0, write the merged,
+// deduplicated per-node file - or, in single-file mode, write the job-wide
+// shared file with collective MPI-IO. Releases all pending sections.
+int node_aggregate_finalize(const char *collective_name);
+
+#endif // COLLECTIVE_PROFILER_NODE_AGGREGATE_H
@@ -4,11 +4,34 @@
  * See LICENSE.txt for license information
  ************************************************************************/
 
+#include <stdint.h>
+
 #include "pattern.h"
+#include "arena.h"
+#include "hash.h"
+
+#define CALL_PATTERN_HASH_BUCKETS (1024) // Number of buckets of the hash index over call-pattern signatures (power of two)
+
+// Pattern nodes are bump-allocated from an arena and recycled through a free
+// list: free_patterns() returns nodes to the pool instead of the heap, so the
+// per-call deduplication (which discards freshly extracted pattern lists on a
+// match) does not churn malloc/free. patterns_cleanup() drops the arena as a
+// whole at finalize.
+static arena_t pattern_arena = ARENA_INITIALIZER(64 * 1024);
+static avPattern_t *pattern_node_pool = NULL;
 
 static avPattern_t *new_pattern(int num_ranks, int num_peers)
 {
-    avPattern_t *sp = malloc(sizeof(avPattern_t));
+    avPattern_t *sp;
+    if (pattern_node_pool != NULL)
+    {
+        sp = pattern_node_pool;
+        pattern_node_pool = sp->next;
+    }
+    else
+    {
+        sp = arena_alloc(&pattern_arena, sizeof(avPattern_t));
+    }
     sp->n_ranks = num_ranks;
     sp->n_peers = num_peers;
     sp->n_calls = 1;
@@ -187,89 +210,194 @@ avCallPattern_t *lookup_call_patterns(avCallPattern_t *call_patterns)
 
 void free_patterns(avPattern_t *p)
 {
-    avPattern_t *ptr = p;
+    avPattern_t *tail = p;
 
     if (p == NULL)
     {
         return;
     }
 
-    while (ptr != NULL)
+    // Return the whole list to the pool
+    while (tail->next != NULL)
     {
-        avPattern_t *ptr2 = ptr->next;
-        free(ptr);
-        ptr = ptr2;
+        tail = tail->next;
     }
+    tail->next = pattern_node_pool;
+    pattern_node_pool = p;
 }
 
-avCallPattern_t *extract_call_patterns(int callID, int *send_counts, int *recv_counts, int size)
-{
-    int i, j, num;
-    int send_patterns[size + 1];
-    int recv_patterns[size + 1];
-
-    avCallPattern_t *cp = (avCallPattern_t *)calloc(1, sizeof(avCallPattern_t));
-    cp->n_calls = 1;
+// Hash index over call-pattern signatures so the per-call deduplication of
+// TRACK_PATTERNS_ON_CALL_BASIS does not degrade into a full list scan (plus
+// node-by-node pattern comparisons) as distinct phases accumulate.
+static avCallPattern_t *call_pattern_table[CALL_PATTERN_HASH_BUCKETS];
 
-    DEBUG_PATTERN("Extracting call patterns\n");
+// Digest of the normalized pattern sets of a call. Pattern lists are built
+// from flat bucket arrays in increasing peer order, so hashing the lists in
+// order is deterministic for a given pattern set.
+uint64_t call_pattern_signature(avCallPattern_t *cp)
+{
+    uint64_t sig = hash_fnv1a_init();
+    avPattern_t *ptr;
 
-    for (i = 0; i < size; i++)
+    for (ptr = cp->spatterns; ptr != NULL; ptr = ptr->next)
     {
-        send_patterns[i] = 0;
+        sig = hash_fnv1a_update_u64(sig, (uint64_t)ptr->n_ranks);
+        sig = hash_fnv1a_update_u64(sig, (uint64_t)ptr->n_peers);
+        sig = hash_fnv1a_update_u64(sig, (uint64_t)ptr->comm_size);
     }
+    sig = hash_fnv1a_update_u64(sig, (uint64_t)-1); // Separator between the send and recv sets
+    for (ptr = cp->rpatterns; ptr != NULL; ptr = ptr->next)
+    {
+        sig = hash_fnv1a_update_u64(sig, (uint64_t)ptr->n_ranks);
+        sig = hash_fnv1a_update_u64(sig, (uint64_t)ptr->n_peers);
+        sig = hash_fnv1a_update_u64(sig, (uint64_t)ptr->comm_size);
+    }
+    return sig;
+}
 
-    for (i = 0; i < size; i++)
+avCallPattern_t *call_pattern_table_find(avCallPattern_t *cp)
+{
+    avCallPattern_t *ptr = call_pattern_table[cp->signature & (CALL_PATTERN_HASH_BUCKETS - 1)];
+    while (ptr != NULL)
     {
-        recv_patterns[i] = 0;
+        // Signatures can collide, confirm with a full comparison
+        if (ptr->signature == cp->signature &&
+            compare_patterns(ptr->spatterns, cp->spatterns) &&
+            compare_patterns(ptr->rpatterns, cp->rpatterns))
+        {
+            return ptr;
+        }
+        ptr = ptr->hash_next;
     }
+    return NULL;
+}
+
+void call_pattern_table_insert(avCallPattern_t *cp)
+{
+    uint64_t bucket = cp->signature & (CALL_PATTERN_HASH_BUCKETS - 1);
+    cp->hash_next = call_pattern_table[bucket];
+    call_pattern_table[bucket] = cp;
+}
+
+void patterns_cleanup(void)
+{
+    pattern_node_pool = NULL;
+    memset(call_pattern_table, 0, sizeof(call_pattern_table));
+    arena_release(&pattern_arena);
+}
+
+// Streaming kernel shared by the pattern extractors: walk one row of a
+// gathered size x size count matrix per rank, pack one bit per non-zero peer
+// into 64-bit words and derive the peer count with hardware popcount instead
+// of a per-entry branch.
+void count_nonzero_peers(const int *counts, int size, int *peers_per_rank)
+{
+    int i, j;
+    const int *row = counts;
 
-    num = 0;
     for (i = 0; i < size; i++)
     {
-        int dst_ranks = 0;
-        int src_ranks = 0;
+        uint64_t word = 0;
+        int peers = 0;
         for (j = 0; j < size; j++)
         {
-            if (send_counts[num] != 0)
+            word |= ((uint64_t)(row[j] != 0)) << (j & 63);
+            if ((j & 63) == 63)
             {
-                dst_ranks++;
+                peers += __builtin_popcountll(word);
+                word = 0;
             }
-            if (recv_counts[num] != 0)
-            {
-                src_ranks++;
-            }
-            num++;
-        }
-        // We know the current rank sends data to <dst_ranks> ranks
-        if (dst_ranks > 0)
-        {
-            send_patterns[dst_ranks - 1]++;
         }
+        peers += __builtin_popcountll(word);
+        peers_per_rank[i] = peers;
+        row += size;
+    }
+}
 
-        // We know the current rank receives data from <src_ranks> ranks
-        if (src_ranks > 0)
+// Merge a flat bucket array (bucket i = number of ranks with i+1 non-zero
+// peers) into a pattern list. A flat index of list nodes by peer count is
+// built with a single walk so each bucket update is O(1); a bucket whose
+// n_ranks differs from the indexed node (rare) falls back to the list scan
+// of add_pattern()/add_pattern_for_size(). comm_size < 0 means patterns are
+// not differentiated by communicator size.
+avPattern_t *add_patterns_from_buckets(avPattern_t *patterns, int *buckets, int size, int comm_size)
+{
+    avPattern_t *index[size];
+    avPattern_t *ptr;
+    int i;
+
+    memset(index, 0, size * sizeof(avPattern_t *));
+    for (ptr = patterns; ptr != NULL; ptr = ptr->next)
+    {
+        if (ptr->n_peers >= 1 && ptr->n_peers <= size && index[ptr->n_peers - 1] == NULL &&
+            (comm_size < 0 || ptr->comm_size == comm_size))
         {
-            recv_patterns[src_ranks - 1]++;
+            index[ptr->n_peers - 1] = ptr;
         }
     }
 
-    // From here we know who many ranks send to how many ranks and how many ranks receive from how many rank
-    DEBUG_PATTERN("Handling call send patterns\n");
     for (i = 0; i < size; i++)
     {
-        if (send_patterns[i] != 0)
+        if (buckets[i] == 0)
+        {
+            continue;
+        }
+        if (index[i] != NULL && index[i]->n_ranks == buckets[i])
         {
-            cp->spatterns = add_pattern_for_size(cp->spatterns, send_patterns[i], i + 1, size);
+            index[i]->n_calls++;
+            continue;
+        }
+        if (comm_size < 0)
+        {
+            patterns = add_pattern(patterns, buckets[i], i + 1);
+        }
+        else
+        {
+            patterns = add_pattern_for_size(patterns, buckets[i], i + 1, comm_size);
         }
     }
-    DEBUG_PATTERN("Handling call receive patterns\n");
+
+    return patterns;
+}
+
+avCallPattern_t *extract_call_patterns(int callID, int *send_counts, int *recv_counts, int size)
+{
+    int i;
+    int send_patterns[size + 1];
+    int recv_patterns[size + 1];
+
+    int send_peers[size];
+    int recv_peers[size];
+
+    avCallPattern_t *cp = (avCallPattern_t *)calloc(1, sizeof(avCallPattern_t));
+    cp->n_calls = 1;
+
+    DEBUG_PATTERN("Extracting call patterns\n");
+
+    for (i = 0; i < size; i++)
+    {
+        send_patterns[i] = 0;
+        recv_patterns[i] = 0;
+    }
+
+    count_nonzero_peers(send_counts, size, send_peers);
+    count_nonzero_peers(recv_counts, size, recv_peers);
     for (i = 0; i < size; i++)
     {
-        if (recv_patterns[i] != 0)
+        if (send_peers[i] > 0)
         {
-            cp->rpatterns = add_pattern_for_size(cp->rpatterns, recv_patterns[i], i + 1, size);
+            send_patterns[send_peers[i] - 1]++;
+        }
+        if (recv_peers[i] > 0)
+        {
+            recv_patterns[recv_peers[i] - 1]++;
         }
     }
 
+    DEBUG_PATTERN("Handling call send patterns\n");
+    cp->spatterns = add_patterns_from_buckets(cp->spatterns, send_patterns, size, size);
+    DEBUG_PATTERN("Handling call receive patterns\n");
+    cp->rpatterns = add_patterns_from_buckets(cp->rpatterns, recv_patterns, size, size);
+
     return cp;
 }
@@ -29,9 +29,15 @@
 #endif // ENABLE_PATTERN_DEBUGING
 
 extern avPattern_t *add_pattern(avPattern_t *patterns, int num_ranks, int num_peers);
+extern avPattern_t *add_patterns_from_buckets(avPattern_t *patterns, int *buckets, int size, int comm_size);
+extern void count_nonzero_peers(const int *counts, int size, int *peers_per_rank);
 extern avCallPattern_t *extract_call_patterns(int callID, int *send_counts, int *recv_counts, int size);
 extern avCallPattern_t *lookup_call_patterns(avCallPattern_t *call_patterns);
+extern uint64_t call_pattern_signature(avCallPattern_t *cp);
+extern avCallPattern_t *call_pattern_table_find(avCallPattern_t *cp);
+extern void call_pattern_table_insert(avCallPattern_t *cp);
 extern void free_patterns(avPattern_t *p);
+void patterns_cleanup(void);
 extern avPattern_t *add_pattern_for_size(avPattern_t *patterns, int num_ranks, int num_peers, int size);
 extern int get_size_patterns(avPattern_t *p);
 extern bool compare_patterns(avPattern_t *p1, avPattern_t *p2);
@@ -0,0 +1,120 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// The engine is a header of static functions specialized by the including
+// translation unit; pulling it in here gives the test direct access to the
+// row-storage internals (new_counter_data, counter_row_matches, lookupCounters).
+#include "counts_engine.h"
+
+#define TEST_VEC_LEN (128)
+
+static int sparse_counts_test(void)
+{
+    int i;
+    int dense_row[TEST_VEC_LEN];
+    int other_row[TEST_VEC_LEN];
+
+    // A halo-exchange-like row: a few neighbors out of many peers
+    memset(dense_row, 0, sizeof(dense_row));
+    dense_row[3] = 5;
+    dense_row[64] = 7;
+    dense_row[127] = 2;
+
+    // Test 0: a long, mostly-zero row is stored as (peer, count) pairs
+    counts_data_t *sparse = new_counter_data(TEST_VEC_LEN, 0, dense_row);
+    if (sparse->sparse_peers == NULL || sparse->num_nonzero != 3 ||
+        sparse->sparse_peers[0] != 3 || sparse->counters[0] != 5 ||
+        sparse->sparse_peers[1] != 64 || sparse->counters[1] != 7 ||
+        sparse->sparse_peers[2] != 127 || sparse->counters[2] != 2)
+    {
+        fprintf(stderr, "Test 0: sparse row was not stored as expected\n");
+        return 1;
+    }
+    fprintf(stdout, "*** Test 0 successful\n");
+
+    // Test 1: a dense row of the same length keeps the flat vector
+    for (i = 0; i < TEST_VEC_LEN; i++)
+        other_row[i] = i + 1;
+    counts_data_t *dense = new_counter_data(TEST_VEC_LEN, 1, other_row);
+    if (dense->sparse_peers != NULL || memcmp(dense->counters, other_row, sizeof(other_row)) != 0)
+    {
+        fprintf(stderr, "Test 1: dense row was unexpectedly stored sparse\n");
+        return 1;
+    }
+    fprintf(stdout, "*** Test 1 successful\n");
+
+    // Test 2: short rows stay dense no matter how sparse they are
+    int short_row[8] = {0, 0, 0, 9, 0, 0, 0, 0};
+    counts_data_t *short_data = new_counter_data(8, 2, short_row);
+    if (short_data->sparse_peers != NULL)
+    {
+        fprintf(stderr, "Test 2: short row was stored sparse\n");
+        return 1;
+    }
+    fprintf(stdout, "*** Test 2 successful\n");
+
+    // Test 3: a sparse row compares equal to the dense row it came from and
+    // different from rows with a changed, added or removed nonzero
+    memcpy(other_row, dense_row, sizeof(dense_row));
+    if (!counter_row_matches(sparse, other_row, TEST_VEC_LEN))
+    {
+        fprintf(stderr, "Test 3: sparse row does not match its own dense form\n");
+        return 1;
+    }
+    other_row[64] = 8;
+    if (counter_row_matches(sparse, other_row, TEST_VEC_LEN))
+    {
+        fprintf(stderr, "Test 3: changed value not detected\n");
+        return 1;
+    }
+    memcpy(other_row, dense_row, sizeof(dense_row));
+    other_row[10] = 1;
+    if (counter_row_matches(sparse, other_row, TEST_VEC_LEN))
+    {
+        fprintf(stderr, "Test 3: extra nonzero not detected\n");
+        return 1;
+    }
+    memcpy(other_row, dense_row, sizeof(dense_row));
+    other_row[127] = 0;
+    if (counter_row_matches(sparse, other_row, TEST_VEC_LEN))
+    {
+        fprintf(stderr, "Test 3: missing nonzero not detected\n");
+        return 1;
+    }
+    fprintf(stdout, "*** Test 3 successful\n");
+
+    // Test 4: deduplication finds the sparse row from a dense candidate
+    counts_data_t *list[1] = {sparse};
+    if (lookupCounters(TEST_VEC_LEN, 1, list, dense_row) != sparse)
+    {
+        fprintf(stderr, "Test 4: dense candidate did not match the stored sparse row\n");
+        return 1;
+    }
+    other_row[127] = 3;
+    if (lookupCounters(TEST_VEC_LEN, 1, list, other_row) != NULL)
+    {
+        fprintf(stderr, "Test 4: different row matched the stored sparse row\n");
+        return 1;
+    }
+    fprintf(stdout, "*** Test 4 successful\n");
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (sparse_counts_test())
+    {
+        fprintf(stderr, "sparse counts test failed\n");
+        return EXIT_FAILURE;
+    }
+
+    fprintf(stdout, "sparse counts test succeeded\n");
+    return EXIT_SUCCESS;
+}
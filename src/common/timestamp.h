@@ -0,0 +1,106 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#include <stdint.h>
+
+#include "mpi.h"
+
+#ifndef _COLLECTIVE_PROFILER_TIMESTAMP_H
+#define _COLLECTIVE_PROFILER_TIMESTAMP_H
+
+// Low-overhead timestamp engine for the per-call timing samples. MPI_Wtime()
+// resolves through clock_gettime() plus a call into the MPI library and is
+// read up to four times per profiled call; on x86 the invariant TSC gives the
+// same information for the cost of one rdtscp instruction and with better
+// resolution for short collectives. timestamp_init() calibrates the tick
+// period against MPI_Wtime() once and anchors the TSC to the MPI_Wtime()
+// epoch, so timestamp_now() returns seconds directly comparable with
+// MPI_Wtime() values - in particular the clock-sync late-arrival offsets keep
+// working. Where no invariant TSC is available (non-x86, old or virtualized
+// hardware) the engine transparently falls back to MPI_Wtime().
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define TIMESTAMP_HAVE_TSC (1)
+#else
+#define TIMESTAMP_HAVE_TSC (0)
+#endif
+
+// Calibration window: long enough to make the MPI_Wtime() read noise at both
+// ends negligible against the elapsed time, short enough to not show up in
+// the init cost.
+#define TIMESTAMP_CALIBRATION_WINDOW (0.01)
+
+// Seconds per TSC tick; 0.0 means uncalibrated and every read falls back to
+// MPI_Wtime().
+static double timestamp_tsc_scale = 0.0;
+static double timestamp_anchor_wtime = 0.0;
+static uint64_t timestamp_anchor_tsc = 0;
+
+#if TIMESTAMP_HAVE_TSC
+static inline uint64_t timestamp_rdtscp(void)
+{
+    unsigned int aux;
+    return __rdtscp(&aux);
+}
+
+// The TSC is only usable as a clock when it is invariant: constant rate and
+// running across power states (CPUID.80000007H:EDX[8]).
+static inline int timestamp_tsc_invariant(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0)
+    {
+        return 0;
+    }
+    return (edx >> 8) & 1;
+}
+#endif // TIMESTAMP_HAVE_TSC
+
+// One-time calibration, to be run at init after MPI is up. Leaves the engine
+// in fallback mode when the TSC cannot be trusted.
+__attribute__((unused)) static void timestamp_init(void)
+{
+#if TIMESTAMP_HAVE_TSC
+    if (!timestamp_tsc_invariant())
+    {
+        return;
+    }
+    double w_start = MPI_Wtime();
+    uint64_t tsc_start = timestamp_rdtscp();
+    double w_end;
+    uint64_t tsc_end;
+    do
+    {
+        w_end = MPI_Wtime();
+        tsc_end = timestamp_rdtscp();
+    } while (w_end - w_start < TIMESTAMP_CALIBRATION_WINDOW);
+    if (tsc_end <= tsc_start)
+    {
+        // Went backwards during calibration (e.g. migration between
+        // unsynchronized sockets): not usable as a clock.
+        return;
+    }
+    timestamp_tsc_scale = (w_end - w_start) / (double)(tsc_end - tsc_start);
+    timestamp_anchor_wtime = w_start;
+    timestamp_anchor_tsc = tsc_start;
+#endif // TIMESTAMP_HAVE_TSC
+}
+
+// Current time in seconds on the MPI_Wtime() scale
+static inline double timestamp_now(void)
+{
+#if TIMESTAMP_HAVE_TSC
+    if (timestamp_tsc_scale != 0.0)
+    {
+        return timestamp_anchor_wtime + (double)(timestamp_rdtscp() - timestamp_anchor_tsc) * timestamp_tsc_scale;
+    }
+#endif // TIMESTAMP_HAVE_TSC
+    return MPI_Wtime();
+}
+
+#endif // _COLLECTIVE_PROFILER_TIMESTAMP_H
@@ -6,8 +6,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <assert.h>
 #include "timings.h"
+#include "compress.h"
 #include "comm.h"
 #include "collective_profiler_config.h"
 #include "common_utils.h"
@@ -16,7 +19,15 @@
 comm_timing_logger_t *timing_loggers_head = NULL;
 comm_timing_logger_t *timing_loggers_tail = NULL;
 
-int init_time_tracking(MPI_Comm comm, char *collective_name, int world_rank, int comm_rank, int jobid, comm_timing_logger_t **logger)
+// Default series used by the compile-flag entry points: a late-arrival-only
+// build logs the late-arrival series, everything else the execution series.
+#if ENABLE_LATE_ARRIVAL_TIMING && !ENABLE_EXEC_TIMING
+#define DEFAULT_TIMING_SERIES TIMING_SERIES_LATE_ARRIVAL
+#else
+#define DEFAULT_TIMING_SERIES TIMING_SERIES_EXEC
+#endif
+
+static int init_time_tracking(int series, MPI_Comm comm, char *collective_name, int world_rank, int comm_rank, int jobid, comm_timing_logger_t **logger)
 {
     int rc = 1;
 
@@ -28,29 +39,33 @@ int init_time_tracking(MPI_Comm comm, char *collective_name, int world_rank, int
     new_logger->filename = NULL;
     new_logger->next = NULL;
     new_logger->prev = NULL;
+    new_logger->comm = comm;
+    new_logger->series = series;
     new_logger->comm_id = comm_id;
+    new_logger->times_buffer = NULL;
+    new_logger->times_buffer_size = 0;
+    new_logger->times_buffer_capacity = 0;
+    new_logger->calls_buffer = NULL;
+    new_logger->sizes_buffer = NULL;
+    new_logger->num_buffered_calls = 0;
+    new_logger->buffered_calls_capacity = 0;
+    new_logger->stats_comm_size = 0;
+    new_logger->stats_count = 0;
+    new_logger->stats_mean = NULL;
+    new_logger->stats_m2 = NULL;
+    new_logger->stats_min = NULL;
+    new_logger->stats_max = NULL;
+    new_logger->stats_histogram = NULL;
 
-#if ENABLE_EXEC_TIMING
+    const char *series_tag = (series == TIMING_SERIES_LATE_ARRIVAL) ? "late_arrival_times" : "execution_times";
     if (getenv(OUTPUT_DIR_ENVVAR))
     {
-        _asprintf(new_logger->filename, rc, "%s/%s_execution_times.rank%d_comm%" PRIu32 "_job%d.md", getenv(OUTPUT_DIR_ENVVAR), collective_name, world_rank, comm_id, jobid);
+        _asprintf(new_logger->filename, rc, "%s/%s_%s.rank%d_comm%" PRIu32 "_job%d.md", getenv(OUTPUT_DIR_ENVVAR), collective_name, series_tag, world_rank, comm_id, jobid);
     }
     else
     {
-        _asprintf(new_logger->filename, rc, "%s_execution_times.rank%d_comm%" PRIu32 "_job%d.md", collective_name, world_rank, comm_id, jobid);
+        _asprintf(new_logger->filename, rc, "%s_%s.rank%d_comm%" PRIu32 "_job%d.md", collective_name, series_tag, world_rank, comm_id, jobid);
     }
-#endif // ENABLE_EXEC_TIMING
-
-#if ENABLE_LATE_ARRIVAL_TIMING
-    if (getenv(OUTPUT_DIR_ENVVAR))
-    {
-        _asprintf(new_logger->filename, rc, "%s/%s_late_arrival_times.rank%d_comm%" PRIu32 "_job%d.md", getenv(OUTPUT_DIR_ENVVAR), collective_name, world_rank, comm_id, jobid);
-    }
-    else
-    {
-        _asprintf(new_logger->filename, rc, "%s_late_arrival_times.rank%d_comm%" PRIu32 "_job%d.md", collective_name, world_rank, comm_id, jobid);
-    }
-#endif // ENABLE_LATE_ARRIVAL_TIMING
     assert(rc > 0);
     assert(new_logger->filename);
 
@@ -66,55 +81,239 @@ int init_time_tracking(MPI_Comm comm, char *collective_name, int world_rank, int
         timing_loggers_tail = new_logger;
     }
 
-    new_logger->fd = fopen(new_logger->filename, "w");
+    new_logger->fd = profile_fopen(new_logger->filename, "w", "timings");
     assert(new_logger->fd);
     // Write the format version at the begining of the file
     FORMAT_VERSION_WRITE(new_logger->fd);
     fclose(new_logger->fd);
     new_logger->fd = NULL;
 
+    // Cache the logger on the communicator record so lookup_timing_logger
+    // resolves it in O(1) instead of scanning the logger list.
+    comm_data_t *comm_data = NULL;
+    if (lookup_comm_data(comm, &comm_data) == 0)
+    {
+        comm_data->timing_logger[series] = new_logger;
+    }
+
     *logger = new_logger;
 
     return 0;
 }
 
-int lookup_timing_logger(MPI_Comm comm, comm_timing_logger_t **logger)
+static int timings_stats_enabled()
 {
-    comm_timing_logger_t *ptr = timing_loggers_head;
-    uint32_t comm_id;
+    static int enabled = -1;
+    if (enabled == -1)
+    {
+        char *stats_envvar = getenv(TIMINGS_STATS_ENVVAR);
+        enabled = (stats_envvar != NULL && atoi(stats_envvar) == 1) ? 1 : 0;
+    }
+    return enabled;
+}
 
-    int rc = lookup_comm(comm, &comm_id);
-    if (rc)
+// Log-scale bin of a timing sample: bin 0 holds everything below 1 usec, bin i
+// holds [2^(i-1), 2^i) usec, the last bin everything above.
+static int timing_histogram_bin(double time)
+{
+    int exponent = 0;
+    if (time * 1e6 < 1.0)
     {
-        // We try to use a logger for a communicator that we know nothing about
-        *logger = NULL;
-        return 1;
+        return 0;
+    }
+    frexp(time * 1e6, &exponent);
+    if (exponent >= TIMINGS_HISTOGRAM_BINS)
+    {
+        return TIMINGS_HISTOGRAM_BINS - 1;
     }
+    return exponent;
+}
 
-    while (ptr != NULL)
+static void update_timing_stats(comm_timing_logger_t *logger, double *times, int comm_size)
+{
+    int i;
+
+    if (logger->stats_mean == NULL)
     {
-        if (ptr->comm_id == comm_id)
+        logger->stats_comm_size = comm_size;
+        logger->stats_mean = calloc(comm_size, sizeof(double));
+        assert(logger->stats_mean);
+        logger->stats_m2 = calloc(comm_size, sizeof(double));
+        assert(logger->stats_m2);
+        logger->stats_min = malloc(comm_size * sizeof(double));
+        assert(logger->stats_min);
+        logger->stats_max = malloc(comm_size * sizeof(double));
+        assert(logger->stats_max);
+        for (i = 0; i < comm_size; i++)
         {
-            *logger = ptr;
-            return 0;
+            logger->stats_min[i] = times[i];
+            logger->stats_max[i] = times[i];
         }
-        ptr = ptr->next;
+        logger->stats_histogram = calloc(TIMINGS_HISTOGRAM_BINS, sizeof(uint64_t));
+        assert(logger->stats_histogram);
     }
+    assert(logger->stats_comm_size == comm_size);
 
-    // We could find data about the communicator but no associated logger
-    *logger = NULL;
+    logger->stats_count++;
+    for (i = 0; i < comm_size; i++)
+    {
+        // Welford's online algorithm
+        double delta = times[i] - logger->stats_mean[i];
+        logger->stats_mean[i] += delta / (double)logger->stats_count;
+        logger->stats_m2[i] += delta * (times[i] - logger->stats_mean[i]);
+        if (times[i] < logger->stats_min[i])
+            logger->stats_min[i] = times[i];
+        if (times[i] > logger->stats_max[i])
+            logger->stats_max[i] = times[i];
+        logger->stats_histogram[timing_histogram_bin(times[i])]++;
+    }
+}
+
+static int flush_timing_stats(comm_timing_logger_t *logger)
+{
+    int i;
+
+    if (logger->stats_count == 0)
+    {
+        return 0;
+    }
+
+    assert(logger->filename);
+    FILE *fd = profile_fopen(logger->filename, "a", "timings");
+    assert(fd);
+
+    fprintf(fd, "# Stats over %" PRIu64 " calls\n", logger->stats_count);
+    fprintf(fd, "# rank mean min max stddev\n");
+    for (i = 0; i < logger->stats_comm_size; i++)
+    {
+        double variance = 0.0;
+        if (logger->stats_count > 1)
+        {
+            variance = logger->stats_m2[i] / (double)(logger->stats_count - 1);
+        }
+        fprintf(fd, "%d %f %f %f %f\n", i, logger->stats_mean[i], logger->stats_min[i], logger->stats_max[i], sqrt(variance));
+    }
+    fprintf(fd, "\n# Histogram (bin i: [2^(i-1), 2^i) usec)\n");
+    for (i = 0; i < TIMINGS_HISTOGRAM_BINS; i++)
+    {
+        fprintf(fd, "%d %" PRIu64 "\n", i, logger->stats_histogram[i]);
+    }
+    fprintf(fd, "\n");
+    fclose(fd);
+
+    logger->stats_count = 0;
+    return 0;
+}
+
+static size_t get_timings_flush_threshold()
+{
+    static size_t threshold = 0;
+    if (threshold == 0)
+    {
+        threshold = DEFAULT_TIMINGS_FLUSH_THRESHOLD;
+        char *threshold_envvar = getenv(TIMINGS_FLUSH_THRESHOLD_ENVVAR);
+        if (threshold_envvar != NULL && atoi(threshold_envvar) > 0)
+        {
+            threshold = atoi(threshold_envvar);
+        }
+    }
+    return threshold;
+}
+
+// Write all the timings buffered in memory to the logger's file in one shot.
+// This is the only place where the timing file is actually opened and written.
+int flush_timings(comm_timing_logger_t *logger)
+{
+    if (logger->num_buffered_calls == 0)
+    {
+        return 0;
+    }
+
+    assert(logger->filename);
+    FILE *fd = profile_fopen(logger->filename, "a", "timings");
+    assert(fd);
+
+    size_t call_idx;
+    size_t offset = 0;
+    for (call_idx = 0; call_idx < logger->num_buffered_calls; call_idx++)
+    {
+        int i;
+        fprintf(fd, "# Call %" PRIu64 "\n", logger->calls_buffer[call_idx]);
+        for (i = 0; i < logger->sizes_buffer[call_idx]; i++)
+        {
+            fprintf(fd, "%f\n", logger->times_buffer[offset + i]);
+        }
+        fprintf(fd, "\n");
+        offset += logger->sizes_buffer[call_idx];
+    }
+    fclose(fd);
+
+    logger->times_buffer_size = 0;
+    logger->num_buffered_calls = 0;
+    return 0;
+}
+
+int lookup_timing_logger(MPI_Comm comm, int series, comm_timing_logger_t **logger)
+{
+    comm_data_t *comm_data = NULL;
+
+    int rc = lookup_comm_data(comm, &comm_data);
+    if (rc)
+    {
+        // We try to use a logger for a communicator that we know nothing about
+        *logger = NULL;
+        return 1;
+    }
+
+    // The logger is cached on the communicator record; NULL simply means no
+    // logger has been created for that communicator and series yet.
+    *logger = (comm_timing_logger_t *)comm_data->timing_logger[series];
     return 0;
 }
 
 int fini_time_tracking(comm_timing_logger_t **logger)
 {
-    if ((*logger)->fd)
+    // Work on a local copy: callers may pass a pointer into the logger list
+    // (e.g. &timing_loggers_head), which the unlinking below reassigns.
+    comm_timing_logger_t *l = *logger;
+
+    flush_timings(l);
+    flush_timing_stats(l);
+    free(l->times_buffer);
+    free(l->calls_buffer);
+    free(l->sizes_buffer);
+    free(l->stats_mean);
+    free(l->stats_m2);
+    free(l->stats_min);
+    free(l->stats_max);
+    free(l->stats_histogram);
+
+    if (l->fd)
     {
-        fclose((*logger)->fd);
-        (*logger)->fd = NULL;
+        fclose(l->fd);
+        l->fd = NULL;
     }
-    free((*logger)->filename);
-    free((*logger));
+
+    // Unlink from the logger list and drop the cached pointer on the
+    // communicator record so the logger can also be released early, e.g. when
+    // the application frees the communicator.
+    if (l->prev != NULL)
+        l->prev->next = l->next;
+    else if (timing_loggers_head == l)
+        timing_loggers_head = l->next;
+    if (l->next != NULL)
+        l->next->prev = l->prev;
+    else if (timing_loggers_tail == l)
+        timing_loggers_tail = l->prev;
+
+    comm_data_t *comm_data = NULL;
+    if (lookup_comm_data(l->comm, &comm_data) == 0 && comm_data->timing_logger[l->series] == l)
+    {
+        comm_data->timing_logger[l->series] = NULL;
+    }
+
+    free(l->filename);
+    free(l);
     *logger = NULL;
 
     return 0;
@@ -134,10 +333,15 @@ int release_time_loggers()
 }
 
 int commit_timings(MPI_Comm comm, char *collective_name, int world_rank, int comm_rank, int jobid, double *times, int comm_size, uint64_t n_call)
+{
+    return commit_timings_series(DEFAULT_TIMING_SERIES, comm, collective_name, world_rank, comm_rank, jobid, times, comm_size, n_call);
+}
+
+int commit_timings_series(int series, MPI_Comm comm, char *collective_name, int world_rank, int comm_rank, int jobid, double *times, int comm_size, uint64_t n_call)
 {
     assert(times);
     comm_timing_logger_t *logger;
-    int rc = lookup_timing_logger(comm, &logger);
+    int rc = lookup_timing_logger(comm, series, &logger);
     if (rc || logger == NULL)
     {
         // We check first if the communicator is already known
@@ -154,7 +358,7 @@ int commit_timings(MPI_Comm comm, char *collective_name, int world_rank, int com
         }
 
         // Now we know the communicator, create a logger for it
-        rc = init_time_tracking(comm, collective_name, world_rank, comm_rank, jobid, &logger);
+        rc = init_time_tracking(series, comm, collective_name, world_rank, comm_rank, jobid, &logger);
         if (rc || logger == NULL)
         {
             fprintf(stderr, "unable to initialize time tracking (rc: %d)\n", rc);
@@ -163,24 +367,47 @@ int commit_timings(MPI_Comm comm, char *collective_name, int world_rank, int com
     }
     assert(logger);
 
-    if (logger->fd == NULL)
+    // In statistics mode only the online aggregates are maintained; nothing is
+    // stored or written until finalize.
+    if (timings_stats_enabled())
     {
-        assert(logger->filename);
-        logger->fd = fopen(logger->filename, "a");
+        update_timing_stats(logger, times, comm_size);
+        return 0;
     }
-    assert(logger->fd);
 
-    // We know from here we have a correct logger
-    int i;
-    fprintf(logger->fd, "# Call %" PRIu64 "\n", n_call);
-    for (i = 0; i < comm_size; i++)
+    // Append the raw timings to the in-memory buffers; the file itself is only
+    // touched when the flush threshold is reached (and at finalize). This cuts
+    // the per-call cost to a memcpy instead of a fopen/fprintf/fclose cycle.
+    if (logger->times_buffer_size + comm_size > logger->times_buffer_capacity)
+    {
+        size_t new_capacity = (logger->times_buffer_capacity == 0) ? 1024 : logger->times_buffer_capacity * 2;
+        while (new_capacity < logger->times_buffer_size + comm_size)
+        {
+            new_capacity *= 2;
+        }
+        logger->times_buffer = realloc(logger->times_buffer, new_capacity * sizeof(double));
+        assert(logger->times_buffer);
+        logger->times_buffer_capacity = new_capacity;
+    }
+    memcpy(&(logger->times_buffer[logger->times_buffer_size]), times, comm_size * sizeof(double));
+    logger->times_buffer_size += comm_size;
+
+    if (logger->num_buffered_calls == logger->buffered_calls_capacity)
+    {
+        size_t new_capacity = (logger->buffered_calls_capacity == 0) ? 128 : logger->buffered_calls_capacity * 2;
+        logger->calls_buffer = realloc(logger->calls_buffer, new_capacity * sizeof(uint64_t));
+        assert(logger->calls_buffer);
+        logger->sizes_buffer = realloc(logger->sizes_buffer, new_capacity * sizeof(int));
+        assert(logger->sizes_buffer);
+        logger->buffered_calls_capacity = new_capacity;
+    }
+    logger->calls_buffer[logger->num_buffered_calls] = n_call;
+    logger->sizes_buffer[logger->num_buffered_calls] = comm_size;
+    logger->num_buffered_calls++;
+
+    if (logger->times_buffer_size >= get_timings_flush_threshold())
     {
-        fprintf(logger->fd, "%f\n", times[i]);
+        return flush_timings(logger);
     }
-    fprintf(logger->fd, "\n");
-    // We experienced some unexpected IO problems when we do not close the file
-    // after the each alltoallv operation.
-    fclose(logger->fd);
-    logger->fd = NULL;
     return 0;
 }
@@ -10,18 +10,47 @@
 #include <inttypes.h>
 #include "mpi.h"
 
+// Timing series tracked by the loggers. Single-feature builds only ever use
+// one of them; the unified build keeps one logger per communicator and series.
+#define TIMING_SERIES_EXEC (0)
+#define TIMING_SERIES_LATE_ARRIVAL (1)
+#define NUM_TIMING_SERIES (2)
+
 typedef struct comm_timing_logger
 {
+    MPI_Comm comm;
+    int series; // TIMING_SERIES_EXEC or TIMING_SERIES_LATE_ARRIVAL
     uint32_t comm_id;
     FILE *fd;
     char *filename;
+    // In-memory timing accumulation: commit_timings() only appends the raw
+    // doubles and the call metadata here; the file is written in large chunks
+    // when the buffer reaches the flush threshold and at finalize.
+    double *times_buffer;
+    size_t times_buffer_size;     // Number of doubles currently buffered
+    size_t times_buffer_capacity; // Allocated number of doubles
+    uint64_t *calls_buffer;       // Call ID of each buffered call
+    int *sizes_buffer;            // Number of timings of each buffered call
+    size_t num_buffered_calls;
+    size_t buffered_calls_capacity;
+    // Online statistics mode (COLLECTIVE_PROFILER_TIMINGS_STATS=1): instead of
+    // storing every sample, keep per-rank aggregates (count, mean, variance via
+    // Welford, min/max) and a log-scale histogram, written once at finalize.
+    int stats_comm_size;
+    uint64_t stats_count; // Number of calls aggregated
+    double *stats_mean;
+    double *stats_m2; // Welford sum of squared deltas
+    double *stats_min;
+    double *stats_max;
+    uint64_t *stats_histogram;
     struct comm_timing_logger *next;
     struct comm_timing_logger *prev;
 } comm_timing_logger_t;
 
-int init_time_tracking(MPI_Comm comm, char *collective_name, int world_rank, int comm_rank, int jobid, comm_timing_logger_t **logger);
 int fini_time_tracking(comm_timing_logger_t **logger);
+int flush_timings(comm_timing_logger_t *logger);
 int release_time_loggers();
 int commit_timings(MPI_Comm comm, char *collective_name, int world_rank, int comm_rank, int jobid, double *times, int comm_size, uint64_t n_call);
+int commit_timings_series(int series, MPI_Comm comm, char *collective_name, int world_rank, int comm_rank, int jobid, double *times, int comm_size, uint64_t n_call);
 
 #endif // COLLECTIVE_PROFILER_TIMINGS_H
\ No newline at end of file
@@ -0,0 +1,105 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "collective_profiler_config.h"
+#include "common_utils.h"
+#include "validation_store.h"
+
+#define VALIDATION_STORE_INDEX_GROWTH (1024)
+
+validation_store_t *validation_store_open(const char *collective_name, int world_rank)
+{
+    char *filename = NULL;
+    int rc;
+
+    if (getenv(OUTPUT_DIR_ENVVAR))
+    {
+        _asprintf(filename, rc, "%s/validation_data-%s-rank%d.bin", getenv(OUTPUT_DIR_ENVVAR), collective_name, world_rank);
+    }
+    else
+    {
+        _asprintf(filename, rc, "validation_data-%s-rank%d.bin", collective_name, world_rank);
+    }
+    assert(rc > 0);
+
+    validation_store_t *store = (validation_store_t *)malloc(sizeof(validation_store_t));
+    assert(store);
+    store->writer = bin_writer_open(filename);
+    free(filename);
+    if (store->writer == NULL)
+    {
+        free(store);
+        return NULL;
+    }
+
+    store->offset = 0;
+    store->index = NULL;
+    store->num_records = 0;
+    store->max_records = 0;
+
+    bin_writer_u32(store->writer, VALIDATION_STORE_MAGIC);
+    bin_writer_u32(store->writer, VALIDATION_STORE_VERSION);
+    store->offset += 2 * sizeof(uint32_t);
+
+    return store;
+}
+
+int validation_store_append(validation_store_t *store, uint64_t call_id, int size,
+                            const int *sendcounts, const int *recvcounts)
+{
+    assert(store);
+
+    if (store->num_records == store->max_records)
+    {
+        store->max_records += VALIDATION_STORE_INDEX_GROWTH;
+        store->index = (validation_store_index_entry_t *)realloc(store->index, store->max_records * sizeof(validation_store_index_entry_t));
+        assert(store->index);
+    }
+    store->index[store->num_records].call_id = call_id;
+    store->index[store->num_records].offset = store->offset;
+    store->num_records++;
+
+    if (bin_writer_u64(store->writer, call_id) ||
+        bin_writer_u32(store->writer, (uint32_t)size) ||
+        bin_writer_write(store->writer, sendcounts, size * sizeof(int)) ||
+        bin_writer_write(store->writer, recvcounts, size * sizeof(int)))
+    {
+        return 1;
+    }
+    store->offset += sizeof(uint64_t) + sizeof(uint32_t) + 2 * size * sizeof(int);
+    return 0;
+}
+
+int validation_store_close(validation_store_t **store)
+{
+    if (store == NULL || *store == NULL)
+    {
+        return 0;
+    }
+
+    validation_store_t *s = *store;
+    uint64_t index_offset = s->offset;
+    uint32_t i;
+
+    for (i = 0; i < s->num_records; i++)
+    {
+        bin_writer_u64(s->writer, s->index[i].call_id);
+        bin_writer_u64(s->writer, s->index[i].offset);
+    }
+    bin_writer_u64(s->writer, index_offset);
+    bin_writer_u32(s->writer, s->num_records);
+    bin_writer_u32(s->writer, VALIDATION_STORE_MAGIC);
+
+    int rc = bin_writer_close(&(s->writer));
+    free(s->index);
+    free(s);
+    *store = NULL;
+    return rc;
+}
@@ -0,0 +1,56 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef COLLECTIVE_PROFILER_VALIDATION_STORE_H
+#define COLLECTIVE_PROFILER_VALIDATION_STORE_H
+
+#include <stdint.h>
+
+#include "bin_writer.h"
+
+// Aggregated store for validation data: one append-only binary file per rank
+// instead of one text file per rank per call, so large validation runs create
+// thousands of times fewer files and do not overwhelm the metadata servers of
+// parallel file systems.
+//
+// File layout:
+//   header:  u32 magic, u32 version
+//   records: { u64 call_id, u32 size, int32 send[size], int32 recv[size] } *
+//   index:   { u64 call_id, u64 offset } * num_records
+//   trailer: u64 index_offset, u32 num_records, u32 magic
+// The index is accumulated in memory and appended at close; a reader loads the
+// trailer and index and can seek directly to the records of a call.
+
+#define VALIDATION_STORE_MAGIC (0x56414C44) // "VALD"
+#define VALIDATION_STORE_VERSION (1)
+
+typedef struct validation_store_index_entry
+{
+    uint64_t call_id;
+    uint64_t offset;
+} validation_store_index_entry_t;
+
+typedef struct validation_store
+{
+    bin_writer_t *writer;
+    uint64_t offset; // Current write position, tracked to avoid ftell on a buffered stream
+    validation_store_index_entry_t *index;
+    uint32_t num_records;
+    uint32_t max_records;
+} validation_store_t;
+
+// Open <output dir>/validation_data-<collective>-rank<n>.bin for appending
+// records. Returns NULL on failure.
+validation_store_t *validation_store_open(const char *collective_name, int world_rank);
+
+// Append the send/recv counts of one call and record it in the index.
+int validation_store_append(validation_store_t *store, uint64_t call_id, int size,
+                            const int *sendcounts, const int *recvcounts);
+
+// Append the index and trailer, flush and free the store.
+int validation_store_close(validation_store_t **store);
+
+#endif // COLLECTIVE_PROFILER_VALIDATION_STORE_H
@@ -4,4 +4,4 @@
 #
 
 # Avoid duplicating the list of common objects is makefiles.
-COMMON_OBJECTS=../common/format.o ../common/comm.o ../common/backtrace.o ../common/grouping.o ../common/location.o
\ No newline at end of file
+COMMON_OBJECTS=../common/format.o ../common/comm.o ../common/backtrace.o ../common/grouping.o ../common/location.o ../common/arena.o ../common/pattern.o ../common/bin_writer.o ../common/validation_store.o ../common/compress.o ../common/node_aggregate.o
\ No newline at end of file
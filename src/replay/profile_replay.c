@@ -0,0 +1,574 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+// profile_replay: re-executes the communication pattern recorded in a pair of
+// counters files (send-counters.job<j>.rank<r>.txt /
+// recv-counters.job<j>.rank<r>.txt) on synthetic buffers. The profiles
+// already contain everything a faithful communication benchmark needs: the
+// exact count matrix of every call, the datatype sizes and the call ordering
+// (the per-section call lists), and the rank lists say which comm rank sent
+// which row. Replaying them lets MPI library tunings (algorithm selection,
+// rendezvous thresholds) be evaluated against production patterns without
+// burning production node-hours.
+//
+// The collective is detected from the row shapes: full rows on both sides is
+// alltoallv, single-count rows on both sides is alltoall, and a single send
+// count with full receive rows is allgatherv. Data is moved as MPI_BYTE with
+// the counts scaled by the recorded datatype size, so message sizes match the
+// original run exactly. The first <Number of ranks> ranks of the job replay
+// the calls in recorded order; a run profiled over several communicators is
+// replayed one counters-file pair at a time.
+//
+// Usage: mpirun -np <N> profile_replay [-n iters] <send-counters> <recv-counters>
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <mpi.h>
+
+// One "# Raw counters" block of a counters file, reduced to what this rank
+// needs: the calls it covers and this comm rank's count row.
+typedef struct section
+{
+    int num_ranks;
+    int type_size;
+    uint64_t num_calls;
+    uint64_t *calls; // Expanded call IDs, in recorded order
+    int row_len;     // Ints in this rank's row (comm size or 1)
+    int *row;        // This comm rank's counts; NULL when the rank is not listed
+} section_t;
+
+typedef struct profile_side
+{
+    section_t *sections;
+    size_t num_sections;
+    int num_ranks; // Communicator size, consistent across sections
+} profile_side_t;
+
+// One replayed call: the originating section on each side, looked up once
+// while building the schedule.
+typedef struct replay_call
+{
+    uint64_t call_id;
+    section_t *send;
+    section_t *recv;
+} replay_call_t;
+
+static const char *next_line(const char *pos, const char *end)
+{
+    const char *nl = memchr(pos, '\n', (size_t)(end - pos));
+    return (nl == NULL) ? end : nl + 1;
+}
+
+static const char *parse_u64(const char *pos, const char *end, uint64_t *value)
+{
+    uint64_t v = 0;
+    if (pos >= end || !isdigit((unsigned char)*pos))
+    {
+        return NULL;
+    }
+    while (pos < end && isdigit((unsigned char)*pos))
+    {
+        v = v * 10 + (uint64_t)(*pos - '0');
+        pos++;
+    }
+    *value = v;
+    return pos;
+}
+
+// Expand a compressed ID list ("0-5, 7, 9-10") terminated by a newline.
+// When <out> is NULL only counts the IDs; otherwise fills the array.
+static int expand_id_list(const char *pos, const char *end, uint64_t *out, uint64_t *num_out)
+{
+    uint64_t n = 0;
+    while (pos < end && *pos != '\n')
+    {
+        uint64_t first, last;
+        pos = parse_u64(pos, end, &first);
+        if (pos == NULL)
+        {
+            return -1;
+        }
+        last = first;
+        if (pos < end && *pos == '-')
+        {
+            pos = parse_u64(pos + 1, end, &last);
+            if (pos == NULL)
+            {
+                return -1;
+            }
+        }
+        uint64_t id;
+        for (id = first; id <= last; id++)
+        {
+            if (out != NULL)
+            {
+                out[n] = id;
+            }
+            n++;
+        }
+        while (pos < end && (*pos == ',' || *pos == ' '))
+        {
+            pos++;
+        }
+    }
+    *num_out = n;
+    return 0;
+}
+
+static int id_list_contains(const char *pos, const char *end, uint64_t id)
+{
+    while (pos < end && *pos != ':' && *pos != '\n')
+    {
+        uint64_t first, last;
+        pos = parse_u64(pos, end, &first);
+        if (pos == NULL)
+        {
+            return 0;
+        }
+        last = first;
+        if (pos < end && *pos == '-')
+        {
+            pos = parse_u64(pos + 1, end, &last);
+            if (pos == NULL)
+            {
+                return 0;
+            }
+        }
+        if (id >= first && id <= last)
+        {
+            return 1;
+        }
+        while (pos < end && (*pos == ',' || *pos == ' '))
+        {
+            pos++;
+        }
+    }
+    return 0;
+}
+
+static const char *map_file(const char *path, size_t *size_out)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    const char *data = (const char *)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return NULL;
+    }
+    *size_out = (size_t)st.st_size;
+    return data;
+}
+
+#define PREFIX_MATCHES(pos, end, lit) \
+    ((size_t)((end) - (pos)) >= sizeof(lit) - 1 && memcmp((pos), (lit), sizeof(lit) - 1) == 0)
+
+// Parse every section of a counters file, keeping only <my_rank>'s rows.
+static int parse_profile_side(const char *path, int my_rank, profile_side_t *side)
+{
+    size_t size = 0;
+    const char *data = map_file(path, &size);
+    if (data == NULL)
+    {
+        fprintf(stderr, "[ERROR] cannot read %s\n", path);
+        return -1;
+    }
+    const char *end = data + size;
+    const char *pos = data;
+
+    memset(side, 0, sizeof(*side));
+    section_t *cur = NULL;
+    int in_data = 0;
+
+    while (pos < end)
+    {
+        const char *line_end = memchr(pos, '\n', (size_t)(end - pos));
+        if (line_end == NULL)
+        {
+            line_end = end;
+        }
+
+        if (PREFIX_MATCHES(pos, end, "# Raw counters"))
+        {
+            side->sections = (section_t *)realloc(side->sections, (side->num_sections + 1) * sizeof(section_t));
+            assert(side->sections);
+            cur = &side->sections[side->num_sections];
+            side->num_sections++;
+            memset(cur, 0, sizeof(*cur));
+            in_data = 0;
+        }
+        else if (cur != NULL && PREFIX_MATCHES(pos, end, "Number of ranks: "))
+        {
+            uint64_t v;
+            if (parse_u64(pos + strlen("Number of ranks: "), end, &v) != NULL)
+            {
+                cur->num_ranks = (int)v;
+            }
+        }
+        else if (cur != NULL && PREFIX_MATCHES(pos, end, "Datatype size: "))
+        {
+            uint64_t v;
+            if (parse_u64(pos + strlen("Datatype size: "), end, &v) != NULL)
+            {
+                cur->type_size = (int)v;
+            }
+        }
+        else if (cur != NULL && PREFIX_MATCHES(pos, end, "Count: "))
+        {
+            const char *list = memchr(pos, '-', (size_t)(line_end - pos));
+            if (list != NULL)
+            {
+                list += 2; // Skip "- "
+                if (expand_id_list(list, line_end, NULL, &cur->num_calls) != 0)
+                {
+                    return -1;
+                }
+                cur->calls = (uint64_t *)malloc(cur->num_calls * sizeof(uint64_t));
+                assert(cur->calls);
+                expand_id_list(list, line_end, cur->calls, &cur->num_calls);
+            }
+        }
+        else if (cur != NULL && PREFIX_MATCHES(pos, end, "BEGINNING DATA"))
+        {
+            in_data = 1;
+        }
+        else if (cur != NULL && PREFIX_MATCHES(pos, end, "END DATA"))
+        {
+            in_data = 0;
+        }
+        else if (cur != NULL && in_data && PREFIX_MATCHES(pos, end, "Rank(s) "))
+        {
+            const char *list = pos + strlen("Rank(s) ");
+            if (cur->row == NULL && id_list_contains(list, line_end, (uint64_t)my_rank))
+            {
+                const char *values = memchr(list, ':', (size_t)(line_end - list));
+                if (values == NULL)
+                {
+                    return -1;
+                }
+                values += 2; // Skip ": "
+                // First pass counts the ints of the row, second pass stores them
+                const char *p = values;
+                int n = 0;
+                uint64_t v;
+                while (p < line_end && (p = parse_u64(p, line_end, &v)) != NULL)
+                {
+                    n++;
+                    while (p < line_end && *p == ' ')
+                    {
+                        p++;
+                    }
+                }
+                cur->row_len = n;
+                cur->row = (int *)malloc(n * sizeof(int));
+                assert(cur->row);
+                p = values;
+                n = 0;
+                while (p < line_end && (p = parse_u64(p, line_end, &v)) != NULL)
+                {
+                    cur->row[n++] = (int)v;
+                    while (p < line_end && *p == ' ')
+                    {
+                        p++;
+                    }
+                }
+            }
+        }
+
+        pos = next_line(pos, end);
+    }
+
+    munmap((void *)data, size);
+
+    if (side->num_sections == 0)
+    {
+        fprintf(stderr, "[ERROR] no counter sections in %s\n", path);
+        return -1;
+    }
+    side->num_ranks = side->sections[0].num_ranks;
+    return 0;
+}
+
+static section_t *section_for_call(profile_side_t *side, uint64_t call_id)
+{
+    size_t s;
+    uint64_t c;
+    for (s = 0; s < side->num_sections; s++)
+    {
+        for (c = 0; c < side->sections[s].num_calls; c++)
+        {
+            if (side->sections[s].calls[c] == call_id)
+            {
+                return &side->sections[s];
+            }
+        }
+    }
+    return NULL;
+}
+
+static int compare_calls(const void *a, const void *b)
+{
+    uint64_t ca = ((const replay_call_t *)a)->call_id;
+    uint64_t cb = ((const replay_call_t *)b)->call_id;
+    if (ca < cb)
+    {
+        return -1;
+    }
+    return (ca > cb) ? 1 : 0;
+}
+
+// Rebuild the recorded call ordering: every call ID of the send side, sorted,
+// paired with the receive section covering the same call.
+static int build_schedule(profile_side_t *send, profile_side_t *recv, replay_call_t **calls_out, size_t *num_out)
+{
+    size_t total = 0, s, i = 0;
+    uint64_t c;
+    for (s = 0; s < send->num_sections; s++)
+    {
+        total += send->sections[s].num_calls;
+    }
+    replay_call_t *calls = (replay_call_t *)malloc(total * sizeof(replay_call_t));
+    assert(calls);
+    for (s = 0; s < send->num_sections; s++)
+    {
+        for (c = 0; c < send->sections[s].num_calls; c++)
+        {
+            calls[i].call_id = send->sections[s].calls[c];
+            calls[i].send = &send->sections[s];
+            calls[i].recv = section_for_call(recv, calls[i].call_id);
+            if (calls[i].recv == NULL)
+            {
+                fprintf(stderr, "[ERROR] call %" PRIu64 " has no receive counts\n", calls[i].call_id);
+                free(calls);
+                return -1;
+            }
+            i++;
+        }
+    }
+    qsort(calls, total, sizeof(replay_call_t), compare_calls);
+    *calls_out = calls;
+    *num_out = total;
+    return 0;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [-n iters] <send-counters-file> <recv-counters-file>\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    int iters = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            iters = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind + 2 > argc || iters < 1)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    MPI_Init(&argc, &argv);
+    int world_rank, world_size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+    profile_side_t send_side, recv_side;
+    if (parse_profile_side(argv[optind], world_rank, &send_side) != 0 ||
+        parse_profile_side(argv[optind + 1], world_rank, &recv_side) != 0)
+    {
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    int num_ranks = send_side.num_ranks;
+    if (world_size < num_ranks)
+    {
+        if (world_rank == 0)
+        {
+            fprintf(stderr, "[ERROR] profile was recorded on %d ranks, job has %d\n", num_ranks, world_size);
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // The first <num_ranks> ranks of the job replay the communicator; the
+    // comm rank equals the world rank, matching the rank lists of the file.
+    MPI_Comm comm;
+    MPI_Comm_split(MPI_COMM_WORLD, (world_rank < num_ranks) ? 0 : MPI_UNDEFINED, world_rank, &comm);
+    if (comm == MPI_COMM_NULL)
+    {
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Finalize();
+        return EXIT_SUCCESS;
+    }
+
+    replay_call_t *calls = NULL;
+    size_t num_calls = 0;
+    if (build_schedule(&send_side, &recv_side, &calls, &num_calls) != 0)
+    {
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Detect the collective from the row shapes and size the buffers for the
+    // biggest call of the sequence.
+    int send_row_len = calls[0].send->row_len;
+    int recv_row_len = calls[0].recv->row_len;
+    const char *collective = "unknown"; // MPI_Abort below does not return
+    if (send_row_len == num_ranks && recv_row_len == num_ranks)
+    {
+        collective = "alltoallv";
+    }
+    else if (send_row_len == 1 && recv_row_len == 1)
+    {
+        collective = "alltoall";
+    }
+    else if (send_row_len == 1 && recv_row_len == num_ranks)
+    {
+        collective = "allgatherv";
+    }
+    else
+    {
+        fprintf(stderr, "[ERROR] unrecognized row shapes (%d send, %d recv ints for %d ranks)\n",
+                send_row_len, recv_row_len, num_ranks);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    size_t max_send_bytes = 0, max_recv_bytes = 0, call;
+    int peer;
+    for (call = 0; call < num_calls; call++)
+    {
+        assert(calls[call].send->row != NULL && calls[call].recv->row != NULL);
+        size_t sb = 0, rb = 0;
+        for (peer = 0; peer < calls[call].send->row_len; peer++)
+        {
+            sb += (size_t)calls[call].send->row[peer] * calls[call].send->type_size;
+        }
+        for (peer = 0; peer < calls[call].recv->row_len; peer++)
+        {
+            rb += (size_t)calls[call].recv->row[peer] * calls[call].recv->type_size;
+        }
+        if (send_row_len == 1)
+        {
+            sb *= num_ranks; // Single recorded count, sent to every peer
+        }
+        if (recv_row_len == 1)
+        {
+            rb *= num_ranks;
+        }
+        if (sb > max_send_bytes)
+        {
+            max_send_bytes = sb;
+        }
+        if (rb > max_recv_bytes)
+        {
+            max_recv_bytes = rb;
+        }
+    }
+
+    char *sbuf = (char *)malloc(max_send_bytes ? max_send_bytes : 1);
+    char *rbuf = (char *)malloc(max_recv_bytes ? max_recv_bytes : 1);
+    int *scounts = (int *)malloc(num_ranks * sizeof(int));
+    int *sdispls = (int *)malloc(num_ranks * sizeof(int));
+    int *rcounts = (int *)malloc(num_ranks * sizeof(int));
+    int *rdispls = (int *)malloc(num_ranks * sizeof(int));
+    assert(sbuf && rbuf && scounts && sdispls && rcounts && rdispls);
+    memset(sbuf, world_rank & 0xff, max_send_bytes);
+
+    MPI_Barrier(comm);
+    double t_start = MPI_Wtime();
+    int iter;
+    for (iter = 0; iter < iters; iter++)
+    {
+        for (call = 0; call < num_calls; call++)
+        {
+            section_t *snd = calls[call].send;
+            section_t *rcv = calls[call].recv;
+            if (send_row_len == 1 && recv_row_len == 1)
+            {
+                MPI_Alltoall(sbuf, snd->row[0] * snd->type_size, MPI_BYTE,
+                             rbuf, rcv->row[0] * rcv->type_size, MPI_BYTE, comm);
+            }
+            else if (send_row_len == 1)
+            {
+                int offset = 0;
+                for (peer = 0; peer < num_ranks; peer++)
+                {
+                    rcounts[peer] = rcv->row[peer] * rcv->type_size;
+                    rdispls[peer] = offset;
+                    offset += rcounts[peer];
+                }
+                MPI_Allgatherv(sbuf, snd->row[0] * snd->type_size, MPI_BYTE,
+                               rbuf, rcounts, rdispls, MPI_BYTE, comm);
+            }
+            else
+            {
+                int soffset = 0, roffset = 0;
+                for (peer = 0; peer < num_ranks; peer++)
+                {
+                    scounts[peer] = snd->row[peer] * snd->type_size;
+                    sdispls[peer] = soffset;
+                    soffset += scounts[peer];
+                    rcounts[peer] = rcv->row[peer] * rcv->type_size;
+                    rdispls[peer] = roffset;
+                    roffset += rcounts[peer];
+                }
+                MPI_Alltoallv(sbuf, scounts, sdispls, MPI_BYTE,
+                              rbuf, rcounts, rdispls, MPI_BYTE, comm);
+            }
+        }
+        MPI_Barrier(comm);
+    }
+    double elapsed = MPI_Wtime() - t_start;
+    double elapsed_max;
+    MPI_Reduce(&elapsed, &elapsed_max, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+    if (world_rank == 0)
+    {
+        printf("REPLAY %s np=%d calls=%zu iters=%d total_s=%.6f mean_call_us=%.3f\n",
+               collective, num_ranks, num_calls, iters, elapsed_max,
+               elapsed_max * 1e6 / ((double)num_calls * iters));
+    }
+
+    free(sbuf);
+    free(rbuf);
+    free(scounts);
+    free(sdispls);
+    free(rcounts);
+    free(rdispls);
+    free(calls);
+    MPI_Comm_free(&comm);
+    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Finalize();
+    return EXIT_SUCCESS;
+}